@@ -10,6 +10,9 @@
 #include <algorithm>
 #include "types.h"
 #include "device.h"
+#include "debugpoints.h"
+#include "fetchbuffer.h"
+#include "memtiming.h"
 
 namespace soc {
 
@@ -31,7 +34,8 @@ public:
     enum BusOperationType {
         BUSOP_RESET,
         BUSOP_READ,
-        BUSOP_WRITE
+        BUSOP_WRITE,
+        BUSOP_FETCH     // instruction read, not seen by watchpoints
     };
 
     struct AddressRange
@@ -48,10 +52,25 @@ private:
         Device *device;
         bool addressable;
         AddressRange addrRange;
+        bool cacheable;     // no earlier device overlaps the range
     };
 
     std::vector<DeviceContext> mDevices;
 
+    // Index of the device found last, firmware polling a register or
+    // running from memory hits the same device again and again
+    size_t mLastHit;
+
+    // Breakpoints and watchpoints, NULL when not debugging
+    DebugPoints *mDebugPoints;
+
+    // Cache and TLB model of the timed device, NULL when not timing
+    MemoryTiming *mTiming;
+    Device *mTimedDevice;
+
+    // Fetch buffers of the CPUs, dropped when their line is written
+    std::vector<FetchBuffer*> mFetchBuffers;
+
 
 protected:
     /**
@@ -64,6 +83,17 @@ protected:
     {
         std::vector<DeviceContext>::const_iterator it;
 
+        // Check the device found last
+        if (mLastHit < mDevices.size()) {
+            const DeviceContext &last = mDevices[mLastHit];
+
+            if ((address >= last.addrRange.start) &&
+                (address <= last.addrRange.end)) {
+                ctx = last;
+                return true;
+            }
+        }
+
         // Iterate through devices connected to the bus
         for (it=mDevices.begin(); it != mDevices.end(); ++it) {
             // Check to see if the device is addressable
@@ -76,7 +106,11 @@ protected:
             // Check if address matches device
             if (address >= it->addrRange.start) {
                 if (address <= it->addrRange.end) {
-                    // found device
+                    // found device, the first device to match wins so
+                    // only remember it if no earlier device overlaps it
+                    if (it->cacheable) {
+                        mLastHit = it - mDevices.begin();
+                    }
                     ctx = *it;
                     return true;
                 }
@@ -111,6 +145,30 @@ protected:
         return false;
     }
 
+    /**
+     * @brief Marks the devices the last hit may remember, called when
+     *        devices are attached or removed
+     */
+    void updateDeviceCache()
+    {
+        mLastHit = mDevices.size();
+
+        for (size_t i=0; i<mDevices.size(); ++i) {
+            DeviceContext &dev = mDevices[i];
+
+            dev.cacheable = dev.addressable;
+            for (size_t j=0; (j < i) && dev.cacheable; ++j) {
+                const DeviceContext &earlier = mDevices[j];
+
+                if (earlier.addressable &&
+                    (earlier.addrRange.start <= dev.addrRange.end) &&
+                    (dev.addrRange.start <= earlier.addrRange.end)) {
+                    dev.cacheable = false;
+                }
+            }
+        }
+    }
+
     /**
      * @brief Resets every device attached to the bus
      * @return true if no error reseting devices, otherwise false
@@ -119,6 +177,8 @@ protected:
     {
         std::vector<DeviceContext>::const_iterator it;
 
+        invalidateFetchBuffers(0, 0);
+
         // Iterate through devices
         for (it=mDevices.begin(); it != mDevices.end(); ++it) {
             // For each device reset it
@@ -132,12 +192,32 @@ protected:
     }
 
 
+    /**
+     * @brief Drops fetched lines overlapping a write
+     * @param address first address written
+     * @param size bytes written, 0 drops every line
+     */
+    void invalidateFetchBuffers(BusAddressType address, U32 size)
+    {
+        std::vector<FetchBuffer*>::const_iterator it;
+
+        for (it=mFetchBuffers.begin(); it != mFetchBuffers.end(); ++it) {
+            if (size == 0) {
+                (*it)->invalidate();
+            } else {
+                (*it)->invalidate(address, size);
+            }
+        }
+    }
+
+
 public:
     /**
      * @brief Constructor, initializes bus
      * @return nothing
      */
     Bus()
+        : mLastHit(0), mDebugPoints(NULL), mTiming(NULL), mTimedDevice(NULL)
     {
         mDevices.clear();
     }
@@ -188,6 +268,7 @@ public:
             }
 
             mDevices.push_back(dev);
+            updateDeviceCache();
 
             return true;
         } else {
@@ -197,6 +278,16 @@ public:
         }
     }
 
+    /**
+     * @brief Sizes the device table once, so attaching that many
+     *        devices does not reallocate it
+     * @param count number of devices that will be attached
+     */
+    void reserveDevices(size_t count)
+    {
+        mDevices.reserve(count);
+    }
+
     /**
      * @brief Removes a device from the bus
      * @param device actual device to remove
@@ -212,6 +303,7 @@ public:
             if (it->device == device) {
                 // Found it, remove it from device list
                 mDevices.erase(it);
+                updateDeviceCache();
                 return true;
             }
         }
@@ -219,6 +311,106 @@ public:
         return false;
     }
 
+    /**
+     * @brief Sets the breakpoints and watchpoints checked by the bus
+     *        and its CPUs
+     * @param points points to check, NULL to stop checking
+     */
+    void setDebugPoints(DebugPoints *points)
+    {
+        mDebugPoints = points;
+    }
+
+    /**
+     * @brief Returns the breakpoints and watchpoints of the bus
+     * @return ptr to points, NULL when not debugging
+     */
+    DebugPoints *getDebugPoints()
+    {
+        return mDebugPoints;
+    }
+
+    /**
+     * @brief Puts a cache and TLB model in front of a device, every
+     *        access to it is passed to the model. A fetch buffer hit is
+     *        not seen by the bus, so the instruction cache sees one
+     *        access per line fetched; the line was just used, so only
+     *        hits are missed.
+     * @param timing model, NULL to stop timing
+     * @param device device timed, normally memory
+     */
+    void setMemoryTiming(MemoryTiming *timing, Device *device)
+    {
+        mTiming = timing;
+        mTimedDevice = (timing != NULL) ? device : NULL;
+    }
+
+    /**
+     * @brief Returns the cache and TLB model of the bus
+     * @return ptr to model, NULL when not timing
+     */
+    MemoryTiming *getMemoryTiming()
+    {
+        return mTiming;
+    }
+
+    /**
+     * @brief Adds a fetch buffer to drop when its line is written
+     * @param buffer buffer filled by fetchLine
+     */
+    void attachFetchBuffer(FetchBuffer *buffer)
+    {
+        if (std::find(mFetchBuffers.begin(), mFetchBuffers.end(),
+                      buffer) == mFetchBuffers.end()) {
+            mFetchBuffers.push_back(buffer);
+        }
+    }
+
+    /**
+     * @brief Removes a fetch buffer added with attachFetchBuffer
+     * @param buffer buffer to remove
+     */
+    void detachFetchBuffer(FetchBuffer *buffer)
+    {
+        mFetchBuffers.erase(std::remove(mFetchBuffers.begin(),
+                                        mFetchBuffers.end(), buffer),
+                            mFetchBuffers.end());
+    }
+
+    /**
+     * @brief Loads the line holding an address in to a fetch buffer
+     *        with one device lookup and one block read
+     * @param address any address in the line
+     * @param buffer buffer to load
+     * @return true if success, false if the line is not entirely in one
+     *         device, fetch a word at a time instead
+     */
+    bool fetchLine(BusAddressType address, FetchBuffer &buffer)
+    {
+        BusAddressType line = FetchBuffer::lineOf(address);
+        DeviceContext dev;
+
+        buffer.invalidate();
+
+        if (!findDevice(line, dev) ||
+            ((line + FetchBuffer::LINE_SIZE - 1) > dev.addrRange.end)) {
+            return false;
+        }
+
+        if ((mTiming != NULL) && (dev.device == mTimedDevice)) {
+            mTiming->access(TIMING_FETCH, line);
+        }
+
+        if (!dev.device->readBlock(line, buffer.words(),
+                                   FetchBuffer::LINE_WORDS)) {
+            return false;
+        }
+
+        buffer.validate(line);
+
+        return true;
+    }
+
     /**
      * @brief Performs a request put on the bus
      * @param op Bus Operation
@@ -233,20 +425,30 @@ public:
 
         if (op == BUSOP_RESET) {
             // Request to reset system
-            retval = resetAll();
-        } else if (findDevice(address, dev)) {
+            return resetAll();
+        }
+
+        if ((mDebugPoints != NULL) && (op != BUSOP_FETCH)) {
+            mDebugPoints->checkAccess((op == BUSOP_WRITE) ?
+                                          DebugPoints::DEBUG_WATCH_WRITE :
+                                          DebugPoints::DEBUG_WATCH_READ,
+                                      address, sizeof(data));
+        }
+
+        if (findDevice(address, dev)) {
             // found device that corresponds to address given
             if (op == BUSOP_WRITE) {
                 // write operation was requested, perform
                 // write action on device
                 if (dev.device->write(address, data)) {
                     // success
+                    invalidateFetchBuffers(address, sizeof(data));
                     retval = true;
                 } else {
                     // device error
                 }
-            } else if (op == BUSOP_READ) {
-                // read operation was requested, perform
+            } else {
+                // read or fetch operation was requested, perform
                 // read action on device
                 if (dev.device->read(address, data)) {
                     // success
@@ -255,6 +457,15 @@ public:
                     // device error
                 }
             }
+
+            // Timed after the device, so a slow host read is under way
+            // while the model runs; nothing it does depends on the data
+            if ((mTiming != NULL) && (dev.device == mTimedDevice)) {
+                mTiming->access((op == BUSOP_WRITE) ? TIMING_WRITE :
+                                (op == BUSOP_FETCH) ? TIMING_FETCH :
+                                                      TIMING_READ,
+                                address);
+            }
         } else {
             // unable to find device associated
             // with the address, bus error
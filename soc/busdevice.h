@@ -36,6 +36,15 @@ protected:
 
 
 public:
+    /**
+     * @brief Constructor, not attached to a bus
+     * @return nothing
+     */
+    BusDevice()
+        : mBus(NULL)
+    {
+    }
+
     /**
      * @brief Attaches device to specific bus
      * @param bus specific bus to connect to
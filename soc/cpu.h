@@ -40,6 +40,58 @@ protected:
 
     CPUContext mContext;
 
+    // PC after reset
+    BusAddressType mResetAddress;
+
+    // Line of instructions being executed
+    FetchBuffer mFetch;
+
+
+protected:
+    /**
+     * @brief Reads an instruction, a whole line is read from the bus at
+     *        once and sequential fetches are served from it
+     * @param address address of the instruction
+     * @param data location to store the instruction
+     * @return true if success, otherwise false
+     */
+    bool fetch(BusAddressType address, BusDataType &data)
+    {
+        if (mFetch.lookup(address, data)) {
+            return true;
+        }
+
+        if (getBus()->fetchLine(address, mFetch) &&
+            mFetch.lookup(address, data)) {
+            return true;
+        }
+
+        return getBus()->request(Bus::BUSOP_FETCH, address, data);
+    }
+
+    /**
+     * @brief Checks the breakpoints of the bus before an instruction
+     * @return true if the CPU must stop before the instruction at pc
+     */
+    bool stopAtBreakpoint()
+    {
+        DebugPoints *points = getBus()->getDebugPoints();
+
+        return (points != NULL) &&
+               points->checkBreakpoint(mContext.reg[REG_PC]);
+    }
+
+    /**
+     * @brief Checks whether a watchpoint was hit by the last instruction
+     * @return true if the CPU must stop after the instruction
+     */
+    bool stopAtWatchpoint()
+    {
+        DebugPoints *points = getBus()->getDebugPoints();
+
+        return (points != NULL) && points->stopped();
+    }
+
 
 public:
     /**
@@ -47,6 +99,7 @@ public:
      * @return nothing
      */
     CPU()
+        : mResetAddress(RESET_ADDRESS)
     {
     }
 
@@ -56,6 +109,30 @@ public:
      */
     virtual ~CPU()
     {
+        if (getBus() != NULL) {
+            getBus()->detachFetchBuffer(&mFetch);
+        }
+    }
+
+    /**
+     * @brief Attaches the CPU to a bus, its fetch buffer is dropped by
+     *        writes on that bus
+     * @param bus specific bus to connect to
+     * @param devType master or slave
+     * @param addrRange addressable range of device
+     * @return true if success, otherwise false
+     */
+    virtual bool attachToBus(Bus *bus,
+                             Bus::BusDeviceType devType,
+                             const Bus::AddressRange *addrRange)
+    {
+        if (!BusDevice::attachToBus(bus, devType, addrRange)) {
+            return false;
+        }
+
+        bus->attachFetchBuffer(&mFetch);
+
+        return true;
     }
 
     /**
@@ -66,7 +143,11 @@ public:
     {
         BusDataType data;
 
-        if (getBus()->request(Bus::BUSOP_READ, mContext.reg[REG_PC], data)) {
+        if (stopAtBreakpoint()) {
+            return false;
+        }
+
+        if (fetch(mContext.reg[REG_PC], data)) {
             mContext.reg[REG_PC] += INSTRUCTION_SIZE;
             // do something
             return true;
@@ -89,11 +170,21 @@ public:
         }
 
         // Set PC to reset address
-        mContext.reg[REG_PC] = RESET_ADDRESS;
+        mContext.reg[REG_PC] = mResetAddress;
+        mFetch.invalidate();
 
         return true;
     }
 
+    /**
+     * @brief Sets the address the CPU starts from after a reset
+     * @param address reset vector, must be aligned to an instruction
+     */
+    void setResetAddress(BusAddressType address)
+    {
+        mResetAddress = address;
+    }
+
     /**
      * @brief Default read operation
      * @param address address to read from
@@ -0,0 +1,275 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes breakpoints and watchpoints
+ */
+
+#ifndef _SOC_DEBUGPOINTS_H
+#define _SOC_DEBUGPOINTS_H
+
+#include <vector>
+#include "types.h"
+
+namespace soc {
+
+/**
+ * @class DebugPoints
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file debugpoints.h
+ * @brief Breakpoints and watchpoints of a bus. Every kind keeps a
+ *        bitmap of the pages it covers, an address in any other page
+ *        is rejected with one bit test.
+ */
+class DebugPoints
+{
+public:
+    enum DebugKind {
+        DEBUG_BREAK_EXECUTE,
+        DEBUG_WATCH_READ,
+        DEBUG_WATCH_WRITE,
+        DEBUG_KIND_COUNT
+    };
+
+    enum {
+        PAGE_SHIFT = 12
+    };
+
+    struct Hit
+    {
+        DebugKind kind;
+        BusAddressType address;     // address that matched
+    };
+
+
+private:
+    struct Point
+    {
+        DebugKind kind;
+        BusAddressType first;
+        BusAddressType last;
+    };
+
+    std::vector<Point> mPoints;
+
+    // One bit per page, only as long as the highest page with a point
+    std::vector<U64> mPageBits[DEBUG_KIND_COUNT];
+
+    Hit mHit;
+    bool mStopped;
+    bool mStepOver;
+
+
+protected:
+    /**
+     * @brief Sets the page bits of every page a point covers
+     * @param point point to add to the bitmap
+     */
+    void setPages(const Point &point)
+    {
+        std::vector<U64> &bits = mPageBits[point.kind];
+        U32 lastPage = point.last >> PAGE_SHIFT;
+
+        if (bits.size() <= (lastPage >> 6)) {
+            bits.resize((lastPage >> 6) + 1, 0);
+        }
+
+        for (U32 page=(point.first >> PAGE_SHIFT); page<=lastPage; ++page) {
+            bits[page >> 6] |= (1ULL << (page & 63));
+        }
+    }
+
+    /**
+     * @brief Tests the page bit of an address
+     * @param kind kind of point
+     * @param address any address in the page
+     * @return true if the page has a point of kind
+     */
+    bool pageSet(DebugKind kind, BusAddressType address) const
+    {
+        const std::vector<U64> &bits = mPageBits[kind];
+        U32 page = address >> PAGE_SHIFT;
+
+        if ((page >> 6) >= bits.size()) {
+            return false;
+        }
+
+        return ((bits[page >> 6] >> (page & 63)) & 1) != 0;
+    }
+
+    /**
+     * @brief Looks for a point covering an access, records the first
+     *        match as the hit
+     * @param kind kind of access
+     * @param address first address accessed
+     * @param size bytes accessed
+     * @return true if a point matched
+     */
+    bool match(DebugKind kind, BusAddressType address, U32 size)
+    {
+        BusAddressType last = address + size - 1;
+        std::vector<Point>::const_iterator it;
+
+        for (it=mPoints.begin(); it != mPoints.end(); ++it) {
+            if ((it->kind == kind) &&
+                (address <= it->last) && (last >= it->first)) {
+                if (!mStopped) {
+                    mStopped = true;
+                    mHit.kind = kind;
+                    mHit.address = address;
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+public:
+    /**
+     * @brief Constructor, no points
+     * @return nothing
+     */
+    DebugPoints()
+        : mStopped(false), mStepOver(false)
+    {
+    }
+
+    /**
+     * @brief Adds a breakpoint or watchpoint
+     * @param kind kind of point
+     * @param first first address covered
+     * @param last last address covered, same as first for a breakpoint
+     * @return true if success, otherwise false
+     */
+    bool add(DebugKind kind, BusAddressType first, BusAddressType last)
+    {
+        if ((kind >= DEBUG_KIND_COUNT) || (first > last)) {
+            return false;
+        }
+
+        Point point;
+
+        point.kind = kind;
+        point.first = first;
+        point.last = last;
+        mPoints.push_back(point);
+
+        setPages(point);
+
+        return true;
+    }
+
+    /**
+     * @brief Removes a point added with the same values
+     * @param kind kind passed to add
+     * @param first first address passed to add
+     * @param last last address passed to add
+     * @return true if success, otherwise false
+     */
+    bool remove(DebugKind kind, BusAddressType first, BusAddressType last)
+    {
+        std::vector<Point>::iterator it;
+
+        for (it=mPoints.begin(); it != mPoints.end(); ++it) {
+            if ((it->kind == kind) && (it->first == first) &&
+                (it->last == last)) {
+                mPoints.erase(it);
+
+                // Other points may share the pages, rebuild the bits
+                for (int i=0; i<DEBUG_KIND_COUNT; ++i) {
+                    mPageBits[i].clear();
+                }
+                for (it=mPoints.begin(); it != mPoints.end(); ++it) {
+                    setPages(*it);
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Removes every point and any pending hit
+     */
+    void clear()
+    {
+        mPoints.clear();
+        for (int i=0; i<DEBUG_KIND_COUNT; ++i) {
+            mPageBits[i].clear();
+        }
+        mStopped = false;
+        mStepOver = false;
+    }
+
+    /**
+     * @brief Checks for a breakpoint before an instruction executes
+     * @param pc address of the instruction
+     * @return true if the CPU must stop before the instruction
+     */
+    bool checkBreakpoint(BusAddressType pc)
+    {
+        if (mStepOver) {
+            mStepOver = false;
+            return false;
+        }
+
+        if (!pageSet(DEBUG_BREAK_EXECUTE, pc)) {
+            return false;
+        }
+
+        return match(DEBUG_BREAK_EXECUTE, pc, 1);
+    }
+
+    /**
+     * @brief Checks an access against the watchpoints, a match stops
+     *        the CPU once the instruction completes
+     * @param kind DEBUG_WATCH_READ or DEBUG_WATCH_WRITE
+     * @param address first address accessed
+     * @param size bytes accessed
+     */
+    void checkAccess(DebugKind kind, BusAddressType address, U32 size)
+    {
+        if (pageSet(kind, address)) {
+            match(kind, address, size);
+        }
+    }
+
+    /**
+     * @brief Returns whether a point was hit since the last resume
+     * @return true if the CPU must stop
+     */
+    bool stopped() const
+    {
+        return mStopped;
+    }
+
+    /**
+     * @brief Returns the point that stopped the CPU
+     * @return hit, only valid while stopped
+     */
+    const Hit &getHit() const
+    {
+        return mHit;
+    }
+
+    /**
+     * @brief Clears the hit so the CPU can run again, a CPU stopped
+     *        at a breakpoint executes that instruction first
+     */
+    void resume()
+    {
+        if (mStopped && (mHit.kind == DEBUG_BREAK_EXECUTE)) {
+            mStepOver = true;
+        }
+
+        mStopped = false;
+    }
+};
+
+} // soc
+
+#endif
@@ -21,6 +21,14 @@ namespace soc {
 class Device
 {
 public:
+    /**
+     * @brief Deconstructor, devices are destroyed through this class
+     * @return nothing
+     */
+    virtual ~Device()
+    {
+    }
+
     /**
      * @brief If an active device then execute should be called
      * @return true if success, otherwise false
@@ -49,6 +57,26 @@ public:
      */
     virtual bool write(BusAddressType address, BusDataType &data) = 0;
 
+    /**
+     * @brief Reads consecutive words, devices that can check the range
+     *        once should override it
+     * @param address address of the first word
+     * @param data location to store count words
+     * @param count number of words to read
+     * @return true if success, otherwise false
+     */
+    virtual bool readBlock(BusAddressType address, BusDataType *data,
+                           U32 count)
+    {
+        for (U32 i=0; i<count; ++i) {
+            if (!read(address + (i * sizeof(BusDataType)), data[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     /**
      * @brief Returns name of device
      * @return String containing name
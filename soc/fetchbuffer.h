@@ -0,0 +1,119 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes an instruction fetch buffer
+ */
+
+#ifndef _SOC_FETCHBUFFER_H
+#define _SOC_FETCHBUFFER_H
+
+#include "types.h"
+
+namespace soc {
+
+/**
+ * @class FetchBuffer
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file fetchbuffer.h
+ * @brief One line of instructions read from the bus in a single
+ *        request. The bus drops the line when anything writes to it.
+ */
+class FetchBuffer
+{
+public:
+    enum {
+        LINE_SHIFT = 6,
+        LINE_SIZE = (1 << LINE_SHIFT),
+        LINE_WORDS = (LINE_SIZE / sizeof(BusDataType))
+    };
+
+
+private:
+    BusAddressType mLine;
+    bool mValid;
+    BusDataType mWords[LINE_WORDS];
+
+
+public:
+    /**
+     * @brief Constructor, holds no line
+     * @return nothing
+     */
+    FetchBuffer()
+        : mLine(0), mValid(false)
+    {
+    }
+
+    /**
+     * @brief Returns the address of the line holding an address
+     * @param address any address in the line
+     * @return first address of the line
+     */
+    static BusAddressType lineOf(BusAddressType address)
+    {
+        return address & ~(BusAddressType)(LINE_SIZE - 1);
+    }
+
+    /**
+     * @brief Reads an instruction if its line is held
+     * @param address address of the instruction, word aligned
+     * @param data location to store the instruction
+     * @return true if held, otherwise the line must be loaded
+     */
+    bool lookup(BusAddressType address, BusDataType &data) const
+    {
+        if (!mValid || (lineOf(address) != mLine) ||
+            ((address & (sizeof(BusDataType) - 1)) != 0)) {
+            return false;
+        }
+
+        data = mWords[(address >> 2) & (LINE_WORDS - 1)];
+
+        return true;
+    }
+
+    /**
+     * @brief Returns storage for a line being loaded, the line is held
+     *        once validate is called
+     * @return LINE_WORDS words
+     */
+    BusDataType *words()
+    {
+        return mWords;
+    }
+
+    /**
+     * @brief Holds the line loaded in to words
+     * @param line first address of the line
+     */
+    void validate(BusAddressType line)
+    {
+        mLine = line;
+        mValid = true;
+    }
+
+    /**
+     * @brief Drops the line
+     */
+    void invalidate()
+    {
+        mValid = false;
+    }
+
+    /**
+     * @brief Drops the line if a write overlaps it
+     * @param address first address written
+     * @param size bytes written
+     */
+    void invalidate(BusAddressType address, U32 size)
+    {
+        if (mValid && (address <= (mLine + LINE_SIZE - 1)) &&
+            ((address + size - 1) >= mLine)) {
+            mValid = false;
+        }
+    }
+};
+
+} // soc
+
+#endif
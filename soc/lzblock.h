@@ -0,0 +1,268 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains a small LZ77 block compressor, in the
+ *        style of LZ4, for trace and snapshot data
+ */
+
+#ifndef _SOC_LZBLOCK_H
+#define _SOC_LZBLOCK_H
+
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "types.h"
+
+namespace soc {
+
+// Block format, a series of sequences:
+//   token       high nibble literal count, low nibble match length - 4,
+//               15 in either means more length bytes follow
+//   lengths     bytes of 255 then the rest, literal count first
+//   literals
+//   offset      16-bit little endian distance back to the match
+//   lengths     extra match length bytes
+// The last sequence is literals only and ends the block.
+enum {
+    LZ_MIN_MATCH = 4,
+    LZ_MAX_OFFSET = 0xFFFF,
+    LZ_HASH_BITS = 12
+};
+
+/**
+ * @brief Returns the most bytes lzCompress can produce
+ * @param length bytes to compress
+ * @return worst case compressed size
+ */
+inline size_t lzCompressBound(size_t length)
+{
+    return length + (length / 255) + 16;
+}
+
+inline U32 lzLoad32(const U8 *ptr)
+{
+    U32 value;
+
+    memcpy(&value, ptr, sizeof(value));
+
+    return value;
+}
+
+inline U32 lzHash(U32 value)
+{
+    return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * @brief Appends a length as 255 bytes and the remainder
+ */
+inline U8 *lzWriteLength(U8 *out, size_t length)
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (U8)length;
+
+    return out;
+}
+
+/**
+ * @brief Appends one sequence
+ * @param out location to write to, at least lzCompressBound of the
+ *            literals plus 8 bytes are available
+ * @param literals first literal
+ * @param literalCount number of literals
+ * @param offset distance back to the match, 0 for the last sequence
+ * @param matchLength bytes matched, ignored for the last sequence
+ * @return location after the sequence
+ */
+inline U8 *lzWriteSequence(U8 *out, const U8 *literals, size_t literalCount,
+                           U32 offset, size_t matchLength)
+{
+    U8 *token = out++;
+    size_t match = (offset != 0) ? (matchLength - LZ_MIN_MATCH) : 0;
+
+    *token = (U8)((((literalCount < 15) ? literalCount : 15) << 4) |
+                  ((match < 15) ? match : 15));
+
+    if (literalCount >= 15) {
+        out = lzWriteLength(out, literalCount - 15);
+    }
+
+    memcpy(out, literals, literalCount);
+    out += literalCount;
+
+    if (offset != 0) {
+        *out++ = (U8)(offset & 0xFF);
+        *out++ = (U8)(offset >> 8);
+
+        if (match >= 15) {
+            out = lzWriteLength(out, match - 15);
+        }
+    }
+
+    return out;
+}
+
+
+/**
+ * @brief Compresses a block
+ * @param src bytes to compress
+ * @param length number of bytes
+ * @param dst location to store compressed bytes, lzCompressBound(length)
+ *            bytes are always enough
+ * @param capacity bytes available at dst
+ * @return compressed size, 0 if it did not fit in capacity
+ */
+inline size_t lzCompress(const U8 *src, size_t length, U8 *dst,
+                         size_t capacity)
+{
+    // Positions + 1, 0 is an empty slot
+    std::vector<U32> table(1 << LZ_HASH_BITS, 0);
+    U8 *out = dst;
+    U8 *outEnd = dst + capacity;
+    size_t anchor = 0;
+    size_t pos = 0;
+
+    while ((pos + LZ_MIN_MATCH) <= length) {
+        U32 value = lzLoad32(src + pos);
+        U32 hash = lzHash(value);
+        U32 candidate = table[hash];
+
+        table[hash] = (U32)pos + 1;
+
+        if ((candidate == 0) || ((pos - (candidate - 1)) > LZ_MAX_OFFSET) ||
+            (lzLoad32(src + candidate - 1) != value)) {
+            ++pos;
+            continue;
+        }
+
+        size_t ref = candidate - 1;
+        size_t matchLength = LZ_MIN_MATCH;
+
+        while (((pos + matchLength) < length) &&
+               (src[ref + matchLength] == src[pos + matchLength])) {
+            ++matchLength;
+        }
+
+        size_t literalCount = pos - anchor;
+
+        // Worst case: token, both lengths, literals and the offset
+        if ((size_t)(outEnd - out) <
+            (1 + (literalCount / 255) + 1 + literalCount + 2 +
+             (matchLength / 255) + 1)) {
+            return 0;
+        }
+
+        out = lzWriteSequence(out, src + anchor, literalCount,
+                              (U32)(pos - ref), matchLength);
+
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    size_t literalCount = length - anchor;
+
+    if ((size_t)(outEnd - out) < (1 + (literalCount / 255) + 1 + literalCount)) {
+        return 0;
+    }
+
+    out = lzWriteSequence(out, src + anchor, literalCount, 0, 0);
+
+    return out - dst;
+}
+
+
+/**
+ * @brief Reads a length continued in 255 bytes
+ * @return true if success, false if the input ended
+ */
+inline bool lzReadLength(const U8 *&in, const U8 *end, size_t &length)
+{
+    U8 byte;
+
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+
+/**
+ * @brief Decompresses a block, every length and offset is checked so
+ *        a damaged block fails instead of writing out of bounds
+ * @param src compressed bytes
+ * @param length number of compressed bytes
+ * @param dst location to store decompressed bytes
+ * @param capacity bytes available at dst
+ * @param produced location to store the decompressed size
+ * @return true if success, otherwise false
+ */
+inline bool lzDecompress(const U8 *src, size_t length, U8 *dst,
+                         size_t capacity, size_t &produced)
+{
+    const U8 *in = src;
+    const U8 *end = src + length;
+    U8 *out = dst;
+    U8 *outEnd = dst + capacity;
+
+    while (in < end) {
+        U8 token = *in++;
+        size_t literalCount = token >> 4;
+        size_t matchLength = token & 0xF;
+
+        if ((literalCount == 15) && !lzReadLength(in, end, literalCount)) {
+            return false;
+        }
+        if ((literalCount > (size_t)(end - in)) ||
+            (literalCount > (size_t)(outEnd - out))) {
+            return false;
+        }
+
+        memcpy(out, in, literalCount);
+        in += literalCount;
+        out += literalCount;
+
+        if (in == end) {
+            // Last sequence
+            break;
+        }
+
+        if ((end - in) < 2) {
+            return false;
+        }
+
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        if ((matchLength == 15) && !lzReadLength(in, end, matchLength)) {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+
+        if ((offset == 0) || (offset > (size_t)(out - dst)) ||
+            (matchLength > (size_t)(outEnd - out))) {
+            return false;
+        }
+
+        // Byte at a time, a match may overlap what it produces
+        const U8 *match = out - offset;
+        for (size_t i=0; i<matchLength; ++i) {
+            out[i] = match[i];
+        }
+        out += matchLength;
+    }
+
+    produced = out - dst;
+
+    return true;
+}
+
+} // soc
+
+#endif
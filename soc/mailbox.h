@@ -0,0 +1,234 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes a scratch and mailbox device shared by
+ *        firmware and the host
+ */
+
+#ifndef _SOC_MAILBOX_H
+#define _SOC_MAILBOX_H
+
+#include <string>
+#include "types.h"
+#include "mmio.h"
+
+namespace soc {
+
+/**
+ * @class Mailbox
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file mailbox.h
+ * @brief Scratch registers plus a FIFO in each direction between
+ *        firmware and the host. Firmware polls STATUS until a message
+ *        from the host is waiting, then reads it from FROM_HOST, and
+ *        answers through TO_HOST. The host uses post and take.
+ *
+ *        Registers, from the base of the device:
+ *          0x00 STATUS     bit 0 FROM_HOST has a message, bit 1
+ *                          TO_HOST is full
+ *          0x04 FROM_HOST  pops the oldest message, 0 if empty
+ *          0x08 TO_HOST    pushes a message, dropped if full
+ *          0x40 SCRATCH0 .. 0x7c SCRATCH15, plain storage
+ */
+class Mailbox : public MmioDevice<Mailbox>
+{
+public:
+    enum {
+        REG_STATUS = 0x00,
+        REG_FROM_HOST = 0x04,
+        REG_TO_HOST = 0x08,
+        REG_SCRATCH = 0x40,
+
+        STATUS_FROM_HOST_READY = 0x1,
+        STATUS_TO_HOST_FULL = 0x2,
+
+        SCRATCH_COUNT = 16,
+        FIFO_SIZE = 16          // a power of 2
+    };
+
+
+private:
+    /**
+     * @brief Fixed size ring of messages
+     */
+    struct Fifo
+    {
+        BusDataType data[FIFO_SIZE];
+        U32 head;               // next to pop
+        U32 tail;               // next to push
+
+        bool empty() const { return head == tail; }
+        bool full() const { return (tail - head) == FIFO_SIZE; }
+        void clear() { head = tail = 0; }
+
+        bool push(BusDataType value)
+        {
+            if (full()) {
+                return false;
+            }
+            data[tail++ & (FIFO_SIZE - 1)] = value;
+            return true;
+        }
+
+        bool pop(BusDataType &value)
+        {
+            if (empty()) {
+                return false;
+            }
+            value = data[head++ & (FIFO_SIZE - 1)];
+            return true;
+        }
+    };
+
+    Fifo mFromHost;
+    Fifo mToHost;
+
+
+    /**
+     * @brief Returns the register bank
+     * @param count location to store number of registers
+     * @return registers
+     */
+    static const Register *registerBank(U32 &count)
+    {
+        static const Register bank[] = {
+            { REG_STATUS, "STATUS", MMIO_READ, 0,
+              &Mailbox::readStatus, NULL },
+            { REG_FROM_HOST, "FROM_HOST",
+              MMIO_READ | MMIO_READ_SIDE_EFFECT, 0,
+              &Mailbox::readFromHost, NULL },
+            { REG_TO_HOST, "TO_HOST", MMIO_WRITE | MMIO_WRITE_SIDE_EFFECT,
+              0, NULL, &Mailbox::writeToHost },
+            { REG_SCRATCH + 0x00, "SCRATCH0", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x04, "SCRATCH1", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x08, "SCRATCH2", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x0c, "SCRATCH3", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x10, "SCRATCH4", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x14, "SCRATCH5", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x18, "SCRATCH6", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x1c, "SCRATCH7", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x20, "SCRATCH8", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x24, "SCRATCH9", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x28, "SCRATCH10", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x2c, "SCRATCH11", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x30, "SCRATCH12", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x34, "SCRATCH13", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x38, "SCRATCH14", MMIO_READ_WRITE, 0, NULL, NULL },
+            { REG_SCRATCH + 0x3c, "SCRATCH15", MMIO_READ_WRITE, 0, NULL, NULL }
+        };
+
+        count = sizeof(bank) / sizeof(bank[0]);
+
+        return bank;
+    }
+
+    /**
+     * @brief Reads the status
+     * @param data location to store status
+     * @return true
+     */
+    bool readStatus(BusDataType &data)
+    {
+        data = 0;
+        if (!mFromHost.empty()) {
+            data |= STATUS_FROM_HOST_READY;
+        }
+        if (mToHost.full()) {
+            data |= STATUS_TO_HOST_FULL;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Pops a message from the host
+     * @param data location to store message, 0 if none
+     * @return true
+     */
+    bool readFromHost(BusDataType &data)
+    {
+        if (!mFromHost.pop(data)) {
+            data = 0;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Pushes a message to the host
+     * @param data message
+     * @return true, a message sent when full is dropped
+     */
+    bool writeToHost(BusDataType data)
+    {
+        mToHost.push(data);
+
+        return true;
+    }
+
+
+public:
+    /**
+     * @brief Constructor
+     * @return nothing
+     */
+    Mailbox()
+        : MmioDevice<Mailbox>(registerBank)
+    {
+        mFromHost.clear();
+        mToHost.clear();
+    }
+
+    /**
+     * @brief Deconstructor
+     * @return nothing
+     */
+    virtual ~Mailbox()
+    {
+    }
+
+    /**
+     * @brief Sends a message to firmware
+     * @param value message
+     * @return true if success, false if FROM_HOST is full
+     */
+    bool post(BusDataType value)
+    {
+        return mFromHost.push(value);
+    }
+
+    /**
+     * @brief Receives a message from firmware
+     * @param value location to store message
+     * @return true if success, false if TO_HOST is empty
+     */
+    bool take(BusDataType &value)
+    {
+        return mToHost.pop(value);
+    }
+
+    /**
+     * @brief Empties both FIFOs and clears the scratch registers
+     * @return true if success, otherwise false
+     */
+    virtual bool reset()
+    {
+        mFromHost.clear();
+        mToHost.clear();
+
+        return MmioDevice<Mailbox>::reset();
+    }
+
+    /**
+     * @brief Returns the name of the device
+     * @return name
+     */
+    virtual std::string getName()
+    {
+        return std::string("Mailbox");
+    }
+};
+
+} // soc
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "types.h"
 #include "busdevice.h"
+#include "memutil.h"
 
 namespace soc {
 
@@ -28,9 +29,21 @@ private:
     };
 
 
+public:
+    enum {
+        PAGE_SHIFT = 6,
+        PAGE_SIZE = (1 << PAGE_SHIFT),
+        PAGE_COUNT = ((MemorySizeInBytes + PAGE_SIZE - 1) >> PAGE_SHIFT)
+    };
+
+
 protected:
     U8 mData[MemorySizeInBytes];
 
+    // Cached hash of every page, dropped when the page is written
+    U64 mPageHash[PAGE_COUNT];
+    bool mPageHashValid[PAGE_COUNT];
+
 
 protected:
     /**
@@ -52,13 +65,33 @@ protected:
      */
     void writeU32ToMem(U16 address, U32 value)
     {
-        U32 *mem32;
+        // Store value in memory
+        memcpy(&mData[address], &value, sizeof(value));
 
-        // First get U32 ptr to memory
-        mem32 = (U32*)&mData[address];
+        invalidatePages(address, sizeof(value));
+    }
 
-        // Store value in memory
-        *mem32 = value;
+    /**
+     * @brief Drops cached hashes of pages covering a range
+     * @param localAddress first location written
+     * @param length number of bytes written
+     */
+    void invalidatePages(BusAddressType localAddress, U32 length)
+    {
+        BusAddressType last = localAddress + length - 1;
+
+        for (BusAddressType page = localAddress >> PAGE_SHIFT;
+             page <= (last >> PAGE_SHIFT); ++page) {
+            mPageHashValid[page] = false;
+        }
+    }
+
+    /**
+     * @brief Drops every cached page hash
+     */
+    void invalidateAllPages()
+    {
+        memset(mPageHashValid, 0, sizeof(mPageHashValid));
     }
 
 
@@ -69,6 +102,7 @@ public:
      */
     Memory()
     {
+        invalidateAllPages();
     }
 
     /**
@@ -96,9 +130,8 @@ public:
     virtual bool reset()
     {
         // Set all data to the default value
-        for (int i=0; i<MemorySizeInBytes; ++i) {
-            mData[i] = DEFAULT_MEMORYVALUE;
-        }
+        memoryFill(mData, DEFAULT_MEMORYVALUE, MemorySizeInBytes);
+        invalidateAllPages();
 
         return true;
     }
@@ -119,8 +152,7 @@ public:
         // TODO: Update 4 to define that's read/write size
         if ((localAddress+4) < MemorySizeInBytes) {
             // valid address
-            U32 *readLoc = (U32*)&mData[localAddress];
-            data = *readLoc;
+            memcpy(&data, &mData[localAddress], sizeof(data));
             return true;
         } else {
             // invalid address
@@ -144,14 +176,92 @@ public:
         // TODO: Update 4 to define that's read/write size
         if ((localAddress+4) < MemorySizeInBytes) {
             // valid address
-            U32 *writeLoc = (U32*)&mData[localAddress];
-            *writeLoc = data;
+            memcpy(&mData[localAddress], &data, sizeof(data));
+            invalidatePages(localAddress, sizeof(data));
             return true;
         } else {
             // invalid address
             return false;
         }
     }
+
+    /**
+     * @brief Reads consecutive words with one range check
+     * @param address address of the first word
+     * @param data location to store count words
+     * @param count number of words to read
+     * @return true if success, otherwise false
+     */
+    virtual bool readBlock(BusAddressType address, BusDataType *data,
+                           U32 count)
+    {
+        BusAddressType localAddress = convertToLocalAddress(address);
+        U32 length = count * sizeof(BusDataType);
+
+        // Same bound as read, for the last word
+        if ((localAddress + length) < MemorySizeInBytes) {
+            memcpy(data, &mData[localAddress], length);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Returns hash of one page, computed only if the page was
+     *        written since it was last hashed
+     * @param page page index, less than PAGE_COUNT
+     * @return hash of page contents
+     */
+    U64 pageHash(U32 page)
+    {
+        if (!mPageHashValid[page]) {
+            U32 offset = page << PAGE_SHIFT;
+            U32 length = MemorySizeInBytes - offset;
+
+            if (length > PAGE_SIZE) {
+                length = PAGE_SIZE;
+            }
+
+            mPageHash[page] = memoryHash(&mData[offset], length, page);
+            mPageHashValid[page] = true;
+        }
+
+        return mPageHash[page];
+    }
+
+    /**
+     * @brief Returns hash of all of memory, built from the page hashes
+     * @return hash of memory contents
+     */
+    U64 hash()
+    {
+        for (U32 page=0; page<PAGE_COUNT; ++page) {
+            pageHash(page);
+        }
+
+        return memoryHash((const U8*)mPageHash, sizeof(mPageHash));
+    }
+
+    /**
+     * @brief Compares contents against another memory of the same size
+     * @param other memory to compare against
+     * @return offset of the first byte that differs,
+     *         MemorySizeInBytes if equal
+     */
+    U32 compare(const Memory &other) const
+    {
+        return (U32)memoryCompare(mData, other.mData, MemorySizeInBytes);
+    }
+
+    /**
+     * @brief Returns contents of memory
+     * @return ptr to MemorySizeInBytes bytes
+     */
+    const U8 *getData() const
+    {
+        return mData;
+    }
 };
 
 
@@ -0,0 +1,240 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes memory sized when the SoC is built
+ */
+
+#ifndef _SOC_MEMREGION_H
+#define _SOC_MEMREGION_H
+
+#include <vector>
+#include "types.h"
+#include "busdevice.h"
+#include "memutil.h"
+
+namespace soc {
+
+/**
+ * @class MemoryRegion
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file memregion.h
+ * @brief Memory the size of the address range it is attached to, for
+ *        platforms described at run time. Addresses are relative to the
+ *        start of the range. Reset fills the region and copies the
+ *        preloaded images back in.
+ */
+class MemoryRegion : public BusDevice
+{
+private:
+    struct Preload
+    {
+        U32 offset;
+        std::vector<U8> bytes;
+    };
+
+    std::vector<U8> mData;
+    std::vector<Preload> mPreloads;
+    BusAddressType mBase;
+    U8 mFill;
+
+
+    /**
+     * @brief Checks an access lies entirely in the region
+     * @param address bus address
+     * @param length bytes accessed
+     * @param offset location to store offset in to the region
+     * @return true if inside, otherwise false
+     */
+    bool locate(BusAddressType address, U32 length, U32 &offset) const
+    {
+        offset = address - mBase;
+
+        return (address >= mBase) && (offset <= mData.size()) &&
+               (length <= (mData.size() - offset));
+    }
+
+
+public:
+    /**
+     * @brief Constructor, holds no memory until attached to a bus
+     * @param fill value of every byte after reset
+     * @return nothing
+     */
+    explicit MemoryRegion(U8 fill=0)
+        : mBase(0), mFill(fill)
+    {
+    }
+
+    /**
+     * @brief Deconstructor
+     * @return nothing
+     */
+    virtual ~MemoryRegion()
+    {
+    }
+
+    /**
+     * @brief Attaches to a bus and sizes the region to the address range
+     * @param bus specific bus to connect to
+     * @param devType master or slave
+     * @param addrRange addressable range, required
+     * @return true if success, otherwise false
+     */
+    virtual bool attachToBus(Bus *bus,
+                             Bus::BusDeviceType devType,
+                             const Bus::AddressRange *addrRange)
+    {
+        if ((addrRange == NULL) || (addrRange->end < addrRange->start)) {
+            return false;
+        }
+
+        if (!BusDevice::attachToBus(bus, devType, addrRange)) {
+            return false;
+        }
+
+        mBase = addrRange->start;
+        mData.assign((size_t)(addrRange->end - addrRange->start) + 1, mFill);
+
+        return true;
+    }
+
+    /**
+     * @brief Memory does nothing on its own
+     * @return true
+     */
+    virtual bool execute()
+    {
+        return true;
+    }
+
+    /**
+     * @brief Sets every byte to the fill value, then copies the
+     *        preloaded images
+     * @return true
+     */
+    virtual bool reset()
+    {
+        memoryFill(mData.data(), mFill, mData.size());
+
+        for (size_t i=0; i<mPreloads.size(); ++i) {
+            memcpy(&mData[mPreloads[i].offset], mPreloads[i].bytes.data(),
+                   mPreloads[i].bytes.size());
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Reads a word
+     * @param address location to read from
+     * @param data location to store read value
+     * @return true if success, otherwise false
+     */
+    virtual bool read(BusAddressType address, BusDataType &data)
+    {
+        U32 offset;
+
+        if (!locate(address, sizeof(data), offset)) {
+            return false;
+        }
+
+        memcpy(&data, &mData[offset], sizeof(data));
+
+        return true;
+    }
+
+    /**
+     * @brief Writes a word
+     * @param address location to write to
+     * @param data value to store
+     * @return true if success, otherwise false
+     */
+    virtual bool write(BusAddressType address, BusDataType &data)
+    {
+        U32 offset;
+
+        if (!locate(address, sizeof(data), offset)) {
+            return false;
+        }
+
+        memcpy(&mData[offset], &data, sizeof(data));
+
+        return true;
+    }
+
+    /**
+     * @brief Reads consecutive words with one range check
+     * @param address address of the first word
+     * @param data location to store count words
+     * @param count number of words to read
+     * @return true if success, otherwise false
+     */
+    virtual bool readBlock(BusAddressType address, BusDataType *data,
+                           U32 count)
+    {
+        U32 offset;
+        U32 length = count * sizeof(BusDataType);
+
+        if (!locate(address, length, offset)) {
+            return false;
+        }
+
+        memcpy(data, &mData[offset], length);
+
+        return true;
+    }
+
+    /**
+     * @brief Adds an image that every reset copies in to the region,
+     *        the region must be attached first
+     * @param offset offset in to the region
+     * @param src bytes to copy
+     * @param length number of bytes
+     * @return true if success, false if the bytes do not fit
+     */
+    bool preload(U32 offset, const U8 *src, U32 length)
+    {
+        if ((offset > mData.size()) || (length > (mData.size() - offset))) {
+            return false;
+        }
+
+        Preload image;
+
+        image.offset = offset;
+        image.bytes.assign(src, src + length);
+        mPreloads.push_back(image);
+
+        return true;
+    }
+
+    /**
+     * @brief Returns size of the region
+     * @return bytes
+     */
+    U32 getSize() const
+    {
+        return (U32)mData.size();
+    }
+
+    /**
+     * @brief Returns contents of the region
+     * @return ptr to getSize() bytes
+     */
+    const U8 *getData() const
+    {
+        return mData.data();
+    }
+
+    /**
+     * @brief Returns name of device
+     * @return String containing name
+     */
+    virtual std::string getName()
+    {
+        return std::string("MemoryRegion");
+    }
+};
+
+} // soc
+
+#endif
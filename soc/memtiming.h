@@ -0,0 +1,345 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes a timing model of the L1 caches and TLB
+ *        in front of memory
+ */
+
+#ifndef _SOC_MEMTIMING_H
+#define _SOC_MEMTIMING_H
+
+#include <vector>
+#include "types.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace soc {
+
+// Kind of access seen by the timing model
+enum TimingAccess {
+    TIMING_FETCH,       // instruction, L1 instruction cache
+    TIMING_READ,        // data, L1 data cache
+    TIMING_WRITE        // data, write allocate
+};
+
+struct CacheStats
+{
+    U64 accesses;
+    U64 misses;         // hits are accesses - misses
+};
+
+
+/**
+ * @class CacheTags
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file memtiming.h
+ * @brief Tags of a set associative cache, no data. The ways of a set
+ *        are next to each other in order of last use, newest first, so
+ *        all the tags of a set are compared at once and the least
+ *        recently used way, replaced on a miss, is always the last.
+ *        A block already in the first way of its set is counted as a
+ *        hit without a look up, nothing moves.
+ */
+template <U32 Ways>
+class CacheTags
+{
+public:
+    enum {
+        INVALID_TAG = 0xFFFFFFFF
+    };
+
+
+private:
+    std::vector<U32> mTags;     // block number, sets * Ways, newest first
+    U32 mSetMask;
+    U32 mShift;
+    CacheStats mStats;
+
+
+    /**
+     * @brief Compares every way of a set with one value at once
+     * @param values tags of the set
+     * @param key value to look for
+     * @return mask with bit n set if way n holds key
+     */
+    static inline U32 matchWays(const U32 *values, U32 key)
+    {
+        U32 mask = 0;
+        U32 way = 0;
+
+#if defined(__AVX2__)
+        __m256i key8 = _mm256_set1_epi32((int)key);
+
+        for (; (way + 8) <= Ways; way += 8) {
+            mask |= (U32)_mm256_movemask_ps(_mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(
+                    _mm256_loadu_si256((const __m256i*)(values + way)),
+                    key8))) << way;
+        }
+#endif
+#if defined(__SSE2__)
+        __m128i key4 = _mm_set1_epi32((int)key);
+
+        for (; (way + 4) <= Ways; way += 4) {
+            mask |= (U32)_mm_movemask_ps(_mm_castsi128_ps(
+                _mm_cmpeq_epi32(
+                    _mm_loadu_si128((const __m128i*)(values + way)),
+                    key4))) << way;
+        }
+#endif
+
+        for (; way < Ways; ++way) {
+            mask |= (U32)(values[way] == key) << way;
+        }
+
+        return mask;
+    }
+
+    /**
+     * @brief Moves a block to the front of its set, the ways before the
+     *        one it leaves move back one. Every way is rewritten, so the
+     *        stores go to addresses known before the way is.
+     * @param tags tags of the set
+     * @param hits ways holding the block, from matchWays. On a miss it
+     *        leaves the last way, dropping the least recently used block.
+     * @param block block number
+     */
+    static inline void moveToFront(U32 *tags, U32 hits, U32 block)
+    {
+#if defined(__SSE2__)
+        if (Ways == 4) {
+            // Ways after the one the block leaves stay where they are
+            static const U32 stay[9][4] = {
+                { 0, 0, 0, 0 },
+                { 0, ~0U, ~0U, ~0U },
+                { 0, 0, ~0U, ~0U },
+                { 0, 0, 0, 0 },
+                { 0, 0, 0, ~0U },
+                { 0, 0, 0, 0 },
+                { 0, 0, 0, 0 },
+                { 0, 0, 0, 0 },
+                { 0, 0, 0, 0 }
+            };
+            __m128i set = _mm_loadu_si128((const __m128i*)tags);
+            __m128i moved = _mm_castps_si128(_mm_move_ss(
+                _mm_castsi128_ps(_mm_slli_si128(set, 4)),
+                _mm_castsi128_ps(_mm_set1_epi32((int)block))));
+            __m128i keep = _mm_loadu_si128((const __m128i*)stay[hits]);
+
+            _mm_storeu_si128((__m128i*)tags, _mm_xor_si128(moved,
+                _mm_and_si128(keep, _mm_xor_si128(set, moved))));
+            return;
+        }
+#endif
+
+        U32 way = (U32)__builtin_ctz(hits | (1U << (Ways - 1)));
+
+        for (U32 i=Ways - 1; i>0; --i) {
+            tags[i] = (i <= way) ? tags[i - 1] : tags[i];
+        }
+        tags[0] = block;
+    }
+
+    /**
+     * @brief Looks up a block not in the first way of its set, and
+     *        fills it on a miss. Nothing branches on the result: the
+     *        hit way, or the last way on a miss, is moved to the front
+     *        and the miss is added to the count.
+     * @param tags tags of the set
+     * @param block address shifted by the line size
+     * @return true if hit, otherwise false
+     */
+    bool lookup(U32 *tags, U32 block)
+    {
+        U32 hits = matchWays(tags, block);
+        U32 miss = (hits == 0);
+
+        moveToFront(tags, hits, block);
+        mStats.misses += miss;
+
+        return (miss == 0);
+    }
+
+
+public:
+    /**
+     * @brief Constructor, every way starts empty
+     * @param sets number of sets, a power of 2
+     * @param lineShift log2 of the bytes of a line
+     * @return nothing
+     */
+    CacheTags(U32 sets, U32 lineShift)
+        : mTags(sets * Ways, (U32)INVALID_TAG),
+          mSetMask(sets - 1), mShift(lineShift)
+    {
+        mStats.accesses = 0;
+        mStats.misses = 0;
+    }
+
+    /**
+     * @brief Looks up the line of an address, and fills it on a miss
+     * @param address address accessed
+     * @return true if hit, otherwise false
+     */
+    bool access(BusAddressType address)
+    {
+        U32 block = address >> mShift;
+        U32 *tags = &mTags[(block & mSetMask) * Ways];
+
+        ++mStats.accesses;
+
+        return (tags[0] == block) || lookup(tags, block);
+    }
+
+    /**
+     * @brief Empties every way and clears the statistics
+     */
+    void reset()
+    {
+        mTags.assign(mTags.size(), (U32)INVALID_TAG);
+        mStats.accesses = 0;
+        mStats.misses = 0;
+    }
+
+    /**
+     * @brief Returns hit and miss counts
+     * @return statistics
+     */
+    const CacheStats &getStats() const
+    {
+        return mStats;
+    }
+};
+
+
+/**
+ * @brief Geometry and latencies of the timing model
+ */
+struct TimingConfig
+{
+    U32 cacheSets;          // sets of each L1 cache, a power of 2
+    U32 lineShift;          // log2 of the bytes of a cache line
+    U32 tlbSets;            // sets of the TLB, a power of 2
+    U32 pageShift;          // log2 of the bytes of a page
+    U32 cacheMissCycles;    // stall of an L1 miss served by memory
+    U32 tlbMissCycles;      // stall of a page table walk
+};
+
+/**
+ * @brief 16KB 4-way L1 caches with 64 byte lines, a 64 entry 4-way TLB
+ *        of 4KB pages
+ */
+inline TimingConfig defaultTimingConfig()
+{
+    TimingConfig config = { 64, 6, 16, 12, 20, 30 };
+
+    return config;
+}
+
+
+/**
+ * @class MemoryTiming
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file memtiming.h
+ * @brief Estimates the stall cycles of accesses to memory on target
+ *        hardware: a TLB and an L1 instruction and data cache. Only
+ *        tags are modeled, data always comes from memory, so the model
+ *        changes no results. Hits are free, misses add their latency.
+ *        Writes allocate and write backs are not modeled.
+ *
+ *        A bus given a model with setMemoryTiming passes it every
+ *        access to the timed device, a bus without one pays a pointer
+ *        test per access.
+ */
+class MemoryTiming
+{
+public:
+    enum {
+        CACHE_WAYS = 4,
+        TLB_WAYS = 4
+    };
+
+
+private:
+    TimingConfig mConfig;
+    CacheTags<CACHE_WAYS> mICache;
+    CacheTags<CACHE_WAYS> mDCache;
+    CacheTags<TLB_WAYS> mTLB;
+
+
+public:
+    /**
+     * @brief Constructor, caches and TLB start empty
+     * @param config geometry and latencies
+     * @return nothing
+     */
+    explicit MemoryTiming(const TimingConfig &config=defaultTimingConfig())
+        : mConfig(config),
+          mICache(config.cacheSets, config.lineShift),
+          mDCache(config.cacheSets, config.lineShift),
+          mTLB(config.tlbSets, config.pageShift)
+    {
+    }
+
+    /**
+     * @brief Models one access, the stalls follow from the misses it
+     *        counts
+     * @param kind instruction fetch, read or write
+     * @param address address accessed
+     */
+    void access(TimingAccess kind, BusAddressType address)
+    {
+        mTLB.access(address);
+
+        if (kind == TIMING_FETCH) {
+            mICache.access(address);
+        } else {
+            mDCache.access(address);
+        }
+    }
+
+    /**
+     * @brief Empties the caches and TLB and clears the statistics
+     */
+    void reset()
+    {
+        mICache.reset();
+        mDCache.reset();
+        mTLB.reset();
+    }
+
+    /**
+     * @brief Returns the stall cycles of every miss so far
+     * @return cycles
+     */
+    U64 getStallCycles() const
+    {
+        return (mTLB.getStats().misses * mConfig.tlbMissCycles) +
+               ((mICache.getStats().misses + mDCache.getStats().misses) *
+                mConfig.cacheMissCycles);
+    }
+
+    const CacheStats &getICacheStats() const
+    {
+        return mICache.getStats();
+    }
+
+    const CacheStats &getDCacheStats() const
+    {
+        return mDCache.getStats();
+    }
+
+    const CacheStats &getTLBStats() const
+    {
+        return mTLB.getStats();
+    }
+};
+
+} // soc
+
+#endif
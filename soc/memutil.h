@@ -0,0 +1,312 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains fill, compare and hash kernels for memory
+ */
+
+#ifndef _SOC_MEMUTIL_H
+#define _SOC_MEMUTIL_H
+
+#include <stddef.h>
+#include <string.h>
+#include "types.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSSE3__)
+    #include <tmmintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace soc {
+
+enum {
+    MEMHASH_LANES = 4,
+    MEMHASH_STRIPE = 32     // bytes consumed per iteration, 8 per lane
+};
+
+/**
+ * @brief Returns one of the xxHash64 primes
+ */
+inline U64 memHashPrime(int index)
+{
+    static const U64 primes[5] = {
+        0x9E3779B185EBCA87ULL,
+        0xC2B2AE3D27D4EB4FULL,
+        0x165667B19E3779F9ULL,
+        0x85EBCA77C2B2AE63ULL,
+        0x27D4EB2F165667C5ULL
+    };
+
+    return primes[index];
+}
+
+inline U64 memHashRotl(U64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline U64 memHashRound(U64 acc, U64 input)
+{
+    acc += input * memHashPrime(1);
+    acc = memHashRotl(acc, 31);
+    return acc * memHashPrime(0);
+}
+
+inline U64 memHashMerge(U64 acc, U64 lane)
+{
+    acc ^= memHashRound(0, lane);
+    return acc * memHashPrime(0) + memHashPrime(3);
+}
+
+inline U64 memLoad64(const U8 *ptr)
+{
+    U64 value;
+
+    memcpy(&value, ptr, sizeof(value));
+
+    return value;
+}
+
+inline U32 memLoad32(const U8 *ptr)
+{
+    U32 value;
+
+    memcpy(&value, ptr, sizeof(value));
+
+    return value;
+}
+
+
+/**
+ * @brief Fills memory with a value using the widest vector stores
+ *        the target supports
+ * @param dst memory to fill
+ * @param value value to store in every byte
+ * @param length number of bytes to fill
+ */
+inline void memoryFill(U8 *dst, U8 value, size_t length)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i fill = _mm256_set1_epi8((char)value);
+
+    for (; (i + 128) <= length; i += 128) {
+        _mm256_storeu_si256((__m256i*)(dst + i), fill);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), fill);
+        _mm256_storeu_si256((__m256i*)(dst + i + 64), fill);
+        _mm256_storeu_si256((__m256i*)(dst + i + 96), fill);
+    }
+    for (; (i + 32) <= length; i += 32) {
+        _mm256_storeu_si256((__m256i*)(dst + i), fill);
+    }
+#elif defined(__SSE2__)
+    __m128i fill = _mm_set1_epi8((char)value);
+
+    for (; (i + 64) <= length; i += 64) {
+        _mm_storeu_si128((__m128i*)(dst + i), fill);
+        _mm_storeu_si128((__m128i*)(dst + i + 16), fill);
+        _mm_storeu_si128((__m128i*)(dst + i + 32), fill);
+        _mm_storeu_si128((__m128i*)(dst + i + 48), fill);
+    }
+    for (; (i + 16) <= length; i += 16) {
+        _mm_storeu_si128((__m128i*)(dst + i), fill);
+    }
+#endif
+
+    memset(dst + i, value, length - i);
+}
+
+
+/**
+ * @brief Compares two blocks of memory
+ * @param a first block
+ * @param b second block
+ * @param length number of bytes to compare
+ * @return offset of the first byte that differs, length if equal
+ */
+inline size_t memoryCompare(const U8 *a, const U8 *b, size_t length)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; (i + 64) <= length; i += 64) {
+        __m256i eq0 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(a + i)),
+            _mm256_loadu_si256((const __m256i*)(b + i)));
+        __m256i eq1 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(a + i + 32)),
+            _mm256_loadu_si256((const __m256i*)(b + i + 32)));
+
+        if (_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1)) != -1) {
+            U32 mask = ~(U32)_mm256_movemask_epi8(eq0);
+
+            if (mask != 0) {
+                return i + __builtin_ctz(mask);
+            }
+
+            mask = ~(U32)_mm256_movemask_epi8(eq1);
+            return i + 32 + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; (i + 16) <= length; i += 16) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),
+                                    _mm_loadu_si128((const __m128i*)(b + i)));
+        U32 mask = (~(U32)_mm_movemask_epi8(eq)) & 0xFFFF;
+
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    // Rest is compared a word at a time
+    for (; (i + 8) <= length; i += 8) {
+        if (memLoad64(a + i) != memLoad64(b + i)) {
+            break;
+        }
+    }
+
+    for (; i < length; ++i) {
+        if (a[i] != b[i]) {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+
+/**
+ * @brief Copies 32-bit words reversing the bytes of each, one shuffle
+ *        swaps a whole vector of words. With only SSE2, the halves of
+ *        each word are swapped, then the bytes of each half.
+ * @param dst location to store swapped words, may be src
+ * @param src words to swap
+ * @param count number of 32-bit words
+ */
+inline void memorySwap32(U8 *dst, const U8 *src, size_t count)
+{
+    size_t length = count * 4;
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                           11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4,
+                                           11, 10, 9, 8, 15, 14, 13, 12);
+
+    for (; (i + 32) <= length; i += 32) {
+        __m256i words = _mm256_loadu_si256((const __m256i*)(src + i));
+
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                            _mm256_shuffle_epi8(words, order));
+    }
+#elif defined(__SSSE3__)
+    const __m128i order = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                        11, 10, 9, 8, 15, 14, 13, 12);
+
+    for (; (i + 16) <= length; i += 16) {
+        __m128i words = _mm_loadu_si128((const __m128i*)(src + i));
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(words, order));
+    }
+#elif defined(__SSE2__)
+    for (; (i + 16) <= length; i += 16) {
+        __m128i words = _mm_loadu_si128((const __m128i*)(src + i));
+
+        words = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, 0xB1), 0xB1);
+        words = _mm_or_si128(_mm_slli_epi16(words, 8),
+                             _mm_srli_epi16(words, 8));
+        _mm_storeu_si128((__m128i*)(dst + i), words);
+    }
+#endif
+
+    for (; i < length; i += 4) {
+        U32 value = memLoad32(src + i);
+
+#if defined(__GNUC__) || defined(__clang__)
+        value = __builtin_bswap32(value);
+#else
+        value = ((value << 24) | ((value & 0x0000FF00) << 8) |
+                 ((value >> 8) & 0x0000FF00) | (value >> 24));
+#endif
+        memcpy(dst + i, &value, sizeof(value));
+    }
+}
+
+
+/**
+ * @brief 64-bit hash of a block of memory (xxHash64 construction).
+ *        Four independent lanes keep the multipliers busy, so the hash
+ *        runs close to memory bandwidth.
+ * @param data block to hash
+ * @param length number of bytes to hash
+ * @param seed starting value, allows hashes to be chained
+ * @return hash value
+ */
+inline U64 memoryHash(const U8 *data, size_t length, U64 seed = 0)
+{
+    const U8 *ptr = data;
+    const U8 *end = data + length;
+    U64 hash;
+
+    if (length >= MEMHASH_STRIPE) {
+        U64 lane[MEMHASH_LANES] = {
+            seed + memHashPrime(0) + memHashPrime(1),
+            seed + memHashPrime(1),
+            seed,
+            seed - memHashPrime(0)
+        };
+
+        do {
+            lane[0] = memHashRound(lane[0], memLoad64(ptr));
+            lane[1] = memHashRound(lane[1], memLoad64(ptr + 8));
+            lane[2] = memHashRound(lane[2], memLoad64(ptr + 16));
+            lane[3] = memHashRound(lane[3], memLoad64(ptr + 24));
+            ptr += MEMHASH_STRIPE;
+        } while (ptr + MEMHASH_STRIPE <= end);
+
+        hash = memHashRotl(lane[0], 1) + memHashRotl(lane[1], 7) +
+               memHashRotl(lane[2], 12) + memHashRotl(lane[3], 18);
+
+        for (int i=0; i<MEMHASH_LANES; ++i) {
+            hash = memHashMerge(hash, lane[i]);
+        }
+    } else {
+        hash = seed + memHashPrime(4);
+    }
+
+    hash += (U64)length;
+
+    for (; ptr + 8 <= end; ptr += 8) {
+        hash ^= memHashRound(0, memLoad64(ptr));
+        hash = memHashRotl(hash, 27) * memHashPrime(0) + memHashPrime(3);
+    }
+
+    if (ptr + 4 <= end) {
+        hash ^= (U64)memLoad32(ptr) * memHashPrime(0);
+        hash = memHashRotl(hash, 23) * memHashPrime(1) + memHashPrime(2);
+        ptr += 4;
+    }
+
+    for (; ptr < end; ++ptr) {
+        hash ^= (*ptr) * memHashPrime(4);
+        hash = memHashRotl(hash, 11) * memHashPrime(0);
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= memHashPrime(1);
+    hash ^= hash >> 29;
+    hash *= memHashPrime(2);
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+} // soc
+
+#endif
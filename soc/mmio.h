@@ -0,0 +1,292 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes memory mapped I/O devices built from a
+ *        table of registers
+ */
+
+#ifndef _SOC_MMIO_H
+#define _SOC_MMIO_H
+
+#include <vector>
+#include "types.h"
+#include "busdevice.h"
+
+namespace soc {
+
+// Access and side effects of a register
+enum MmioFlags {
+    MMIO_READ = 0x1,                // can be read
+    MMIO_WRITE = 0x2,               // can be written
+    MMIO_READ_SIDE_EFFECT = 0x4,    // reading changes the device, e.g.
+                                    // pops a FIFO, peek refuses it
+    MMIO_WRITE_SIDE_EFFECT = 0x8,   // writing does more than store
+    MMIO_READ_WRITE = MMIO_READ | MMIO_WRITE
+};
+
+/**
+ * @brief One register of a device's register bank. A register without
+ *        a read or write callback is plain storage: reads return the
+ *        last value written, writes store it.
+ */
+template <typename Owner>
+struct MmioRegister
+{
+    BusAddressType offset;          // from the device base, word aligned
+    const char *name;
+    U32 flags;                      // MmioFlags
+    BusDataType resetValue;
+    bool (Owner::*read)(BusDataType &data);     // NULL for storage
+    bool (Owner::*write)(BusDataType data);     // NULL for storage
+};
+
+
+/**
+ * @class MmioDevice
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file mmio.h
+ * @brief A device made of registers. The register bank is turned in
+ *        to a dense table with one entry per word of the bank when the
+ *        device is built, so an access is one table lookup and at most
+ *        one call, whatever the number of registers.
+ *
+ *        Owner derives from MmioDevice<Owner> and passes the function
+ *        returning its bank to the constructor, callbacks are members
+ *        of Owner.
+ */
+template <typename Owner>
+class MmioDevice : public BusDevice
+{
+public:
+    typedef MmioRegister<Owner> Register;
+
+    // Returns the register bank of Owner and its number of registers
+    typedef const Register *(*RegisterBank)(U32 &count);
+
+
+private:
+    struct Handler
+    {
+        const Register *reg;        // NULL for a hole in the bank
+        BusDataType value;          // storage of plain registers
+    };
+
+    std::vector<Handler> mTable;    // indexed by offset / word size
+    const Register *mRegisters;
+    U32 mRegisterCount;
+    BusAddressType mBase;
+
+
+protected:
+    /**
+     * @brief Finds the handler of an address
+     * @param address bus address
+     * @return handler, NULL if no register is at the address
+     */
+    Handler *findHandler(BusAddressType address)
+    {
+        BusAddressType offset = address - mBase;
+        BusAddressType index = offset / sizeof(BusDataType);
+
+        if (((offset & (sizeof(BusDataType) - 1)) != 0) ||
+            (index >= mTable.size())) {
+            return NULL;
+        }
+
+        return (mTable[index].reg != NULL) ? &mTable[index] : NULL;
+    }
+
+    /**
+     * @brief Returns the stored value of a plain register, for
+     *        callbacks that also keep their value in the table
+     * @param offset register offset
+     * @return reference to value
+     */
+    BusDataType &storage(BusAddressType offset)
+    {
+        return mTable[offset / sizeof(BusDataType)].value;
+    }
+
+
+public:
+    /**
+     * @brief Constructor, builds the offset table of a register bank
+     * @param bank returns the register bank, which must outlive the
+     *             device
+     * @return nothing
+     */
+    explicit MmioDevice(RegisterBank bank)
+        : mRegisters(NULL), mRegisterCount(0), mBase(0)
+    {
+        BusAddressType words = 0;
+        U32 count = 0;
+        const Register *registers = bank(count);
+
+        mRegisters = registers;
+        mRegisterCount = count;
+
+        for (U32 i=0; i<count; ++i) {
+            BusAddressType index = registers[i].offset /
+                                   sizeof(BusDataType);
+
+            if (index >= words) {
+                words = index + 1;
+            }
+        }
+
+        Handler hole = { NULL, 0 };
+        mTable.assign(words, hole);
+
+        for (U32 i=0; i<count; ++i) {
+            Handler &handler = mTable[registers[i].offset /
+                                      sizeof(BusDataType)];
+
+            handler.reg = &registers[i];
+            handler.value = registers[i].resetValue;
+        }
+    }
+
+    /**
+     * @brief Deconstructor
+     * @return nothing
+     */
+    virtual ~MmioDevice()
+    {
+    }
+
+    /**
+     * @brief Attaches the device, registers are at offsets from the
+     *        start of the range
+     * @param bus specific bus to connect to
+     * @param devType master or slave
+     * @param addrRange addressable range of device
+     * @return true if success, otherwise false
+     */
+    virtual bool attachToBus(Bus *bus,
+                             Bus::BusDeviceType devType,
+                             const Bus::AddressRange *addrRange)
+    {
+        if (!BusDevice::attachToBus(bus, devType, addrRange)) {
+            return false;
+        }
+
+        mBase = (addrRange != NULL) ? addrRange->start : 0;
+
+        return true;
+    }
+
+    /**
+     * @brief Register devices are passive
+     * @return true if success, otherwise false
+     */
+    virtual bool execute()
+    {
+        return true;
+    }
+
+    /**
+     * @brief Puts every plain register back to its reset value
+     * @return true if success, otherwise false
+     */
+    virtual bool reset()
+    {
+        for (U32 i=0; i<mRegisterCount; ++i) {
+            storage(mRegisters[i].offset) = mRegisters[i].resetValue;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Reads a register
+     * @param address address of the register
+     * @param data location to store value
+     * @return true if success, false if nothing readable is there
+     */
+    virtual bool read(BusAddressType address, BusDataType &data)
+    {
+        Handler *handler = findHandler(address);
+
+        if ((handler == NULL) || ((handler->reg->flags & MMIO_READ) == 0)) {
+            return false;
+        }
+
+        if (handler->reg->read != NULL) {
+            return (static_cast<Owner*>(this)->*handler->reg->read)(data);
+        }
+
+        data = handler->value;
+
+        return true;
+    }
+
+    /**
+     * @brief Writes a register
+     * @param address address of the register
+     * @param data value to write
+     * @return true if success, false if nothing writable is there
+     */
+    virtual bool write(BusAddressType address, BusDataType &data)
+    {
+        Handler *handler = findHandler(address);
+
+        if ((handler == NULL) || ((handler->reg->flags & MMIO_WRITE) == 0)) {
+            return false;
+        }
+
+        if (handler->reg->write != NULL) {
+            return (static_cast<Owner*>(this)->*handler->reg->write)(data);
+        }
+
+        handler->value = data;
+
+        return true;
+    }
+
+    /**
+     * @brief Registers are never fetched as a line, a fetch from the
+     *        device reads one word at a time through read
+     * @return false
+     */
+    virtual bool readBlock(BusAddressType address, BusDataType *data,
+                           U32 count)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Reads a register for a debugger without disturbing the
+     *        device
+     * @param address address of the register
+     * @param data location to store value
+     * @return true if success, false if the read has side effects or
+     *         nothing readable is there
+     */
+    bool peek(BusAddressType address, BusDataType &data)
+    {
+        Handler *handler = findHandler(address);
+
+        if ((handler == NULL) ||
+            ((handler->reg->flags & MMIO_READ_SIDE_EFFECT) != 0)) {
+            return false;
+        }
+
+        return read(address, data);
+    }
+
+    /**
+     * @brief Returns the register bank of the device
+     * @param count location to store number of registers
+     * @return registers
+     */
+    const Register *getRegisters(U32 &count) const
+    {
+        count = mRegisterCount;
+
+        return mRegisters;
+    }
+};
+
+} // soc
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the page allocator used for guest memory
+ */
+
+#ifndef _SOC_PAGEALLOC_H
+#define _SOC_PAGEALLOC_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+
+#if defined(_WIN32)
+    #include <malloc.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #if defined(__linux__)
+        #include <sched.h>
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+namespace soc {
+
+// Pages backing guest memory, a policy that is not available falls back
+// to the next one down
+enum PagePolicy {
+    PAGES_NORMAL,
+    PAGES_TRANSPARENT_HUGE,     // madvise(MADV_HUGEPAGE), 2MB aligned
+    PAGES_HUGETLB               // MAP_HUGETLB from the reserved pool
+};
+
+enum {
+    PAGE_SIZE_NORMAL = 0x1000,
+    PAGE_SIZE_HUGE = 0x200000
+};
+
+struct MemoryPolicy
+{
+    PagePolicy pages;
+    bool numaLocal;     // prefer the NUMA node of the allocating thread
+};
+
+struct PageBlock
+{
+    U8 *base;
+    size_t length;      // as mapped, at least the length asked for
+    PagePolicy pages;   // policy actually used
+};
+
+
+/**
+ * @brief Returns the policy used when none is selected
+ * @return normal pages, no NUMA preference
+ */
+inline MemoryPolicy defaultMemoryPolicy()
+{
+    MemoryPolicy policy;
+
+    policy.pages = PAGES_NORMAL;
+    policy.numaLocal = false;
+
+    return policy;
+}
+
+
+/**
+ * @brief Parses a policy name
+ * @param name normal, thp or hugetlb, optionally followed by ",numa"
+ * @param policy location to store policy
+ * @return true if success, otherwise false
+ */
+inline bool parseMemoryPolicy(const char *name, MemoryPolicy &policy)
+{
+    const char *numa = strchr(name, ',');
+    size_t length = (numa != NULL) ? (size_t)(numa - name) : strlen(name);
+
+    if ((length == 6) && (strncmp(name, "normal", length) == 0)) {
+        policy.pages = PAGES_NORMAL;
+    } else if ((length == 3) && (strncmp(name, "thp", length) == 0)) {
+        policy.pages = PAGES_TRANSPARENT_HUGE;
+    } else if ((length == 7) && (strncmp(name, "hugetlb", length) == 0)) {
+        policy.pages = PAGES_HUGETLB;
+    } else {
+        return false;
+    }
+
+    if (numa == NULL) {
+        policy.numaLocal = false;
+    } else if (strcmp(numa, ",numa") == 0) {
+        policy.numaLocal = true;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+
+#if defined(__linux__)
+/**
+ * @brief Prefers the NUMA node of the calling thread for a range not
+ *        yet touched. Pages go elsewhere only if the node is full.
+ * @param base first address of the range, page aligned
+ * @param length bytes in the range
+ */
+inline void preferLocalNode(void *base, size_t length)
+{
+    unsigned int cpu;
+    unsigned int node;
+    unsigned long mask[16];     // up to 1024 nodes
+    const int MPOL_PREFERRED_MODE = 1;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        return;
+    }
+    if (node >= (sizeof(mask) * 8)) {
+        return;
+    }
+
+    memset(mask, 0, sizeof(mask));
+    mask[node / (sizeof(mask[0]) * 8)] = 1UL << (node % (sizeof(mask[0]) * 8));
+
+    // Without NUMA support this fails and the default policy is kept
+    syscall(SYS_mbind, base, length, MPOL_PREFERRED_MODE, mask,
+            sizeof(mask) * 8, 0);
+}
+#endif
+
+
+/**
+ * @brief Maps zeroed pages for guest memory. Huge pages fall back to
+ *        normal pages when the host has none to give.
+ * @param length bytes needed
+ * @param policy pages to use and NUMA placement
+ * @param block location to store the mapping, pass it to freePages
+ * @return true if success, otherwise false
+ */
+inline bool allocatePages(size_t length, const MemoryPolicy &policy,
+                          PageBlock &block)
+{
+    block.base = NULL;
+    block.pages = policy.pages;
+
+#if defined(_WIN32)
+    block.pages = PAGES_NORMAL;
+    block.length = (length + PAGE_SIZE_NORMAL - 1) &
+                   ~(size_t)(PAGE_SIZE_NORMAL - 1);
+    block.base = (U8*)_aligned_malloc(block.length, PAGE_SIZE_NORMAL);
+    if (block.base == NULL) {
+        return false;
+    }
+    memset(block.base, 0, block.length);
+
+    return true;
+#else
+    void *base = MAP_FAILED;
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    if (block.pages == PAGES_HUGETLB) {
+        block.length = (length + PAGE_SIZE_HUGE - 1) &
+                       ~(size_t)(PAGE_SIZE_HUGE - 1);
+        base = mmap(NULL, block.length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            // Nothing reserved, try transparent huge pages instead
+            block.pages = PAGES_TRANSPARENT_HUGE;
+        }
+    }
+#else
+    if (block.pages == PAGES_HUGETLB) {
+        block.pages = PAGES_TRANSPARENT_HUGE;
+    }
+#endif
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (block.pages == PAGES_TRANSPARENT_HUGE) {
+        // Over map so a 2MB aligned range can be kept
+        size_t huge = (length + PAGE_SIZE_HUGE - 1) &
+                      ~(size_t)(PAGE_SIZE_HUGE - 1);
+        size_t mapped = huge + PAGE_SIZE_HUGE;
+        U8 *raw = (U8*)mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (raw != (U8*)MAP_FAILED) {
+            U8 *aligned = (U8*)(((size_t)raw + PAGE_SIZE_HUGE - 1) &
+                                ~(size_t)(PAGE_SIZE_HUGE - 1));
+
+            if (aligned != raw) {
+                munmap(raw, aligned - raw);
+            }
+            if ((raw + mapped) != (aligned + huge)) {
+                munmap(aligned + huge, (raw + mapped) - (aligned + huge));
+            }
+
+            base = aligned;
+            block.length = huge;
+
+            if (madvise(base, huge, MADV_HUGEPAGE) != 0) {
+                block.pages = PAGES_NORMAL;
+            }
+        } else {
+            block.pages = PAGES_NORMAL;
+        }
+    }
+#else
+    if (block.pages == PAGES_TRANSPARENT_HUGE) {
+        block.pages = PAGES_NORMAL;
+    }
+#endif
+
+    if (base == MAP_FAILED) {
+        block.pages = PAGES_NORMAL;
+        block.length = (length + PAGE_SIZE_NORMAL - 1) &
+                       ~(size_t)(PAGE_SIZE_NORMAL - 1);
+        base = mmap(NULL, block.length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+    }
+
+#if defined(__linux__)
+    if (policy.numaLocal) {
+        preferLocalNode(base, block.length);
+    }
+#endif
+
+    block.base = (U8*)base;
+
+    return true;
+#endif
+}
+
+
+/**
+ * @brief Unmaps pages mapped by allocatePages
+ * @param block mapping to free
+ */
+inline void freePages(PageBlock &block)
+{
+    if (block.base == NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    _aligned_free(block.base);
+#else
+    munmap(block.base, block.length);
+#endif
+
+    block.base = NULL;
+}
+
+
+/**
+ * @brief Returns a name for a page policy
+ * @param pages policy
+ * @return name, never NULL
+ */
+inline const char *pagePolicyName(PagePolicy pages)
+{
+    switch (pages) {
+    case PAGES_TRANSPARENT_HUGE:
+        return "thp";
+    case PAGES_HUGETLB:
+        return "hugetlb";
+    default:
+        return "normal";
+    }
+}
+
+} // soc
+
+#endif
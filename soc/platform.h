@@ -0,0 +1,1066 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes a SoC platform built from a text
+ *        description at run time
+ */
+
+#ifndef _SOC_PLATFORM_H
+#define _SOC_PLATFORM_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "bus.h"
+#include "busdevice.h"
+#include "memregion.h"
+#include "memtiming.h"
+#include "memutil.h"
+#include "uart.h"
+#include "mailbox.h"
+
+namespace soc {
+
+/**
+ * @brief key=value setting of a device, read by its factory
+ */
+struct PlatformParam
+{
+    std::string key;
+    std::string value;
+};
+
+/**
+ * @brief One device of a platform, devices are attached to the bus in
+ *        the order they are described
+ */
+struct PlatformDevice
+{
+    std::string kind;
+    std::string name;
+    bool addressable;
+    Bus::AddressRange range;
+    std::vector<PlatformParam> params;
+
+    /**
+     * @brief Finds a setting
+     * @param key name of setting
+     * @return value, NULL if not set
+     */
+    const char *param(const char *key) const
+    {
+        for (size_t i=0; i<params.size(); ++i) {
+            if (params[i].key == key) {
+                return params[i].value.c_str();
+            }
+        }
+
+        return NULL;
+    }
+
+    /**
+     * @brief Reads a numeric setting
+     * @param key name of setting
+     * @param defaultValue value if not set
+     * @return value
+     */
+    U32 paramU32(const char *key, U32 defaultValue) const
+    {
+        const char *value = param(key);
+
+        return (value != NULL) ? (U32)strtoul(value, NULL, 0) : defaultValue;
+    }
+};
+
+/**
+ * @brief Raw binary file copied in to a MemoryRegion on every reset
+ */
+struct PlatformImage
+{
+    std::string device;
+    U32 offset;             // from the start of the device
+    std::string path;
+};
+
+// Fields of a PlatformCPU set by the description
+enum {
+    PLATFORM_CPU_REGISTERS = 0x01,
+    PLATFORM_CPU_RESET = 0x02,
+    PLATFORM_CPU_STACK = 0x04,
+    PLATFORM_CPU_INSTRUCTION_SIZE = 0x08,
+    PLATFORM_CPU_EXCEPTION = 0x10,
+    PLATFORM_CPU_ALL = 0x1F
+};
+
+/**
+ * @brief CPU profile of a platform. Only the fields the description
+ *        sets are valid, the application running it keeps its own
+ *        defaults for the others and checks it supports the profile.
+ */
+struct PlatformCPU
+{
+    U32 set;                // PLATFORM_CPU_* of the fields set
+    U32 registers;
+    U32 reset;              // pc after reset
+    U32 stack;              // sp after reset
+    U32 instructionSize;    // bytes
+    U32 exception;          // vector faults enter
+};
+
+/**
+ * @brief Parsed and validated description of a platform
+ */
+struct PlatformConfig
+{
+    U64 sourceHash;         // hash of the text parsed
+    std::vector<PlatformDevice> devices;
+    std::vector<PlatformImage> images;
+    std::string timed;      // device behind the cache model, empty if none
+    PlatformCPU cpu;
+};
+
+// Creates a device from its description, NULL if a setting is invalid
+typedef BusDevice *(*PlatformFactory)(const PlatformDevice &desc);
+
+/**
+ * @brief A kind of device a description can name
+ */
+struct PlatformKind
+{
+    const char *kind;
+    Bus::BusDeviceType type;
+    bool needsRange;        // must be given an address range
+    PlatformFactory create;
+};
+
+
+/**
+ * @brief Reads a whole file
+ * @param path file to read
+ * @param contents location to store contents of file
+ * @return true if success, otherwise false
+ */
+inline bool readPlatformFile(const char *path, std::vector<U8> &contents)
+{
+    FILE *fp = fopen(path, "rb");
+    bool retval = false;
+
+    if (fp == NULL) {
+        return false;
+    }
+
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long length = ftell(fp);
+
+        if ((length >= 0) && (fseek(fp, 0, SEEK_SET) == 0)) {
+            contents.resize((size_t)length);
+            retval = (fread(contents.data(), 1, contents.size(), fp) ==
+                      contents.size());
+        }
+    }
+
+    fclose(fp);
+
+    return retval;
+}
+
+
+// Binary form of a PlatformConfig, in host byte order. Strings are
+// stored once, NUL terminated, and referred to by offset.
+//   PlatformBlobHeader
+//   PlatformBlobDevice[deviceCount]
+//   PlatformBlobParam[paramCount]
+//   PlatformBlobImage[imageCount]
+//   strings[stringBytes]
+enum {
+    PLATFORM_BLOB_MAGIC = 0x50434F53,   // "SOCP"
+    PLATFORM_BLOB_VERSION = 2,
+    PLATFORM_BLOB_NONE = 0xFFFFFFFF     // no string
+};
+
+struct PlatformBlobHeader
+{
+    U32 magic;
+    U32 version;
+    U64 sourceHash;
+    U32 deviceCount;
+    U32 paramCount;
+    U32 imageCount;
+    U32 timed;
+    U32 stringBytes;
+    U32 reserved;
+    PlatformCPU cpu;
+};
+
+struct PlatformBlobDevice
+{
+    U32 kind;
+    U32 name;
+    U32 addressable;
+    U32 start;
+    U32 end;
+    U32 firstParam;
+    U32 paramCount;
+};
+
+struct PlatformBlobParam
+{
+    U32 key;
+    U32 value;
+};
+
+struct PlatformBlobImage
+{
+    U32 device;
+    U32 offset;
+    U32 path;
+};
+
+/**
+ * @brief Adds a string to the string table of a blob
+ * @return offset of the string
+ */
+inline U32 addPlatformBlobString(std::vector<U8> &strings,
+                                 const std::string &value)
+{
+    U32 offset = (U32)strings.size();
+
+    strings.insert(strings.end(), value.begin(), value.end());
+    strings.push_back('\0');
+
+    return offset;
+}
+
+/**
+ * @brief Appends the bytes of a record to a blob
+ */
+template <typename Record>
+inline void appendPlatformBlob(std::vector<U8> &blob, const Record &record)
+{
+    const U8 *bytes = (const U8*)&record;
+
+    blob.insert(blob.end(), bytes, bytes + sizeof(record));
+}
+
+/**
+ * @brief Writes a parsed config as a blob that readPlatformBlob loads
+ *        without parsing
+ * @param path file to write
+ * @param config config to write
+ * @return true if success, otherwise false
+ */
+inline bool writePlatformBlob(const char *path, const PlatformConfig &config)
+{
+    std::vector<U8> records;
+    std::vector<U8> params;
+    std::vector<U8> strings;
+    PlatformBlobHeader header;
+    U32 paramCount = 0;
+
+    memset(&header, 0, sizeof(header));
+
+    for (size_t i=0; i<config.devices.size(); ++i) {
+        const PlatformDevice &desc = config.devices[i];
+        PlatformBlobDevice device;
+
+        device.kind = addPlatformBlobString(strings, desc.kind);
+        device.name = addPlatformBlobString(strings, desc.name);
+        device.addressable = desc.addressable ? 1 : 0;
+        device.start = desc.range.start;
+        device.end = desc.range.end;
+        device.firstParam = paramCount;
+        device.paramCount = (U32)desc.params.size();
+        appendPlatformBlob(records, device);
+
+        for (size_t j=0; j<desc.params.size(); ++j) {
+            PlatformBlobParam param;
+
+            param.key = addPlatformBlobString(strings, desc.params[j].key);
+            param.value = addPlatformBlobString(strings,
+                                                desc.params[j].value);
+            appendPlatformBlob(params, param);
+            ++paramCount;
+        }
+    }
+
+    records.insert(records.end(), params.begin(), params.end());
+
+    for (size_t i=0; i<config.images.size(); ++i) {
+        PlatformBlobImage image;
+
+        image.device = addPlatformBlobString(strings,
+                                             config.images[i].device);
+        image.offset = config.images[i].offset;
+        image.path = addPlatformBlobString(strings, config.images[i].path);
+        appendPlatformBlob(records, image);
+    }
+
+    header.magic = PLATFORM_BLOB_MAGIC;
+    header.version = PLATFORM_BLOB_VERSION;
+    header.sourceHash = config.sourceHash;
+    header.deviceCount = (U32)config.devices.size();
+    header.paramCount = paramCount;
+    header.imageCount = (U32)config.images.size();
+    header.timed = config.timed.empty() ?
+                       (U32)PLATFORM_BLOB_NONE :
+                       addPlatformBlobString(strings, config.timed);
+    header.stringBytes = (U32)strings.size();
+    header.cpu = config.cpu;
+
+    // Written aside and renamed, instances starting at the same time
+    // see the old blob or the new one, never half of one
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%ld", (long)getpid());
+    std::string temp = std::string(path) + suffix;
+
+    FILE *fp = fopen(temp.c_str(), "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool retval = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+                  (fwrite(records.data(), 1, records.size(), fp) ==
+                   records.size()) &&
+                  (fwrite(strings.data(), 1, strings.size(), fp) ==
+                   strings.size());
+
+    retval = (fclose(fp) == 0) && retval &&
+             (rename(temp.c_str(), path) == 0);
+    if (!retval) {
+        remove(temp.c_str());
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Reads a blob written by writePlatformBlob. Only the layout is
+ *        checked, the config was validated before it was written.
+ * @param path file to read
+ * @param config location to store config
+ * @return true if success, false if missing, damaged or of another
+ *         version
+ */
+inline bool readPlatformBlob(const char *path, PlatformConfig &config)
+{
+    std::vector<U8> blob;
+    PlatformBlobHeader header;
+
+    if (!readPlatformFile(path, blob) || (blob.size() < sizeof(header))) {
+        return false;
+    }
+
+    memcpy(&header, blob.data(), sizeof(header));
+
+    size_t expected = sizeof(header) +
+                      ((size_t)header.deviceCount *
+                       sizeof(PlatformBlobDevice)) +
+                      ((size_t)header.paramCount *
+                       sizeof(PlatformBlobParam)) +
+                      ((size_t)header.imageCount *
+                       sizeof(PlatformBlobImage)) +
+                      header.stringBytes;
+
+    if ((header.magic != PLATFORM_BLOB_MAGIC) ||
+        (header.version != PLATFORM_BLOB_VERSION) ||
+        (blob.size() != expected) || (header.stringBytes == 0) ||
+        (blob.back() != '\0') || ((header.cpu.set & ~PLATFORM_CPU_ALL) != 0)) {
+        return false;
+    }
+
+    const U8 *pos = blob.data() + sizeof(header);
+    const U8 *paramBase = pos + (header.deviceCount *
+                                 sizeof(PlatformBlobDevice));
+    const U8 *imageBase = paramBase + (header.paramCount *
+                                       sizeof(PlatformBlobParam));
+    const char *strings = (const char*)(blob.data() + blob.size() -
+                                        header.stringBytes);
+    U32 stringBytes = header.stringBytes;
+
+#define PLATFORM_BLOB_STRING_OK(_offset) ((_offset) < stringBytes)
+
+    config.sourceHash = header.sourceHash;
+    config.cpu = header.cpu;
+    config.devices.resize(header.deviceCount);
+    config.images.resize(header.imageCount);
+
+    for (U32 i=0; i<header.deviceCount; ++i) {
+        PlatformBlobDevice device;
+        PlatformDevice &desc = config.devices[i];
+
+        memcpy(&device, pos + (i * sizeof(device)), sizeof(device));
+
+        if (!PLATFORM_BLOB_STRING_OK(device.kind) ||
+            !PLATFORM_BLOB_STRING_OK(device.name) ||
+            (device.firstParam > header.paramCount) ||
+            (device.paramCount > (header.paramCount - device.firstParam))) {
+            return false;
+        }
+
+        desc.kind = strings + device.kind;
+        desc.name = strings + device.name;
+        desc.addressable = (device.addressable != 0);
+        desc.range.start = device.start;
+        desc.range.end = device.end;
+        desc.params.resize(device.paramCount);
+
+        for (U32 j=0; j<device.paramCount; ++j) {
+            PlatformBlobParam param;
+
+            memcpy(&param,
+                   paramBase + ((device.firstParam + j) * sizeof(param)),
+                   sizeof(param));
+
+            if (!PLATFORM_BLOB_STRING_OK(param.key) ||
+                !PLATFORM_BLOB_STRING_OK(param.value)) {
+                return false;
+            }
+
+            desc.params[j].key = strings + param.key;
+            desc.params[j].value = strings + param.value;
+        }
+    }
+
+    for (U32 i=0; i<header.imageCount; ++i) {
+        PlatformBlobImage image;
+
+        memcpy(&image, imageBase + (i * sizeof(image)), sizeof(image));
+
+        if (!PLATFORM_BLOB_STRING_OK(image.device) ||
+            !PLATFORM_BLOB_STRING_OK(image.path)) {
+            return false;
+        }
+
+        config.images[i].device = strings + image.device;
+        config.images[i].offset = image.offset;
+        config.images[i].path = strings + image.path;
+    }
+
+    if (header.timed == PLATFORM_BLOB_NONE) {
+        config.timed.clear();
+    } else if (PLATFORM_BLOB_STRING_OK(header.timed)) {
+        config.timed = strings + header.timed;
+    } else {
+        return false;
+    }
+
+#undef PLATFORM_BLOB_STRING_OK
+
+    return true;
+}
+
+
+/**
+ * @brief Creates a MemoryRegion, fill=value sets its reset value
+ */
+inline BusDevice *createPlatformMemory(const PlatformDevice &desc)
+{
+    return new MemoryRegion((U8)desc.paramU32("fill", 0));
+}
+
+/**
+ * @brief Creates a Uart, fd=value picks the host file descriptor it
+ *        transmits to, stdout by default
+ */
+inline BusDevice *createPlatformUart(const PlatformDevice &desc)
+{
+    return new Uart((int)desc.paramU32("fd", 1));
+}
+
+/**
+ * @brief Creates a Mailbox
+ */
+inline BusDevice *createPlatformMailbox(const PlatformDevice &desc)
+{
+    return new Mailbox();
+}
+
+
+/**
+ * @class Platform
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file platform.h
+ * @brief A bus and the devices on it, built from a description. A
+ *        description has one statement per line, # starts a comment:
+ *
+ *          <kind> <name> [start-end] [key=value ...]
+ *              adds a device, attached in the order listed
+ *          image <memory> <offset> <path>
+ *              copies a raw binary file in to a memory on every reset
+ *          timing <memory>
+ *              puts a cache and TLB model in front of a memory
+ *          cpu [registers=n] [reset=pc] [stack=sp] [isize=bytes]
+ *              [exception=vector]
+ *              sets the CPU profile, at most once
+ *
+ *        for example
+ *
+ *          memory  ram   0x0000-0xFFFF fill=0xFF
+ *          uart    uart0 0x10000-0x1000F fd=1
+ *          image   ram   0x0000 firmware.bin
+ *          cpu     registers=8 stack=0x10000
+ *
+ *        Kinds memory, uart and mailbox are built in, applications add
+ *        their CPUs and devices with addKind. Address ranges may not
+ *        overlap. A parsed description can be cached as a binary blob,
+ *        so starting many instances only reads the blob.
+ */
+class Platform
+{
+private:
+    std::vector<PlatformKind> mKinds;
+    Bus mBus;
+    PlatformConfig mConfig;             // config built
+    std::vector<BusDevice*> mDevices;   // one per device of mConfig
+    MemoryTiming *mTiming;
+
+
+    // Not copyable, devices are owned
+    Platform(const Platform &);
+    Platform &operator=(const Platform &);
+
+
+    /**
+     * @brief Finds a kind by name
+     * @param kind name of kind
+     * @return kind, NULL if unknown
+     */
+    const PlatformKind *findKind(const std::string &kind) const
+    {
+        for (size_t i=0; i<mKinds.size(); ++i) {
+            if (kind == mKinds[i].kind) {
+                return &mKinds[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    /**
+     * @brief Finds a device of a config by name
+     * @return index, config.devices.size() if none
+     */
+    static size_t findConfigDevice(const PlatformConfig &config,
+                                   const std::string &name)
+    {
+        for (size_t i=0; i<config.devices.size(); ++i) {
+            if (config.devices[i].name == name) {
+                return i;
+            }
+        }
+
+        return config.devices.size();
+    }
+
+    /**
+     * @brief Parses an address or other number, all of text must be used
+     */
+    static bool parseNumber(const std::string &text, U32 &value)
+    {
+        char *end;
+        unsigned long long parsed;
+
+        if (text.empty() || (text[0] == '-')) {
+            return false;
+        }
+
+        parsed = strtoull(text.c_str(), &end, 0);
+        value = (U32)parsed;
+
+        return (*end == '\0') && (parsed <= 0xFFFFFFFFULL);
+    }
+
+    /**
+     * @brief Finds a setting of the cpu statement
+     * @param cpu profile being parsed
+     * @param key name of setting
+     * @param flag location to store the PLATFORM_CPU_* of the setting
+     * @return field of the setting, NULL if unknown
+     */
+    static U32 *findCPUField(PlatformCPU &cpu, const std::string &key,
+                             U32 &flag)
+    {
+        if (key == "registers") {
+            flag = PLATFORM_CPU_REGISTERS;
+            return &cpu.registers;
+        } else if (key == "reset") {
+            flag = PLATFORM_CPU_RESET;
+            return &cpu.reset;
+        } else if (key == "stack") {
+            flag = PLATFORM_CPU_STACK;
+            return &cpu.stack;
+        } else if (key == "isize") {
+            flag = PLATFORM_CPU_INSTRUCTION_SIZE;
+            return &cpu.instructionSize;
+        } else if (key == "exception") {
+            flag = PLATFORM_CPU_EXCEPTION;
+            return &cpu.exception;
+        }
+
+        return NULL;
+    }
+
+    /**
+     * @brief Formats an error of one line of a description
+     */
+    static bool lineError(std::string &error, U32 line, const char *message,
+                          const std::string &detail)
+    {
+        char prefix[32];
+
+        snprintf(prefix, sizeof(prefix), "line %u: ", line);
+        error = std::string(prefix) + message + " " + detail;
+
+        return false;
+    }
+
+
+public:
+    /**
+     * @brief Constructor, knows the built in kinds
+     * @return nothing
+     */
+    Platform()
+        : mTiming(NULL)
+    {
+        static const PlatformKind builtinKinds[] = {
+            { "memory", Bus::BUSDEVICE_SLAVE, true, createPlatformMemory },
+            { "uart", Bus::BUSDEVICE_SLAVE, true, createPlatformUart },
+            { "mailbox", Bus::BUSDEVICE_SLAVE, true, createPlatformMailbox }
+        };
+
+        mKinds.assign(builtinKinds, builtinKinds +
+                      (sizeof(builtinKinds) / sizeof(builtinKinds[0])));
+        mConfig.sourceHash = 0;
+        memset(&mConfig.cpu, 0, sizeof(mConfig.cpu));
+    }
+
+    /**
+     * @brief Deconstructor, destroys every device built
+     * @return nothing
+     */
+    ~Platform()
+    {
+        mBus.setMemoryTiming(NULL, NULL);
+
+        for (size_t i=mDevices.size(); i>0; --i) {
+            mBus.removeDevice(mDevices[i - 1]);
+            delete mDevices[i - 1];
+        }
+
+        delete mTiming;
+    }
+
+    /**
+     * @brief Adds a kind of device
+     * @param kind kind, its name must outlive the platform
+     * @return true if success, false if a kind of that name exists
+     */
+    bool addKind(const PlatformKind &kind)
+    {
+        if (findKind(kind.kind) != NULL) {
+            return false;
+        }
+
+        mKinds.push_back(kind);
+
+        return true;
+    }
+
+    /**
+     * @brief Parses and validates a description
+     * @param text description
+     * @param length bytes of text
+     * @param config location to store the config
+     * @param error location to store a message on failure
+     * @return true if success, otherwise false
+     */
+    bool parse(const char *text, size_t length, PlatformConfig &config,
+               std::string &error) const
+    {
+        U32 lineNumber = 0;
+        size_t pos = 0;
+
+        config.sourceHash = memoryHash((const U8*)text, length);
+        config.devices.clear();
+        config.images.clear();
+        config.timed.clear();
+        memset(&config.cpu, 0, sizeof(config.cpu));
+        bool cpuDescribed = false;
+
+        while (pos < length) {
+            size_t end = pos;
+            std::vector<std::string> tokens;
+
+            while ((end < length) && (text[end] != '\n')) {
+                ++end;
+            }
+            ++lineNumber;
+
+            // Split on white space up to a comment
+            for (size_t i=pos; (i < end) && (text[i] != '#'); ) {
+                if (isspace((unsigned char)text[i])) {
+                    ++i;
+                    continue;
+                }
+
+                size_t first = i;
+                while ((i < end) && (text[i] != '#') &&
+                       !isspace((unsigned char)text[i])) {
+                    ++i;
+                }
+                tokens.push_back(std::string(text + first, i - first));
+            }
+            pos = end + 1;
+
+            if (tokens.empty()) {
+                continue;
+            }
+
+            if (tokens[0] == "image") {
+                PlatformImage image;
+
+                if (tokens.size() != 4) {
+                    return lineError(error, lineNumber, "expected",
+                                     "image <memory> <offset> <path>");
+                }
+                if (findConfigDevice(config, tokens[1]) ==
+                    config.devices.size()) {
+                    return lineError(error, lineNumber, "unknown device",
+                                     tokens[1]);
+                }
+                if (!parseNumber(tokens[2], image.offset)) {
+                    return lineError(error, lineNumber, "invalid offset",
+                                     tokens[2]);
+                }
+
+                image.device = tokens[1];
+                image.path = tokens[3];
+                config.images.push_back(image);
+                continue;
+            }
+
+            if (tokens[0] == "timing") {
+                if (tokens.size() != 2) {
+                    return lineError(error, lineNumber, "expected",
+                                     "timing <memory>");
+                }
+                if (findConfigDevice(config, tokens[1]) ==
+                    config.devices.size()) {
+                    return lineError(error, lineNumber, "unknown device",
+                                     tokens[1]);
+                }
+                if (!config.timed.empty()) {
+                    return lineError(error, lineNumber, "already timing",
+                                     config.timed);
+                }
+
+                config.timed = tokens[1];
+                continue;
+            }
+
+            if (tokens[0] == "cpu") {
+                if (cpuDescribed) {
+                    return lineError(error, lineNumber, "already", "cpu");
+                }
+
+                for (size_t i=1; i<tokens.size(); ++i) {
+                    size_t equals = tokens[i].find('=');
+                    U32 flag = 0;
+                    U32 *field = (equals == std::string::npos) ? NULL :
+                                 findCPUField(config.cpu,
+                                              tokens[i].substr(0, equals),
+                                              flag);
+
+                    if (field == NULL) {
+                        return lineError(error, lineNumber, "expected",
+                                         "cpu [registers=n] [reset=pc] "
+                                         "[stack=sp] [isize=bytes] "
+                                         "[exception=vector]");
+                    }
+                    if (!parseNumber(tokens[i].substr(equals + 1), *field)) {
+                        return lineError(error, lineNumber, "invalid value",
+                                         tokens[i]);
+                    }
+                    config.cpu.set |= flag;
+                }
+
+                cpuDescribed = true;
+                continue;
+            }
+
+            const PlatformKind *kind = findKind(tokens[0]);
+            PlatformDevice desc;
+            size_t next = 2;
+
+            if (kind == NULL) {
+                return lineError(error, lineNumber, "unknown kind",
+                                 tokens[0]);
+            }
+            if (tokens.size() < 2) {
+                return lineError(error, lineNumber, "expected",
+                                 "<kind> <name> [start-end] [key=value ...]");
+            }
+            if (findConfigDevice(config, tokens[1]) !=
+                config.devices.size()) {
+                return lineError(error, lineNumber, "duplicate device",
+                                 tokens[1]);
+            }
+
+            desc.kind = tokens[0];
+            desc.name = tokens[1];
+            desc.addressable = false;
+            desc.range.start = 0;
+            desc.range.end = 0;
+
+            if ((tokens.size() > 2) &&
+                (tokens[2].find('=') == std::string::npos)) {
+                size_t dash = tokens[2].find('-');
+
+                if ((dash == std::string::npos) ||
+                    !parseNumber(tokens[2].substr(0, dash),
+                                 desc.range.start) ||
+                    !parseNumber(tokens[2].substr(dash + 1),
+                                 desc.range.end) ||
+                    (desc.range.end < desc.range.start)) {
+                    return lineError(error, lineNumber, "invalid range",
+                                     tokens[2]);
+                }
+                desc.addressable = true;
+                next = 3;
+            }
+
+            if (kind->needsRange && !desc.addressable) {
+                return lineError(error, lineNumber, "range required for",
+                                 desc.name);
+            }
+
+            for (size_t i=next; i<tokens.size(); ++i) {
+                size_t equals = tokens[i].find('=');
+                PlatformParam param;
+
+                if ((equals == std::string::npos) || (equals == 0)) {
+                    return lineError(error, lineNumber, "expected key=value",
+                                     tokens[i]);
+                }
+
+                param.key = tokens[i].substr(0, equals);
+                param.value = tokens[i].substr(equals + 1);
+                desc.params.push_back(param);
+            }
+
+            if (desc.addressable) {
+                for (size_t i=0; i<config.devices.size(); ++i) {
+                    const PlatformDevice &other = config.devices[i];
+
+                    if (other.addressable &&
+                        (desc.range.start <= other.range.end) &&
+                        (other.range.start <= desc.range.end)) {
+                        return lineError(error, lineNumber, "range overlaps",
+                                         other.name);
+                    }
+                }
+            }
+
+            config.devices.push_back(desc);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Loads a description file, through a blob cache when one is
+     *        given. A blob of the same text is used without parsing,
+     *        otherwise the text is parsed and the blob rewritten.
+     * @param path description file
+     * @param cachePath blob file, NULL to always parse
+     * @param config location to store the config
+     * @param error location to store a message on failure
+     * @param cached location to store whether the blob was used, may be
+     *               NULL
+     * @return true if success, otherwise false
+     */
+    bool load(const char *path, const char *cachePath,
+              PlatformConfig &config, std::string &error,
+              bool *cached=NULL) const
+    {
+        std::vector<U8> text;
+
+        if (!readPlatformFile(path, text)) {
+            error = std::string("unable to read ") + path;
+            return false;
+        }
+
+        U64 sourceHash = memoryHash(text.data(), text.size());
+        bool hit = (cachePath != NULL) &&
+                   readPlatformBlob(cachePath, config) &&
+                   (config.sourceHash == sourceHash);
+
+        if (cached != NULL) {
+            *cached = hit;
+        }
+        if (hit) {
+            return true;
+        }
+
+        if (!parse((const char*)text.data(), text.size(), config, error)) {
+            return false;
+        }
+
+        if (cachePath != NULL) {
+            // Only a cache, the next start parses again if this fails
+            writePlatformBlob(cachePath, config);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Creates and attaches the devices of a config, loads its
+     *        images and resets the platform. Only one config can be
+     *        built per platform.
+     * @param config parsed config
+     * @param error location to store a message on failure
+     * @return true if success, otherwise false
+     */
+    bool build(const PlatformConfig &config, std::string &error)
+    {
+        if (!mDevices.empty()) {
+            error = "platform already built";
+            return false;
+        }
+
+        mConfig = config;
+        mBus.reserveDevices(config.devices.size());
+
+        for (size_t i=0; i<config.devices.size(); ++i) {
+            const PlatformDevice &desc = config.devices[i];
+            const PlatformKind *kind = findKind(desc.kind);
+            BusDevice *device = (kind != NULL) ? kind->create(desc) : NULL;
+
+            if (device == NULL) {
+                error = "unable to create " + desc.name;
+                return false;
+            }
+
+            mDevices.push_back(device);
+            if (!device->attachToBus(&mBus, kind->type,
+                                     desc.addressable ? &desc.range : NULL)) {
+                error = "unable to attach " + desc.name;
+                return false;
+            }
+        }
+
+        for (size_t i=0; i<config.images.size(); ++i) {
+            const PlatformImage &image = config.images[i];
+            MemoryRegion *memory = findMemory(image.device.c_str());
+            std::vector<U8> contents;
+
+            if (memory == NULL) {
+                error = image.device + " is not a memory";
+                return false;
+            }
+            if (!readPlatformFile(image.path.c_str(), contents)) {
+                error = "unable to read " + image.path;
+                return false;
+            }
+            if (!memory->preload(image.offset, contents.data(),
+                                 (U32)contents.size())) {
+                error = image.path + " does not fit in " + image.device;
+                return false;
+            }
+        }
+
+        if (!config.timed.empty()) {
+            mTiming = new MemoryTiming();
+            mBus.setMemoryTiming(mTiming, find(config.timed.c_str()));
+        }
+
+        if (!mBus.systemReset()) {
+            error = "unable to reset";
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Returns the bus of the platform
+     * @return bus
+     */
+    Bus &getBus()
+    {
+        return mBus;
+    }
+
+    /**
+     * @brief Returns the config the platform was built from
+     * @return config
+     */
+    const PlatformConfig &getConfig() const
+    {
+        return mConfig;
+    }
+
+    /**
+     * @brief Finds a device by name
+     * @param name name given in the description
+     * @return device, NULL if none
+     */
+    BusDevice *find(const char *name)
+    {
+        for (size_t i=0; i<mDevices.size(); ++i) {
+            if (mConfig.devices[i].name == name) {
+                return mDevices[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    /**
+     * @brief Finds the description of a device by name
+     * @param name name given in the description
+     * @return description, NULL if none
+     */
+    const PlatformDevice *describe(const char *name) const
+    {
+        size_t index = findConfigDevice(mConfig, name);
+
+        return (index < mDevices.size()) ? &mConfig.devices[index] : NULL;
+    }
+
+    /**
+     * @brief Finds a memory device by name
+     * @param name name given in the description
+     * @return memory, NULL if none or not of kind memory
+     */
+    MemoryRegion *findMemory(const char *name)
+    {
+        const PlatformDevice *desc = describe(name);
+
+        if ((desc == NULL) || (desc->kind != "memory")) {
+            return NULL;
+        }
+
+        return static_cast<MemoryRegion*>(find(name));
+    }
+
+    /**
+     * @brief Returns the cache and TLB model of the platform
+     * @return ptr to model, NULL when the description has no timing
+     */
+    MemoryTiming *getMemoryTiming()
+    {
+        return mTiming;
+    }
+};
+
+} // soc
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes a pool of objects recycled through a
+ *        free list
+ */
+
+#ifndef _SOC_POOL_H
+#define _SOC_POOL_H
+
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <vector>
+#include "types.h"
+#include "pagealloc.h"
+
+namespace soc {
+
+/**
+ * @class ObjectPool
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file pool.h
+ * @brief Hands out objects carved from large blocks and takes them
+ *        back on a free list, so creating and destroying instances
+ *        never reaches the global allocator once the pool is warm.
+ *        Objects start on a cache line and are laid out back to back
+ *        in blocks mapped with the pool's MemoryPolicy.
+ *
+ *        A pool is not thread safe, give every worker thread its own.
+ *        Blocks are touched by the thread that grows the pool, so even
+ *        without a NUMA policy they live on that thread's node on a
+ *        first touch host.
+ */
+template <typename T>
+class ObjectPool
+{
+public:
+    enum {
+        LINE_SIZE = 64,
+        SLOT_SIZE = ((sizeof(T) + LINE_SIZE - 1) / LINE_SIZE) * LINE_SIZE,
+        DEFAULT_BLOCK_OBJECTS = 64
+    };
+
+
+private:
+    struct FreeSlot
+    {
+        FreeSlot *next;
+    };
+
+    std::vector<PageBlock> mBlocks;
+    MemoryPolicy mPolicy;
+    PagePolicy mPages;          // pages the last block got
+    FreeSlot *mFree;
+    size_t mBlockObjects;
+    size_t mCapacity;
+    size_t mInUse;
+
+
+protected:
+    /**
+     * @brief Allocates one more block and puts its slots on the free list
+     * @return true if success, otherwise false
+     */
+    bool grow()
+    {
+        PageBlock block;
+
+        if (!allocatePages(mBlockObjects * SLOT_SIZE, mPolicy, block)) {
+            return false;
+        }
+
+        // First touch, faults every page in on this thread's node
+        memset(block.base, 0, block.length);
+        mBlocks.push_back(block);
+        mPages = block.pages;
+
+        U8 *slot = block.base;
+
+        // Pushed in reverse so objects are handed out in address order
+        for (size_t i=mBlockObjects; i>0; --i) {
+            FreeSlot *free = (FreeSlot*)(slot + ((i - 1) * SLOT_SIZE));
+
+            free->next = mFree;
+            mFree = free;
+        }
+
+        mCapacity += mBlockObjects;
+
+        return true;
+    }
+
+
+public:
+    /**
+     * @brief Constructor, no blocks are allocated until the first
+     *        object is needed
+     * @param blockObjects objects allocated together when the pool grows
+     * @param policy pages backing the blocks
+     * @return nothing
+     */
+    explicit ObjectPool(size_t blockObjects = DEFAULT_BLOCK_OBJECTS,
+                        const MemoryPolicy &policy = defaultMemoryPolicy())
+        : mPolicy(policy), mPages(policy.pages), mFree(NULL),
+          mBlockObjects((blockObjects == 0) ? 1 : blockObjects),
+          mCapacity(0), mInUse(0)
+    {
+    }
+
+    /**
+     * @brief Deconstructor, frees every block. Objects still in use are
+     *        not destroyed, release them first.
+     * @return nothing
+     */
+    ~ObjectPool()
+    {
+        for (size_t i=0; i<mBlocks.size(); ++i) {
+            freePages(mBlocks[i]);
+        }
+    }
+
+    /**
+     * @brief Grows the pool ahead of time, so the first acquires do not
+     *        allocate
+     * @param count objects the pool should hold
+     * @return true if success, otherwise false
+     */
+    bool reserve(size_t count)
+    {
+        while (mCapacity < count) {
+            if (!grow()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Constructs an object in a free slot, POD objects are left
+     *        uninitialized like any other default construction
+     * @return ptr to object, NULL if out of memory
+     */
+    T *acquire()
+    {
+        if ((mFree == NULL) && !grow()) {
+            return NULL;
+        }
+
+        FreeSlot *slot = mFree;
+
+        mFree = slot->next;
+        ++mInUse;
+
+        return new (slot) T;
+    }
+
+    /**
+     * @brief Destroys an object and puts its slot back on the free list
+     * @param object object returned by acquire of this pool
+     */
+    void release(T *object)
+    {
+        if (object == NULL) {
+            return;
+        }
+
+        object->~T();
+
+        FreeSlot *slot = (FreeSlot*)(void*)object;
+
+        slot->next = mFree;
+        mFree = slot;
+        --mInUse;
+    }
+
+    /**
+     * @brief Returns the number of objects acquired and not released
+     * @return objects in use
+     */
+    size_t inUse() const
+    {
+        return mInUse;
+    }
+
+    /**
+     * @brief Returns the number of objects the pool holds without growing
+     * @return capacity
+     */
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+    /**
+     * @brief Returns the pages the pool actually got, a huge page
+     *        policy falls back when the host has none
+     * @return page policy of the last block allocated
+     */
+    PagePolicy pages() const
+    {
+        return mPages;
+    }
+
+
+private:
+    // Pools own their blocks, they are not copied
+    ObjectPool(const ObjectPool&);
+    ObjectPool &operator=(const ObjectPool&);
+};
+
+} // soc
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes a transmit only UART writing to a host
+ *        file descriptor
+ */
+
+#ifndef _SOC_UART_H
+#define _SOC_UART_H
+
+#include <unistd.h>
+#include <string>
+#include "types.h"
+#include "mmio.h"
+
+namespace soc {
+
+/**
+ * @class Uart
+ * @author Wayne Moorefield
+ * @date 10/10/2012
+ * @file uart.h
+ * @brief A UART whose transmitter is a host file descriptor. Bytes are
+ *        buffered and written to the host when the buffer fills, when
+ *        the device is flushed or reset, or when it is destroyed, so a
+ *        firmware printing a byte at a time does not cost a system
+ *        call per byte. The transmitter is always ready.
+ *
+ *        Registers, from the base of the device:
+ *          0x0 DATA     write the low byte to transmit
+ *          0x4 STATUS   bit 0 transmitter ready, bit 1 enabled
+ *          0x8 CONTROL  bit 0 enables the transmitter, writing bit 1
+ *                       flushes the buffer to the host
+ */
+class Uart : public MmioDevice<Uart>
+{
+public:
+    enum {
+        REG_DATA = 0x0,
+        REG_STATUS = 0x4,
+        REG_CONTROL = 0x8,
+
+        STATUS_TX_READY = 0x1,
+        STATUS_ENABLED = 0x2,
+
+        CONTROL_ENABLE = 0x1,
+        CONTROL_FLUSH = 0x2,
+
+        BUFFER_SIZE = 4096
+    };
+
+
+private:
+    int mFd;
+    U32 mLength;
+    U8 mBuffer[BUFFER_SIZE];
+
+
+    /**
+     * @brief Returns the register bank, enabled at reset so firmware
+     *        can print without setting the UART up
+     * @param count location to store number of registers
+     * @return registers
+     */
+    static const Register *registerBank(U32 &count)
+    {
+        static const Register bank[] = {
+            { REG_DATA, "DATA", MMIO_WRITE | MMIO_WRITE_SIDE_EFFECT, 0,
+              NULL, &Uart::writeData },
+            { REG_STATUS, "STATUS", MMIO_READ, 0,
+              &Uart::readStatus, NULL },
+            { REG_CONTROL, "CONTROL",
+              MMIO_READ_WRITE | MMIO_WRITE_SIDE_EFFECT, CONTROL_ENABLE,
+              NULL, &Uart::writeControl }
+        };
+
+        count = sizeof(bank) / sizeof(bank[0]);
+
+        return bank;
+    }
+
+    /**
+     * @brief Queues a byte, drops it if the transmitter is disabled
+     * @param data byte in the low bits
+     * @return true
+     */
+    bool writeData(BusDataType data)
+    {
+        if ((storage(REG_CONTROL) & CONTROL_ENABLE) == 0) {
+            return true;
+        }
+
+        mBuffer[mLength++] = (U8)data;
+        if (mLength == BUFFER_SIZE) {
+            flush();
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Reads the status, the transmitter never has to be waited on
+     * @param data location to store status
+     * @return true
+     */
+    bool readStatus(BusDataType &data)
+    {
+        data = STATUS_TX_READY;
+        if ((storage(REG_CONTROL) & CONTROL_ENABLE) != 0) {
+            data |= STATUS_ENABLED;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Writes the control register, the flush bit is not stored
+     * @param data new control value
+     * @return true
+     */
+    bool writeControl(BusDataType data)
+    {
+        storage(REG_CONTROL) = data & CONTROL_ENABLE;
+        if ((data & CONTROL_FLUSH) != 0) {
+            flush();
+        }
+
+        return true;
+    }
+
+
+public:
+    /**
+     * @brief Constructor
+     * @param fd host file descriptor to transmit to, not closed by the
+     *           device
+     * @return nothing
+     */
+    explicit Uart(int fd)
+        : MmioDevice<Uart>(registerBank), mFd(fd), mLength(0)
+    {
+    }
+
+    /**
+     * @brief Deconstructor, writes what is still buffered
+     * @return nothing
+     */
+    virtual ~Uart()
+    {
+        flush();
+    }
+
+    /**
+     * @brief Writes buffered bytes to the host
+     * @return true if success, otherwise false
+     */
+    bool flush()
+    {
+        U32 written = 0;
+
+        while (written < mLength) {
+            ssize_t count = ::write(mFd, mBuffer + written,
+                                    mLength - written);
+
+            if (count <= 0) {
+                // host error, drop the rest
+                mLength = 0;
+                return false;
+            }
+            written += (U32)count;
+        }
+        mLength = 0;
+
+        return true;
+    }
+
+    /**
+     * @brief Writes what is buffered and puts the registers back to
+     *        their reset values
+     * @return true if success, otherwise false
+     */
+    virtual bool reset()
+    {
+        flush();
+
+        return MmioDevice<Uart>::reset();
+    }
+
+    /**
+     * @brief Returns the name of the device
+     * @return name
+     */
+    virtual std::string getName()
+    {
+        return std::string("Uart");
+    }
+};
+
+} // soc
+
+#endif
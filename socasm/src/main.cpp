@@ -0,0 +1,112 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Command line assembler and disassembler for SoC programs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "socasm.h"
+#include "socdisasm.h"
+
+
+/**
+ * @brief Prints program usage
+ * @param name name of program
+ */
+static void printUsage(const char *name)
+{
+    printf("Usage: %s [-isize bytes] input.s -o output.img\n", name);
+    printf("       %s -d input.img\n", name);
+}
+
+
+/**
+ * @brief Assembles a source file in to an image file
+ * @param input source file
+ * @param output image file
+ * @param instructionSize bytes per instruction until the source
+ *        picks another with .isize
+ * @return 0 if success, otherwise error
+ */
+static int assembleFile(const char *input, const char *output,
+                        U32 instructionSize)
+{
+    std::vector<U8> source;
+    std::vector<U8> image;
+    AsmError error;
+
+    if (!readFile(input, source)) {
+        printf("ERROR: Unable to read %s\n", input);
+        return 1;
+    }
+
+    if (!assembleImage((const char*)source.data(), source.size(),
+                       image, error, instructionSize)) {
+        printf("%s:%u: error: %s\n", input, error.line, error.message);
+        return 1;
+    }
+
+    if (!writeFile(output, image)) {
+        printf("ERROR: Unable to write %s\n", output);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Disassembles an image file to stdout
+ * @param input image file
+ * @return 0 if success, otherwise error
+ */
+static int disassembleFile(const char *input)
+{
+    std::vector<U8> image;
+    std::string text;
+
+    if (!readFile(input, image)) {
+        printf("ERROR: Unable to read %s\n", input);
+        return 1;
+    }
+
+    if (!disassembleImage(image.data(), (U32)image.size(), text)) {
+        printf("ERROR: %s is not a valid image\n", input);
+        return 1;
+    }
+
+    fwrite(text.data(), 1, text.size(), stdout);
+
+    return 0;
+}
+
+
+/**
+ * @brief Program Entry Point
+ * @param argc number of arguments passed
+ * @param argv ptr to arguments
+ * @return 0 if success, otherwise error
+ */
+int main(int argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[1], "-d") == 0)) {
+        return disassembleFile(argv[2]);
+    }
+
+    U32 instructionSize = CPU_INSTRUCTION_SIZE;
+    int first = 1;
+    if ((argc > 2) && (strcmp(argv[1], "-isize") == 0)) {
+        instructionSize = (U32)strtoul(argv[2], NULL, 0);
+        first = 3;
+    }
+
+    if ((argc == first + 3) && (strcmp(argv[first + 1], "-o") == 0)) {
+        return assembleFile(argv[first], argv[first + 2], instructionSize);
+    }
+
+    printUsage(argv[0]);
+
+    return 1;
+}
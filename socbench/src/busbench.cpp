@@ -0,0 +1,189 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Measures what the cache and TLB timing model adds to bus
+ *        requests
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <soc/bus.h>
+#include <soc/memregion.h>
+#include <soc/memtiming.h>
+
+// Reads per timed run unless -l says otherwise
+#define BUSBENCH_DEFAULT_READS  10000000ULL
+#define BUSBENCH_DEFAULT_RUNS   7
+
+// Memory read by the benchmark, far larger than the caches and the
+// reach of the TLB so random reads mostly miss both
+#define BUSBENCH_MEMORY_SIZE    (16 * 1024 * 1024)
+
+// Addresses visited in turn, a power of 2
+#define BUSBENCH_ADDRESSES      (64 * 1024)
+
+
+/**
+ * @brief Prints program usage
+ * @param name name of program
+ */
+static void printUsage(const char *name)
+{
+    printf("Usage: %s [-l reads] [-n runs] [-max ratio]\n", name);
+}
+
+
+/**
+ * @brief Builds the addresses one access pattern reads
+ * @param random true for random words of memory, false for every word
+ *        in turn
+ * @param addresses location to store addresses
+ */
+static void buildAddresses(bool random,
+                           std::vector<soc::BusAddressType> &addresses)
+{
+    U32 state = 0x2545F491;
+
+    addresses.resize(BUSBENCH_ADDRESSES);
+    for (U32 i=0; i<BUSBENCH_ADDRESSES; ++i) {
+        if (random) {
+            // xorshift32
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            addresses[i] = state & (BUSBENCH_MEMORY_SIZE - 4);
+        } else {
+            addresses[i] = (i * 4) & (BUSBENCH_MEMORY_SIZE - 4);
+        }
+    }
+}
+
+
+/**
+ * @brief Times one run of reads on the bus
+ * @param bus bus with memory attached
+ * @param addresses addresses read in turn
+ * @param reads reads in the run
+ * @return nanoseconds per read
+ */
+static double timeReads(soc::Bus &bus,
+                        const std::vector<soc::BusAddressType> &addresses,
+                        U64 reads)
+{
+    U32 sum = 0;
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    for (U64 i=0; i<reads; ++i) {
+        soc::BusDataType data = 0;
+
+        bus.request(soc::Bus::BUSOP_READ,
+                    addresses[i & (BUSBENCH_ADDRESSES - 1)], data);
+        sum += data;
+    }
+
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    // Keep the reads from being optimized away
+    if (sum == 0xFFFFFFFF) {
+        printf("\n");
+    }
+
+    return elapsed.count() / (double)reads;
+}
+
+
+/**
+ * @brief Program Entry Point
+ *        Usage: socbusbench [-l reads] [-n runs] [-max ratio]
+ *        reads memory through a bus with and without a MemoryTiming
+ *        model, in order and at random, and prints what the model
+ *        costs as the median ratio to the untimed read. -max fails the
+ *        run if either ratio is above it.
+ * @param argc number of arguments passed
+ * @param argv ptr to arguments
+ * @return 0 if success, otherwise error
+ */
+int main(int argc, char **argv)
+{
+    U64 reads = BUSBENCH_DEFAULT_READS;
+    U32 runs = BUSBENCH_DEFAULT_RUNS;
+    double maxRatio = 0.0;
+
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc)) {
+            reads = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc)) {
+            runs = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-max") == 0) && ((i + 1) < argc)) {
+            maxRatio = strtod(argv[++i], NULL);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((reads == 0) || (runs == 0)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    soc::Bus bus;
+    soc::MemoryRegion memory;
+    soc::Bus::AddressRange range = { 0, BUSBENCH_MEMORY_SIZE - 1 };
+    if (!memory.attachToBus(&bus, soc::Bus::BUSDEVICE_SLAVE, &range)) {
+        printf("ERROR: Unable to attach memory\n");
+        return 1;
+    }
+
+    bool failed = false;
+    for (int pattern=0; pattern<2; ++pattern) {
+        std::vector<soc::BusAddressType> addresses;
+        soc::MemoryTiming timing;
+
+        buildAddresses(pattern != 0, addresses);
+
+        // Untimed and timed runs alternate so each pair sees the same
+        // noise, the medians are reported
+        std::vector<double> untimed(runs);
+        std::vector<double> timed(runs);
+        std::vector<double> ratios(runs);
+        for (U32 run=0; run<runs; ++run) {
+            bus.setMemoryTiming(NULL, NULL);
+            untimed[run] = timeReads(bus, addresses, reads);
+
+            bus.setMemoryTiming(&timing, &memory);
+            timed[run] = timeReads(bus, addresses, reads);
+
+            ratios[run] = timed[run] / untimed[run];
+        }
+        bus.setMemoryTiming(NULL, NULL);
+
+        std::sort(untimed.begin(), untimed.end());
+        std::sort(timed.begin(), timed.end());
+        std::sort(ratios.begin(), ratios.end());
+        double ratio = ratios[runs / 2];
+
+        const soc::CacheStats &dcache = timing.getDCacheStats();
+        const soc::CacheStats &tlb = timing.getTLBStats();
+
+        printf("%-10s untimed %.2f ns, timed %.2f ns, %.2fx, "
+               "dcache %.1f%% misses, tlb %.1f%% misses\n",
+               (pattern != 0) ? "random" : "sequential",
+               untimed[runs / 2], timed[runs / 2], ratio,
+               (100.0 * dcache.misses) / dcache.accesses,
+               (100.0 * tlb.misses) / tlb.accesses);
+
+        if ((maxRatio > 0.0) && (ratio > maxRatio)) {
+            printf("FAIL: timed reads cost more than %.2fx\n", maxRatio);
+            failed = true;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Measures how many instructions per second an executor runs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "socbasic.h"
+#include "socimage.h"
+#include "socarena.h"
+
+// Instructions run per timed run unless -l says otherwise
+#define BENCH_DEFAULT_INSTRUCTIONS  100000000ULL
+#define BENCH_DEFAULT_RUNS          3
+
+
+/**
+ * @brief Prints program usage
+ * @param name name of program
+ */
+static void printUsage(const char *name)
+{
+    printf("Usage: %s [-r registers] [-l instructions] [-n runs] [-nofuse] "
+           "[image]\n", name);
+}
+
+
+/**
+ * @brief Runs the loaded program until it stops or count instructions
+ *        have run
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param execute executor
+ * @param count instructions to run
+ * @return instructions run
+ */
+static U64 runBenchmark(CPUContext &ctx, Memory &mem,
+                        CPUExecuteFunction execute, U64 count)
+{
+    U64 ran = 0;
+
+    while (ran < count) {
+        if (!stepCPU(ctx, mem, execute, count - ran, ran)) {
+            break;
+        }
+    }
+
+    return ran;
+}
+
+
+/**
+ * @brief Program Entry Point
+ *        Usage: socbench [-r registers] [-l instructions] [-n runs]
+ *                        [-nofuse] [image]
+ *        without an image the built in program is loaded. The program
+ *        is reloaded for each of -n runs and run for -l instructions,
+ *        or until it stops. The fastest run is reported, a workload
+ *        that loops forever, like programs/bench.s, measures the
+ *        executor rather than the reload. -nofuse times the executor
+ *        that dispatches every instruction on its own.
+ * @param argc number of arguments passed
+ * @param argv ptr to arguments
+ * @return 0 if success, otherwise error
+ */
+int main(int argc, char **argv)
+{
+    CPUProfile profile = defaultCPUProfile;
+    const char *imagePath = NULL;
+    U64 instructions = BENCH_DEFAULT_INSTRUCTIONS;
+    U32 runs = BENCH_DEFAULT_RUNS;
+    U32 features = CPU_EXECUTE_FUSE;
+
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc)) {
+            profile.registerCount = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc)) {
+            instructions = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc)) {
+            runs = (U32)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-nofuse") == 0) {
+            features = 0;
+        } else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            imagePath = argv[i];
+        }
+    }
+
+    CPUExecuteFunction execute = selectCPUExecutor(profile, features);
+    if (execute == NULL) {
+        printf("ERROR: CPU profile with %u registers is not supported\n",
+               profile.registerCount);
+        return 1;
+    }
+
+    InstanceArena arena(1);
+    double best = 0.0;
+    U64 ran = 0;
+
+    for (U32 run=0; run<runs; ++run) {
+        SoCInstance *instance = createSoCInstance(arena, profile);
+        bool loaded;
+
+        if (instance == NULL) {
+            printf("ERROR: Unable to allocate SoC\n");
+            return 1;
+        }
+
+        if (imagePath != NULL) {
+            loaded = loadImageFile(instance->mem, imagePath);
+        } else {
+            loaded = loadProgram(instance->mem);
+        }
+        if (!loaded) {
+            printf("ERROR: Unable to load program\n");
+            destroySoCInstance(arena, instance);
+            return 1;
+        }
+
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        ran = runBenchmark(instance->ctx, instance->mem, execute,
+                           instructions);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        double rate = (elapsed.count() > 0.0) ? (ran / elapsed.count()) : 0.0;
+        if (rate > best) {
+            best = rate;
+        }
+
+        destroySoCInstance(arena, instance);
+    }
+
+    printf("%llu instructions, best of %u runs: %.2f MIPS\n",
+           ran, runs, best / 1000000.0);
+
+    return 0;
+}
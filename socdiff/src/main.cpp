@@ -0,0 +1,157 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Runs a program on the reference executor and a candidate
+ *        executor in lockstep and reports the first instruction where
+ *        they diverge
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "socbasic.h"
+#include "socimage.h"
+#include "soclockstep.h"
+
+// Executors that can be checked against the reference
+struct LockstepEngine
+{
+    const char *name;
+    U32 features;           // CPU_EXECUTE_* passed to selectCPUExecutor
+};
+
+static const LockstepEngine lockstepEngines[] = {
+    { "profile", 0 },
+    { "debug", CPU_EXECUTE_DEBUG },
+    { "record", CPU_EXECUTE_RECORD },
+    { "trace", CPU_EXECUTE_TRACE },
+    { "fuse", CPU_EXECUTE_FUSE },
+    { "timing", CPU_EXECUTE_TIMING }
+};
+
+
+/**
+ * @brief Prints program usage
+ * @param name name of program
+ */
+static void printUsage(const char *name)
+{
+    printf("Usage: %s [-r registers] [-x vector] [-e engine] [-n interval] "
+           "[-l limit] [image]\n", name);
+    printf("       engines:");
+    for (size_t i=0; i<(sizeof(lockstepEngines) / sizeof(lockstepEngines[0]));
+         ++i) {
+        printf(" %s", lockstepEngines[i].name);
+    }
+    printf("\n");
+}
+
+
+/**
+ * @brief Finds an engine by name
+ * @param name name of engine
+ * @return engine, NULL if there is none by that name
+ */
+static const LockstepEngine *findLockstepEngine(const char *name)
+{
+    for (size_t i=0; i<(sizeof(lockstepEngines) / sizeof(lockstepEngines[0]));
+         ++i) {
+        if (strcmp(lockstepEngines[i].name, name) == 0) {
+            return &lockstepEngines[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Program Entry Point
+ *        Usage: socdiff [-r registers] [-x vector] [-e engine]
+ *                       [-n interval] [-l limit] [image]
+ *        without an image the built in program is loaded. The program
+ *        runs on executeCPUInstruction, or the plain executor of the
+ *        profile when -r picks another register count, and on the
+ *        engine picked by -e. States are compared every -n
+ *        instructions until the program stops or -l instructions ran.
+ * @param argc number of arguments passed
+ * @param argv ptr to arguments
+ * @return 0 if the executors agree, otherwise error
+ */
+int main(int argc, char **argv)
+{
+    CPUProfile profile = defaultCPUProfile;
+    const char *imagePath = NULL;
+    const LockstepEngine *engine = &lockstepEngines[0];
+    U64 interval = LOCKSTEP_DEFAULT_INTERVAL;
+    U64 limit = 0;
+
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc)) {
+            profile.registerCount = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-x") == 0) && ((i + 1) < argc)) {
+            profile.exceptionVector = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-e") == 0) && ((i + 1) < argc)) {
+            engine = findLockstepEngine(argv[++i]);
+            if (engine == NULL) {
+                printf("ERROR: Unknown engine %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc)) {
+            interval = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc)) {
+            limit = strtoull(argv[++i], NULL, 0);
+        } else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            imagePath = argv[i];
+        }
+    }
+
+    CPUExecuteFunction reference = executeCPUInstruction;
+    if ((profile.registerCount != defaultCPUProfile.registerCount) ||
+        (profile.instructionSize != defaultCPUProfile.instructionSize)) {
+        reference = selectCPUExecutor(profile);
+    }
+    CPUExecuteFunction candidate = selectCPUExecutor(profile,
+                                                     engine->features);
+    if ((reference == NULL) || (candidate == NULL)) {
+        printf("ERROR: CPU profile with %u registers is not supported\n",
+               profile.registerCount);
+        return 1;
+    }
+
+    // Reference, candidate and checkpoint
+    InstanceArena arena(3);
+    LockstepRun run;
+    if (!openLockstepRun(run, arena, profile, reference, candidate,
+                         interval)) {
+        printf("ERROR: Unable to allocate SoCs\n");
+        return 1;
+    }
+
+    bool loaded;
+    if (imagePath != NULL) {
+        loaded = loadImageFile(run.reference->mem, imagePath);
+    } else {
+        loaded = loadProgram(run.reference->mem);
+    }
+    if (!loaded) {
+        printf("ERROR: Unable to load program\n");
+        closeLockstepRun(run);
+        return 1;
+    }
+
+    // Large, the result holds both contexts
+    LockstepResult *result = new LockstepResult;
+    int retval = runLockstep(run, limit, *result) ? 0 : 1;
+
+    printf("Engine %s\n", engine->name);
+    writeLockstepReport(stdout, *result);
+
+    delete result;
+    closeLockstepRun(run);
+
+    return retval;
+}
@@ -0,0 +1,234 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Keeps SoCs resident and runs jobs for local clients through
+ *        shared memory, and a client to submit jobs from the shell
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "socbasic.h"
+#include "socimage.h"
+#include "socipc.h"
+#include "socsim.h"
+
+
+/**
+ * @brief Prints program usage
+ * @param name name of program
+ */
+static void printUsage(const char *name)
+{
+    printf("Usage: %s [-r registers] [-x vector] [-w workers] name image...\n",
+           name);
+    printf("       %s -submit name image [-l budget] [-set reg=value]... "
+           "[-out address:length]\n", name);
+    printf("       %s -stop name\n", name);
+}
+
+
+/**
+ * @brief Loads every image and serves jobs until stopped
+ * @return 0 if success, otherwise error
+ */
+static int serveImages(const char *name, const CPUProfile &profile,
+                       U32 workers, const std::vector<const char*> &paths)
+{
+    IpcServer server;
+
+    if (!openIpcServer(server, name, profile)) {
+        printf("ERROR: Unable to create %s, is another server running on it?\n",
+               name);
+        return 1;
+    }
+
+    for (size_t i=0; i<paths.size(); ++i) {
+        std::vector<U8> image;
+
+        if (!readFile(paths[i], image) ||
+            !addIpcImage(server, image.data(), (U32)image.size())) {
+            printf("ERROR: Unable to load %s\n", paths[i]);
+            closeIpcServer(server);
+            return 1;
+        }
+
+        printf("%016llx %s\n", hashSimImage(image.data(), (U32)image.size()),
+               paths[i]);
+    }
+
+    printf("Serving %s with %u workers\n", name, workers);
+    fflush(stdout);
+
+    serveIpc(server, workers);
+    closeIpcServer(server);
+
+    return 0;
+}
+
+
+/**
+ * @brief Runs one job and prints its result
+ * @return 0 if the job ran, otherwise error
+ */
+static int submitJob(const char *name, const char *path, IpcJob &job)
+{
+    std::vector<U8> image;
+    IpcClient client;
+
+    if (!readFile(path, image)) {
+        printf("ERROR: Unable to read %s\n", path);
+        return 1;
+    }
+    job.imageHash = hashSimImage(image.data(), (U32)image.size());
+
+    if (!openIpcClient(client, name)) {
+        printf("ERROR: No server on %s\n", name);
+        return 1;
+    }
+
+    // Large, holds every register
+    IpcResult *result = new IpcResult;
+    bool ran = runIpcJob(client, job, *result);
+    closeIpcClient(client);
+
+    int retval = 1;
+    if (!ran) {
+        printf("ERROR: Server on %s stopped\n", name);
+    } else if (result->status == IPC_RESULT_NO_IMAGE) {
+        printf("ERROR: Server has no image %016llx\n", job.imageHash);
+    } else if (result->status == IPC_RESULT_INVALID) {
+        printf("ERROR: Invalid register or memory range\n");
+    } else {
+        printf("%s after %llu instructions, %llu cycles\n",
+               (result->reason == SIM_STOP_LIMIT) ? "Budget used" : "Stopped",
+               result->instructionCount, result->cycleCount);
+        if (result->fault.kind != CPU_FAULT_NONE) {
+            printf("%s 0x%08x @ 0x%08x\n", describeCPUFault(result->fault.kind),
+                   result->fault.address, result->fault.pc);
+        }
+        for (U32 i=0; i<result->registerCount; ++i) {
+            printf("\treg[%u] = 0x%08x\n", i, result->reg[i]);
+        }
+        for (U32 i=0; i<job.outputLength; ++i) {
+            printf("%s%02x", ((i % 16) == 0) ? ((i == 0) ? "" : "\n") : " ",
+                   result->output[i]);
+        }
+        if (job.outputLength != 0) {
+            printf("\n");
+        }
+        retval = 0;
+    }
+
+    delete result;
+
+    return retval;
+}
+
+
+/**
+ * @brief Program Entry Point
+ *        Usage: socserve [-r registers] [-x vector] [-w workers]
+ *                        name image...
+ *               socserve -submit name image [-l budget]
+ *                        [-set reg=value]... [-out address:length]
+ *               socserve -stop name
+ *        The server loads each image once and keeps a snapshot of it,
+ *        every job starts from a copy of the snapshot. name is a POSIX
+ *        shared memory name, e.g. /socsim. -submit runs one job with
+ *        the image named by its hash, -stop stops the server.
+ * @param argc number of arguments passed
+ * @param argv ptr to arguments
+ * @return 0 if success, otherwise error
+ */
+int main(int argc, char **argv)
+{
+    CPUProfile profile = defaultCPUProfile;
+    U32 workers = 1;
+    const char *name = NULL;
+    const char *submitPath = NULL;
+    bool submit = false;
+    bool stop = false;
+    std::vector<const char*> paths;
+    IpcJob job;
+
+    memset(&job, 0, sizeof(job));
+    job.budget = ~0ULL;
+
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc)) {
+            profile.registerCount = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-x") == 0) && ((i + 1) < argc)) {
+            profile.exceptionVector = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-w") == 0) && ((i + 1) < argc)) {
+            workers = (U32)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-submit") == 0) {
+            submit = true;
+        } else if (strcmp(argv[i], "-stop") == 0) {
+            stop = true;
+        } else if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc)) {
+            job.budget = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-set") == 0) && ((i + 1) < argc)) {
+            char *end;
+            U32 index = (U32)strtoul(argv[++i], &end, 0);
+
+            if ((*end != '=') || (job.registerCount >= IPC_MAX_REGISTERS)) {
+                printf("ERROR: Invalid register input %s\n", argv[i]);
+                return 1;
+            }
+            job.registers[job.registerCount].index = index;
+            job.registers[job.registerCount].value =
+                (U32)strtoul(end + 1, NULL, 0);
+            ++job.registerCount;
+        } else if ((strcmp(argv[i], "-out") == 0) && ((i + 1) < argc)) {
+            char *end;
+
+            job.outputAddress = (U32)strtoul(argv[++i], &end, 0);
+            job.outputLength = (*end == ':') ?
+                                   (U32)strtoul(end + 1, NULL, 0) : 4;
+        } else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else if (name == NULL) {
+            name = argv[i];
+        } else if (submit && (submitPath == NULL)) {
+            submitPath = argv[i];
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (name == NULL) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (stop) {
+        IpcClient client;
+
+        if (!openIpcClient(client, name)) {
+            printf("ERROR: No server on %s\n", name);
+            return 1;
+        }
+        stopIpcServer(client);
+        closeIpcClient(client);
+
+        return 0;
+    }
+
+    if (submit) {
+        if (submitPath == NULL) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        return submitJob(name, submitPath, job);
+    }
+
+    if (paths.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    return serveImages(name, profile, workers, paths);
+}
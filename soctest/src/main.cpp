@@ -4,9 +4,11 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <soc/bus.h>
 #include <soc/cpu.h>
 #include <soc/memory.h>
+#include <soc/platform.h>
 
 union TestInstruction {
     U32 value32;
@@ -55,9 +57,8 @@ public:
     virtual bool reset()
     {
         // Set all data to the default value
-        for (int i=0; i<MYMEMORY_SIZE; ++i) {
-            mData[i] = 0xFF;
-        }
+        soc::memoryFill(mData, 0xFF, MYMEMORY_SIZE);
+        invalidateAllPages();
 
         // Put preloaded memory here
         TestInstruction instruction;
@@ -116,7 +117,12 @@ public:
         TestInstruction data;
         U32 oldPC = mContext.reg[REG_PC];
 
-        if (getBus()->request(soc::Bus::BUSOP_READ, mContext.reg[REG_PC], data.value32)) {
+        if (stopAtBreakpoint()) {
+            printf("Breakpoint @ 0x%08x\n", oldPC);
+            return false;
+        }
+
+        if (fetch(mContext.reg[REG_PC], data.value32)) {
             // Increment Program Counter
             mContext.reg[REG_PC] += INSTRUCTION_SIZE;
 
@@ -178,39 +184,143 @@ public:
             retval = false;
         }
 
+        if (retval && stopAtWatchpoint()) {
+            printf("Watchpoint @ 0x%08x\n", oldPC);
+            retval = false;
+        }
+
         return retval;
     }
 };
 
 
+// SoC of the test when no description is given
+static const char defaultPlatform[] =
+    "# memory preloaded with the test program, then the CPU\n"
+    "mymemory ram   0x0000-0x1000\n"
+    "mycpu    cpu0\n"
+    "uart     uart0 0x2000-0x200F fd=1\n"
+    "mailbox  mbox0 0x3000-0x307F\n"
+    "timing   ram\n";
+
+/**
+ * @brief Creates the test memory
+ */
+static soc::BusDevice *createMyMemory(const soc::PlatformDevice &desc)
+{
+    return new MyMemory();
+}
+
+/**
+ * @brief Creates the test cpu, reset=address sets its reset vector
+ */
+static soc::BusDevice *createMyCPU(const soc::PlatformDevice &desc)
+{
+    MyCPU *cpu = new MyCPU();
+
+    cpu->setResetAddress(desc.paramU32("reset", 0));
+
+    return cpu;
+}
+
+/**
+ * @brief Finds a device of the platform the test needs
+ * @param platform platform built
+ * @param name name of device
+ * @param kind kind the device must be
+ * @return device, NULL if missing or of another kind
+ */
+static soc::BusDevice *findTestDevice(soc::Platform &platform,
+                                      const char *name, const char *kind)
+{
+    const soc::PlatformDevice *desc = platform.describe(name);
+
+    if ((desc == NULL) || (desc->kind != kind)) {
+        printf("Platform has no %s %s\n", kind, name);
+        return NULL;
+    }
+
+    return platform.find(name);
+}
+
+
 /**
  * @brief Program Entry Point
+ *        Usage: soctest [-platform file] [-cache blob]
+ *        -platform builds the SoC from a description instead of the
+ *        built in one, it needs a mymemory ram, mycpu cpu0, uart uart0
+ *        and mailbox mbox0. -cache keeps the parsed description in a
+ *        blob, later runs of the same description skip parsing.
  * @param argc number of arguments passed
  * @param argv ptr to arguments
  * @return 0 if success, otherwise error
  */
 int main(int argc, char *argv[])
 {
-    printf("Creating SoC\n");
-
-    soc::Bus bus;
-    MyMemory mem;
-    MyCPU cpu;
+    static const soc::PlatformKind testKinds[] = {
+        { "mymemory", soc::Bus::BUSDEVICE_SLAVE, true, createMyMemory },
+        { "mycpu", soc::Bus::BUSDEVICE_MASTER, false, createMyCPU }
+    };
+    const char *platformPath = NULL;
+    const char *cachePath = NULL;
+
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-platform") == 0) && ((i + 1) < argc)) {
+            platformPath = argv[++i];
+        } else if ((strcmp(argv[i], "-cache") == 0) && ((i + 1) < argc)) {
+            cachePath = argv[++i];
+        } else {
+            printf("Usage: %s [-platform file] [-cache blob]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    soc::Bus::AddressRange addrRange;
+    printf("Creating SoC\n");
 
-    // set up memory
-    addrRange.start = 0x0000;
-    addrRange.end = 0x1000;
-    if (!mem.attachToBus(&bus, soc::Bus::BUSDEVICE_SLAVE, &addrRange)) {
-        printf("Failed to attach memory to bus\n");
+    soc::Platform platform;
+    soc::PlatformConfig config;
+    std::string error;
+    bool cached = false;
+
+    platform.addKind(testKinds[0]);
+    platform.addKind(testKinds[1]);
+
+    bool parsed = (platformPath != NULL) ?
+                      platform.load(platformPath, cachePath, config, error,
+                                    &cached) :
+                      platform.parse(defaultPlatform,
+                                     sizeof(defaultPlatform) - 1, config,
+                                     error);
+    if (!parsed || !platform.build(config, error)) {
+        printf("Failed to create SoC: %s\n", error.c_str());
+        return 1;
+    }
+    if (cached) {
+        printf("Platform from %s\n", cachePath);
     }
 
-    // set up cpu
-    if (!cpu.attachToBus(&bus, soc::Bus::BUSDEVICE_MASTER, &addrRange)) {
-        printf("Failed to attach cpu to bus\n");
+    soc::Bus &bus = platform.getBus();
+    MyMemory *memDevice = static_cast<MyMemory*>(
+        findTestDevice(platform, "ram", "mymemory"));
+    MyCPU *cpuDevice = static_cast<MyCPU*>(
+        findTestDevice(platform, "cpu0", "mycpu"));
+    soc::Uart *uartDevice = static_cast<soc::Uart*>(
+        findTestDevice(platform, "uart0", "uart"));
+    soc::Mailbox *mailboxDevice = static_cast<soc::Mailbox*>(
+        findTestDevice(platform, "mbox0", "mailbox"));
+
+    if ((memDevice == NULL) || (cpuDevice == NULL) || (uartDevice == NULL) ||
+        (mailboxDevice == NULL)) {
+        return 1;
     }
 
+    MyMemory &mem = *memDevice;
+    MyCPU &cpu = *cpuDevice;
+    soc::Uart &uart = *uartDevice;
+    soc::Mailbox &mailbox = *mailboxDevice;
+    soc::BusAddressType uartBase = platform.describe("uart0")->range.start;
+    soc::BusAddressType mailboxBase = platform.describe("mbox0")->range.start;
+
     printf("SoC Created\n");
 
     // Send Reset Signal
@@ -225,9 +335,7 @@ int main(int argc, char *argv[])
     printf("CPU has stopped\n");
 
     printf("Verification begin\n");
-    // Do something
-    // - check cpu
-    // - check memory
+    bool passed = true;
 
     // CPU
     soc::CPU::CPUContext cpuctx;
@@ -240,16 +348,96 @@ int main(int argc, char *argv[])
         printf("\treg[%d] = 0x%08x\n", i, cpuctx.reg[i]);
     }
 
-    // Verify contents of Registers
-    // PC correct?
-    // Registers correct?
+    // Verify contents of Registers, pc stops past the first
+    // invalid instruction
+    static const U32 expectedRegisters[soc::CPU::MAX_CPUREGISTERS] = {
+        0xABCD1234,
+        0x1C1C1B1B,     // untouched, CPU register reset value
+        0x0000000C
+    };
+
+    for (int i=0; i<soc::CPU::MAX_CPUREGISTERS; ++i) {
+        if (cpuctx.reg[i] != expectedRegisters[i]) {
+            printf("FAIL: reg[%d] = 0x%08x expected 0x%08x\n",
+                   i, cpuctx.reg[i], expectedRegisters[i]);
+            passed = false;
+        }
+    }
+
+    // Memory, the program does not store so it must still match
+    // a freshly reset copy
+    MyMemory golden;
+    golden.reset();
+
+    U32 offset = mem.compare(golden);
+    if (offset != MYMEMORY_SIZE) {
+        printf("FAIL: memory[0x%04x] = 0x%02x expected 0x%02x\n",
+               offset, mem.getData()[offset], golden.getData()[offset]);
+        passed = false;
+    }
+
+    // Timing, the program fits in one line of the instruction cache and
+    // reads no data
+    soc::MemoryTiming *timing = platform.getMemoryTiming();
+    if (timing != NULL) {
+        const soc::CacheStats &icache = timing->getICacheStats();
+        const soc::CacheStats &dcache = timing->getDCacheStats();
+        const soc::CacheStats &tlb = timing->getTLBStats();
+
+        printf("Memory timing\n");
+        printf("\ticache %llu accesses %llu misses\n",
+               (unsigned long long)icache.accesses,
+               (unsigned long long)icache.misses);
+        printf("\tdcache %llu accesses %llu misses\n",
+               (unsigned long long)dcache.accesses,
+               (unsigned long long)dcache.misses);
+        printf("\ttlb %llu accesses %llu misses\n",
+               (unsigned long long)tlb.accesses,
+               (unsigned long long)tlb.misses);
+        printf("\tstall %llu cycles\n",
+               (unsigned long long)timing->getStallCycles());
+
+        if ((icache.misses != 1) || (dcache.accesses != 0)) {
+            printf("FAIL: memory timing\n");
+            passed = false;
+        }
+    }
+
+    // Mailbox, answer a message from the host the way firmware would
+    soc::BusDataType data = 0;
+    soc::BusDataType answer = 0;
+    mailbox.post(0x1234);
+    if (!bus.request(soc::Bus::BUSOP_READ,
+                     mailboxBase + soc::Mailbox::REG_STATUS, data) ||
+        ((data & soc::Mailbox::STATUS_FROM_HOST_READY) == 0) ||
+        !bus.request(soc::Bus::BUSOP_READ,
+                     mailboxBase + soc::Mailbox::REG_FROM_HOST, data) ||
+        !bus.request(soc::Bus::BUSOP_WRITE,
+                     mailboxBase + soc::Mailbox::REG_TO_HOST, ++data) ||
+        !mailbox.take(answer) || (answer != 0x1235)) {
+        printf("FAIL: mailbox answered 0x%08x expected 0x00001235\n",
+               answer);
+        passed = false;
+    }
 
-    // Memory
-    // Is Memory correct?
+    // UART, print through the bus, stdout is flushed first so the line
+    // comes out in order
+    static const char uartMessage[] = "UART ready\n";
+    fflush(stdout);
+    for (const char *c = uartMessage; *c != '\0'; ++c) {
+        data = (soc::BusDataType)*c;
+        if (!bus.request(soc::Bus::BUSOP_WRITE, uartBase, data)) {
+            printf("FAIL: uart write\n");
+            passed = false;
+            break;
+        }
+    }
+    uart.flush();
 
+    printf("Verification %s\n", passed ? "passed" : "failed");
     printf("Verification complete\n");
 
-    return 0;
+    return passed ? 0 : 1;
 }
 
 
@@ -0,0 +1,27 @@
+; Representative workload for socbench and PGO training, a loop using
+; every instruction that never ends, run it with an instruction limit
+
+start:
+    ; reg0 = running total
+    LOADLI r0, lo(1000)
+    LOADHI r0, hi(1000)
+
+loop:
+    ; reg1 = 7, never zero so DIV cannot fault
+    LOADLI r1, lo(7)
+    LOADHI r1, hi(7)
+
+    ; total = total + 7, then total / 7
+    ADD r0, r1, r0
+    DIV r0, r1, r1
+    SUB r0, r1, r1
+
+    ; spill both to the stack, then reload one of them
+    PUSH r0
+    PUSH r1
+    STORE sp, r1, 4
+    LOAD sp, r1, 0
+    POP r1
+    POP r1
+
+    LOADLI pc, lo(loop)
@@ -0,0 +1,42 @@
+; Same program as loadProgram(), calls funcAdd(4, 3)
+
+start:
+    ; reg0 = Return Address
+    LOADLI r0, lo(answer)
+    LOADHI r0, hi(answer)
+
+    ; push reg0 on to the stack
+    PUSH r0
+
+    ; A = 4... reg[0] = 4
+    LOADLI r0, lo(4)
+    LOADHI r0, hi(4)
+
+    ; B = 3... reg[1] = 3
+    LOADLI r1, lo(3)
+    LOADHI r1, hi(3)
+
+    ; push reg0 and reg1 on to the stack
+    PUSH r0
+    PUSH r1
+
+    ; Jump to funcAdd
+    LOADLI pc, lo(funcAdd)
+
+answer:
+    .space 4
+
+    ; end of program
+    .space 4
+
+; int funcAdd(int A, int B)
+funcAdd:
+    ; pop reg1 (B) and reg0 (A) off of the stack
+    POP r1
+    POP r0
+
+    ; C = A + B
+    ADD r0, r1, r1
+
+    ; pop PC, answer returned in reg1
+    POP pc
@@ -0,0 +1,16 @@
+; Firmware waiting on a status word that nothing will ever change, the
+; loop stores nothing and ends each iteration with the same registers
+
+start:
+    ; reg0 = address of the status word
+    LOADLI r0, lo(status)
+    LOADHI r0, hi(status)
+
+poll:
+    ; reg1 = status, then test it the only way the ISA allows
+    LOAD r0, r1, 0
+    ADD r1, r1, r1
+    LOADLI pc, lo(poll)
+
+status:
+    .word 0
@@ -0,0 +1,19 @@
+; PUSH sp stores sp after it moved down, POP sp gets the value + 4
+
+start:
+    ; mem[0x7c] = 0x7c, sp = 0x7c
+    PUSH sp
+
+    ; reg[0] = 0x7c, sp = 0x80
+    POP r0
+
+    ; reg[1] = 0x40
+    LOADLI r1, lo(0x40)
+    LOADHI r1, hi(0x40)
+
+    ; mem[0x7c] = 0x40, then sp = 0x44
+    PUSH r1
+    POP sp
+
+    ; end of program
+    .space 4
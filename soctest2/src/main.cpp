@@ -4,33 +4,506 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <soc/platform.h>
 #include "socbasic.h"
+#include "socimage.h"
+#include "socverify.h"
+#include "socdebug.h"
+#include "socgdb.h"
+#include "socreverse.h"
+#include "socarena.h"
+#include "soctrace.h"
+#include "socsample.h"
+
+// One run of a -batch, the image is checked against the spec
+struct BatchRun
+{
+    const char *specPath;
+    const char *imagePath;
+};
+
+
+/**
+ * @brief Runs every image of a batch, then verifies all the results in
+ *        parallel, one report line each
+ * @param profile CPU profile every image runs with
+ * @param runs spec and image of each run
+ * @param threads verification threads, 0 uses every host thread
+ * @param policy page policy of the SoCs
+ * @return 0 if every result passed, otherwise error
+ */
+static int runBatch(const CPUProfile &profile,
+                    const std::vector<BatchRun> &runs, U32 threads,
+                    const soc::MemoryPolicy &policy)
+{
+    CPUExecuteFunction execute = selectCPUExecutor(profile,
+                                                   CPU_EXECUTE_FUSE);
+    InstanceArena arena(runs.size(), policy);
+    std::vector<VerifySpec> specs(runs.size());
+    std::vector<SoCInstance*> instances(runs.size(), (SoCInstance*)NULL);
+    std::vector<VerifyJob> jobs;
+    std::vector<VerifyReport> reports;
+    int retval = 0;
+
+    if (execute == NULL) {
+        printf("ERROR: CPU profile with %u registers and %u byte "
+               "instructions is not supported\n",
+               profile.registerCount, profile.instructionSize);
+        return 1;
+    }
+
+    for (size_t i=0; (i<runs.size()) && (retval == 0); ++i) {
+        U32 errorLine;
+
+        if (!loadVerifySpec(runs[i].specPath, specs[i], errorLine)) {
+            printf("ERROR: Unable to load spec %s line %u\n",
+                   runs[i].specPath, errorLine);
+            retval = 1;
+            continue;
+        }
+
+        instances[i] = createSoCInstance(arena, profile);
+        if (instances[i] == NULL) {
+            printf("ERROR: Unable to allocate SoC\n");
+            retval = 1;
+        } else if (!loadImageFile(instances[i]->mem, runs[i].imagePath)) {
+            printf("ERROR: Unable to load %s\n", runs[i].imagePath);
+            retval = 1;
+        } else if (!runProgram(instances[i]->ctx, instances[i]->mem,
+                               execute)) {
+            printf("ERROR: Unable to run %s\n", runs[i].imagePath);
+            retval = 1;
+        } else {
+            VerifyJob job;
+
+            job.name = runs[i].imagePath;
+            job.spec = &specs[i];
+            job.ctx = &instances[i]->ctx;
+            job.mem = &instances[i]->mem;
+            jobs.push_back(job);
+        }
+    }
+
+    if (retval == 0) {
+        U32 failed = verifyBatch(jobs, threads, reports);
+
+        for (size_t i=0; i<reports.size(); ++i) {
+            writeVerifyReport(stdout, reports[i]);
+        }
+        printf("Verified %u results, %u failed\n", (U32)reports.size(),
+               failed);
+
+        retval = (failed == 0) ? 0 : 1;
+    }
+
+    for (size_t i=0; i<instances.size(); ++i) {
+        destroySoCInstance(arena, instances[i]);
+    }
+
+    return retval;
+}
+
+
+/**
+ * @brief Takes the CPU profile of a platform description, fields the
+ *        description does not set are kept
+ * @param path description file
+ * @param profile profile to update
+ * @return true if success, otherwise false
+ */
+static bool loadPlatformProfile(const char *path, CPUProfile &profile)
+{
+    soc::Platform platform;
+    soc::PlatformConfig config;
+    std::string error;
+
+    if (!platform.load(path, NULL, config, error)) {
+        printf("ERROR: Platform %s: %s\n", path, error.c_str());
+        return false;
+    }
+
+    const soc::PlatformCPU &cpu = config.cpu;
+
+    if (cpu.set & soc::PLATFORM_CPU_REGISTERS) {
+        profile.registerCount = cpu.registers;
+    }
+    if (cpu.set & soc::PLATFORM_CPU_RESET) {
+        profile.resetVector = cpu.reset;
+    }
+    if (cpu.set & soc::PLATFORM_CPU_STACK) {
+        profile.stackReset = cpu.stack;
+    }
+    if (cpu.set & soc::PLATFORM_CPU_INSTRUCTION_SIZE) {
+        profile.instructionSize = cpu.instructionSize;
+    }
+    if (cpu.set & soc::PLATFORM_CPU_EXCEPTION) {
+        profile.exceptionVector = cpu.exception;
+    }
+
+    return true;
+}
 
 
 /**
  * @brief Program Entry Point
+ *        Usage: soctest2 [-platform file] [-r registers]
+ *                        [-v spec] [-g spec]
+ *                        [-b addr] [-wr first[-last]] [-ww first[-last]]
+ *                        [-gdb port|unix:path]
+ *                        [-history interval[:budget]] [-back count]
+ *                        [-x vector] [-pages policy[,numa]]
+ *                        [-trace file] [-readtrace file]
+ *                        [-sample skip:window[:warmup]] [-l instructions]
+ *                        [image]
+ *               soctest2 [-platform file] [-r registers] [-j threads]
+ *                        -batch spec image [-batch spec image]...
+ *        without an image the built in program is loaded. -platform
+ *        takes the CPU profile from the cpu statement of a soc
+ *        platform description, -r and -x after it override it. -v
+ *        checks the result against a spec, -g writes a spec of the
+ *        result. -batch runs each image and checks its result against
+ *        its spec, the results are verified on -j threads at once.
+ *        -b, -wr and -ww add a breakpoint, read watchpoint and write
+ *        watchpoint, the CPU is dumped at every stop. -gdb waits for
+ *        GDB to connect and lets it run the program. -history records
+ *        the run so -back, or GDB, can go back to earlier instructions.
+ *        -x makes faults enter a guest exception vector instead of
+ *        stopping the program. -pages picks normal, thp or hugetlb
+ *        pages for the SoC, ",numa" keeps them on the local node.
+ *        -trace writes every retired instruction to a compressed
+ *        binary trace, -readtrace prints one instead of running.
+ *        -sample runs fast for skip instructions and times the caches
+ *        of the next warmup and window instructions, over and over,
+ *        and estimates totals of the whole run from the windows. -l
+ *        stops a sampled run after that many instructions.
  * @param argc number of arguments passed
  * @param argv ptr to arguments
  * @return 0 if success, otherwise error
  */
 int main(int argc, char **argv)
 {
-    Memory mem;
-    CPUContext cpuctx;
+    CPUProfile profile = defaultCPUProfile;
+    const char *imagePath = NULL;
+    const char *verifyPath = NULL;
+    const char *goldenPath = NULL;
+    const char *gdbAddress = NULL;
+    const char *tracePath = NULL;
+    const char *readTracePath = NULL;
+    int retval = 0;
+    DebugState debug;
+    U64 historyInterval = 0;
+    size_t historyBudget = REVERSE_DEFAULT_BUDGET;
+    U64 backCount = 0;
+    soc::MemoryPolicy memoryPolicy = soc::defaultMemoryPolicy();
+    bool sampling = false;
+    SampleConfig sampleConfig;
+    std::vector<BatchRun> batch;
+    U32 batchThreads = 0;
+
+    defaultSampleConfig(sampleConfig);
+
+    resetDebugState(debug);
+
+    for (int i=1; i<argc; ++i) {
+        if ((strcmp(argv[i], "-platform") == 0) && ((i + 1) < argc)) {
+            if (!loadPlatformProfile(argv[++i], profile)) {
+                return 1;
+            }
+        } else if ((strcmp(argv[i], "-r") == 0) && ((i + 1) < argc)) {
+            profile.registerCount = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-v") == 0) && ((i + 1) < argc)) {
+            verifyPath = argv[++i];
+        } else if ((strcmp(argv[i], "-batch") == 0) && ((i + 2) < argc)) {
+            BatchRun run;
+
+            run.specPath = argv[++i];
+            run.imagePath = argv[++i];
+            batch.push_back(run);
+        } else if ((strcmp(argv[i], "-j") == 0) && ((i + 1) < argc)) {
+            batchThreads = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-g") == 0) && ((i + 1) < argc)) {
+            goldenPath = argv[++i];
+        } else if ((strcmp(argv[i], "-gdb") == 0) && ((i + 1) < argc)) {
+            gdbAddress = argv[++i];
+        } else if ((strcmp(argv[i], "-history") == 0) && ((i + 1) < argc)) {
+            char *end;
+
+            historyInterval = strtoull(argv[++i], &end, 0);
+            if (*end == ':') {
+                historyBudget = (size_t)strtoull(end + 1, NULL, 0);
+            }
+        } else if ((strcmp(argv[i], "-sample") == 0) && ((i + 1) < argc)) {
+            char *end;
+
+            sampleConfig.skip = strtoull(argv[++i], &end, 0);
+            sampleConfig.window = (*end == ':') ?
+                                      strtoull(end + 1, &end, 0) : 0;
+            sampleConfig.warmup = (*end == ':') ?
+                                      strtoull(end + 1, &end, 0) : 0;
+            if ((*end != '\0') || (sampleConfig.window == 0)) {
+                printf("ERROR: Invalid sample %s\n", argv[i]);
+                return 1;
+            }
+            sampling = true;
+        } else if ((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc)) {
+            sampleConfig.limit = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-x") == 0) && ((i + 1) < argc)) {
+            profile.exceptionVector = (U32)strtoul(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-pages") == 0) && ((i + 1) < argc)) {
+            if (!soc::parseMemoryPolicy(argv[++i], memoryPolicy)) {
+                printf("ERROR: Invalid page policy %s\n", argv[i]);
+                return 1;
+            }
+        } else if ((strcmp(argv[i], "-trace") == 0) && ((i + 1) < argc)) {
+            tracePath = argv[++i];
+        } else if ((strcmp(argv[i], "-readtrace") == 0) &&
+                   ((i + 1) < argc)) {
+            readTracePath = argv[++i];
+        } else if ((strcmp(argv[i], "-back") == 0) && ((i + 1) < argc)) {
+            backCount = strtoull(argv[++i], NULL, 0);
+        } else if ((strcmp(argv[i], "-b") == 0) && ((i + 1) < argc)) {
+            U32 address = (U32)strtoul(argv[++i], NULL, 0);
+
+            if (!addDebugPoint(debug, DEBUG_BREAK_EXECUTE, address, address)) {
+                printf("ERROR: Invalid breakpoint %s\n", argv[i]);
+                return 1;
+            }
+        } else if (((strcmp(argv[i], "-wr") == 0) ||
+                    (strcmp(argv[i], "-ww") == 0)) && ((i + 1) < argc)) {
+            U32 kind = (argv[i][2] == 'r') ? DEBUG_WATCH_READ :
+                                             DEBUG_WATCH_WRITE;
+            char *end;
+            U32 first = (U32)strtoul(argv[++i], &end, 0);
+            U32 last = (*end == '-') ? (U32)strtoul(end + 1, NULL, 0) : first;
+
+            if (!addDebugPoint(debug, kind, first, last)) {
+                printf("ERROR: Invalid watchpoint %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            imagePath = argv[i];
+        }
+    }
+
+    if (readTracePath != NULL) {
+        TraceReader reader;
+        TraceRecord record;
+
+        if (!openTraceReader(reader, readTracePath)) {
+            printf("ERROR: Unable to read trace %s\n", readTracePath);
+            return 1;
+        }
+
+        while (readTraceRecord(reader, record)) {
+            printTraceRecord(stdout, record);
+        }
+        closeTraceReader(reader);
+
+        if (reader.failed) {
+            printf("ERROR: Trace %s is damaged\n", readTracePath);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (!batch.empty()) {
+        return runBatch(profile, batch, batchThreads, memoryPolicy);
+    }
+
+    VerifySpec spec;
+    if (verifyPath != NULL) {
+        U32 errorLine;
+
+        if (!loadVerifySpec(verifyPath, spec, errorLine)) {
+            printf("ERROR: Unable to load spec %s line %u\n",
+                   verifyPath, errorLine);
+            return 1;
+        }
+    }
+
+    ReverseHistory history;
+    if ((historyInterval != 0) &&
+        !initReverseHistory(history, profile, historyInterval,
+                            historyBudget)) {
+        printf("ERROR: Unable to record history\n");
+        return 1;
+    }
+
+    // Executor is picked once for the profile, only a debug session
+    // pays for breakpoint and watchpoint checks, and only a recorded
+    // run pays for the undo log, and only a traced run for the trace.
+    // Runs without any of them fuse idioms.
+    bool debugging = !debug.points.empty();
+    U32 features = (debugging ? CPU_EXECUTE_DEBUG : 0) |
+                   ((historyInterval != 0) ? CPU_EXECUTE_RECORD : 0) |
+                   ((tracePath != NULL) ? CPU_EXECUTE_TRACE : 0);
+    if (sampling && ((features != 0) || (gdbAddress != NULL))) {
+        printf("ERROR: -sample runs without debugging, history, trace or "
+               "GDB\n");
+        return 1;
+    }
+    if (features == 0) {
+        features = CPU_EXECUTE_FUSE;
+    }
+    CPUExecuteFunction execute = selectCPUExecutor(profile, features);
+    if (execute == NULL) {
+        printf("ERROR: CPU profile with %u registers and %u byte "
+               "instructions is not supported\n",
+               profile.registerCount, profile.instructionSize);
+        return 1;
+    }
+
+    // CPU context and memory of the SoC, backed by the page policy
+    InstanceArena arena(1, memoryPolicy);
+    SoCInstance *instance = arena.acquire();
+    if (instance == NULL) {
+        printf("ERROR: Unable to allocate SoC\n");
+        return 1;
+    }
+    if (memoryPolicy.pages != arena.pages()) {
+        printf("Using %s pages, %s pages are not available\n",
+               soc::pagePolicyName(arena.pages()),
+               soc::pagePolicyName(memoryPolicy.pages));
+    }
+
+    Memory &mem = instance->mem;
+    CPUContext &cpuctx = instance->ctx;
 
-    if (resetSoC(cpuctx, mem)) {
-        if (loadProgram(mem)) {
-            if (runProgram(cpuctx, mem)) {
+    TraceWriter traceWriter;
+    TraceStream traceStream;
+    if (tracePath != NULL) {
+        if (!openTraceWriter(traceWriter, tracePath)) {
+            printf("ERROR: Unable to create trace %s\n", tracePath);
+            arena.release(instance);
+            return 1;
+        }
+        openTraceStream(traceStream, traceWriter);
+    }
+
+    if (resetSoC(cpuctx, mem, profile)) {
+        bool loaded;
+
+        if (imagePath != NULL) {
+            loaded = loadImageFile(mem, imagePath);
+        } else {
+            loaded = loadProgram(mem);
+        }
+
+        if (loaded) {
+            bool ran;
+
+            if (tracePath != NULL) {
+                cpuctx.trace = &traceStream;
+            }
+
+            if (gdbAddress != NULL) {
+                GdbStub stub;
+
+                printf("Waiting for GDB on %s\n", gdbAddress);
+                fflush(stdout);
+
+                ran = openGdbStub(stub, gdbAddress);
+                if (ran) {
+                    if (historyInterval != 0) {
+                        stub.history = &history;
+                    }
+                    ran = runGdbStub(stub, cpuctx, mem, profile);
+                }
+                closeGdbStub(stub);
+            } else if (sampling) {
+                SampleResult sample;
+
+                ran = runSampled(cpuctx, mem, profile, sampleConfig, sample);
+                if (ran) {
+                    writeSampleResult(stdout, sample);
+                }
+            } else {
+                if (debugging) {
+                    cpuctx.debug = &debug;
+                }
+                if (historyInterval != 0) {
+                    cpuctx.history = &history;
+                }
+
+                // Runs again after every breakpoint or watchpoint
+                while ((ran = runProgram(cpuctx, mem, execute)) &&
+                       debug.hit.hit) {
+                    debugDumpCPU(cpuctx);
+                    resumeDebug(debug);
+                }
+
+                if (ran && (backCount != 0)) {
+                    // history is only initialized when recording
+                    U64 target = 0;
+
+                    if (historyInterval != 0) {
+                        target = (backCount < history.position) ?
+                                     history.position - backCount : 0;
+                    }
+
+                    if ((historyInterval == 0) ||
+                        !reverseToPosition(history, cpuctx, mem, target)) {
+                        printf("ERROR: Unable to go back %llu instructions\n",
+                               backCount);
+                        retval = 1;
+                    } else {
+                        printf("Went back %llu instructions\n", backCount);
+                    }
+                }
+            }
+
+            if (ran) {
                 debugDumpSocStatus(cpuctx, mem);
+
+                if (verifyPath != NULL) {
+                    VerifyReport report;
+
+                    report.name = verifyPath;
+                    if (!verifyResult(spec, cpuctx, mem, report)) {
+                        retval = 1;
+                    }
+                    writeVerifyReport(stdout, report);
+                }
+
+                if (goldenPath != NULL) {
+                    FILE *fp = fopen(goldenPath, "w");
+
+                    if ((fp == NULL) || !writeVerifySpec(fp, cpuctx, mem)) {
+                        printf("ERROR: Unable to write spec %s\n",
+                               goldenPath);
+                        retval = 1;
+                    }
+                    if (fp != NULL) {
+                        fclose(fp);
+                    }
+                }
             } else {
                 printf("ERROR: Unable to run program\n");
+                retval = 1;
             }
         } else {
             printf("ERROR: Unable to load program\n");
+            retval = 1;
         }
     } else {
         printf("ERROR: Unable to reset SoC\n");
+        retval = 1;
     }
 
-	return 0;
+    if (tracePath != NULL) {
+        closeTraceStream(traceStream);
+        if (!closeTraceWriter(traceWriter)) {
+            printf("ERROR: Unable to write trace %s\n", tracePath);
+            retval = 1;
+        }
+    }
+
+    arena.release(instance);
+
+	return retval;
 }
@@ -0,0 +1,41 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Instance arena functions
+ */
+
+#include "socarena.h"
+
+
+/**
+ * @brief Takes an instance from the arena and resets it
+ * @param arena arena of the calling thread
+ * @param profile CPU profile to reset the CPU with
+ * @return instance, NULL if out of memory or the profile is invalid
+ */
+SoCInstance *createSoCInstance(InstanceArena &arena,
+                               const CPUProfile &profile)
+{
+    SoCInstance *instance = arena.acquire();
+
+    if (instance == NULL) {
+        return NULL;
+    }
+
+    if (!resetSoC(instance->ctx, instance->mem, profile)) {
+        arena.release(instance);
+        return NULL;
+    }
+
+    return instance;
+}
+
+
+/**
+ * @brief Gives an instance back to the arena it came from
+ * @param arena arena passed to createSoCInstance
+ * @param instance instance to recycle, may be NULL
+ */
+void destroySoCInstance(InstanceArena &arena, SoCInstance *instance)
+{
+    arena.release(instance);
+}
@@ -0,0 +1,32 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the instance arena, SoCs created and
+ *        destroyed in bulk by batch runs
+ */
+
+#ifndef _EWATC_SOCARENA_H
+#define _EWATC_SOCARENA_H
+
+#include <soc/pool.h>
+#include "socbasic.h"
+
+/**
+ * @brief Everything one SoC needs, allocated as one object so the CPU
+ *        context is followed by its memory
+ */
+struct SoCInstance
+{
+    CPUContext ctx;
+    Memory mem;
+};
+
+// One arena per worker thread, instances are recycled through its free
+// list. Blocks are local to the thread's NUMA node, and are backed by
+// the soc::MemoryPolicy the arena was constructed with.
+typedef soc::ObjectPool<SoCInstance> InstanceArena;
+
+SoCInstance *createSoCInstance(InstanceArena &arena,
+                               const CPUProfile &profile);
+void destroySoCInstance(InstanceArena &arena, SoCInstance *instance);
+
+#endif
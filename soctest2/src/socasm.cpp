@@ -0,0 +1,786 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Assembler for the SoC instruction set
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include "socasm.h"
+#include "socisa.h"
+
+#define ASM_MAX_OPERANDS 3
+
+struct AsmText
+{
+    const char *ptr;
+    size_t length;
+};
+
+enum AsmStatementType {
+    ASM_INSTRUCTION,
+    ASM_WORD
+};
+
+struct AsmStatement
+{
+    AsmStatementType type;
+    U32 line;
+    U32 address;
+    U32 registerCount;
+    U32 instructionSize;
+    const ISAInstructionInfo *info;
+    AsmText operand[ASM_MAX_OPERANDS];
+};
+
+struct AsmWord
+{
+    U32 address;
+    U32 value;
+    U32 line;
+    U32 size;       // bytes taken, the value then zero padding
+};
+
+typedef std::unordered_map<std::string, U32> AsmLabels;
+
+
+/**
+ * @brief Records an error
+ * @param error location to store error
+ * @param line line the error occurred on
+ * @param format printf style format
+ * @return false, so callers can return it directly
+ */
+static bool asmError(AsmError &error, U32 line, const char *format, ...)
+{
+    va_list args;
+
+    error.line = line;
+
+    va_start(args, format);
+    vsnprintf(error.message, sizeof(error.message), format, args);
+    va_end(args);
+
+    return false;
+}
+
+
+/**
+ * @brief Removes leading and trailing white space
+ * @param text text to trim
+ * @return trimmed text
+ */
+static AsmText asmTrim(AsmText text)
+{
+    while ((text.length > 0) && isspace((unsigned char)text.ptr[0])) {
+        ++text.ptr;
+        --text.length;
+    }
+
+    while ((text.length > 0) &&
+           isspace((unsigned char)text.ptr[text.length - 1])) {
+        --text.length;
+    }
+
+    return text;
+}
+
+
+/**
+ * @brief Checks if a character can be part of an identifier
+ */
+static bool asmIsIdentChar(char c)
+{
+    return (isalnum((unsigned char)c) || (c == '_') || (c == '.'));
+}
+
+
+/**
+ * @brief Case insensitive compare of text against a keyword
+ */
+static bool asmTextEquals(const AsmText &text, const char *keyword)
+{
+    size_t i;
+
+    for (i=0; i<text.length; ++i) {
+        if ((keyword[i] == '\0') ||
+            (tolower((unsigned char)text.ptr[i]) != keyword[i])) {
+            return false;
+        }
+    }
+
+    return (keyword[i] == '\0');
+}
+
+
+/**
+ * @brief Parses a register name
+ * @param text register name, r0-r255, pc or sp
+ * @param registerCount registers of the CPU profile, locates pc and sp
+ * @param regIndex location to store register index
+ * @return true if success, otherwise false
+ */
+static bool asmParseRegister(AsmText text, U32 registerCount, U8 &regIndex)
+{
+    text = asmTrim(text);
+
+    if (asmTextEquals(text, "pc")) {
+        regIndex = (U8)CPU_PC_INDEX(registerCount);
+        return true;
+    }
+
+    if (asmTextEquals(text, "sp")) {
+        regIndex = (U8)CPU_SP_INDEX(registerCount);
+        return true;
+    }
+
+    if ((text.length < 2) || (text.length > 4) ||
+        (tolower((unsigned char)text.ptr[0]) != 'r')) {
+        return false;
+    }
+
+    U32 value = 0;
+    for (size_t i=1; i<text.length; ++i) {
+        if (!isdigit((unsigned char)text.ptr[i])) {
+            return false;
+        }
+        value = value*10 + (text.ptr[i] - '0');
+    }
+
+    if (value > 0xFF) {
+        return false;
+    }
+
+    regIndex = (U8)value;
+
+    return true;
+}
+
+
+/**
+ * @brief Recursive descent expression evaluator
+ */
+class AsmExpression
+{
+private:
+    const AsmLabels &mLabels;
+    const char *mPtr;
+    const char *mEnd;
+    bool mUndefined;
+
+    void skipSpace()
+    {
+        while ((mPtr < mEnd) && isspace((unsigned char)*mPtr)) {
+            ++mPtr;
+        }
+    }
+
+    bool parseNumber(S32 &value)
+    {
+        U32 base = 10;
+        U32 result = 0;
+        const char *start;
+
+        if (((mEnd - mPtr) > 2) && (mPtr[0] == '0') &&
+            ((mPtr[1] == 'x') || (mPtr[1] == 'X'))) {
+            base = 16;
+            mPtr += 2;
+        } else if (((mEnd - mPtr) > 2) && (mPtr[0] == '0') &&
+                   ((mPtr[1] == 'b') || (mPtr[1] == 'B'))) {
+            base = 2;
+            mPtr += 2;
+        }
+
+        start = mPtr;
+        while (mPtr < mEnd) {
+            U32 digit;
+            char c = (char)tolower((unsigned char)*mPtr);
+
+            if ((c >= '0') && (c <= '9')) {
+                digit = c - '0';
+            } else if ((c >= 'a') && (c <= 'f')) {
+                digit = c - 'a' + 10;
+            } else {
+                break;
+            }
+
+            if (digit >= base) {
+                return false;
+            }
+
+            result = result*base + digit;
+            ++mPtr;
+        }
+
+        value = (S32)result;
+
+        return (mPtr != start);
+    }
+
+    bool parseTerm(S32 &value)
+    {
+        skipSpace();
+        if (mPtr >= mEnd) {
+            return false;
+        }
+
+        if (*mPtr == '-') {
+            ++mPtr;
+            if (!parseTerm(value)) {
+                return false;
+            }
+            value = -value;
+            return true;
+        }
+
+        if (*mPtr == '(') {
+            ++mPtr;
+            if (!parseSum(value)) {
+                return false;
+            }
+            skipSpace();
+            if ((mPtr >= mEnd) || (*mPtr != ')')) {
+                return false;
+            }
+            ++mPtr;
+            return true;
+        }
+
+        if (isdigit((unsigned char)*mPtr)) {
+            return parseNumber(value);
+        }
+
+        if (!asmIsIdentChar(*mPtr)) {
+            return false;
+        }
+
+        AsmText ident;
+        ident.ptr = mPtr;
+        while ((mPtr < mEnd) && asmIsIdentChar(*mPtr)) {
+            ++mPtr;
+        }
+        ident.length = mPtr - ident.ptr;
+
+        skipSpace();
+        if ((mPtr < mEnd) && (*mPtr == '(')) {
+            // lo(expr) or hi(expr)
+            bool high;
+
+            if (asmTextEquals(ident, "lo")) {
+                high = false;
+            } else if (asmTextEquals(ident, "hi")) {
+                high = true;
+            } else {
+                return false;
+            }
+
+            if (!parseTerm(value)) {
+                return false;
+            }
+
+            value = high ? (S32)(((U32)value >> 16) & 0xFFFF)
+                         : (S32)((U32)value & 0xFFFF);
+            return true;
+        }
+
+        AsmLabels::const_iterator it =
+            mLabels.find(std::string(ident.ptr, ident.length));
+        if (it == mLabels.end()) {
+            mUndefined = true;
+            value = 0;
+        } else {
+            value = (S32)it->second;
+        }
+
+        return true;
+    }
+
+    bool parseSum(S32 &value)
+    {
+        if (!parseTerm(value)) {
+            return false;
+        }
+
+        for (;;) {
+            S32 rhs;
+
+            skipSpace();
+            if ((mPtr >= mEnd) || ((*mPtr != '+') && (*mPtr != '-'))) {
+                return true;
+            }
+
+            char op = *mPtr++;
+            if (!parseTerm(rhs)) {
+                return false;
+            }
+
+            value = (op == '+') ? (S32)((U32)value + (U32)rhs)
+                                : (S32)((U32)value - (U32)rhs);
+        }
+    }
+
+public:
+    AsmExpression(const AsmLabels &labels)
+        : mLabels(labels), mPtr(NULL), mEnd(NULL), mUndefined(false)
+    {
+    }
+
+    /**
+     * @brief Evaluates an expression
+     * @param text expression to evaluate
+     * @param value location to store result
+     * @param undefined set if the expression used an unknown label
+     * @return true if expression is valid, otherwise false
+     */
+    bool evaluate(AsmText text, S32 &value, bool &undefined)
+    {
+        mPtr = text.ptr;
+        mEnd = text.ptr + text.length;
+        mUndefined = false;
+
+        if (!parseSum(value)) {
+            return false;
+        }
+
+        skipSpace();
+        undefined = mUndefined;
+
+        return (mPtr == mEnd);
+    }
+};
+
+
+/**
+ * @brief Evaluates an expression that must be fully resolved
+ * @return true if success, otherwise false with error set
+ */
+static bool asmEvaluate(const AsmLabels &labels, AsmText text, U32 line,
+                        S32 &value, AsmError &error)
+{
+    AsmExpression expr(labels);
+    bool undefined;
+
+    if (!expr.evaluate(text, value, undefined)) {
+        return asmError(error, line, "invalid expression '%.*s'",
+                        (int)text.length, text.ptr);
+    }
+
+    if (undefined) {
+        return asmError(error, line, "undefined label in '%.*s'",
+                        (int)text.length, text.ptr);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Splits text in to comma separated operands
+ * @return number of operands found, ASM_MAX_OPERANDS + 1 if too many
+ */
+static int asmSplitOperands(AsmText text, AsmText *operand)
+{
+    int count = 0;
+
+    text = asmTrim(text);
+    if (text.length == 0) {
+        return 0;
+    }
+
+    for (;;) {
+        const char *comma = (const char*)memchr(text.ptr, ',', text.length);
+        AsmText item;
+
+        if (count == ASM_MAX_OPERANDS) {
+            return ASM_MAX_OPERANDS + 1;
+        }
+
+        item.ptr = text.ptr;
+        item.length = (comma != NULL) ? (size_t)(comma - text.ptr)
+                                      : text.length;
+        operand[count++] = asmTrim(item);
+
+        if (comma == NULL) {
+            return count;
+        }
+
+        text.length -= (comma - text.ptr) + 1;
+        text.ptr = comma + 1;
+    }
+}
+
+
+/**
+ * @brief Returns number of operands an instruction takes
+ */
+static int asmOperandCount(const ISAInstructionInfo *info)
+{
+    int count = 0;
+
+    for (int i=0; i<ISA_MAX_FIELDS; ++i) {
+        if (info->role[i] != ISA_ROLE_NONE) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+
+/**
+ * @brief Checks an instruction size is one a CPU profile can use
+ */
+static bool asmValidInstructionSize(U32 size)
+{
+#define ASM_INSTRUCTION_SIZE_CASE(_size) case _size:
+    switch (size) {
+    CPU_PROFILE_INSTRUCTION_SIZES(ASM_INSTRUCTION_SIZE_CASE)
+        return true;
+    default:
+        return false;
+    }
+#undef ASM_INSTRUCTION_SIZE_CASE
+}
+
+
+/**
+ * @brief First pass, splits source in to statements and defines labels
+ */
+static bool asmFirstPass(const char *source, size_t length,
+                         std::vector<AsmStatement> &statements,
+                         AsmLabels &labels,
+                         U32 instructionSize,
+                         AsmError &error)
+{
+    const char *ptr = source;
+    const char *end = source + length;
+    U32 address = 0;
+    U32 registerCount = MAX_CPU_REGISTERS;
+    U32 line = 0;
+
+    while (ptr < end) {
+        AsmText text;
+
+        ++line;
+
+        // Find the end of the line, stripping comments
+        const char *eol = (const char*)memchr(ptr, '\n', end - ptr);
+        if (eol == NULL) {
+            eol = end;
+        }
+
+        text.ptr = ptr;
+        text.length = eol - ptr;
+        for (size_t i=0; i<text.length; ++i) {
+            if ((text.ptr[i] == ';') || (text.ptr[i] == '#')) {
+                text.length = i;
+                break;
+            }
+        }
+        ptr = eol + 1;
+
+        // Labels
+        for (;;) {
+            text = asmTrim(text);
+
+            size_t i = 0;
+            while ((i < text.length) && asmIsIdentChar(text.ptr[i])) {
+                ++i;
+            }
+
+            if ((i == 0) || (i >= text.length) || (text.ptr[i] != ':')) {
+                break;
+            }
+
+            if (isdigit((unsigned char)text.ptr[0])) {
+                return asmError(error, line, "invalid label '%.*s'",
+                                (int)i, text.ptr);
+            }
+
+            std::string name(text.ptr, i);
+            if (!labels.insert(std::make_pair(name, address)).second) {
+                return asmError(error, line, "label '%s' already defined",
+                                name.c_str());
+            }
+
+            text.ptr += i + 1;
+            text.length -= i + 1;
+        }
+
+        if (text.length == 0) {
+            continue;
+        }
+
+        // Mnemonic or directive
+        AsmText name = text;
+        name.length = 0;
+        while ((name.length < text.length) &&
+               !isspace((unsigned char)text.ptr[name.length])) {
+            ++name.length;
+        }
+
+        AsmText rest;
+        rest.ptr = text.ptr + name.length;
+        rest.length = text.length - name.length;
+
+        AsmStatement stmt;
+        int count = asmSplitOperands(rest, stmt.operand);
+
+        stmt.line = line;
+        stmt.address = address;
+        stmt.registerCount = registerCount;
+        stmt.instructionSize = instructionSize;
+        stmt.info = NULL;
+
+        if (name.ptr[0] == '.') {
+            S32 value;
+
+            if (count != 1) {
+                return asmError(error, line, "'%.*s' takes one operand",
+                                (int)name.length, name.ptr);
+            }
+
+            if (asmTextEquals(name, ".word")) {
+                stmt.type = ASM_WORD;
+                statements.push_back(stmt);
+                address += instructionSize;
+            } else if (asmTextEquals(name, ".org")) {
+                if (!asmEvaluate(labels, stmt.operand[0], line, value, error)) {
+                    return false;
+                }
+                address = (U32)value;
+            } else if (asmTextEquals(name, ".registers")) {
+                if (!asmEvaluate(labels, stmt.operand[0], line, value, error)) {
+                    return false;
+                }
+                if ((value < 3) || (value > CPU_REGISTER_FILE_SIZE)) {
+                    return asmError(error, line, "invalid register count %d",
+                                    value);
+                }
+                registerCount = (U32)value;
+            } else if (asmTextEquals(name, ".isize")) {
+                if (!asmEvaluate(labels, stmt.operand[0], line, value, error)) {
+                    return false;
+                }
+                if (!asmValidInstructionSize((U32)value)) {
+                    return asmError(error, line,
+                                    "invalid instruction size %d", value);
+                }
+                instructionSize = (U32)value;
+            } else if (asmTextEquals(name, ".space")) {
+                if (!asmEvaluate(labels, stmt.operand[0], line, value, error)) {
+                    return false;
+                }
+                address += (U32)value;
+            } else {
+                return asmError(error, line, "unknown directive '%.*s'",
+                                (int)name.length, name.ptr);
+            }
+
+            if ((address & (instructionSize - 1)) != 0) {
+                return asmError(error, line,
+                                "address 0x%08x is not aligned to %u bytes",
+                                address, instructionSize);
+            }
+        } else {
+            stmt.info = isaLookupMnemonic(name.ptr, name.length);
+            if (stmt.info == NULL) {
+                return asmError(error, line, "unknown instruction '%.*s'",
+                                (int)name.length, name.ptr);
+            }
+
+            if (count != asmOperandCount(stmt.info)) {
+                return asmError(error, line, "%s takes %d operand(s)",
+                                stmt.info->mnemonic,
+                                asmOperandCount(stmt.info));
+            }
+
+            stmt.type = ASM_INSTRUCTION;
+            statements.push_back(stmt);
+            address += instructionSize;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Encodes a single statement
+ */
+static bool asmEncode(const AsmStatement &stmt, const AsmLabels &labels,
+                      U32 &word, AsmError &error)
+{
+    S32 value;
+
+    if (stmt.type == ASM_WORD) {
+        if (!asmEvaluate(labels, stmt.operand[0], stmt.line, value, error)) {
+            return false;
+        }
+
+        word = (U32)value;
+        return true;
+    }
+
+    const ISAInstructionInfo *info = stmt.info;
+    int operand = 0;
+
+    word = (U32)info->opcode << 24;
+
+    for (int i=0; i<ISA_MAX_FIELDS; ++i) {
+        int shift = (ISA_MAX_FIELDS - 1 - i) * 8;
+        const AsmText &text = stmt.operand[operand];
+        U8 regIndex;
+
+        switch (info->role[i]) {
+        case ISA_ROLE_NONE:
+            word |= (U32)ISA_NOT_USED << shift;
+            continue;
+        case ISA_ROLE_IMM16:
+            if (!asmEvaluate(labels, text, stmt.line, value, error)) {
+                return false;
+            }
+            if ((value < -0x8000) || (value > 0xFFFF)) {
+                return asmError(error, stmt.line,
+                                "immediate %d does not fit in 16 bits", value);
+            }
+            word |= (U32)value & 0xFFFF;
+
+            // immediate covers the rest of the instruction
+            return true;
+        case ISA_ROLE_OFF8:
+            if (!asmEvaluate(labels, text, stmt.line, value, error)) {
+                return false;
+            }
+            if ((value < -0x80) || (value > 0x7F)) {
+                return asmError(error, stmt.line,
+                                "offset %d does not fit in 8 bits", value);
+            }
+            word |= ((U32)value & 0xFF) << shift;
+            break;
+        default:
+            if (!asmParseRegister(text, stmt.registerCount, regIndex)) {
+                return asmError(error, stmt.line, "invalid register '%.*s'",
+                                (int)text.length, text.ptr);
+            }
+            word |= (U32)regIndex << shift;
+            break;
+        }
+
+        ++operand;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Assembles source in to image segments
+ * @param source assembly source text
+ * @param length length of source in bytes
+ * @param segments location to store assembled segments
+ * @param error location to store error information
+ * @param instructionSize bytes per instruction and .word until the
+ *        source picks another with .isize
+ * @return true if success, otherwise false
+ */
+bool assembleProgram(const char *source, size_t length,
+                     std::vector<ImageSegment> &segments,
+                     AsmError &error, U32 instructionSize)
+{
+    std::vector<AsmStatement> statements;
+    std::vector<AsmWord> words;
+    AsmLabels labels;
+    bool sorted = true;
+
+    error.line = 0;
+    error.message[0] = '\0';
+    segments.clear();
+
+    if (!asmValidInstructionSize(instructionSize)) {
+        return asmError(error, 0, "invalid instruction size %u",
+                        instructionSize);
+    }
+
+    statements.reserve(length / 16);
+    if (!asmFirstPass(source, length, statements, labels, instructionSize,
+                      error)) {
+        return false;
+    }
+
+    // Second pass, every label is known
+    words.resize(statements.size());
+    for (size_t i=0; i<statements.size(); ++i) {
+        words[i].address = statements[i].address;
+        words[i].line = statements[i].line;
+        words[i].size = statements[i].instructionSize;
+
+        if (!asmEncode(statements[i], labels, words[i].value, error)) {
+            return false;
+        }
+
+        if ((i > 0) && (words[i].address < words[i-1].address)) {
+            sorted = false;
+        }
+    }
+
+    if (!sorted) {
+        std::stable_sort(words.begin(), words.end(),
+                         [](const AsmWord &a, const AsmWord &b) {
+            return a.address < b.address;
+        });
+    }
+
+    // Group contiguous words in to segments
+    for (size_t i=0; i<words.size(); ++i) {
+        if ((i > 0) &&
+            (words[i].address < words[i-1].address + words[i-1].size)) {
+            return asmError(error, words[i].line,
+                            "address 0x%08x is already used",
+                            words[i].address);
+        }
+
+        if ((i == 0) ||
+            (words[i].address != words[i-1].address + words[i-1].size)) {
+            segments.push_back(ImageSegment());
+            segments.back().address = words[i].address;
+        }
+
+        std::vector<U8> &data = segments.back().data;
+        data.push_back((U8)(words[i].value >> 24));
+        data.push_back((U8)(words[i].value >> 16));
+        data.push_back((U8)(words[i].value >> 8));
+        data.push_back((U8)words[i].value);
+        data.resize(data.size() + words[i].size - 4, 0);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Assembles source in to a binary image
+ * @param source assembly source text
+ * @param length length of source in bytes
+ * @param image location to store image
+ * @param error location to store error information
+ * @param instructionSize bytes per instruction and .word until the
+ *        source picks another with .isize
+ * @return true if success, otherwise false
+ */
+bool assembleImage(const char *source, size_t length,
+                   std::vector<U8> &image,
+                   AsmError &error, U32 instructionSize)
+{
+    std::vector<ImageSegment> segments;
+
+    if (!assembleProgram(source, length, segments, error, instructionSize)) {
+        return false;
+    }
+
+    return buildImage(segments, image);
+}
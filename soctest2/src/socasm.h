@@ -0,0 +1,44 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the assembler prototypes
+ */
+
+#ifndef _EWATC_SOCASM_H
+#define _EWATC_SOCASM_H
+
+#include <stddef.h>
+#include <vector>
+#include "socimage.h"
+
+// Assembly syntax, one statement per line:
+//   label:                      defines label at current address
+//   MNEMONIC op, op, op         instruction, operands in encoding order
+//   .org expr                   moves current address
+//   .word expr                  stores a 32-bit value, padded with
+//                               zeros to the instruction size
+//   .space expr                 skips expr bytes
+//   .registers expr             register count of the CPU profile,
+//                               decides which registers pc and sp are
+//   .isize expr                 instruction size of the CPU profile,
+//                               bytes each instruction and .word take
+//   ; or #                      starts a comment
+//
+// Registers are r0-r255, pc and sp. Expressions are numbers, labels,
+// lo(expr), hi(expr) and +/- of those.
+
+struct AsmError
+{
+    U32 line;
+    char message[128];
+};
+
+bool assembleProgram(const char *source, size_t length,
+                     std::vector<ImageSegment> &segments,
+                     AsmError &error,
+                     U32 instructionSize=CPU_INSTRUCTION_SIZE);
+bool assembleImage(const char *source, size_t length,
+                   std::vector<U8> &image,
+                   AsmError &error,
+                   U32 instructionSize=CPU_INSTRUCTION_SIZE);
+
+#endif
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include "socbasic.h"
+#include "socdebug.h"
 
 
 
@@ -16,11 +17,81 @@
  * @return true if success, otherwise error
  */
 bool runProgram(CPUContext &ctx, Memory &mem)
+{
+    return runProgram(ctx, mem, executeCPUInstruction);
+}
+
+
+/**
+ * @brief Returns a name for a fault
+ * @param kind CPUFaultKind
+ * @return name, never NULL
+ */
+const char *describeCPUFault(U32 kind)
+{
+    static const char *names[] = {
+        "No fault",
+        "Fetch fault",
+        "Illegal instruction",
+        "Read fault",
+        "Write fault",
+        "Divide by zero"
+    };
+
+    if (kind >= (sizeof(names) / sizeof(names[0]))) {
+        return "Unknown fault";
+    }
+
+    return names[kind];
+}
+
+
+/**
+ * @brief Runs the program loaded in to memory with the executor
+ *        selected for the CPU profile, until it finishes, stops at
+ *        a breakpoint or watchpoint, or reaches a loop that changes
+ *        nothing and so never ends
+ * @param ctx CPU Context
+ * @param mem Memory to use
+ * @param execute executor returned by selectCPUExecutor
+ * @return true if success, otherwise error
+ */
+bool runProgram(CPUContext &ctx, Memory &mem, CPUExecuteFunction execute)
 {
     bool finished = false;
+    IdleLoop idle;
+    U32 pcIndex = CPU_PC_INDEX(ctx.registerCount);
+
+    if (execute == NULL) {
+        return false;
+    }
+
+    resetIdleLoop(idle);
 
     while (!finished) {
-        if (!executeCPUInstruction(ctx, mem)) {
+        U32 oldPC = ctx.reg[pcIndex];
+
+        if (!execute(ctx, mem)) {
+            if ((ctx.debug != NULL) && ctx.debug->hit.hit) {
+                static const char *kinds[DEBUG_KIND_COUNT] = {
+                    "Breakpoint", "Read watchpoint", "Write watchpoint"
+                };
+
+                printf("%s 0x%08x @ 0x%08x\n", kinds[ctx.debug->hit.kind],
+                       ctx.debug->hit.address, ctx.debug->hit.pc);
+            } else {
+                if (ctx.fault.kind != CPU_FAULT_NONE) {
+                    printf("%s 0x%08x @ 0x%08x\n",
+                           describeCPUFault(ctx.fault.kind),
+                           ctx.fault.address, ctx.fault.pc);
+                }
+                printf("Program Finished\n");
+            }
+            finished = true;
+        } else if (checkIdleLoop(idle, ctx, mem, oldPC)) {
+            // Nothing can end the loop, it would run forever
+            printf("Idle loop @ 0x%08x, %llu instructions per iteration\n",
+                   ctx.reg[pcIndex], idle.periodInstructions);
             printf("Program Finished\n");
             finished = true;
         }
@@ -39,11 +110,15 @@ void debugDumpCPU(const CPUContext &ctx)
     printf("CPU\n");
 
     // Print the last two, PC and SP
-    printf("\tpc = 0x%08x\tsp = 0x%08x\n", ctx.reg[REG_PC], ctx.reg[REG_SP]);
+    printf("\tpc = 0x%08x\tsp = 0x%08x\n",
+           ctx.reg[CPU_PC_INDEX(ctx.registerCount)],
+           ctx.reg[CPU_SP_INDEX(ctx.registerCount)]);
+    printf("\tinstructions = %llu\tcycles = %llu\n",
+           ctx.instructionCount, ctx.cycleCount);
 
     // Print the rest of the registers
-    for (int i=0; i<MAX_CPU_REGISTERS - 2; ++i) {
-        printf("\treg[%d] = 0x%08x\n", i, ctx.reg[i]);
+    for (U32 i=0; i<ctx.registerCount - 2; ++i) {
+        printf("\treg[%u] = 0x%08x\n", i, ctx.reg[i]);
     }
 }
 
@@ -65,13 +140,19 @@ void debugDumpMemory(const Memory &mem, U32 first=0, U32 last=MEMORY_SIZE-1)
     // Print memory
     printf("Memory (0x%08x-0x%08x)\n", first, last);
     for (U32 addr=first; addr<last; addr+= alignment) {
+        U8 row[16];
+
+        if (!readMemoryBlock(mem, addr, row, alignment)) {
+            break;
+        }
+
         printf("0x%08x", addr);
         for (int i=0; i<alignment; ++i) {
             if ((i&(alignment/2 - 1)) == 0) {
                 printf(" ");
             }
 
-            printf("%02x ", mem.data[addr+i]);
+            printf("%02x ", row[i]);
         }
 
         for (int i=0; i<alignment; ++i) {
@@ -79,10 +160,10 @@ void debugDumpMemory(const Memory &mem, U32 first=0, U32 last=MEMORY_SIZE-1)
                 printf(" ");
             }
 
-            if ((mem.data[addr+i] >= 32) && (mem.data[addr+i] < 127)) {
-                printf("%c", mem.data[addr+i]);
-            } else if ((mem.data[addr+i] >= 129) && (mem.data[addr+i] < 255)) {
-                printf("%c", mem.data[addr+i]);
+            if ((row[i] >= 32) && (row[i] < 127)) {
+                printf("%c", row[i]);
+            } else if ((row[i] >= 129) && (row[i] < 255)) {
+                printf("%c", row[i]);
             } else {
                 printf(".");
             }
@@ -110,180 +191,6 @@ void debugDumpSocStatus(const CPUContext &ctx, const Memory &mem)
 }
 
 
-/**
- * @brief reads 8-bit value memory at address and stores it in value
- * @param mem memory to read from
- * @param address location to read from
- * @param value location to store value read
- * @return true if success, otherwise false
- */
-bool read8Memory(const Memory &mem, U32 address, U8 &value)
-{
-    bool retval;
-
-    if (address < MEMORY_SIZE) {
-        value = mem.data[address];
-        retval = true;
-    } else {
-        printf("READ ERROR: Address 0x%08x >= 0x%08x\n",
-               address, MEMORY_SIZE);
-        retval = false;
-    }
-
-    return retval;
-}
-
-
-/**
- * @brief reads 16-bit value memory at address and stores it in value
- * @param mem memory to read from
- * @param address location to read from
- * @param value location to store value read
- * @return true if success, otherwise false
- */
-bool read16Memory(const Memory &mem, U32 address, U16 &value)
-{
-    bool retval;
-
-    // Check alignment
-    if ((address & 0x1) == 0) {
-        if (address < MEMORY_SIZE) {
-            U16 *memptr = (U16*)&mem.data[address];
-            value = *memptr;
-            value = byteswap16(value);
-            retval = true;
-        } else {
-            printf("READ ERROR: Address 0x%08x >= 0x%08x\n",
-                   address, MEMORY_SIZE);
-            retval = false;
-        }
-    } else {
-        printf("READ ERROR: Address 0x%08x is not 16-bit aligned\n", address);
-        retval = false;
-    }
-
-    return retval;
-}
-
-
-/**
- * @brief reads 32-bit value memory at address and stores it in value
- * @param mem memory to read from
- * @param address location to read from
- * @param value location to store value read
- * @return true if success, otherwise false
- */
-bool read32Memory(const Memory &mem, U32 address, U32 &value)
-{
-    bool retval;
-
-    // Check alignment
-    if ((address & 0x3) == 0) {
-        if (address < MEMORY_SIZE) {
-            U32 *memptr = (U32*)&mem.data[address];
-            value = *memptr;
-            value = byteswap32(value);
-            retval = true;
-        } else {
-            printf("READ ERROR: Address 0x%08x >= 0x%08x\n",
-                   address, MEMORY_SIZE);
-            retval = false;
-        }
-    } else {
-        printf("READ ERROR: Address 0x%08x is not 32-bit aligned\n", address);
-        retval = false;
-    }
-
-    return retval;
-}
-
-
-/**
- * @brief writes 8-bit value to memory at address
- * @param mem memory to write to
- * @param address location to write to
- * @param value value to store in memory
- * @return true if success, otherwise false
- */
-bool write8Memory(Memory &mem, U32 address, const U8 &value)
-{
-    bool retval;
-
-    if (address < MEMORY_SIZE) {
-        mem.data[address] = value;
-        retval = true;
-    } else {
-        printf("WRITE ERROR: Address 0x%08x >= 0x%08x\n",
-               address, MEMORY_SIZE);
-        retval = false;
-    }
-
-    return retval;
-}
-
-
-/**
- * @brief writes 16-bit value to memory at address
- * @param mem memory to write to
- * @param address location to write to
- * @param value value to store in memory
- * @return true if success, otherwise false
- */
-bool write16Memory(Memory &mem, U32 address, const U16 &value)
-{
-    bool retval;
-
-    // Check alignment
-    if ((address & 0x3) == 0) {
-        if (address < MEMORY_SIZE) {
-            U16 *memptr = (U16*)&mem.data[address];
-            *memptr = byteswap16(value);
-            retval = true;
-        } else {
-            printf("WRITE ERROR: Address 0x%08x >= 0x%08x\n",
-                   address, MEMORY_SIZE);
-            retval = false;
-        }
-    } else {
-        printf("WRITE ERROR: Address 0x%08x is not 16-bit aligned\n", address);
-        retval = false;
-    }
-
-    return retval;
-}
-
-
-/**
- * @brief writes 32-bit value to memory at address
- * @param mem memory to write to
- * @param address location to write to
- * @param value value to store in memory
- * @return true if success, otherwise false
- */
-bool write32Memory(Memory &mem, U32 address, const U32 &value)
-{
-    bool retval;
-
-    // Check alignment
-    if ((address & 0x3) == 0) {
-        if (address < MEMORY_SIZE) {
-            U32 *memptr = (U32*)&mem.data[address];
-            *memptr = byteswap32(value);
-            retval = true;
-        } else {
-            printf("WRITE ERROR: Address 0x%08x >= 0x%08x\n",
-                   address, MEMORY_SIZE);
-            retval = false;
-        }
-    } else {
-        printf("WRITE ERROR: Address 0x%08x is not 32-bit aligned\n", address);
-        retval = false;
-    }
-
-    return retval;
-}
-
-
 /**
  * @brief Takes an opcode, register index and data and formats it
  *        in to an instruction format 1 type
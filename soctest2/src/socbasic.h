@@ -3,11 +3,19 @@
  * @brief This file contains common prototypes
  */
 
+#ifndef _EWATC_SOCBASIC_H
+#define _EWATC_SOCBASIC_H
+
 #include "types.h"
 #include "soccfg.h"
+#include "socmemory.h"
+
+// PC and SP are always the last two registers of a profile
+#define CPU_PC_INDEX(_registerCount) ((_registerCount) - 1)
+#define CPU_SP_INDEX(_registerCount) ((_registerCount) - 2)
 
-#define REG_PC (MAX_CPU_REGISTERS - 1)
-#define REG_SP (MAX_CPU_REGISTERS - 2)
+#define REG_PC CPU_PC_INDEX(MAX_CPU_REGISTERS)
+#define REG_SP CPU_SP_INDEX(MAX_CPU_REGISTERS)
 
 union TestInstruction {
     U32 value32;
@@ -61,35 +69,181 @@ union TestInstruction {
     } format3;
 };
 
-struct Memory
+struct CPUProfile
 {
-    U8 data[MEMORY_SIZE];
+    U32 registerCount;      // including PC and SP
+    U32 resetVector;        // initial PC
+    U32 stackReset;         // initial SP
+    U32 instructionSize;    // bytes PC advances per instruction
+    U32 exceptionVector;    // CPU_NO_EXCEPTION_VECTOR stops on a fault
+};
+
+#define CPU_NO_EXCEPTION_VECTOR 0xFFFFFFFF
+
+// Why an instruction could not complete
+enum CPUFaultKind {
+    CPU_FAULT_NONE,
+    CPU_FAULT_FETCH,        // instruction could not be read
+    CPU_FAULT_ILLEGAL,      // unknown opcode or register out of range
+    CPU_FAULT_READ,         // data read out of range or misaligned
+    CPU_FAULT_WRITE,        // data write out of range or misaligned
+    CPU_FAULT_DIVIDE        // divide by zero
 };
 
+/**
+ * @brief Fault of the last instruction that stopped the CPU. Faults
+ *        are precise, PC and every other register are as they were
+ *        before the faulting instruction.
+ *
+ *        With an exception vector the CPU is not stopped, instead it
+ *        pushes a frame and jumps to the vector:
+ *          [SP+8] pc of the faulting instruction
+ *          [SP+4] address
+ *          [SP+0] kind
+ */
+struct CPUFault
+{
+    U32 kind;               // CPUFaultKind
+    U32 address;            // address accessed, pc for fetch/illegal
+    U32 size;               // bytes accessed, 0 if not an access
+    U32 pc;                 // address of the faulting instruction
+};
+
+struct DebugState;
+struct ReverseHistory;
+struct TraceStream;
+
+namespace soc {
+class MemoryTiming;
+}
+
 struct CPUContext
 {
-    U32 reg[MAX_CPU_REGISTERS];
+    U32 reg[CPU_REGISTER_FILE_SIZE];
+    U32 registerCount;      // registers of the profile ctx was reset with
+    U64 instructionCount;
+    U64 cycleCount;
+    U64 instructionLimit;   // fusing executors never run an idiom past it
+    CPUFault fault;         // kind is CPU_FAULT_NONE unless stopped by one
+    U32 exceptionVector;
+    FetchBuffer fetch;      // lines of instructions held decoded
+    DebugState *debug;      // used by debug executors, NULL after reset
+    ReverseHistory *history;    // used by recording executors, NULL after
+                                // reset
+    TraceStream *trace;     // used by tracing executors, NULL after reset
+    soc::MemoryTiming *timing;  // used by timing executors, NULL after reset
 };
 
+typedef bool (*CPUExecuteFunction)(CPUContext &ctx, Memory &mem);
+
+/**
+ * @brief Finds loops that change nothing. Every backward jump is a
+ *        possible loop head, the state of the CPU is remembered there.
+ *        When the CPU jumps back to the same head with the same
+ *        registers and no page of memory written since, the loop can
+ *        never leave: nothing but the CPU changes the SoC, and it will
+ *        do exactly the same again. Such a loop polling memory or a
+ *        status register only ends with the run, so whole iterations
+ *        up to the end of the run need not be interpreted.
+ */
+struct IdleLoop
+{
+    bool armed;             // state below is of a loop head
+    U32 head;               // pc jumped back to
+    U64 instructionCount;   // counters when head was reached
+    U64 cycleCount;
+    U32 reg[CPU_REGISTER_FILE_SIZE];
+    U32 pageVersion[MEMORY_PAGE_COUNT];
+    U64 periodInstructions; // one iteration, once found
+    U64 periodCycles;
+};
+
+// Optional executor features, an executor is compiled for every
+// combination so unused features cost nothing
+#define CPU_EXECUTE_DEBUG   0x1     // check breakpoints and watchpoints
+#define CPU_EXECUTE_RECORD  0x2     // log undo entries for reverse execution
+#define CPU_EXECUTE_TRACE   0x4     // write retired instructions to a trace
+#define CPU_EXECUTE_FEATURES(X) X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) \
+                                X(CPU_EXECUTE_FUSE) X(CPU_EXECUTE_TIMING)
+
+// Runs an idiom of ISA_IDIOMS with one dispatch, so a call may retire
+// more than one instruction. Only compiled on its own, the features
+// above see every instruction.
+#define CPU_EXECUTE_FUSE    0x8
+
+// Passes every fetch, load and store to the cache and TLB model of
+// ctx.timing, for the detailed windows of a sampled run. Only compiled
+// on its own.
+#define CPU_EXECUTE_TIMING  0x10
+
+extern const CPUProfile defaultCPUProfile;
 
 bool resetSoC(CPUContext &ctx, Memory &mem);
+bool resetSoC(CPUContext &ctx, Memory &mem, const CPUProfile &profile);
 bool loadProgram(Memory &mem);
 bool executeCPUInstruction(CPUContext &ctx, Memory &mem);
+CPUExecuteFunction selectCPUExecutor(const CPUProfile &profile,
+                                     U32 features=0);
+
+void resetIdleLoop(IdleLoop &idle);
+bool matchIdleLoop(IdleLoop &idle, const CPUContext &ctx, const Memory &mem);
+U64 skipIdleLoop(const IdleLoop &idle, CPUContext &ctx, U64 budget);
+
+/**
+ * @brief Checks for an idle loop after every instruction, only backward
+ *        jumps are looked at further
+ * @param idle loop state, reset before the run
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param oldPC pc of the instruction just run
+ * @return true if the CPU just finished an iteration of an idle loop
+ */
+static inline bool checkIdleLoop(IdleLoop &idle, const CPUContext &ctx,
+                                 const Memory &mem, U32 oldPC)
+{
+    if (SOC_LIKELY(ctx.reg[CPU_PC_INDEX(ctx.registerCount)] > oldPC)) {
+        return false;
+    }
+
+    return matchIdleLoop(idle, ctx, mem);
+}
+
+/**
+ * @brief Runs one call of an executor within a budget, for executors
+ *        that may retire an idiom per call
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param execute executor
+ * @param budget instructions left, at least 1
+ * @param ran location to add the instructions run to, a call that
+ *            stops the CPU or enters the exception vector counts as one
+ * @return value returned by the executor
+ */
+static inline bool stepCPU(CPUContext &ctx, Memory &mem,
+                           CPUExecuteFunction execute, U64 budget, U64 &ran)
+{
+    U64 before = ctx.instructionCount;
+
+    ctx.instructionLimit = (budget < (~0ULL - before)) ? before + budget :
+                                                         ~0ULL;
+
+    bool retval = execute(ctx, mem);
+    U64 retired = ctx.instructionCount - before;
+
+    ran += (retired > 1) ? retired : 1;
+
+    return retval;
+}
 
 bool runProgram(CPUContext &ctx, Memory &mem);
+bool runProgram(CPUContext &ctx, Memory &mem, CPUExecuteFunction execute);
+
+const char *describeCPUFault(U32 kind);
 
 void debugDumpCPU(const CPUContext &ctx);
 void debugDumpCPU(const Memory &mem, U32 first=0, U32 last=MEMORY_SIZE-1);
 void debugDumpSocStatus(const CPUContext &ctx, const Memory &mem);
 
-bool read8Memory(const Memory &mem, U32 address, U8 &value);
-bool read16Memory(const Memory &mem, U32 address, U16 &value);
-bool read32Memory(const Memory &mem, U32 address, U32 &value);
-
-bool write8Memory(Memory &mem, U32 address, const U8 &value);
-bool write16Memory(Memory &mem, U32 address, const U16 &value);
-bool write32Memory(Memory &mem, U32 address, const U32 &value);
-
 
 TestInstruction buildCPUInstructionFmt1(U8 opcode,
                                         U8 regIndex,
@@ -103,34 +257,4 @@ TestInstruction buildCPUInstructionFmt3(U8 opcode,
                                         U8 regIndex2,
                                         U8 data);
 
-#define swap16(_value) ((((_value)&0x00FF) << 8) | \
-                        (((_value)&0xFF00) >> 8))
-
-#define swap32(_value) ((((_value)&0x000000FF) << 24) | \
-                        (((_value)&0x0000FF00) << 8)  | \
-                        (((_value)&0x00FF0000) >> 8)  | \
-                        (((_value)&0xFF000000) >> 24))
-
-#ifdef HOST_LITTLE_ENDIAN
-    #ifdef SOC_LITTLE_ENDIAN
-        #define byteswap16(_value) (_value)
-        #define byteswap32(_value) (_value)
-    #elif defined(SOC_BIG_ENDIAN)
-        #define byteswap16(_value) swap16(_value)
-        #define byteswap32(_value) swap32(_value)
-    #else
-        #error "Invalid SoC Configuration"
-    #endif
-#elif defined(HOST_BIG_ENDIAN)
-    #ifdef SOC_LITTLE_ENDIAN
-        #define byteswap16(_value) swap16(_value)
-        #define byteswap32(_value) swap32(_value)
-    #elif defined(SOC_BIG_ENDIAN)
-        #define byteswap16(_value) (_value)
-        #define byteswap32(_value) (_value)
-    #else
-        #error "Invalid SoC Configuration"
-    #endif
-#else
-    #error "Invalid Host Configuration"
 #endif
@@ -9,39 +9,62 @@
 #define MEMORY_SIZE   0x0080
 #define MEMORY_RESET_VALUE 0xFF
 
+// Memory is tracked in pages for hashing and change detection,
+// 64 bytes matches a host cache line
+#define MEMORY_PAGE_SHIFT 6
+
+// Default CPU profile, other profiles are selected at runtime
 #define MAX_CPU_REGISTERS 4
 #define CPU_REGISTER_RESET_VALUE 0x1A1A2B2B
 #define CPU_PC_RESET_VECTOR 0x00000000
 #define CPU_INSTRUCTION_SIZE 4
 
+// Faults jump here with a frame on the stack, 0xFFFFFFFF stops the CPU
+// on a fault instead
+#define CPU_EXCEPTION_VECTOR 0xFFFFFFFF
+
+// Lines of instructions the CPU keeps decoded, a power of 2. A return
+// or jump to a line still held does not load it again.
+#define CPU_FETCH_LINES 8
+
+// Register indexes are 8 bits, so a context always has room for 256
+#define CPU_REGISTER_FILE_SIZE 256
+
+// Register counts and instruction sizes an executor is compiled for,
+// a CPU profile must use one of each
+#define CPU_PROFILE_REGISTER_COUNTS(X) \
+    X(4) X(8) X(12) X(16) X(32) X(64) X(128) X(256)
+#define CPU_PROFILE_INSTRUCTION_SIZES(X) \
+    X(4) X(8)
+
+// Set to 0 to remove the per instruction trace from the executor, tools
+// that run many instructions build with -DCPU_TRACE_ENABLED=0
+#ifndef CPU_TRACE_ENABLED
+#define CPU_TRACE_ENABLED 1
+#endif
 
-// This section do not worry about
 
 // Intel is Little Endian
 // ARM is Big Endian
 // More information: http://en.wikipedia.org/wiki/Endianness
 #define SOC_BIG_ENDIAN
-#define HOST_LITTLE_ENDIAN
 
-#if 0
-/* This is some defines that determine at compile time the host
- * endianess. It does cause a warning and is not cross-compiler
- * friendly.
- */
-#define LITTLE_ENDIAN 0x41424344UL
-#define BIG_ENDIAN    0x44434241UL
-#define ENDIAN_ORDER  ('ABCD')
-#undef HOST_LITTLE_ENDIAN
-#undef HOST_BIG_ENDIAN
+// 1 stores memory as 32-bit words in host order, so guest 32-bit loads
+// and stores need no byte swap. Bytes are only reordered when memory is
+// copied in or out (images, dumps). 0 stores memory in SoC byte order.
+#define MEMORY_HOST_ORDER 1
 
-#if ENDIAN_ORDER==LITTLE_ENDIAN
+// Host endianness is detected at compile time
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
     #define HOST_LITTLE_ENDIAN
-#elif ENDIAN_ORDER==BIG_ENDIAN
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
     #define HOST_BIG_ENDIAN
+#elif defined(_MSC_VER)
+    // Every Windows target is little endian
+    #define HOST_LITTLE_ENDIAN
 #else
     #error "Unable to determine host endianness"
 #endif
-#endif
 
 
 #endif
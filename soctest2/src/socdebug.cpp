@@ -0,0 +1,144 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Breakpoint and watchpoint functions
+ */
+
+#include <string.h>
+#include "socdebug.h"
+
+
+/**
+ * @brief Sets the page bits of every page a range covers
+ */
+static void setDebugPages(DebugState &debug, const DebugPoint &point)
+{
+    U32 last = point.last;
+
+    if (last >= MEMORY_SIZE) {
+        last = MEMORY_SIZE - 1;
+    }
+
+    for (U32 page = point.first >> MEMORY_PAGE_SHIFT;
+         page <= (last >> MEMORY_PAGE_SHIFT); ++page) {
+        debug.pageBits[point.kind][page >> 5] |= (1U << (page & 31));
+    }
+}
+
+
+/**
+ * @brief Removes every debug point and any pending hit
+ * @param debug debug state
+ */
+void resetDebugState(DebugState &debug)
+{
+    memset(debug.pageBits, 0, sizeof(debug.pageBits));
+    debug.points.clear();
+    debug.hit.hit = false;
+    debug.stepOver = false;
+}
+
+
+/**
+ * @brief Adds a breakpoint or watchpoint
+ * @param debug debug state
+ * @param kind DEBUG_BREAK_EXECUTE, DEBUG_WATCH_READ or DEBUG_WATCH_WRITE
+ * @param first first address covered
+ * @param last last address covered, same as first for a breakpoint
+ * @return true if success, otherwise false
+ */
+bool addDebugPoint(DebugState &debug, U32 kind, U32 first, U32 last)
+{
+    if ((kind >= DEBUG_KIND_COUNT) || (first > last) ||
+        (first >= MEMORY_SIZE)) {
+        return false;
+    }
+
+    DebugPoint point;
+
+    point.kind = kind;
+    point.first = first;
+    point.last = last;
+    debug.points.push_back(point);
+
+    setDebugPages(debug, point);
+
+    return true;
+}
+
+
+/**
+ * @brief Removes a breakpoint or watchpoint added with the same values
+ * @param debug debug state
+ * @param kind kind passed to addDebugPoint
+ * @param first first address passed to addDebugPoint
+ * @param last last address passed to addDebugPoint
+ * @return true if success, otherwise false
+ */
+bool removeDebugPoint(DebugState &debug, U32 kind, U32 first, U32 last)
+{
+    for (size_t i=0; i<debug.points.size(); ++i) {
+        const DebugPoint &point = debug.points[i];
+
+        if ((point.kind == kind) && (point.first == first) &&
+            (point.last == last)) {
+            debug.points.erase(debug.points.begin() + i);
+
+            // Other points may share the pages, rebuild the bits
+            memset(debug.pageBits, 0, sizeof(debug.pageBits));
+            for (size_t j=0; j<debug.points.size(); ++j) {
+                setDebugPages(debug, debug.points[j]);
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Clears the last hit so the CPU can run again, a CPU stopped
+ *        at a breakpoint executes that instruction first
+ * @param debug debug state
+ */
+void resumeDebug(DebugState &debug)
+{
+    if (debug.hit.hit && (debug.hit.kind == DEBUG_BREAK_EXECUTE)) {
+        debug.stepOver = true;
+    }
+
+    debug.hit.hit = false;
+}
+
+
+/**
+ * @brief Slow path of the checks, only called for pages with a point
+ *        of kind, records the first match as the hit
+ * @param debug debug state
+ * @param kind kind of access
+ * @param address first address accessed
+ * @param size bytes accessed
+ * @return true if a point matched
+ */
+bool matchDebugPoint(DebugState &debug, U32 kind, U32 address, U32 size)
+{
+    U32 last = address + size - 1;
+
+    for (size_t i=0; i<debug.points.size(); ++i) {
+        const DebugPoint &point = debug.points[i];
+
+        if ((point.kind == kind) &&
+            (address <= point.last) && (last >= point.first)) {
+            if (!debug.hit.hit) {
+                debug.hit.hit = true;
+                debug.hit.kind = kind;
+                debug.hit.address = address;
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
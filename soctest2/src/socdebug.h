@@ -0,0 +1,114 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains breakpoints and watchpoints
+ */
+
+#ifndef _EWATC_SOCDEBUG_H
+#define _EWATC_SOCDEBUG_H
+
+#include <vector>
+#include "socbasic.h"
+
+// Kinds of debug points, also indexes in to DebugState::pageBits
+#define DEBUG_BREAK_EXECUTE 0
+#define DEBUG_WATCH_READ    1
+#define DEBUG_WATCH_WRITE   2
+#define DEBUG_KIND_COUNT    3
+
+#define DEBUG_PAGE_WORDS    ((MEMORY_PAGE_COUNT + 31) / 32)
+
+struct DebugPoint
+{
+    U32 kind;
+    U32 first;      // first address covered
+    U32 last;       // last address covered
+};
+
+struct DebugHit
+{
+    bool hit;
+    U32 kind;
+    U32 address;    // address that matched
+    U32 pc;         // address of the instruction, set by the executor
+};
+
+/**
+ * @brief Breakpoints and watchpoints of one CPU. A page bit is set for
+ *        every page a point covers, accesses to other pages cost one
+ *        bit test. Only executors selected with debug enabled look
+ *        at this at all.
+ */
+struct DebugState
+{
+    U32 pageBits[DEBUG_KIND_COUNT][DEBUG_PAGE_WORDS];
+    std::vector<DebugPoint> points;
+    DebugHit hit;
+    bool stepOver;  // next instruction ignores a breakpoint at its PC
+};
+
+void resetDebugState(DebugState &debug);
+bool addDebugPoint(DebugState &debug, U32 kind, U32 first, U32 last);
+bool removeDebugPoint(DebugState &debug, U32 kind, U32 first, U32 last);
+void resumeDebug(DebugState &debug);
+
+bool matchDebugPoint(DebugState &debug, U32 kind, U32 address, U32 size);
+
+
+/**
+ * @brief Tests whether a page has any debug point of a kind
+ * @param debug debug state
+ * @param kind DEBUG_BREAK_EXECUTE, DEBUG_WATCH_READ or DEBUG_WATCH_WRITE
+ * @param address any address in the page
+ * @return true if the page has a debug point of kind
+ */
+static inline bool debugPageSet(const DebugState &debug, U32 kind,
+                                U32 address)
+{
+    U32 page = address >> MEMORY_PAGE_SHIFT;
+
+    if (page >= MEMORY_PAGE_COUNT) {
+        return false;
+    }
+
+    return ((debug.pageBits[kind][page >> 5] >> (page & 31)) & 1) != 0;
+}
+
+
+/**
+ * @brief Checks for a breakpoint before an instruction executes
+ * @param debug debug state
+ * @param pc address of the instruction
+ * @return true if the CPU must stop before the instruction
+ */
+static inline bool checkDebugBreakpoint(DebugState &debug, U32 pc)
+{
+    if (debug.stepOver) {
+        debug.stepOver = false;
+        return false;
+    }
+
+    if (!debugPageSet(debug, DEBUG_BREAK_EXECUTE, pc)) {
+        return false;
+    }
+
+    return matchDebugPoint(debug, DEBUG_BREAK_EXECUTE, pc, 1);
+}
+
+
+/**
+ * @brief Checks a memory access against the watchpoints, a match stops
+ *        the CPU once the instruction completes
+ * @param debug debug state
+ * @param kind DEBUG_WATCH_READ or DEBUG_WATCH_WRITE
+ * @param address first address accessed
+ * @param size bytes accessed, accesses are aligned so never span pages
+ */
+static inline void checkDebugAccess(DebugState &debug, U32 kind,
+                                    U32 address, U32 size)
+{
+    if (debugPageSet(debug, kind, address)) {
+        matchDebugPoint(debug, kind, address, size);
+    }
+}
+
+#endif
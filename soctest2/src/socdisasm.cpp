@@ -0,0 +1,199 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Disassembler for the SoC instruction set
+ */
+
+#include "socdisasm.h"
+#include "socisa.h"
+
+// Column address comments start at in disassembled images
+#define DISASM_COMMENT_COLUMN 32
+
+static const char disasmHexDigits[] = "0123456789abcdef";
+
+
+/**
+ * @brief Appends a string
+ * @return ptr to end of buffer
+ */
+static char *disasmString(char *out, const char *str)
+{
+    while (*str != '\0') {
+        *out++ = *str++;
+    }
+
+    return out;
+}
+
+
+/**
+ * @brief Appends a value as 0x prefixed hex with a fixed digit count
+ * @return ptr to end of buffer
+ */
+static char *disasmHex(char *out, U32 value, int digits)
+{
+    *out++ = '0';
+    *out++ = 'x';
+
+    for (int shift=(digits - 1)*4; shift>=0; shift-=4) {
+        *out++ = disasmHexDigits[(value >> shift) & 0xF];
+    }
+
+    return out;
+}
+
+
+/**
+ * @brief Appends a register name
+ * @return ptr to end of buffer
+ */
+static char *disasmRegister(char *out, U8 regIndex, U32 registerCount)
+{
+    if (regIndex == CPU_PC_INDEX(registerCount)) {
+        return disasmString(out, "pc");
+    }
+
+    if (regIndex == CPU_SP_INDEX(registerCount)) {
+        return disasmString(out, "sp");
+    }
+
+    *out++ = 'r';
+    if (regIndex >= 100) {
+        *out++ = (char)('0' + regIndex/100);
+    }
+    if (regIndex >= 10) {
+        *out++ = (char)('0' + (regIndex/10)%10);
+    }
+    *out++ = (char)('0' + regIndex%10);
+
+    return out;
+}
+
+
+/**
+ * @brief Appends a signed decimal offset
+ * @return ptr to end of buffer
+ */
+static char *disasmOffset(char *out, S8 offset)
+{
+    int value = offset;
+
+    if (value < 0) {
+        *out++ = '-';
+        value = -value;
+    }
+
+    if (value >= 100) {
+        *out++ = (char)('0' + value/100);
+    }
+    if (value >= 10) {
+        *out++ = (char)('0' + (value/10)%10);
+    }
+    *out++ = (char)('0' + value%10);
+
+    return out;
+}
+
+
+/**
+ * @brief Disassembles one instruction, output can be assembled again
+ * @param instruction instruction word in host order
+ * @param buffer location to store text, at least DISASM_MAX_LENGTH bytes
+ * @param registerCount registers of the CPU profile, names pc and sp
+ * @return number of characters written, not including terminator
+ */
+U32 disassembleInstruction(U32 instruction, char *buffer, U32 registerCount)
+{
+    const ISAInstructionInfo *info = isaLookupOpcode(ISA_OPCODE(instruction));
+    char *out = buffer;
+
+    if (info == NULL) {
+        out = disasmString(out, ".word ");
+        out = disasmHex(out, instruction, 8);
+        *out = '\0';
+        return (U32)(out - buffer);
+    }
+
+    out = disasmString(out, info->mnemonic);
+
+    for (int i=0; i<ISA_MAX_FIELDS; ++i) {
+        U32 field = (instruction >> ((ISA_MAX_FIELDS - 1 - i) * 8)) & 0xFF;
+
+        if (info->role[i] == ISA_ROLE_NONE) {
+            continue;
+        }
+
+        out = disasmString(out, (i == 0) ? " " : ", ");
+
+        if (info->role[i] == ISA_ROLE_IMM16) {
+            out = disasmHex(out, ISA_DATA16(instruction), 4);
+            break;
+        } else if (info->role[i] == ISA_ROLE_OFF8) {
+            out = disasmOffset(out, (S8)field);
+        } else {
+            out = disasmRegister(out, (U8)field, registerCount);
+        }
+    }
+
+    *out = '\0';
+
+    return (U32)(out - buffer);
+}
+
+
+/**
+ * @brief Disassembles every segment of an image in to assembly source
+ * @param image image to disassemble
+ * @param size size of image in bytes
+ * @param text location to store assembly source
+ * @param registerCount registers of the CPU profile, names pc and sp
+ * @return true if success, otherwise false
+ */
+bool disassembleImage(const U8 *image, U32 size, std::string &text,
+                      U32 registerCount)
+{
+    std::vector<ImageSegment> segments;
+    char line[DISASM_MAX_LENGTH + 32];
+
+    if (!parseImage(image, size, segments)) {
+        return false;
+    }
+
+    text.clear();
+    text.reserve(size * 8);
+
+    if (registerCount != MAX_CPU_REGISTERS) {
+        text.append(".registers " + std::to_string(registerCount) + "\n");
+    }
+
+    for (size_t i=0; i<segments.size(); ++i) {
+        const std::vector<U8> &data = segments[i].data;
+        U32 address = segments[i].address;
+
+        if ((data.size() % CPU_INSTRUCTION_SIZE) != 0) {
+            return false;
+        }
+
+        char *out = disasmString(line, ".org ");
+        out = disasmHex(out, address, 8);
+        *out++ = '\n';
+        text.append(line, out - line);
+
+        for (size_t j=0; j<data.size(); j+=CPU_INSTRUCTION_SIZE) {
+            U32 instruction = ((U32)data[j] << 24) | ((U32)data[j+1] << 16) |
+                              ((U32)data[j+2] << 8) | (U32)data[j+3];
+
+            out = disasmString(line, "    ");
+            out += disassembleInstruction(instruction, out, registerCount);
+            do {
+                *out++ = ' ';
+            } while ((out - line) < DISASM_COMMENT_COLUMN);
+            out = disasmString(out, "; ");
+            out = disasmHex(out, address + (U32)j, 8);
+            *out++ = '\n';
+            text.append(line, out - line);
+        }
+    }
+
+    return true;
+}
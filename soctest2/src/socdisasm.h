@@ -0,0 +1,20 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the disassembler prototypes
+ */
+
+#ifndef _EWATC_SOCDISASM_H
+#define _EWATC_SOCDISASM_H
+
+#include <string>
+#include "socimage.h"
+
+// Large enough for any disassembled instruction plus terminator
+#define DISASM_MAX_LENGTH 48
+
+U32 disassembleInstruction(U32 instruction, char *buffer,
+                           U32 registerCount=MAX_CPU_REGISTERS);
+bool disassembleImage(const U8 *image, U32 size, std::string &text,
+                      U32 registerCount=MAX_CPU_REGISTERS);
+
+#endif
@@ -0,0 +1,882 @@
+/**
+ * @author Wayne Moorefield
+ * @brief GDB remote serial protocol stub, one client at a time over a
+ *        Unix socket or a loopback TCP port
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "socgdb.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+// Reasons the CPU stopped, in GDB signal numbers
+#define GDB_SIGINT  2
+#define GDB_SIGILL  4
+#define GDB_SIGTRAP 5
+#define GDB_SIGFPE  8
+#define GDB_SIGSEGV 11
+
+#ifndef _WIN32
+
+static const char hexDigits[] = "0123456789abcdef";
+
+/**
+ * @brief Converts a hex digit
+ * @return value of digit, -1 if not a hex digit
+ */
+static int gdbHexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Parses a hex number, stopping at the first non hex digit
+ * @param ptr current position, updated past the number
+ * @param value location to store number
+ * @return true if at least one digit was parsed
+ */
+static bool parseGdbHex(const char *&ptr, U32 &value)
+{
+    const char *start = ptr;
+    int digit;
+
+    value = 0;
+    while ((digit = gdbHexValue(*ptr)) >= 0) {
+        value = (value << 4) | (U32)digit;
+        ++ptr;
+    }
+
+    return (ptr != start);
+}
+
+
+/**
+ * @brief Appends a byte as two hex digits
+ */
+static void appendGdbHex8(std::string &text, U8 value)
+{
+    text += hexDigits[value >> 4];
+    text += hexDigits[value & 0xF];
+}
+
+
+/**
+ * @brief Appends a register in SoC byte order
+ */
+static void appendGdbRegister(std::string &text, U32 value)
+{
+#ifdef SOC_BIG_ENDIAN
+    for (int shift=24; shift>=0; shift-=8) {
+#else
+    for (int shift=0; shift<32; shift+=8) {
+#endif
+        appendGdbHex8(text, (U8)(value >> shift));
+    }
+}
+
+
+/**
+ * @brief Parses a register sent in SoC byte order
+ * @param ptr current position, updated past the register
+ * @param value location to store register
+ * @return true if success, otherwise false
+ */
+static bool parseGdbRegister(const char *&ptr, U32 &value)
+{
+    value = 0;
+
+    for (int i=0; i<4; ++i) {
+        int high = gdbHexValue(ptr[0]);
+        int low = (high < 0) ? -1 : gdbHexValue(ptr[1]);
+
+        if (low < 0) {
+            return false;
+        }
+
+#ifdef SOC_BIG_ENDIAN
+        value = (value << 8) | (U32)((high << 4) | low);
+#else
+        value |= (U32)((high << 4) | low) << (i * 8);
+#endif
+        ptr += 2;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Writes a whole buffer to the client
+ */
+static bool sendGdbBytes(GdbStub &stub, const char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t sent = send(stub.fd, data, length, 0);
+
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += sent;
+        length -= (size_t)sent;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Reads one character from the client, blocking. The buffer is
+ *        only refilled once every character in it was read.
+ * @return character, -1 if the connection closed
+ */
+static int readGdbChar(GdbStub &stub)
+{
+    if (stub.inputOffset >= stub.input.size()) {
+        char buffer[GDB_MAX_PACKET];
+        ssize_t received;
+
+        stub.input.clear();
+        stub.inputOffset = 0;
+
+        do {
+            received = recv(stub.fd, buffer, sizeof(buffer), 0);
+        } while ((received < 0) && (errno == EINTR));
+
+        if (received <= 0) {
+            return -1;
+        }
+
+        stub.input.assign(buffer, (size_t)received);
+    }
+
+    return (unsigned char)stub.input[stub.inputOffset++];
+}
+
+
+/**
+ * @brief Sends a packet, waiting for the client to acknowledge it
+ * @param stub GDB session
+ * @param payload packet contents
+ * @return true if success, otherwise false
+ */
+static bool sendGdbPacket(GdbStub &stub, const std::string &payload)
+{
+    std::string packet;
+    U8 checksum = 0;
+
+    packet.reserve(payload.size() + 4);
+    packet += '$';
+    for (size_t i=0; i<payload.size(); ++i) {
+        checksum += (U8)payload[i];
+    }
+    packet += payload;
+    packet += '#';
+    appendGdbHex8(packet, checksum);
+
+    for (;;) {
+        if (!sendGdbBytes(stub, packet.data(), packet.size())) {
+            return false;
+        }
+
+        if (stub.noAck) {
+            return true;
+        }
+
+        int c;
+        do {
+            c = readGdbChar(stub);
+        } while ((c != '+') && (c != '-') && (c >= 0));
+
+        if (c != '-') {
+            return (c == '+');
+        }
+    }
+}
+
+
+/**
+ * @brief Receives the next packet, bad packets are asked for again.
+ *        Packets longer than the PacketSize given in qSupported are
+ *        dropped and asked for again.
+ * @param stub GDB session
+ * @param packet location to store packet contents, a lone interrupt
+ *               is returned as "\x03"
+ * @return true if success, false if the connection closed
+ */
+static bool readGdbPacket(GdbStub &stub, std::string &packet)
+{
+    int c;
+
+    for (;;) {
+        do {
+            c = readGdbChar(stub);
+            if (c == 0x03) {
+                packet = "\x03";
+                return true;
+            }
+        } while ((c != '$') && (c >= 0));
+
+        if (c < 0) {
+            return false;
+        }
+
+        U8 checksum = 0;
+        bool tooLong = false;
+
+        packet.clear();
+        while (((c = readGdbChar(stub)) != '#') && (c >= 0)) {
+            if (packet.size() < GDB_MAX_PACKET) {
+                packet += (char)c;
+            } else {
+                tooLong = true;
+            }
+            checksum += (U8)c;
+        }
+
+        int high = gdbHexValue((char)readGdbChar(stub));
+        int low = gdbHexValue((char)readGdbChar(stub));
+
+        if ((high < 0) || (low < 0)) {
+            return false;
+        }
+
+        if (stub.noAck) {
+            if (!tooLong) {
+                return true;
+            }
+            continue;
+        }
+
+        if (!tooLong && (checksum == (U8)((high << 4) | low))) {
+            return sendGdbBytes(stub, "+", 1);
+        }
+
+        if (!sendGdbBytes(stub, "-", 1)) {
+            return false;
+        }
+    }
+}
+
+
+/**
+ * @brief Checks for an interrupt from the client without blocking,
+ *        up to GDB_MAX_PACKET other bytes are kept for readGdbPacket
+ * @param stub GDB session
+ * @return true if the client wants the CPU stopped
+ */
+static bool pollGdbInterrupt(GdbStub &stub)
+{
+    char buffer[GDB_MAX_PACKET];
+    ssize_t received = recv(stub.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (received == 0) {
+        // Client went away, stop so the session can end
+        return true;
+    }
+
+    stub.input.erase(0, stub.inputOffset);
+    stub.inputOffset = 0;
+
+    if (received > 0) {
+        stub.input.append(buffer, (size_t)received);
+    }
+
+    size_t pos = stub.input.find('\x03');
+    if (pos != std::string::npos) {
+        stub.input.erase(pos, 1);
+    }
+
+    // GDB waits for the stop reply, anything past a packet is dropped
+    // and fails its checksum, so GDB sends it again
+    if (stub.input.size() > GDB_MAX_PACKET) {
+        stub.input.resize(GDB_MAX_PACKET);
+    }
+
+    return (pos != std::string::npos);
+}
+
+
+/**
+ * @brief Builds the reply telling GDB why the CPU stopped
+ * @param stub GDB session
+ * @param signal signal to report when no debug point was hit
+ * @return stop reply packet
+ */
+static std::string gdbStopReply(GdbStub &stub, int signal)
+{
+    char reply[64];
+    const DebugHit &hit = stub.debug.hit;
+
+    if (!hit.hit) {
+        snprintf(reply, sizeof(reply), "S%02x", signal);
+    } else if (hit.kind == DEBUG_BREAK_EXECUTE) {
+        snprintf(reply, sizeof(reply), "T%02xswbreak:;", GDB_SIGTRAP);
+    } else {
+        snprintf(reply, sizeof(reply), "T%02x%s:%x;", GDB_SIGTRAP,
+                 (hit.kind == DEBUG_WATCH_WRITE) ? "watch" : "rwatch",
+                 hit.address);
+    }
+
+    return reply;
+}
+
+
+/**
+ * @brief Returns the signal of the fault that stopped the CPU
+ * @param ctx CPU Context
+ * @return GDB signal number
+ */
+static int gdbFaultSignal(const CPUContext &ctx)
+{
+    switch (ctx.fault.kind) {
+    case CPU_FAULT_FETCH:
+    case CPU_FAULT_READ:
+    case CPU_FAULT_WRITE:
+        return GDB_SIGSEGV;
+    case CPU_FAULT_DIVIDE:
+        return GDB_SIGFPE;
+    default:
+        return GDB_SIGILL;
+    }
+}
+
+
+/**
+ * @brief Runs the CPU for a step or until something stops it. While
+ *        continuing the socket is only polled every GDB_POLL_BUDGET
+ *        instructions, and the normal executor is used when there are
+ *        no debug points.
+ * @param stub GDB session
+ * @param step true to execute one instruction
+ * @return stop reply packet
+ */
+static std::string resumeGdb(GdbStub &stub, bool step)
+{
+    CPUExecuteFunction execute = stub.debug.points.empty() ?
+                                     stub.execute : stub.executeDebug;
+    CPUContext &ctx = *stub.ctx;
+    Memory &mem = *stub.mem;
+
+    resumeDebug(stub.debug);
+    ctx.fault.kind = CPU_FAULT_NONE;
+
+    // Only the debug executor clears stepOver, so it is only set when
+    // that executor runs. A breakpoint at pc must not stop a step.
+    stub.debug.stepOver = (execute == stub.executeDebug) &&
+                          (step || stub.debug.stepOver);
+
+    if (step) {
+        if (!execute(ctx, mem)) {
+            return gdbStopReply(stub, gdbFaultSignal(ctx));
+        }
+
+        return gdbStopReply(stub, GDB_SIGTRAP);
+    }
+
+    for (;;) {
+        for (U32 i=0; i<GDB_POLL_BUDGET; ++i) {
+            if (!execute(ctx, mem)) {
+                return gdbStopReply(stub, gdbFaultSignal(ctx));
+            }
+        }
+
+        if (pollGdbInterrupt(stub)) {
+            return gdbStopReply(stub, GDB_SIGINT);
+        }
+    }
+}
+
+
+/**
+ * @brief Builds the target description, one 32-bit register per
+ *        register of the profile
+ */
+static std::string gdbTargetDescription(U32 registerCount)
+{
+    std::string xml =
+        "<?xml version=\"1.0\"?>\n"
+        "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+        "<target version=\"1.0\">\n"
+        "<feature name=\"org.soctest2.cpu\">\n";
+
+    for (U32 i=0; i<registerCount - 2; ++i) {
+        xml += "<reg name=\"r" + std::to_string(i) +
+               "\" bitsize=\"32\" type=\"uint32\"/>\n";
+    }
+    xml += "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>\n";
+    xml += "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>\n";
+    xml += "</feature>\n</target>\n";
+
+    return xml;
+}
+
+
+/**
+ * @brief Handles a Z or z packet
+ * @return reply packet
+ */
+static std::string handleGdbDebugPoint(GdbStub &stub, const char *ptr)
+{
+    bool insert = (*ptr++ == 'Z');
+    char type = *ptr++;
+    U32 address;
+    U32 length;
+
+    if ((*ptr++ != ',') || !parseGdbHex(ptr, address) ||
+        (*ptr++ != ',') || !parseGdbHex(ptr, length)) {
+        return "E01";
+    }
+
+    U32 kinds[2];
+    int count = 0;
+    U32 last = address;
+
+    switch (type) {
+    case '0':   // software breakpoint
+    case '1':   // hardware breakpoint
+        kinds[count++] = DEBUG_BREAK_EXECUTE;
+        break;
+    case '2':   // write watchpoint
+        kinds[count++] = DEBUG_WATCH_WRITE;
+        break;
+    case '3':   // read watchpoint
+        kinds[count++] = DEBUG_WATCH_READ;
+        break;
+    case '4':   // access watchpoint
+        kinds[count++] = DEBUG_WATCH_READ;
+        kinds[count++] = DEBUG_WATCH_WRITE;
+        break;
+    default:
+        return "";
+    }
+
+    if ((kinds[0] != DEBUG_BREAK_EXECUTE) && (length > 0)) {
+        last = address + length - 1;
+    }
+
+    for (int i=0; i<count; ++i) {
+        bool ok = insert ?
+                      addDebugPoint(stub.debug, kinds[i], address, last) :
+                      removeDebugPoint(stub.debug, kinds[i], address, last);
+
+        if (!ok) {
+            return "E01";
+        }
+    }
+
+    return "OK";
+}
+
+
+/**
+ * @brief Handles one packet
+ * @param stub GDB session
+ * @param packet packet contents
+ * @param reply location to store reply
+ * @param done set when the session ends
+ * @return true if reply must be sent
+ */
+static bool handleGdbPacket(GdbStub &stub, const std::string &packet,
+                            std::string &reply, bool &done)
+{
+    CPUContext &ctx = *stub.ctx;
+    Memory &mem = *stub.mem;
+    const char *ptr = packet.c_str();
+    U32 regIndex;
+    U32 address;
+    U32 length;
+    U32 value;
+
+    reply.clear();
+
+    switch (*ptr++) {
+    case '?':
+        reply = stub.stopReply;
+        break;
+
+    case 'g':
+        for (U32 i=0; i<ctx.registerCount; ++i) {
+            appendGdbRegister(reply, ctx.reg[i]);
+        }
+        break;
+
+    case 'G':
+        {
+            // Nothing is written unless every register parses
+            U32 regs[CPU_REGISTER_FILE_SIZE];
+            U32 count = 0;
+
+            while ((count < ctx.registerCount) &&
+                   parseGdbRegister(ptr, regs[count])) {
+                ++count;
+            }
+
+            if ((count != ctx.registerCount) || (*ptr != '\0')) {
+                reply = "E01";
+            } else {
+                memcpy(ctx.reg, regs, count * sizeof(ctx.reg[0]));
+                reply = "OK";
+            }
+        }
+        break;
+
+    case 'p':
+        if (!parseGdbHex(ptr, regIndex) || (regIndex >= ctx.registerCount)) {
+            reply = "E01";
+        } else {
+            appendGdbRegister(reply, ctx.reg[regIndex]);
+        }
+        break;
+
+    case 'P':
+        if (!parseGdbHex(ptr, regIndex) || (*ptr++ != '=') ||
+            (regIndex >= ctx.registerCount) ||
+            !parseGdbRegister(ptr, value)) {
+            reply = "E01";
+        } else {
+            ctx.reg[regIndex] = value;
+            reply = "OK";
+        }
+        break;
+
+    case 'm':
+        if (!parseGdbHex(ptr, address) || (*ptr++ != ',') ||
+            !parseGdbHex(ptr, length) || (length > GDB_MAX_PACKET / 2)) {
+            reply = "E01";
+        } else {
+            std::vector<U8> bytes(length);
+
+            if (!readMemoryBlock(mem, address, bytes.data(), length)) {
+                reply = "E01";
+            } else {
+                for (U32 i=0; i<length; ++i) {
+                    appendGdbHex8(reply, bytes[i]);
+                }
+            }
+        }
+        break;
+
+    case 'M':
+        if (!parseGdbHex(ptr, address) || (*ptr++ != ',') ||
+            !parseGdbHex(ptr, length) || (*ptr++ != ':') ||
+            (strlen(ptr) != (size_t)length * 2)) {
+            reply = "E01";
+        } else {
+            // Memory is only written once every digit is valid
+            std::vector<U8> bytes(length);
+            U32 parsed = 0;
+
+            for (; parsed<length; ++parsed, ptr+=2) {
+                int high = gdbHexValue(ptr[0]);
+                int low = gdbHexValue(ptr[1]);
+
+                if ((high < 0) || (low < 0)) {
+                    break;
+                }
+                bytes[parsed] = (U8)((high << 4) | low);
+            }
+
+            reply = ((parsed == length) &&
+                     writeMemoryBlock(mem, address, bytes.data(), length)) ?
+                        "OK" : "E01";
+        }
+        break;
+
+    case 'c':
+    case 's':
+        // Resume address is optional
+        if (parseGdbHex(ptr, address)) {
+            ctx.reg[CPU_PC_INDEX(ctx.registerCount)] = address;
+        }
+        reply = resumeGdb(stub, packet[0] == 's');
+        stub.stopReply = reply;
+        break;
+
+    case 'b':
+        // Reverse step and continue
+        if (stub.history == NULL) {
+            break;
+        }
+        if (*ptr == 's') {
+            reply = reverseStep(*stub.history, ctx, mem) ?
+                        "S05" : "T05replaylog:begin;";
+        } else if (*ptr == 'c') {
+            reply = reverseContinue(*stub.history, ctx, mem) ?
+                        gdbStopReply(stub, GDB_SIGTRAP) :
+                        "T05replaylog:begin;";
+        } else {
+            break;
+        }
+        stub.stopReply = reply;
+        break;
+
+    case 'Z':
+    case 'z':
+        reply = handleGdbDebugPoint(stub, packet.c_str());
+        break;
+
+    case 'H':
+        reply = "OK";
+        break;
+
+    case 'k':
+        // Kill has no reply
+        done = true;
+        return false;
+
+    case 'D':
+        reply = "OK";
+        done = true;
+        break;
+
+    case 'q':
+        if (packet.compare(0, 10, "qSupported") == 0) {
+            char supported[96];
+
+            snprintf(supported, sizeof(supported),
+                     "PacketSize=%x;qXfer:features:read+;swbreak+;"
+                     "QStartNoAckMode+", GDB_MAX_PACKET);
+            reply = supported;
+            if (stub.history != NULL) {
+                reply += ";ReverseStep+;ReverseContinue+";
+            }
+        } else if (packet.compare(0, 31,
+                                  "qXfer:features:read:target.xml:") == 0) {
+            std::string xml = gdbTargetDescription(ctx.registerCount);
+
+            ptr = packet.c_str() + 31;
+            if (!parseGdbHex(ptr, address) || (*ptr++ != ',') ||
+                !parseGdbHex(ptr, length)) {
+                reply = "E01";
+            } else if (address >= xml.size()) {
+                reply = "l";
+            } else {
+                std::string part = xml.substr(address, length);
+
+                reply = ((address + part.size() < xml.size()) ? "m" : "l") +
+                        part;
+            }
+        } else if (packet == "qAttached") {
+            reply = "1";
+        } else if (packet == "qC") {
+            reply = "QC1";
+        } else if (packet == "qfThreadInfo") {
+            reply = "m1";
+        } else if (packet == "qsThreadInfo") {
+            reply = "l";
+        }
+        break;
+
+    case 'Q':
+        if (packet == "QStartNoAckMode") {
+            // Last acknowledged packet, the reply is still acknowledged
+            sendGdbPacket(stub, "OK");
+            stub.noAck = true;
+            return false;
+        }
+        break;
+
+    case '\x03':
+        reply = gdbStopReply(stub, GDB_SIGINT);
+        break;
+
+    default:
+        // Empty reply tells GDB the packet is not supported
+        break;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Opens the socket GDB connects to
+ * @param stub GDB session
+ * @param address "unix:<path>" or a loopback TCP port
+ * @return true if success, otherwise false
+ */
+bool openGdbStub(GdbStub &stub, const char *address)
+{
+    stub.listenFd = -1;
+    stub.fd = -1;
+    stub.noAck = false;
+    stub.input.clear();
+    stub.inputOffset = 0;
+    stub.history = NULL;
+    resetDebugState(stub.debug);
+
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        const char *path = address + 5;
+
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+            return false;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        unlink(path);
+
+        stub.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ((stub.listenFd < 0) ||
+            (bind(stub.listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0)) {
+            closeGdbStub(stub);
+            return false;
+        }
+    } else {
+        struct sockaddr_in addr;
+        int reuse = 1;
+        char *end;
+        unsigned long port = strtoul(address, &end, 0);
+
+        if ((*end != '\0') || (port == 0) || (port > 0xFFFF)) {
+            return false;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((U16)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        stub.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if ((stub.listenFd < 0) ||
+            (setsockopt(stub.listenFd, SOL_SOCKET, SO_REUSEADDR,
+                        &reuse, sizeof(reuse)) != 0) ||
+            (bind(stub.listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0)) {
+            closeGdbStub(stub);
+            return false;
+        }
+    }
+
+    if (listen(stub.listenFd, 1) != 0) {
+        closeGdbStub(stub);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Closes the client connection and the listening socket
+ * @param stub GDB session
+ */
+void closeGdbStub(GdbStub &stub)
+{
+    if (stub.fd >= 0) {
+        close(stub.fd);
+        stub.fd = -1;
+    }
+
+    if (stub.listenFd >= 0) {
+        close(stub.listenFd);
+        stub.listenFd = -1;
+    }
+}
+
+
+/**
+ * @brief Waits for GDB to connect and serves it until it detaches,
+ *        kills the program or disconnects
+ * @param stub GDB session opened with openGdbStub
+ * @param ctx CPU Context, already reset and loaded
+ * @param mem Memory, already reset and loaded
+ * @param profile CPU profile ctx was reset with
+ * @return true if success, otherwise false
+ */
+bool runGdbStub(GdbStub &stub, CPUContext &ctx, Memory &mem,
+                const CPUProfile &profile)
+{
+    std::string packet;
+    std::string reply;
+    bool done = false;
+
+    U32 features = ((stub.history != NULL) ? CPU_EXECUTE_RECORD : 0) |
+                   ((ctx.trace != NULL) ? CPU_EXECUTE_TRACE : 0);
+
+    stub.execute = selectCPUExecutor(profile, features);
+    stub.executeDebug = selectCPUExecutor(profile,
+                                          features | CPU_EXECUTE_DEBUG);
+    if ((stub.execute == NULL) || (stub.executeDebug == NULL)) {
+        return false;
+    }
+
+    do {
+        stub.fd = accept(stub.listenFd, NULL, NULL);
+    } while ((stub.fd < 0) && (errno == EINTR));
+
+    if (stub.fd < 0) {
+        return false;
+    }
+
+    stub.ctx = &ctx;
+    stub.mem = &mem;
+    stub.stopReply = "S05";
+    ctx.debug = &stub.debug;
+    ctx.history = stub.history;
+
+    while (!done && readGdbPacket(stub, packet)) {
+        if (handleGdbPacket(stub, packet, reply, done) &&
+            !sendGdbPacket(stub, reply)) {
+            break;
+        }
+    }
+
+    ctx.debug = NULL;
+    ctx.history = NULL;
+    close(stub.fd);
+    stub.fd = -1;
+
+    return true;
+}
+
+#else
+
+// Sockets are only implemented for POSIX hosts
+
+bool openGdbStub(GdbStub &stub, const char *address)
+{
+    stub.listenFd = -1;
+    stub.fd = -1;
+    stub.history = NULL;
+
+    return false;
+}
+
+void closeGdbStub(GdbStub &stub)
+{
+}
+
+bool runGdbStub(GdbStub &stub, CPUContext &ctx, Memory &mem,
+                const CPUProfile &profile)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the GDB remote serial protocol stub
+ */
+
+#ifndef _EWATC_SOCGDB_H
+#define _EWATC_SOCGDB_H
+
+#include <string>
+#include "socbasic.h"
+#include "socdebug.h"
+#include "socreverse.h"
+
+// Instructions executed between checks for a GDB interrupt while
+// continuing, the socket is not touched in between
+#define GDB_POLL_BUDGET 0x10000
+
+#define GDB_MAX_PACKET  0x1000
+
+/**
+ * @brief One GDB session controlling one SoC. Registers are numbered
+ *        as in CPUContext, pc and sp are the last two, and are sent in
+ *        SoC byte order.
+ */
+struct GdbStub
+{
+    int listenFd;
+    int fd;
+
+    CPUContext *ctx;
+    Memory *mem;
+    CPUExecuteFunction execute;         // used without breakpoints
+    CPUExecuteFunction executeDebug;    // used with breakpoints
+    DebugState debug;
+    ReverseHistory *history;            // NULL if the run is not recorded
+
+    bool noAck;
+    std::string input;                  // received, parsed up to offset
+    size_t inputOffset;
+    std::string stopReply;              // why the CPU last stopped
+};
+
+bool openGdbStub(GdbStub &stub, const char *address);
+void closeGdbStub(GdbStub &stub);
+bool runGdbStub(GdbStub &stub, CPUContext &ctx, Memory &mem,
+                const CPUProfile &profile);
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Program image functions
+ */
+
+#include <stdio.h>
+#include "socimage.h"
+
+
+/**
+ * @brief reads a big endian 32-bit value from a byte stream
+ * @param ptr location to read from
+ * @return value read
+ */
+static U32 readImageU32(const U8 *ptr)
+{
+    return ((U32)ptr[0] << 24) | ((U32)ptr[1] << 16) |
+           ((U32)ptr[2] << 8)  | (U32)ptr[3];
+}
+
+
+/**
+ * @brief appends a big endian 32-bit value to a byte stream
+ * @param image stream to append to
+ * @param value value to append
+ */
+static void appendImageU32(std::vector<U8> &image, U32 value)
+{
+    image.push_back((U8)(value >> 24));
+    image.push_back((U8)(value >> 16));
+    image.push_back((U8)(value >> 8));
+    image.push_back((U8)value);
+}
+
+
+/**
+ * @brief Walks the segments of an image, validating the layout
+ * @param image image to walk
+ * @param size size of image in bytes
+ * @param visit called with address, data and length of each segment,
+ *              returning false stops the walk
+ * @return true if the image is valid and every visit succeeded
+ */
+template <typename Visitor>
+static bool walkImage(const U8 *image, U32 size, Visitor visit)
+{
+    if ((image == NULL) || (size < IMAGE_HEADER_SIZE)) {
+        return false;
+    }
+
+    if (readImageU32(image) != IMAGE_MAGIC) {
+        return false;
+    }
+
+    U32 count = readImageU32(image + 4);
+    U32 offset = IMAGE_HEADER_SIZE;
+
+    for (U32 i=0; i<count; ++i) {
+        if ((size - offset) < IMAGE_SEGMENT_SIZE) {
+            return false;
+        }
+
+        U32 address = readImageU32(image + offset);
+        U32 length = readImageU32(image + offset + 4);
+        offset += IMAGE_SEGMENT_SIZE;
+
+        if ((size - offset) < length) {
+            return false;
+        }
+
+        if (!visit(address, image + offset, length)) {
+            return false;
+        }
+        offset += length;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Builds a binary image out of segments
+ * @param segments segments to store in the image
+ * @param image location to store image
+ * @return true if success, otherwise false
+ */
+bool buildImage(const std::vector<ImageSegment> &segments,
+                std::vector<U8> &image)
+{
+    size_t total = IMAGE_HEADER_SIZE;
+
+    for (size_t i=0; i<segments.size(); ++i) {
+        total += IMAGE_SEGMENT_SIZE + segments[i].data.size();
+    }
+
+    image.clear();
+    image.reserve(total);
+
+    appendImageU32(image, IMAGE_MAGIC);
+    appendImageU32(image, (U32)segments.size());
+
+    for (size_t i=0; i<segments.size(); ++i) {
+        appendImageU32(image, segments[i].address);
+        appendImageU32(image, (U32)segments[i].data.size());
+        image.insert(image.end(),
+                     segments[i].data.begin(), segments[i].data.end());
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Splits a binary image in to its segments
+ * @param image image to parse
+ * @param size size of image in bytes
+ * @param segments location to store segments
+ * @return true if success, otherwise false
+ */
+bool parseImage(const U8 *image, U32 size,
+                std::vector<ImageSegment> &segments)
+{
+    segments.clear();
+
+    return walkImage(image, size,
+                     [&segments](U32 address, const U8 *data, U32 length) {
+        ImageSegment segment;
+
+        segment.address = address;
+        segment.data.assign(data, data + length);
+        segments.push_back(segment);
+
+        return true;
+    });
+}
+
+
+/**
+ * @brief Loads a binary image in to memory
+ * @param mem memory to load image in to
+ * @param image image to load
+ * @param size size of image in bytes
+ * @return true if success, otherwise false
+ */
+bool loadImage(Memory &mem, const U8 *image, U32 size)
+{
+    return walkImage(image, size,
+                     [&mem](U32 address, const U8 *data, U32 length) {
+        return writeMemoryBlock(mem, address, data, length);
+    });
+}
+
+
+/**
+ * @brief Loads a binary image file in to memory
+ * @param mem memory to load image in to
+ * @param path file containing image
+ * @return true if success, otherwise false
+ */
+bool loadImageFile(Memory &mem, const char *path)
+{
+    std::vector<U8> image;
+
+    if (!readFile(path, image)) {
+        return false;
+    }
+
+    return loadImage(mem, image.data(), (U32)image.size());
+}
+
+
+/**
+ * @brief Reads a whole file
+ * @param path file to read
+ * @param contents location to store contents of file
+ * @return true if success, otherwise false
+ */
+bool readFile(const char *path, std::vector<U8> &contents)
+{
+    bool retval = false;
+    FILE *fp = fopen(path, "rb");
+
+    if (fp != NULL) {
+        if (fseek(fp, 0, SEEK_END) == 0) {
+            long length = ftell(fp);
+
+            if ((length >= 0) && (fseek(fp, 0, SEEK_SET) == 0)) {
+                contents.resize((size_t)length);
+
+                if (fread(contents.data(), 1, contents.size(), fp) ==
+                    contents.size()) {
+                    retval = true;
+                }
+            }
+        }
+
+        fclose(fp);
+    }
+
+    return retval;
+}
+
+
+/**
+ * @brief Writes a whole file
+ * @param path file to write
+ * @param contents data to write
+ * @return true if success, otherwise false
+ */
+bool writeFile(const char *path, const std::vector<U8> &contents)
+{
+    bool retval = false;
+    FILE *fp = fopen(path, "wb");
+
+    if (fp != NULL) {
+        if (fwrite(contents.data(), 1, contents.size(), fp) ==
+            contents.size()) {
+            retval = true;
+        }
+
+        if (fclose(fp) != 0) {
+            retval = false;
+        }
+    }
+
+    return retval;
+}
@@ -0,0 +1,40 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file describes the binary program image format
+ */
+
+#ifndef _EWATC_SOCIMAGE_H
+#define _EWATC_SOCIMAGE_H
+
+#include <vector>
+#include "socbasic.h"
+
+// Image layout, every field is stored big endian:
+//   U32 magic ('SOCI')
+//   U32 number of segments
+//   for each segment:
+//       U32 load address
+//       U32 length in bytes
+//       U8  data[length], stored in SoC memory order
+#define IMAGE_MAGIC         0x534F4349
+#define IMAGE_HEADER_SIZE   8
+#define IMAGE_SEGMENT_SIZE  8
+
+struct ImageSegment
+{
+    U32 address;
+    std::vector<U8> data;
+};
+
+bool buildImage(const std::vector<ImageSegment> &segments,
+                std::vector<U8> &image);
+bool parseImage(const U8 *image, U32 size,
+                std::vector<ImageSegment> &segments);
+
+bool loadImage(Memory &mem, const U8 *image, U32 size);
+bool loadImageFile(Memory &mem, const char *path);
+
+bool readFile(const char *path, std::vector<U8> &contents);
+bool writeFile(const char *path, const std::vector<U8> &contents);
+
+#endif
@@ -0,0 +1,643 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Shared memory job server functions
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include <soc/memutil.h>
+#include "socipc.h"
+#include "socimage.h"
+#include "socsim.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// A waiting thread spins this many times, then yields, then sleeps
+#define IPC_SPIN_COUNT      1000
+#define IPC_YIELD_COUNT     100
+#define IPC_SLEEP_US        100
+
+
+/**
+ * @brief Returns the hash clients name an image by
+ * @param image image, as passed to loadImage
+ * @param size size of image in bytes
+ * @return hash of image
+ */
+U64 hashSimImage(const U8 *image, U32 size)
+{
+    return soc::memoryHash(image, size);
+}
+
+#ifndef _WIN32
+
+/**
+ * @brief Backs off a little more each time nothing was ready
+ * @param idle times nothing was ready in a row, updated
+ */
+static void waitIpcBackoff(U32 &idle)
+{
+    ++idle;
+
+    if (idle < IPC_SPIN_COUNT) {
+        return;
+    }
+    if (idle < (IPC_SPIN_COUNT + IPC_YIELD_COUNT)) {
+        std::this_thread::yield();
+        return;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(IPC_SLEEP_US));
+}
+
+
+/**
+ * @brief Makes a ring empty
+ * @param ring ring in shared memory
+ */
+static void resetIpcRing(IpcRing &ring)
+{
+    for (U32 i=0; i<IPC_SLOT_COUNT; ++i) {
+        ring.cells[i].sequence.store(i, std::memory_order_relaxed);
+        ring.cells[i].slot = 0;
+    }
+
+    ring.head.store(0, std::memory_order_relaxed);
+    ring.tail.store(0, std::memory_order_relaxed);
+}
+
+
+/**
+ * @brief Adds a slot index to a ring
+ * @param ring ring in shared memory
+ * @param slot slot index
+ * @return true if success, false if the ring is full
+ */
+static bool pushIpcRing(IpcRing &ring, U32 slot)
+{
+    U64 position = ring.head.load(std::memory_order_relaxed);
+
+    for (;;) {
+        IpcRing::Cell &cell = ring.cells[position & (IPC_SLOT_COUNT - 1)];
+        U64 sequence = cell.sequence.load(std::memory_order_acquire);
+        S64 diff = (S64)(sequence - position);
+
+        if (diff == 0) {
+            if (ring.head.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                cell.slot = slot;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            position = ring.head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+/**
+ * @brief Takes the oldest slot index off a ring
+ * @param ring ring in shared memory
+ * @param slot location to store slot index
+ * @return true if success, false if the ring is empty
+ */
+static bool popIpcRing(IpcRing &ring, U32 &slot)
+{
+    U64 position = ring.tail.load(std::memory_order_relaxed);
+
+    for (;;) {
+        IpcRing::Cell &cell = ring.cells[position & (IPC_SLOT_COUNT - 1)];
+        U64 sequence = cell.sequence.load(std::memory_order_acquire);
+        S64 diff = (S64)(sequence - (position + 1));
+
+        if (diff == 0) {
+            if (ring.tail.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                slot = cell.slot;
+                cell.sequence.store(position + IPC_SLOT_COUNT,
+                                    std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            position = ring.tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+/**
+ * @brief Checks whether an existing shared memory object was left
+ *        behind by a server that is gone, e.g. one that crashed
+ * @param name POSIX shared memory name
+ * @return true if no live server owns it, otherwise false
+ */
+static bool isStaleIpcRegion(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat info;
+
+    if (fd < 0) {
+        // Removed in the meantime, nothing to recover
+        return (errno == ENOENT);
+    }
+
+    if ((fstat(fd, &info) != 0) || (info.st_size != sizeof(IpcRegion))) {
+        close(fd);
+        return true;
+    }
+
+    void *base = mmap(NULL, sizeof(IpcRegion), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const IpcRegion &region = *(const IpcRegion*)base;
+    bool stale = (memcmp(region.magic, IPC_MAGIC,
+                         sizeof(region.magic)) != 0) ||
+                 (region.version != IPC_VERSION) ||
+                 (region.running.load(std::memory_order_acquire) == 0) ||
+                 ((kill((pid_t)region.serverPid, 0) != 0) &&
+                  (errno == ESRCH));
+
+    munmap(base, sizeof(IpcRegion));
+
+    return stale;
+}
+
+
+/**
+ * @brief Maps the shared memory object of a server
+ * @param name POSIX shared memory name, e.g. "/socsim"
+ * @param create true to create it, an object left behind by a server
+ *               that is gone is removed first
+ * @return region, NULL if it could not be mapped or a live server owns
+ *         the name
+ */
+static IpcRegion *mapIpcRegion(const char *name, bool create)
+{
+    int flags = create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR;
+    int fd = shm_open(name, flags, 0600);
+
+    if (create && (fd < 0) && (errno == EEXIST) && isStaleIpcRegion(name)) {
+        shm_unlink(name);
+        fd = shm_open(name, flags, 0600);
+    }
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (create && (ftruncate(fd, sizeof(IpcRegion)) != 0)) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, sizeof(IpcRegion), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        if (create) {
+            shm_unlink(name);
+        }
+        return NULL;
+    }
+
+    return (IpcRegion*)base;
+}
+
+
+/**
+ * @brief Runs one job on a worker's instance
+ * @param server server
+ * @param instance SoC of the calling worker
+ * @param job job to run
+ * @param result location to store result
+ */
+static void runIpcSlot(const IpcServer &server, SoCInstance &instance,
+                       const IpcJob &job, IpcResult &result)
+{
+    const IpcImage *image = NULL;
+
+    memset(&result, 0, offsetof(IpcResult, reg));
+
+    for (size_t i=0; i<server.loaded.size(); ++i) {
+        if (server.loaded[i].hash == job.imageHash) {
+            image = &server.loaded[i];
+            break;
+        }
+    }
+    if (image == NULL) {
+        result.status = IPC_RESULT_NO_IMAGE;
+        return;
+    }
+
+    if ((job.registerCount > IPC_MAX_REGISTERS) ||
+        (job.inputLength > IPC_MAX_INPUT) ||
+        (job.outputLength > IPC_MAX_OUTPUT) ||
+        (job.outputAddress > MEMORY_SIZE) ||
+        (job.outputLength > (MEMORY_SIZE - job.outputAddress))) {
+        result.status = IPC_RESULT_INVALID;
+        return;
+    }
+
+    // Start from the state right after the image was loaded
+    instance = *image->snapshot;
+
+    CPUContext &ctx = instance.ctx;
+
+    for (U32 i=0; i<job.registerCount; ++i) {
+        if (job.registers[i].index >= ctx.registerCount) {
+            result.status = IPC_RESULT_INVALID;
+            return;
+        }
+        ctx.reg[job.registers[i].index] = job.registers[i].value;
+    }
+
+    if ((job.inputLength != 0) &&
+        !writeMemoryBlock(instance.mem, job.inputAddress, job.input,
+                          job.inputLength)) {
+        result.status = IPC_RESULT_INVALID;
+        return;
+    }
+
+    IdleLoop idle;
+    U32 pcIndex = CPU_PC_INDEX(ctx.registerCount);
+
+    resetIdleLoop(idle);
+
+    // Firmware waiting on an idle loop uses its budget up without
+    // interpreting it
+    result.status = IPC_RESULT_OK;
+    result.reason = SIM_STOP_LIMIT;
+    while (result.ran < job.budget) {
+        U32 oldPC = ctx.reg[pcIndex];
+
+        if (!stepCPU(ctx, instance.mem, server.execute,
+                     job.budget - result.ran, result.ran)) {
+            result.reason = SIM_STOP_FINISHED;
+            break;
+        }
+
+        if (checkIdleLoop(idle, ctx, instance.mem, oldPC)) {
+            result.ran += skipIdleLoop(idle, ctx, job.budget - result.ran);
+        }
+    }
+
+    result.instructionCount = ctx.instructionCount;
+    result.cycleCount = ctx.cycleCount;
+    result.fault = ctx.fault;
+    result.registerCount = ctx.registerCount;
+    memcpy(result.reg, ctx.reg, ctx.registerCount * sizeof(ctx.reg[0]));
+    readMemoryBlock(instance.mem, job.outputAddress, result.output,
+                    job.outputLength);
+}
+
+
+/**
+ * @brief Takes jobs off the submit ring until the server is stopped
+ * @param server server
+ */
+static void runIpcWorker(IpcServer *server)
+{
+    // One arena per worker thread, its SoC is on the worker's node
+    InstanceArena arena(1);
+    SoCInstance *instance = arena.acquire();
+    IpcRegion &region = *server->region;
+    U32 idle = 0;
+
+    if (instance == NULL) {
+        return;
+    }
+
+    while (region.running.load(std::memory_order_acquire) != 0) {
+        U32 index;
+
+        if (!popIpcRing(region.submitRing, index) ||
+            (index >= IPC_SLOT_COUNT)) {
+            waitIpcBackoff(idle);
+            continue;
+        }
+        idle = 0;
+
+        IpcSlot &slot = region.slots[index];
+
+        runIpcSlot(*server, *instance, slot.job, slot.result);
+        slot.state.store(IPC_SLOT_DONE, std::memory_order_release);
+    }
+
+    arena.release(instance);
+}
+
+
+/**
+ * @brief Creates the shared memory object of a server. Images are
+ *        added with addIpcImage before serveIpc.
+ * @param server server to open
+ * @param name POSIX shared memory name, e.g. "/socsim", no running
+ *             server may be using it
+ * @param profile CPU profile every job runs with
+ * @return true if success, otherwise false
+ */
+bool openIpcServer(IpcServer &server, const char *name,
+                   const CPUProfile &profile)
+{
+    server.name = name;
+    server.profile = profile;
+    server.execute = selectCPUExecutor(profile, CPU_EXECUTE_FUSE);
+    server.images = NULL;
+    server.region = NULL;
+
+    if (server.execute == NULL) {
+        return false;
+    }
+
+    server.region = mapIpcRegion(name, true);
+    if (server.region == NULL) {
+        return false;
+    }
+
+    IpcRegion &region = *server.region;
+
+    region.version = IPC_VERSION;
+    region.slotCount = IPC_SLOT_COUNT;
+    region.serverPid = (U32)getpid();
+    region.running.store(1, std::memory_order_relaxed);
+    resetIpcRing(region.freeRing);
+    resetIpcRing(region.submitRing);
+    for (U32 i=0; i<IPC_SLOT_COUNT; ++i) {
+        region.slots[i].state.store(IPC_SLOT_FREE, std::memory_order_relaxed);
+        pushIpcRing(region.freeRing, i);
+    }
+
+    // Clients only use the region once the magic is there
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(region.magic, IPC_MAGIC, sizeof(region.magic));
+
+    server.images = new InstanceArena();
+
+    return true;
+}
+
+
+/**
+ * @brief Loads an image and keeps a snapshot of the SoC right after
+ * @param server server
+ * @param image image, clients name it by hashSimImage
+ * @param size size of image in bytes
+ * @return true if success, otherwise false
+ */
+bool addIpcImage(IpcServer &server, const U8 *image, U32 size)
+{
+    SoCInstance *snapshot = createSoCInstance(*server.images, server.profile);
+
+    if (snapshot == NULL) {
+        return false;
+    }
+
+    if (!loadImage(snapshot->mem, image, size)) {
+        destroySoCInstance(*server.images, snapshot);
+        return false;
+    }
+
+    IpcImage loaded;
+
+    loaded.hash = hashSimImage(image, size);
+    loaded.snapshot = snapshot;
+    server.loaded.push_back(loaded);
+
+    return true;
+}
+
+
+/**
+ * @brief Runs jobs until a client calls stopIpcServer
+ * @param server server
+ * @param workers threads running jobs
+ * @return true if success, otherwise false
+ */
+bool serveIpc(IpcServer &server, U32 workers)
+{
+    if (server.region == NULL) {
+        return false;
+    }
+
+    for (U32 i=0; i<((workers == 0) ? 1 : workers); ++i) {
+        server.workers.push_back(std::thread(runIpcWorker, &server));
+    }
+
+    for (size_t i=0; i<server.workers.size(); ++i) {
+        server.workers[i].join();
+    }
+    server.workers.clear();
+
+    return true;
+}
+
+
+/**
+ * @brief Removes the shared memory object and frees the snapshots
+ * @param server server
+ */
+void closeIpcServer(IpcServer &server)
+{
+    if (server.region != NULL) {
+        server.region->running.store(0, std::memory_order_release);
+        munmap(server.region, sizeof(IpcRegion));
+        shm_unlink(server.name.c_str());
+        server.region = NULL;
+    }
+
+    if (server.images != NULL) {
+        for (size_t i=0; i<server.loaded.size(); ++i) {
+            destroySoCInstance(*server.images, server.loaded[i].snapshot);
+        }
+        delete server.images;
+        server.images = NULL;
+    }
+    server.loaded.clear();
+}
+
+
+/**
+ * @brief Connects to a running server
+ * @param client client to open
+ * @param name name the server was opened with
+ * @return true if success, otherwise false
+ */
+bool openIpcClient(IpcClient &client, const char *name)
+{
+    client.region = mapIpcRegion(name, false);
+    if (client.region == NULL) {
+        return false;
+    }
+
+    if ((memcmp(client.region->magic, IPC_MAGIC,
+                sizeof(client.region->magic)) != 0) ||
+        (client.region->version != IPC_VERSION) ||
+        (client.region->slotCount != IPC_SLOT_COUNT)) {
+        closeIpcClient(client);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return true;
+}
+
+
+/**
+ * @brief Disconnects from a server
+ * @param client client
+ */
+void closeIpcClient(IpcClient &client)
+{
+    if (client.region != NULL) {
+        munmap(client.region, sizeof(IpcRegion));
+        client.region = NULL;
+    }
+}
+
+
+/**
+ * @brief Submits a job and waits for its result. Any number of threads
+ *        and processes can run jobs at once, up to IPC_SLOT_COUNT are
+ *        in flight and the rest wait for a free slot.
+ * @param client client
+ * @param job job to run
+ * @param result location to store result, registers and output are
+ *               only filled in if status is IPC_RESULT_OK
+ * @return true if the job ran or was rejected, false if the server
+ *         stopped
+ */
+bool runIpcJob(IpcClient &client, const IpcJob &job, IpcResult &result)
+{
+    IpcRegion &region = *client.region;
+    U32 index;
+    U32 idle = 0;
+
+    memset(&result, 0, offsetof(IpcResult, reg));
+
+    // Rejected before it is posted, result only has room for this much
+    if ((job.registerCount > IPC_MAX_REGISTERS) ||
+        (job.inputLength > IPC_MAX_INPUT) ||
+        (job.outputLength > IPC_MAX_OUTPUT)) {
+        result.status = IPC_RESULT_INVALID;
+        return true;
+    }
+
+    while (!popIpcRing(region.freeRing, index)) {
+        if (region.running.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        waitIpcBackoff(idle);
+    }
+
+    IpcSlot &slot = region.slots[index];
+
+    slot.job = job;
+    slot.state.store(IPC_SLOT_SUBMITTED, std::memory_order_relaxed);
+    pushIpcRing(region.submitRing, index);
+
+    idle = 0;
+    while (slot.state.load(std::memory_order_acquire) != IPC_SLOT_DONE) {
+        if (region.running.load(std::memory_order_acquire) == 0) {
+            // The slot may still be in use, it is not given back
+            return false;
+        }
+        waitIpcBackoff(idle);
+    }
+
+    memcpy(&result, &slot.result, offsetof(IpcResult, reg));
+    if ((result.status == IPC_RESULT_OK) &&
+        (result.registerCount > CPU_REGISTER_FILE_SIZE)) {
+        result.status = IPC_RESULT_INVALID;
+    }
+    if (result.status == IPC_RESULT_OK) {
+        memcpy(result.reg, slot.result.reg,
+               result.registerCount * sizeof(result.reg[0]));
+        memcpy(result.output, slot.result.output, job.outputLength);
+    } else {
+        result.registerCount = 0;
+    }
+
+    slot.state.store(IPC_SLOT_FREE, std::memory_order_relaxed);
+    pushIpcRing(region.freeRing, index);
+
+    return true;
+}
+
+
+/**
+ * @brief Asks the server to stop once its workers finish the jobs they
+ *        are running
+ * @param client client
+ */
+void stopIpcServer(IpcClient &client)
+{
+    client.region->running.store(0, std::memory_order_release);
+}
+
+#else
+
+// Shared memory is only implemented for POSIX hosts
+
+bool openIpcServer(IpcServer &server, const char *name,
+                   const CPUProfile &profile)
+{
+    server.region = NULL;
+    server.images = NULL;
+
+    return false;
+}
+
+bool addIpcImage(IpcServer &server, const U8 *image, U32 size)
+{
+    return false;
+}
+
+bool serveIpc(IpcServer &server, U32 workers)
+{
+    return false;
+}
+
+void closeIpcServer(IpcServer &server)
+{
+}
+
+bool openIpcClient(IpcClient &client, const char *name)
+{
+    client.region = NULL;
+
+    return false;
+}
+
+void closeIpcClient(IpcClient &client)
+{
+}
+
+bool runIpcJob(IpcClient &client, const IpcJob &job, IpcResult &result)
+{
+    return false;
+}
+
+void stopIpcServer(IpcClient &client)
+{
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the shared memory job server, SoCs stay
+ *        resident in a server process and local clients hand it jobs
+ *        through lock-free rings in POSIX shared memory
+ */
+
+#ifndef _EWATC_SOCIPC_H
+#define _EWATC_SOCIPC_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "socbasic.h"
+#include "socarena.h"
+
+#define IPC_MAGIC           "SOCIPC\0\0"
+#define IPC_VERSION         2
+
+// Jobs in flight at once, a power of 2
+#define IPC_SLOT_COUNT      64
+
+// Inputs applied to the snapshot before a job runs, outputs copied back
+#define IPC_MAX_REGISTERS   16
+#define IPC_MAX_INPUT       256
+#define IPC_MAX_OUTPUT      256
+
+// IpcSlot.state, a slot moves FREE -> SUBMITTED -> DONE -> FREE
+enum {
+    IPC_SLOT_FREE,          // on the free ring
+    IPC_SLOT_SUBMITTED,     // owned by the server until DONE
+    IPC_SLOT_DONE           // result written, owned by the client again
+};
+
+// IpcResult.status
+enum {
+    IPC_RESULT_OK,          // ran, reason is a SimStopReason
+    IPC_RESULT_NO_IMAGE,    // server has no image with the hash
+    IPC_RESULT_INVALID      // an input or output is out of range
+};
+
+/**
+ * @brief Bounded multi producer, multi consumer ring of slot indexes.
+ *        Each cell has a sequence number telling whether it is ready
+ *        to be written or read at a position, so producers and
+ *        consumers only contend on head or tail. Lock-free atomics are
+ *        address free, so the ring works across processes.
+ */
+struct IpcRing
+{
+    struct Cell
+    {
+        std::atomic<U64> sequence;
+        U32 slot;
+    };
+
+    alignas(64) std::atomic<U64> head;  // next position to write
+    alignas(64) std::atomic<U64> tail;  // next position to read
+    alignas(64) Cell cells[IPC_SLOT_COUNT];
+};
+
+struct IpcRegister
+{
+    U32 index;
+    U32 value;
+};
+
+/**
+ * @brief A job, written by the client before it is submitted
+ */
+struct IpcJob
+{
+    U64 imageHash;          // hashSimImage of an image the server loaded
+    U64 budget;             // instructions to run at most
+    U32 registerCount;      // register inputs used
+    IpcRegister registers[IPC_MAX_REGISTERS];
+    U32 inputAddress;       // bytes written to memory, SoC byte order
+    U32 inputLength;
+    U8 input[IPC_MAX_INPUT];
+    U32 outputAddress;      // bytes copied to the result
+    U32 outputLength;
+};
+
+/**
+ * @brief Result of a job, written by the server before the slot is DONE
+ */
+struct IpcResult
+{
+    U32 status;             // IPC_RESULT_*
+    U32 reason;             // SimStopReason
+    U64 ran;
+    U64 instructionCount;
+    U64 cycleCount;
+    CPUFault fault;
+    U32 registerCount;
+    U32 reg[CPU_REGISTER_FILE_SIZE];
+    U8 output[IPC_MAX_OUTPUT];
+};
+
+struct IpcSlot
+{
+    alignas(64) std::atomic<U32> state;
+    IpcJob job;
+    IpcResult result;
+};
+
+/**
+ * @brief Layout of the shared memory object. Clients take a slot index
+ *        from the free ring, fill in its job and push it on the submit
+ *        ring. A server worker pops it, writes the result and marks the
+ *        slot DONE. The client reads the result and pushes the index
+ *        back on the free ring.
+ */
+struct IpcRegion
+{
+    char magic[8];
+    U32 version;
+    U32 slotCount;
+    U32 serverPid;                  // process that created the region
+    std::atomic<U32> running;       // cleared to stop the server
+    IpcRing freeRing;
+    IpcRing submitRing;
+    IpcSlot slots[IPC_SLOT_COUNT];
+};
+
+/**
+ * @brief An image resident in the server, as it was right after it was
+ *        loaded. Every job starts from a copy of this snapshot.
+ */
+struct IpcImage
+{
+    U64 hash;
+    SoCInstance *snapshot;
+};
+
+struct IpcServer
+{
+    std::string name;
+    IpcRegion *region;
+    CPUProfile profile;
+    CPUExecuteFunction execute;
+    InstanceArena *images;          // snapshots, read only once serving
+    std::vector<IpcImage> loaded;
+    std::vector<std::thread> workers;
+};
+
+struct IpcClient
+{
+    IpcRegion *region;
+};
+
+U64 hashSimImage(const U8 *image, U32 size);
+
+bool openIpcServer(IpcServer &server, const char *name,
+                   const CPUProfile &profile);
+bool addIpcImage(IpcServer &server, const U8 *image, U32 size);
+bool serveIpc(IpcServer &server, U32 workers);
+void closeIpcServer(IpcServer &server);
+
+bool openIpcClient(IpcClient &client, const char *name);
+void closeIpcClient(IpcClient &client);
+bool runIpcJob(IpcClient &client, const IpcJob &job, IpcResult &result);
+void stopIpcServer(IpcClient &client);
+
+#endif
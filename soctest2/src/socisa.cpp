@@ -0,0 +1,121 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Instruction set lookup functions
+ */
+
+#include <ctype.h>
+#include "socisa.h"
+
+// Every instruction described by ISA_INSTRUCTIONS
+static const ISAInstructionInfo isaInstructions[] = {
+#define ISA_INFO_ENTRY(_mnemonic, _opcode, _format, _role1, _role2, _role3, \
+                       _cycles, _semantics) \
+    { #_mnemonic, _opcode, _format, { _role1, _role2, _role3 }, _cycles },
+    ISA_INSTRUCTIONS(ISA_INFO_ENTRY)
+#undef ISA_INFO_ENTRY
+};
+
+#define ISA_INSTRUCTION_COUNT \
+    (sizeof(isaInstructions) / sizeof(isaInstructions[0]))
+
+
+/**
+ * @brief Opcode indexed table of instructions, invalid opcodes are NULL
+ */
+struct ISAOpcodeTable
+{
+    const ISAInstructionInfo *entry[256];
+
+    ISAOpcodeTable()
+    {
+        for (int i=0; i<256; ++i) {
+            entry[i] = NULL;
+        }
+
+        for (size_t i=0; i<ISA_INSTRUCTION_COUNT; ++i) {
+            entry[isaInstructions[i].opcode] = &isaInstructions[i];
+        }
+    }
+};
+
+static const ISAOpcodeTable isaOpcodeTable;
+
+
+/**
+ * @brief Looks up an instruction by opcode
+ * @param opcode opcode to look up
+ * @return instruction info, NULL if opcode is invalid
+ */
+const ISAInstructionInfo *isaLookupOpcode(U8 opcode)
+{
+    return isaOpcodeTable.entry[opcode];
+}
+
+
+/**
+ * @brief Looks up an instruction by mnemonic, case insensitive
+ * @param mnemonic mnemonic to look up, does not need to be terminated
+ * @param length number of characters in mnemonic
+ * @return instruction info, NULL if mnemonic is unknown
+ */
+const ISAInstructionInfo *isaLookupMnemonic(const char *mnemonic,
+                                            size_t length)
+{
+    for (size_t i=0; i<ISA_INSTRUCTION_COUNT; ++i) {
+        const char *name = isaInstructions[i].mnemonic;
+        size_t j;
+
+        for (j=0; j<length; ++j) {
+            if ((name[j] == '\0') ||
+                (name[j] != toupper((unsigned char)mnemonic[j]))) {
+                break;
+            }
+        }
+
+        if ((j == length) && (name[j] == '\0')) {
+            return &isaInstructions[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Finds the idioms in a run of instructions. An idiom is tagged
+ *        on its first instruction, the instructions it covers are not
+ *        tagged so idioms never overlap.
+ * @param words instructions in host order
+ * @param idioms location to store ISA_IDIOM_* of each instruction
+ * @param count number of instructions
+ */
+void isaFindIdioms(const U32 *words, U8 *idioms, U32 count)
+{
+    U32 i = 0;
+
+    while (i < count) {
+        U32 opcode1 = ISA_OPCODE(words[i]);
+        U32 opcode2 = ((i + 1) < count) ? ISA_OPCODE(words[i + 1]) :
+                                          ISA_IDIOM_END;
+        U32 opcode3 = ((i + 2) < count) ? ISA_OPCODE(words[i + 2]) :
+                                          ISA_IDIOM_END;
+        U32 length = 1;
+
+        idioms[i] = ISA_IDIOM_NONE;
+
+#define ISA_IDIOM_MATCH(_name, _opcode1, _opcode2, _opcode3) \
+        if ((length == 1) && (opcode1 == _opcode1) && \
+            (opcode2 == _opcode2) && \
+            ((_opcode3 == ISA_IDIOM_END) || (opcode3 == _opcode3))) { \
+            idioms[i] = ISA_IDIOM_##_name; \
+            length = (_opcode3 == ISA_IDIOM_END) ? 2 : 3; \
+        }
+        ISA_IDIOMS(ISA_IDIOM_MATCH)
+#undef ISA_IDIOM_MATCH
+
+        for (U32 j=1; j<length; ++j) {
+            idioms[i + j] = ISA_IDIOM_NONE;
+        }
+        i += length;
+    }
+}
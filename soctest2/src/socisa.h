@@ -0,0 +1,121 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the description of the CPU instruction set
+ */
+
+#ifndef _EWATC_SOCISA_H
+#define _EWATC_SOCISA_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Instruction formats, opcode is always the most significant byte
+//   Fmt1: | opcode | regIndex  | data (16 bits)        |
+//   Fmt2: | opcode | regIndex1 | regIndex2 | regIndex3 |
+//   Fmt3: | opcode | regIndex1 | regIndex2 | data      |
+enum {
+    ISA_FORMAT1 = 1,
+    ISA_FORMAT2 = 2,
+    ISA_FORMAT3 = 3
+};
+
+// Role of each instruction field, fields are listed in encoding order
+// and an IMM16 field covers both of the last two bytes
+enum {
+    ISA_ROLE_NONE,      // field not used, encoded as ISA_NOT_USED
+    ISA_ROLE_SRC,       // register that is read
+    ISA_ROLE_DST,       // register that is written
+    ISA_ROLE_SRCDST,    // register that is read and written
+    ISA_ROLE_IMM16,     // 16-bit immediate
+    ISA_ROLE_OFF8       // signed 8-bit offset
+};
+
+#define ISA_MAX_FIELDS 3
+
+/**
+ * All known CPU instructions, this is the only place an
+ * instruction is described. The decoder, executor, tracer,
+ * assembler and disassembler are all generated from this table.
+ *
+ * ISA_OP(mnemonic, opcode, format, role1, role2, role3, cycles, semantics)
+ *
+ * semantics names a functor in socsemantics.h
+ */
+#define ISA_INSTRUCTIONS(ISA_OP) \
+    ISA_OP(LOADLI, 0x01, ISA_FORMAT1, ISA_ROLE_SRCDST, ISA_ROLE_IMM16, ISA_ROLE_NONE, 1, ISALoadLow)   \
+    ISA_OP(LOADHI, 0x02, ISA_FORMAT1, ISA_ROLE_SRCDST, ISA_ROLE_IMM16, ISA_ROLE_NONE, 1, ISALoadHigh)  \
+    ISA_OP(ADD,    0x03, ISA_FORMAT2, ISA_ROLE_SRC,    ISA_ROLE_SRC,   ISA_ROLE_DST,  1, ISAAdd)       \
+    ISA_OP(SUB,    0x04, ISA_FORMAT2, ISA_ROLE_SRC,    ISA_ROLE_SRC,   ISA_ROLE_DST,  1, ISASub)       \
+    ISA_OP(DIV,    0x05, ISA_FORMAT2, ISA_ROLE_SRC,    ISA_ROLE_SRC,   ISA_ROLE_DST,  8, ISADiv)       \
+    ISA_OP(STORE,  0x10, ISA_FORMAT3, ISA_ROLE_SRC,    ISA_ROLE_SRC,   ISA_ROLE_OFF8, 2, ISAStore)     \
+    ISA_OP(LOAD,   0x11, ISA_FORMAT3, ISA_ROLE_SRC,    ISA_ROLE_DST,   ISA_ROLE_OFF8, 2, ISALoad)      \
+    ISA_OP(PUSH,   0x20, ISA_FORMAT2, ISA_ROLE_SRC,    ISA_ROLE_NONE,  ISA_ROLE_NONE, 2, ISAPush)      \
+    ISA_OP(POP,    0x21, ISA_FORMAT2, ISA_ROLE_DST,    ISA_ROLE_NONE,  ISA_ROLE_NONE, 2, ISAPop)
+
+// All known CPU OPCodes
+enum {
+#define ISA_OPCODE_ENUM(_mnemonic, _opcode, _format, _role1, _role2, _role3, \
+                        _cycles, _semantics) \
+    OPCODE_##_mnemonic = _opcode,
+    ISA_INSTRUCTIONS(ISA_OPCODE_ENUM)
+#undef ISA_OPCODE_ENUM
+};
+
+// Value placed in register fields that are not used
+#define ISA_NOT_USED 0xFF
+
+/**
+ * Instruction sequences a fusing executor runs with one dispatch, found
+ * by opcode when a line of instructions is fetched. Every instruction
+ * of an idiom still runs its own semantics, so any registers are fine.
+ *
+ * ISA_IDIOM(name, opcode1, opcode2, opcode3), opcode3 is ISA_IDIOM_END
+ * for a pair
+ */
+#define ISA_IDIOMS(ISA_IDIOM) \
+    ISA_IDIOM(CONST, OPCODE_LOADLI, OPCODE_LOADHI, ISA_IDIOM_END)   \
+    ISA_IDIOM(PUSH2, OPCODE_PUSH,   OPCODE_PUSH,   ISA_IDIOM_END)   \
+    ISA_IDIOM(POP2,  OPCODE_POP,    OPCODE_POP,    ISA_IDIOM_END)   \
+    ISA_IDIOM(RMW,   OPCODE_LOAD,   OPCODE_ADD,    OPCODE_STORE)
+
+#define ISA_IDIOM_END 0
+
+// Idiom starting at an instruction
+enum {
+    ISA_IDIOM_NONE,
+#define ISA_IDIOM_ENUM(_name, _opcode1, _opcode2, _opcode3) \
+    ISA_IDIOM_##_name,
+    ISA_IDIOMS(ISA_IDIOM_ENUM)
+#undef ISA_IDIOM_ENUM
+    ISA_IDIOM_COUNT
+};
+
+// Field accessors for an instruction word in host order
+#define ISA_OPCODE(_word)   (((_word) >> 24) & 0xFF)
+#define ISA_BYTE1(_word)    (((_word) >> 16) & 0xFF)
+#define ISA_BYTE2(_word)    (((_word) >> 8) & 0xFF)
+#define ISA_BYTE3(_word)    ((_word) & 0xFF)
+#define ISA_DATA16(_word)   ((_word) & 0xFFFF)
+
+struct ISAInstructionInfo
+{
+    const char *mnemonic;
+    U8 opcode;
+    U8 format;
+    U8 role[ISA_MAX_FIELDS];
+    U8 cycles;
+};
+
+/**
+ * @brief Checks if a field role refers to a register
+ */
+#define ISA_ROLE_IS_REGISTER(_role) \
+    (((_role) == ISA_ROLE_SRC) || ((_role) == ISA_ROLE_DST) || \
+     ((_role) == ISA_ROLE_SRCDST))
+
+const ISAInstructionInfo *isaLookupOpcode(U8 opcode);
+const ISAInstructionInfo *isaLookupMnemonic(const char *mnemonic,
+                                            size_t length);
+void isaFindIdioms(const U32 *words, U8 *idioms, U32 count);
+
+#endif
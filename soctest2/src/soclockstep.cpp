@@ -0,0 +1,356 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Lockstep runner functions
+ */
+
+#include <string.h>
+#include "soclockstep.h"
+
+
+/**
+ * @brief Returns hash of everything an executor can change
+ * @param instance SoC to hash
+ * @param cache cache of page hashes for the instance's memory
+ * @return hash of state
+ */
+static U64 hashLockstepState(const SoCInstance &instance,
+                             MemoryHashCache &cache)
+{
+    const CPUContext &ctx = instance.ctx;
+    U64 counters[2] = { ctx.instructionCount, ctx.cycleCount };
+    U64 hash = hashMemory(instance.mem, cache);
+
+    hash = soc::memoryHash((const U8*)ctx.reg,
+                           ctx.registerCount * sizeof(ctx.reg[0]), hash);
+    hash = soc::memoryHash((const U8*)counters, sizeof(counters), hash);
+    hash = soc::memoryHash((const U8*)&ctx.fault, sizeof(ctx.fault), hash);
+
+    return hash;
+}
+
+
+/**
+ * @brief Runs instructions until count have run or the executor stops
+ * @param instance SoC to run
+ * @param execute executor
+ * @param count instructions to run
+ * @param stopped location to store whether the executor stopped
+ * @return instructions run, including the one that stopped
+ */
+static U64 runLockstepSteps(SoCInstance &instance, CPUExecuteFunction execute,
+                            U64 count, bool &stopped)
+{
+    U64 ran = 0;
+
+    stopped = false;
+
+    while (ran < count) {
+        if (!stepCPU(instance.ctx, instance.mem, execute, count - ran, ran)) {
+            stopped = true;
+            break;
+        }
+    }
+
+    return ran;
+}
+
+
+/**
+ * @brief Runs both SoCs and compares them
+ * @param run lockstep run
+ * @param count instructions to run
+ * @param ran location to store instructions run by the reference
+ * @param stopped location to store whether the reference stopped
+ * @return true if the states are equal, otherwise false
+ */
+static bool runLockstepBoth(LockstepRun &run, U64 count, U64 &ran,
+                            bool &stopped)
+{
+    bool candidateStopped;
+    U64 candidateRan;
+
+    ran = runLockstepSteps(*run.reference, run.referenceExecute, count,
+                           stopped);
+    candidateRan = runLockstepSteps(*run.candidate, run.candidateExecute,
+                                    count, candidateStopped);
+
+    return (ran == candidateRan) && (stopped == candidateStopped) &&
+           (hashLockstepState(*run.reference, run.referenceCache) ==
+            hashLockstepState(*run.candidate, run.candidateCache));
+}
+
+
+/**
+ * @brief Puts both SoCs back to the checkpoint
+ * @param run lockstep run
+ */
+static void rewindLockstep(LockstepRun &run)
+{
+    *run.reference = *run.checkpoint;
+    *run.candidate = *run.checkpoint;
+
+    // Page versions went back, a cached hash may no longer match its page
+    resetMemoryHashCache(run.referenceCache);
+    resetMemoryHashCache(run.candidateCache);
+}
+
+
+/**
+ * @brief Moves the checkpoint to the reference state, copying only
+ *        the pages written since the last checkpoint
+ * @param run lockstep run
+ */
+static void advanceLockstepCheckpoint(LockstepRun &run)
+{
+    const Memory &mem = run.reference->mem;
+    Memory &saved = run.checkpoint->mem;
+
+    for (U32 page=0; page<MEMORY_PAGE_COUNT; ++page) {
+        if (mem.pageVersion[page] != saved.pageVersion[page]) {
+            U32 offset = page << MEMORY_PAGE_SHIFT;
+            U32 length = MEMORY_SIZE - offset;
+
+            if (length > MEMORY_PAGE_SIZE) {
+                length = MEMORY_PAGE_SIZE;
+            }
+
+            memcpy(&saved.data[offset], &mem.data[offset], length);
+            saved.pageVersion[page] = mem.pageVersion[page];
+        }
+    }
+
+    run.checkpoint->ctx = run.reference->ctx;
+}
+
+
+/**
+ * @brief Finds the first instruction after the checkpoint that leaves
+ *        the states different, and fills in result with both states
+ *        right after it
+ * @param run lockstep run
+ * @param count instructions after the checkpoint known to differ
+ * @param result location to store divergence
+ */
+static void findLockstepDivergence(LockstepRun &run, U64 count,
+                                   LockstepResult &result)
+{
+    U64 equal = 0;
+    U64 differ = count;
+    U64 ran;
+    bool stopped;
+
+    while ((differ - equal) > 1) {
+        U64 middle = equal + ((differ - equal) / 2);
+
+        rewindLockstep(run);
+        if (runLockstepBoth(run, middle, ran, stopped)) {
+            equal = middle;
+        } else {
+            differ = middle;
+        }
+    }
+
+    // Both are equal, and running, right before the diverging instruction
+    rewindLockstep(run);
+    runLockstepBoth(run, equal, ran, stopped);
+
+    CPUContext &ctx = run.reference->ctx;
+
+    result.status = LOCKSTEP_DIVERGED;
+    result.position = run.position + equal;
+    result.pc = ctx.reg[CPU_PC_INDEX(ctx.registerCount)];
+    result.referenceRan = run.referenceExecute(run.reference->ctx,
+                                               run.reference->mem);
+    result.candidateRan = run.candidateExecute(run.candidate->ctx,
+                                               run.candidate->mem);
+    result.referenceCtx = run.reference->ctx;
+    result.candidateCtx = run.candidate->ctx;
+    result.memoryAddress = compareMemory(run.reference->mem,
+                                         run.candidate->mem);
+    result.referenceByte = 0;
+    result.candidateByte = 0;
+    if (result.memoryAddress < MEMORY_SIZE) {
+        read8Memory(run.reference->mem, result.memoryAddress,
+                    result.referenceByte);
+        read8Memory(run.candidate->mem, result.memoryAddress,
+                    result.candidateByte);
+    }
+}
+
+
+/**
+ * @brief Sets up a lockstep run, the reference SoC is reset and the
+ *        program must be loaded in to run.reference->mem before
+ *        runLockstep is called
+ * @param run lockstep run to set up
+ * @param arena arena the three SoCs are taken from
+ * @param profile CPU profile both executors were selected for
+ * @param reference trusted executor, e.g. executeCPUInstruction
+ * @param candidate executor checked against the reference
+ * @param interval instructions run between comparisons
+ * @return true if success, otherwise false
+ */
+bool openLockstepRun(LockstepRun &run, InstanceArena &arena,
+                     const CPUProfile &profile,
+                     CPUExecuteFunction reference,
+                     CPUExecuteFunction candidate,
+                     U64 interval)
+{
+    run.arena = &arena;
+    run.reference = createSoCInstance(arena, profile);
+    run.candidate = arena.acquire();
+    run.checkpoint = arena.acquire();
+    run.referenceExecute = reference;
+    run.candidateExecute = candidate;
+    run.interval = (interval == 0) ? 1 : interval;
+    run.position = 0;
+    run.started = false;
+
+    if ((run.reference == NULL) || (run.candidate == NULL) ||
+        (run.checkpoint == NULL) || (reference == NULL) ||
+        (candidate == NULL)) {
+        closeLockstepRun(run);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Gives the SoCs of a lockstep run back to its arena
+ * @param run lockstep run
+ */
+void closeLockstepRun(LockstepRun &run)
+{
+    destroySoCInstance(*run.arena, run.reference);
+    destroySoCInstance(*run.arena, run.candidate);
+    destroySoCInstance(*run.arena, run.checkpoint);
+
+    run.reference = NULL;
+    run.candidate = NULL;
+    run.checkpoint = NULL;
+}
+
+
+/**
+ * @brief Runs both executors until they stop, diverge or limit
+ *        instructions have run. Can be called again after
+ *        LOCKSTEP_LIMIT to continue.
+ * @param run lockstep run
+ * @param limit instructions to run, 0 for no limit
+ * @param result location to store the outcome
+ * @return true if the executors agree, false if they diverged
+ */
+bool runLockstep(LockstepRun &run, U64 limit, LockstepResult &result)
+{
+    if (!run.started) {
+        // Both start from the loaded program
+        *run.candidate = *run.reference;
+        *run.checkpoint = *run.reference;
+        resetMemoryHashCache(run.referenceCache);
+        resetMemoryHashCache(run.candidateCache);
+        run.started = true;
+    }
+
+    U64 end = (limit != 0) ? run.position + limit : 0;
+
+    while ((end == 0) || (run.position < end)) {
+        U64 count = run.interval;
+        U64 ran;
+        bool stopped;
+
+        if ((end != 0) && (count > (end - run.position))) {
+            count = end - run.position;
+        }
+
+        if (!runLockstepBoth(run, count, ran, stopped)) {
+            findLockstepDivergence(run, count, result);
+            return false;
+        }
+
+        run.position += ran;
+        advanceLockstepCheckpoint(run);
+
+        if (stopped) {
+            result.status = LOCKSTEP_FINISHED;
+            result.position = run.position;
+            return true;
+        }
+    }
+
+    result.status = LOCKSTEP_LIMIT;
+    result.position = run.position;
+
+    return true;
+}
+
+
+/**
+ * @brief Writes a register, counter or fault field that differs
+ */
+static void writeLockstepField(FILE *fp, const char *name, U64 reference,
+                               U64 candidate)
+{
+    if (reference != candidate) {
+        fprintf(fp, "\t%s = 0x%08llx, expected 0x%08llx\n", name,
+                candidate, reference);
+    }
+}
+
+
+/**
+ * @brief Writes the outcome of a lockstep run, for a divergence every
+ *        field of the candidate that differs from the reference
+ * @param fp file to write to
+ * @param result outcome of runLockstep
+ */
+void writeLockstepReport(FILE *fp, const LockstepResult &result)
+{
+    if (result.status == LOCKSTEP_FINISHED) {
+        fprintf(fp, "Executors agree, both stopped after %llu instructions\n",
+                result.position);
+        return;
+    }
+    if (result.status == LOCKSTEP_LIMIT) {
+        fprintf(fp, "Executors agree for %llu instructions\n",
+                result.position);
+        return;
+    }
+
+    const CPUContext &expected = result.referenceCtx;
+    const CPUContext &actual = result.candidateCtx;
+    U32 count = expected.registerCount;
+
+    fprintf(fp, "Executors diverge at instruction %llu @ 0x%08x\n",
+            result.position, result.pc);
+
+    if (result.referenceRan != result.candidateRan) {
+        fprintf(fp, "\t%s stopped, the other did not\n",
+                result.referenceRan ? "candidate" : "reference");
+    }
+
+    writeLockstepField(fp, "pc", expected.reg[CPU_PC_INDEX(count)],
+                       actual.reg[CPU_PC_INDEX(count)]);
+    writeLockstepField(fp, "sp", expected.reg[CPU_SP_INDEX(count)],
+                       actual.reg[CPU_SP_INDEX(count)]);
+    for (U32 i=0; i<count - 2; ++i) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "reg[%u]", i);
+        writeLockstepField(fp, name, expected.reg[i], actual.reg[i]);
+    }
+
+    writeLockstepField(fp, "instructions", expected.instructionCount,
+                       actual.instructionCount);
+    writeLockstepField(fp, "cycles", expected.cycleCount, actual.cycleCount);
+    writeLockstepField(fp, "fault", expected.fault.kind, actual.fault.kind);
+    writeLockstepField(fp, "fault address", expected.fault.address,
+                       actual.fault.address);
+
+    if (result.memoryAddress < MEMORY_SIZE) {
+        fprintf(fp, "\tmemory 0x%08x = 0x%02x, expected 0x%02x\n",
+                result.memoryAddress, result.candidateByte,
+                result.referenceByte);
+    }
+}
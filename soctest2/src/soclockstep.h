@@ -0,0 +1,86 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the lockstep runner, two executors run the
+ *        same program and are compared until their states diverge
+ */
+
+#ifndef _EWATC_SOCLOCKSTEP_H
+#define _EWATC_SOCLOCKSTEP_H
+
+#include <stdio.h>
+#include "socbasic.h"
+#include "socarena.h"
+#include "socmemutil.h"
+
+// Instructions run by both executors between state comparisons
+#define LOCKSTEP_DEFAULT_INTERVAL   100000
+
+enum LockstepStatus {
+    LOCKSTEP_FINISHED,      // both stopped on the same instruction, equal
+    LOCKSTEP_LIMIT,         // instruction limit reached, equal
+    LOCKSTEP_DIVERGED       // states differ, see LockstepResult
+};
+
+/**
+ * @brief Two SoCs running the same program, one with the reference
+ *        executor and one with the candidate. Every interval
+ *        instructions a hash of each state is compared. States are
+ *        hashed from the registers, counters, fault and memory, memory
+ *        pages are only hashed again when their pageVersion changed, so
+ *        a comparison costs the pages written rather than all of memory.
+ *
+ *        After every matching interval the reference state is kept as
+ *        a checkpoint, only pages written since the last one are copied.
+ *        A mismatch is narrowed down by binary search, both SoCs are
+ *        rewound to the checkpoint and run part of the interval again.
+ *        A difference that is overwritten before the end of an interval
+ *        is not seen, an interval of 1 compares every instruction.
+ */
+struct LockstepRun
+{
+    InstanceArena *arena;
+    SoCInstance *reference;     // load the program here before running
+    SoCInstance *candidate;
+    SoCInstance *checkpoint;
+    CPUExecuteFunction referenceExecute;
+    CPUExecuteFunction candidateExecute;
+    U64 interval;
+    U64 position;               // instructions run by both, checkpoint
+                                // is the state at position
+    bool started;
+
+    MemoryHashCache referenceCache;
+    MemoryHashCache candidateCache;
+};
+
+/**
+ * @brief Where and how two executors diverged. The diverging
+ *        instruction is the first one after which the states differ,
+ *        both contexts are as they were right after it.
+ */
+struct LockstepResult
+{
+    U32 status;                 // LockstepStatus
+    U64 position;               // instructions run before the diverging
+                                // one, or before stopping
+    U32 pc;                     // address of the diverging instruction
+    bool referenceRan;          // executor returned true
+    bool candidateRan;
+    CPUContext referenceCtx;
+    CPUContext candidateCtx;
+    U32 memoryAddress;          // first byte that differs, MEMORY_SIZE
+                                // if memory is equal
+    U8 referenceByte;           // bytes at memoryAddress
+    U8 candidateByte;
+};
+
+bool openLockstepRun(LockstepRun &run, InstanceArena &arena,
+                     const CPUProfile &profile,
+                     CPUExecuteFunction reference,
+                     CPUExecuteFunction candidate,
+                     U64 interval=LOCKSTEP_DEFAULT_INTERVAL);
+void closeLockstepRun(LockstepRun &run);
+bool runLockstep(LockstepRun &run, U64 limit, LockstepResult &result);
+void writeLockstepReport(FILE *fp, const LockstepResult &result);
+
+#endif
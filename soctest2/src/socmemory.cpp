@@ -0,0 +1,139 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Memory functions that are not on the fast path
+ */
+
+#include <soc/memutil.h>
+#include "socmemory.h"
+#include "socisa.h"
+
+
+/**
+ * @brief Copies bytes out of memory in SoC byte order, whatever
+ *        order memory is stored in
+ * @param mem memory to read from
+ * @param address first location to read
+ * @param dst location to store bytes
+ * @param length number of bytes to copy
+ * @return true if success, otherwise false
+ */
+bool readMemoryBlock(const Memory &mem, U32 address, U8 *dst, U32 length)
+{
+    if ((address > MEMORY_SIZE) || (length > (MEMORY_SIZE - address))) {
+        return false;
+    }
+
+    if (MEMORY_XOR8 == 0) {
+        memcpy(dst, &mem.data[address], length);
+        return true;
+    }
+
+    // Whole words are swapped as they are copied
+    U32 i = 0;
+    while ((i < length) && (((address + i) & 0x3) != 0)) {
+        dst[i] = mem.data[(address + i) ^ MEMORY_XOR8];
+        ++i;
+    }
+
+    soc::memorySwap32(&dst[i], &mem.data[address + i], (length - i) / 4);
+    i += (length - i) & ~0x3U;
+
+    for (; i < length; ++i) {
+        dst[i] = mem.data[(address + i) ^ MEMORY_XOR8];
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Copies bytes in SoC byte order in to memory, whatever
+ *        order memory is stored in
+ * @param mem memory to write to
+ * @param address first location to write
+ * @param src bytes to copy
+ * @param length number of bytes to copy
+ * @return true if success, otherwise false
+ */
+bool writeMemoryBlock(Memory &mem, U32 address, const U8 *src, U32 length)
+{
+    if ((address > MEMORY_SIZE) || (length > (MEMORY_SIZE - address))) {
+        return false;
+    }
+
+    touchMemoryPages(mem, address, length);
+
+    if (MEMORY_XOR8 == 0) {
+        memcpy(&mem.data[address], src, length);
+        return true;
+    }
+
+    // Whole words are swapped as they are copied
+    U32 i = 0;
+    while ((i < length) && (((address + i) & 0x3) != 0)) {
+        mem.data[(address + i) ^ MEMORY_XOR8] = src[i];
+        ++i;
+    }
+
+    soc::memorySwap32(&mem.data[address + i], &src[i], (length - i) / 4);
+    i += (length - i) & ~0x3U;
+
+    for (; i < length; ++i) {
+        mem.data[(address + i) ^ MEMORY_XOR8] = src[i];
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Marks pages as written, for changes made to mem.data directly
+ * @param mem memory that was changed
+ * @param address first location changed
+ * @param length number of bytes changed
+ */
+void touchMemoryPages(Memory &mem, U32 address, U32 length)
+{
+    if (length == 0) {
+        return;
+    }
+
+    U32 last = (address + length - 1) >> MEMORY_PAGE_SHIFT;
+
+    for (U32 page = address >> MEMORY_PAGE_SHIFT; page <= last; ++page) {
+        ++mem.pageVersion[page];
+    }
+}
+
+
+/**
+ * @brief Loads the line holding an address in to a fetch buffer, the
+ *        whole line is bounds checked and byte swapped at once
+ * @param mem memory to read from
+ * @param fetch fetch buffer to load
+ * @param address any address in the line
+ * @return true if success, false if the line is not entirely in memory
+ */
+bool fillFetchBuffer(const Memory &mem, FetchBuffer &fetch, U32 address)
+{
+    U32 line = address & ~(U32)(MEMORY_PAGE_SIZE - 1);
+    FetchLine &held = fetchLineOf(fetch, address);
+
+    if ((line > MEMORY_SIZE) || (MEMORY_PAGE_SIZE > (MEMORY_SIZE - line))) {
+        held.line = FETCH_LINE_INVALID;
+        return false;
+    }
+
+    if (MEMORY_WORD_SWAP) {
+        soc::memorySwap32((U8*)held.word, &mem.data[line], FETCH_LINE_WORDS);
+    } else {
+        memcpy(held.word, &mem.data[line], MEMORY_PAGE_SIZE);
+    }
+
+    isaFindIdioms(held.word, held.idiom, FETCH_LINE_WORDS);
+
+    held.line = line;
+    held.version = mem.pageVersion[line >> MEMORY_PAGE_SHIFT];
+
+    return true;
+}
@@ -0,0 +1,319 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the memory model and its access functions
+ */
+
+#ifndef _EWATC_SOCMEMORY_H
+#define _EWATC_SOCMEMORY_H
+
+#include <string.h>
+#include "types.h"
+#include "soccfg.h"
+
+#define MEMORY_PAGE_SIZE    (1 << MEMORY_PAGE_SHIFT)
+#define MEMORY_PAGE_COUNT   \
+    ((MEMORY_SIZE + MEMORY_PAGE_SIZE - 1) >> MEMORY_PAGE_SHIFT)
+
+struct Memory
+{
+    U8 data[MEMORY_SIZE];
+
+    // Bumped on every write to a page, lets caches of memory
+    // contents tell whether a page changed
+    U32 pageVersion[MEMORY_PAGE_COUNT];
+};
+
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define SOC_LIKELY(_cond)   __builtin_expect(!!(_cond), 1)
+    #define SOC_UNLIKELY(_cond) __builtin_expect(!!(_cond), 0)
+#else
+    #define SOC_LIKELY(_cond)   (_cond)
+    #define SOC_UNLIKELY(_cond) (_cond)
+#endif
+
+/**
+ * @brief Swaps the bytes of a 16-bit value
+ */
+static inline U16 swap16(U16 value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap16(value);
+#else
+    return (U16)(((value&0x00FF) << 8) | ((value&0xFF00) >> 8));
+#endif
+}
+
+/**
+ * @brief Swaps the bytes of a 32-bit value
+ */
+static inline U32 swap32(U32 value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(value);
+#else
+    return (((value&0x000000FF) << 24) |
+            ((value&0x0000FF00) << 8)  |
+            ((value&0x00FF0000) >> 8)  |
+            ((value&0xFF000000) >> 24));
+#endif
+}
+
+#if (defined(HOST_LITTLE_ENDIAN) && defined(SOC_LITTLE_ENDIAN)) || \
+    (defined(HOST_BIG_ENDIAN) && defined(SOC_BIG_ENDIAN))
+    #define SOC_HOST_SAME_ORDER 1
+#elif defined(SOC_LITTLE_ENDIAN) || defined(SOC_BIG_ENDIAN)
+    #define SOC_HOST_SAME_ORDER 0
+#else
+    #error "Invalid SoC Configuration"
+#endif
+
+/**
+ * @brief Converts between host and SoC byte order
+ */
+static inline U16 byteswap16(U16 value)
+{
+    return SOC_HOST_SAME_ORDER ? value : swap16(value);
+}
+
+static inline U32 byteswap32(U32 value)
+{
+    return SOC_HOST_SAME_ORDER ? value : swap32(value);
+}
+
+// How memory is stored:
+//   MEMORY_WORD_SWAP - 32-bit accesses need a byte swap
+//   MEMORY_XOR8      - applied to a guest address to find a byte
+//   MEMORY_XOR16     - applied to a guest address to find a 16-bit value
+#if MEMORY_HOST_ORDER && !SOC_HOST_SAME_ORDER
+    #define MEMORY_WORD_SWAP    0
+    #define MEMORY_XOR8         3
+    #define MEMORY_XOR16        2
+#else
+    #define MEMORY_WORD_SWAP    (!SOC_HOST_SAME_ORDER)
+    #define MEMORY_XOR8         0
+    #define MEMORY_XOR16        0
+#endif
+
+
+// Words of one page, line, held for instruction fetch
+#define FETCH_LINE_WORDS    (MEMORY_PAGE_SIZE / 4)
+#define FETCH_LINE_INVALID  0xFFFFFFFF
+
+/**
+ * @brief Instructions of one line, in host order. The line is checked
+ *        and byte swapped once when loaded, fetches then only compare
+ *        the line and its page version, so a write to the line loads it
+ *        again. Idioms are found when the line is loaded, for fusing
+ *        executors.
+ */
+struct FetchLine
+{
+    U32 line;               // address of the line, FETCH_LINE_INVALID if none
+    U32 version;            // pageVersion of the line when loaded
+    U32 word[FETCH_LINE_WORDS];
+    U8 idiom[FETCH_LINE_WORDS];     // ISA_IDIOM_* starting at each word
+};
+
+/**
+ * @brief Lines of instructions held for fetch, direct mapped by line
+ *        number. Calls, returns and other jumps between lines already
+ *        held, e.g. a POP pc back in to the caller, find their target
+ *        decoded with the same check as a sequential fetch.
+ */
+struct FetchBuffer
+{
+    FetchLine lines[CPU_FETCH_LINES];
+};
+
+bool readMemoryBlock(const Memory &mem, U32 address, U8 *dst, U32 length);
+bool writeMemoryBlock(Memory &mem, U32 address, const U8 *src, U32 length);
+void touchMemoryPages(Memory &mem, U32 address, U32 length);
+bool fillFetchBuffer(const Memory &mem, FetchBuffer &fetch, U32 address);
+
+/**
+ * @brief Drops every line held by a fetch buffer
+ * @param fetch fetch buffer
+ */
+static inline void invalidateFetchBuffer(FetchBuffer &fetch)
+{
+    for (U32 i=0; i<CPU_FETCH_LINES; ++i) {
+        fetch.lines[i].line = FETCH_LINE_INVALID;
+    }
+}
+
+/**
+ * @brief Finds where a fetch buffer holds the line of an address
+ * @param fetch fetch buffer
+ * @param address any address in the line
+ * @return entry of the line, holding it or another line
+ */
+static inline FetchLine &fetchLineOf(FetchBuffer &fetch, U32 address)
+{
+    return fetch.lines[(address >> MEMORY_PAGE_SHIFT) & (CPU_FETCH_LINES - 1)];
+}
+
+static inline const FetchLine &fetchLineOf(const FetchBuffer &fetch,
+                                           U32 address)
+{
+    return fetch.lines[(address >> MEMORY_PAGE_SHIFT) & (CPU_FETCH_LINES - 1)];
+}
+
+// The access functions below return false for an access that is out of
+// range or misaligned and print nothing, the caller decides what a
+// failed access means
+
+
+/**
+ * @brief reads 8-bit value memory at address and stores it in value
+ * @param mem memory to read from
+ * @param address location to read from
+ * @param value location to store value read
+ * @return true if success, otherwise false
+ */
+static inline bool read8Memory(const Memory &mem, U32 address, U8 &value)
+{
+    if (SOC_LIKELY(address < MEMORY_SIZE)) {
+        value = mem.data[address ^ MEMORY_XOR8];
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief reads 16-bit value memory at address and stores it in value
+ * @param mem memory to read from
+ * @param address location to read from
+ * @param value location to store value read
+ * @return true if success, otherwise false
+ */
+static inline bool read16Memory(const Memory &mem, U32 address, U16 &value)
+{
+    if (SOC_LIKELY(((address & 0x1) == 0) && (address <= MEMORY_SIZE - 2))) {
+        memcpy(&value, &mem.data[address ^ MEMORY_XOR16], sizeof(value));
+        if (MEMORY_WORD_SWAP) {
+            value = swap16(value);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief reads 32-bit value memory at address and stores it in value
+ * @param mem memory to read from
+ * @param address location to read from
+ * @param value location to store value read
+ * @return true if success, otherwise false
+ */
+static inline bool read32Memory(const Memory &mem, U32 address, U32 &value)
+{
+    if (SOC_LIKELY(((address & 0x3) == 0) && (address <= MEMORY_SIZE - 4))) {
+        memcpy(&value, &mem.data[address], sizeof(value));
+        if (MEMORY_WORD_SWAP) {
+            value = swap32(value);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief reads a 32-bit instruction through a fetch buffer, the same
+ *        as read32Memory but without checks while in the buffered line
+ * @param mem memory to read from
+ * @param fetch fetch buffer of the CPU
+ * @param address location to read from
+ * @param value location to store value read
+ * @return true if success, otherwise false
+ */
+static inline bool fetch32Memory(const Memory &mem, FetchBuffer &fetch,
+                                 U32 address, U32 &value)
+{
+    U32 line = address & ~(U32)(MEMORY_PAGE_SIZE - 1);
+    FetchLine &held = fetchLineOf(fetch, address);
+
+    if (SOC_UNLIKELY((line != held.line) ||
+                     (mem.pageVersion[line >> MEMORY_PAGE_SHIFT] !=
+                      held.version))) {
+        if (!fillFetchBuffer(mem, fetch, address)) {
+            // Partial line at the end of memory, or out of range
+            return read32Memory(mem, address, value);
+        }
+    }
+
+    if (SOC_UNLIKELY((address & 0x3) != 0)) {
+        return false;
+    }
+
+    value = held.word[(address >> 2) & (FETCH_LINE_WORDS - 1)];
+
+    return true;
+}
+
+
+/**
+ * @brief writes 8-bit value to memory at address
+ * @param mem memory to write to
+ * @param address location to write to
+ * @param value value to store in memory
+ * @return true if success, otherwise false
+ */
+static inline bool write8Memory(Memory &mem, U32 address, const U8 &value)
+{
+    if (SOC_LIKELY(address < MEMORY_SIZE)) {
+        mem.data[address ^ MEMORY_XOR8] = value;
+        ++mem.pageVersion[address >> MEMORY_PAGE_SHIFT];
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief writes 16-bit value to memory at address
+ * @param mem memory to write to
+ * @param address location to write to
+ * @param value value to store in memory
+ * @return true if success, otherwise false
+ */
+static inline bool write16Memory(Memory &mem, U32 address, const U16 &value)
+{
+    if (SOC_LIKELY(((address & 0x1) == 0) && (address <= MEMORY_SIZE - 2))) {
+        U16 stored = MEMORY_WORD_SWAP ? swap16(value) : value;
+        memcpy(&mem.data[address ^ MEMORY_XOR16], &stored, sizeof(stored));
+        ++mem.pageVersion[address >> MEMORY_PAGE_SHIFT];
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief writes 32-bit value to memory at address
+ * @param mem memory to write to
+ * @param address location to write to
+ * @param value value to store in memory
+ * @return true if success, otherwise false
+ */
+static inline bool write32Memory(Memory &mem, U32 address, const U32 &value)
+{
+    if (SOC_LIKELY(((address & 0x3) == 0) && (address <= MEMORY_SIZE - 4))) {
+        U32 stored = MEMORY_WORD_SWAP ? swap32(value) : value;
+        memcpy(&mem.data[address], &stored, sizeof(stored));
+        ++mem.pageVersion[address >> MEMORY_PAGE_SHIFT];
+        return true;
+    }
+
+    return false;
+}
+
+#endif
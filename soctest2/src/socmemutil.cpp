@@ -0,0 +1,190 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Fill, compare and hash functions for memory
+ */
+
+#include "socmemutil.h"
+
+// Expected data is converted to memory order this many bytes at a time
+#define COMPARE_CHUNK_SIZE 4096
+
+
+/**
+ * @brief Sets every byte of memory to a value
+ * @param mem memory to fill
+ * @param value value to store
+ */
+void fillMemory(Memory &mem, U8 value)
+{
+    soc::memoryFill(mem.data, value, MEMORY_SIZE);
+    touchMemoryPages(mem, 0, MEMORY_SIZE);
+}
+
+
+/**
+ * @brief Finds the first byte, in guest address order, that differs
+ *        within the word holding storage offset
+ * @return guest address of first differing byte
+ */
+static U32 firstDifferenceInWord(const U8 *a, const U8 *b, U32 offset)
+{
+    U32 word = offset & ~0x3U;
+
+    for (U32 address=word; address<word + 4; ++address) {
+        if (a[address ^ MEMORY_XOR8] != b[address ^ MEMORY_XOR8]) {
+            return address;
+        }
+    }
+
+    return offset;
+}
+
+
+/**
+ * @brief Compares two memories
+ * @param a first memory
+ * @param b second memory
+ * @return address of the first byte that differs, MEMORY_SIZE if equal
+ */
+U32 compareMemory(const Memory &a, const Memory &b)
+{
+    U32 offset = (U32)soc::memoryCompare(a.data, b.data, MEMORY_SIZE);
+
+    if ((offset == MEMORY_SIZE) || (MEMORY_XOR8 == 0)) {
+        return offset;
+    }
+
+    return firstDifferenceInWord(a.data, b.data, offset);
+}
+
+
+/**
+ * @brief Compares memory against expected bytes, e.g. a golden image
+ * @param mem memory to check
+ * @param address first location to check
+ * @param expected expected bytes in SoC byte order
+ * @param length number of bytes to check
+ * @return address of the first byte that differs, address + length if
+ *         equal, and address if the range is outside of memory
+ */
+U32 compareMemoryBlock(const Memory &mem, U32 address,
+                       const U8 *expected, U32 length)
+{
+    if ((address > MEMORY_SIZE) || (length > (MEMORY_SIZE - address))) {
+        return address;
+    }
+
+    if (MEMORY_XOR8 == 0) {
+        return address + (U32)soc::memoryCompare(&mem.data[address],
+                                                 expected, length);
+    }
+
+    // Unaligned ranges are rare, check them a byte at a time
+    if (((address | length) & 0x3) != 0) {
+        for (U32 i=0; i<length; ++i) {
+            if (mem.data[(address + i) ^ MEMORY_XOR8] != expected[i]) {
+                return address + i;
+            }
+        }
+
+        return address + length;
+    }
+
+    // Swap expected words in to memory order, then compare
+    U8 chunk[COMPARE_CHUNK_SIZE];
+
+    for (U32 done=0; done<length; done+=COMPARE_CHUNK_SIZE) {
+        U32 size = length - done;
+
+        if (size > COMPARE_CHUNK_SIZE) {
+            size = COMPARE_CHUNK_SIZE;
+        }
+
+        for (U32 i=0; i<size; i+=4) {
+            U32 value = swap32(soc::memLoad32(&expected[done + i]));
+            memcpy(&chunk[i], &value, sizeof(value));
+        }
+
+        U32 offset = (U32)soc::memoryCompare(&mem.data[address + done],
+                                             chunk, size);
+        if (offset != size) {
+            U32 word = (address + done + offset) & ~0x3U;
+
+            for (U32 i=0; i<4; ++i) {
+                if (mem.data[(word + i) ^ MEMORY_XOR8] !=
+                    expected[word + i - address]) {
+                    return word + i;
+                }
+            }
+        }
+    }
+
+    return address + length;
+}
+
+
+/**
+ * @brief Drops every hash held by a cache
+ * @param cache cache to reset
+ */
+void resetMemoryHashCache(MemoryHashCache &cache)
+{
+    memset(cache.valid, 0, sizeof(cache.valid));
+}
+
+
+/**
+ * @brief Returns hash of one page, hashing it only if it changed
+ * @param mem memory to hash
+ * @param cache cache of page hashes for mem
+ * @param page page index, less than MEMORY_PAGE_COUNT
+ * @return hash of page
+ */
+U64 hashMemoryPage(const Memory &mem, MemoryHashCache &cache, U32 page)
+{
+    if (!cache.valid[page] || (cache.version[page] != mem.pageVersion[page])) {
+        U32 offset = page << MEMORY_PAGE_SHIFT;
+        U32 length = MEMORY_SIZE - offset;
+
+        if (length > MEMORY_PAGE_SIZE) {
+            length = MEMORY_PAGE_SIZE;
+        }
+
+        cache.hash[page] = soc::memoryHash(&mem.data[offset], length, page);
+        cache.version[page] = mem.pageVersion[page];
+        cache.valid[page] = 1;
+    }
+
+    return cache.hash[page];
+}
+
+
+/**
+ * @brief Returns hash of all of memory, only changed pages are hashed
+ * @param mem memory to hash
+ * @param cache cache of page hashes for mem
+ * @return hash of memory
+ */
+U64 hashMemory(const Memory &mem, MemoryHashCache &cache)
+{
+    for (U32 page=0; page<MEMORY_PAGE_COUNT; ++page) {
+        hashMemoryPage(mem, cache, page);
+    }
+
+    return soc::memoryHash((const U8*)cache.hash, sizeof(cache.hash));
+}
+
+
+/**
+ * @brief Returns hash of all of memory without a cache
+ * @param mem memory to hash
+ * @return hash of memory, same value as the cached version
+ */
+U64 hashMemory(const Memory &mem)
+{
+    MemoryHashCache cache;
+
+    resetMemoryHashCache(cache);
+
+    return hashMemory(mem, cache);
+}
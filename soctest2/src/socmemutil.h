@@ -0,0 +1,36 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains fill, compare and hash functions for memory
+ */
+
+#ifndef _EWATC_SOCMEMUTIL_H
+#define _EWATC_SOCMEMUTIL_H
+
+#include <soc/memutil.h>
+#include "socmemory.h"
+
+/**
+ * @brief Cached hash of every page of a memory, a page is hashed again
+ *        only when its pageVersion changed
+ */
+struct MemoryHashCache
+{
+    U32 version[MEMORY_PAGE_COUNT];
+    U64 hash[MEMORY_PAGE_COUNT];
+    U8 valid[MEMORY_PAGE_COUNT];
+};
+
+void fillMemory(Memory &mem, U8 value);
+
+U32 compareMemory(const Memory &a, const Memory &b);
+U32 compareMemoryBlock(const Memory &mem, U32 address,
+                       const U8 *expected, U32 length);
+
+// Hashes are of memory as stored, they only match hashes taken with
+// the same MEMORY_HOST_ORDER setting
+void resetMemoryHashCache(MemoryHashCache &cache);
+U64 hashMemoryPage(const Memory &mem, MemoryHashCache &cache, U32 page);
+U64 hashMemory(const Memory &mem, MemoryHashCache &cache);
+U64 hashMemory(const Memory &mem);
+
+#endif
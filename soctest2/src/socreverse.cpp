@@ -0,0 +1,380 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Reverse execution functions
+ */
+
+#include <string.h>
+#include "socreverse.h"
+#include "socdebug.h"
+
+
+/**
+ * @brief Returns bytes of history held by a snapshot
+ */
+static size_t reverseSnapshotBytes(const ReverseSnapshot &snapshot)
+{
+    return sizeof(snapshot) + (snapshot.pages.size() * sizeof(U32)) +
+           snapshot.data.size();
+}
+
+
+/**
+ * @brief Returns bytes of history held by the undo log
+ */
+static size_t reverseLogBytes(const ReverseHistory &history)
+{
+    return (history.entries.size() * sizeof(ReverseEntry)) +
+           (history.writes.size() * sizeof(ReverseWrite));
+}
+
+
+/**
+ * @brief Returns the size of a page, the last page may be partial
+ */
+static U32 reversePageLength(U32 page)
+{
+    U32 offset = page << MEMORY_PAGE_SHIFT;
+    U32 length = MEMORY_SIZE - offset;
+
+    return (length > MEMORY_PAGE_SIZE) ? MEMORY_PAGE_SIZE : length;
+}
+
+
+/**
+ * @brief Copies a CPU Context, keeping the debug, history, trace and
+ *        timing of ctx. The fetch buffer is dropped, memory was copied
+ *        under it.
+ */
+static void restoreReverseContext(CPUContext &ctx, const CPUContext &saved)
+{
+    DebugState *debug = ctx.debug;
+    ReverseHistory *history = ctx.history;
+    TraceStream *trace = ctx.trace;
+    soc::MemoryTiming *timing = ctx.timing;
+
+    ctx = saved;
+    ctx.debug = debug;
+    ctx.history = history;
+    ctx.trace = trace;
+    ctx.timing = timing;
+    invalidateFetchBuffer(ctx.fetch);
+}
+
+
+/**
+ * @brief Sets up an empty history, recording starts with the first
+ *        call of a recording executor
+ * @param history history to set up
+ * @param profile CPU profile of the CPU being recorded
+ * @param interval executor calls between snapshots, at most
+ * @param budget bytes of snapshots and undo log kept, a snapshot is
+ *               taken before the log would exceed it and the oldest
+ *               snapshots are dropped to stay within it
+ * @return true if success, false if the budget cannot hold a snapshot
+ *         and one undo entry
+ */
+bool initReverseHistory(ReverseHistory &history, const CPUProfile &profile,
+                        U64 interval, size_t budget)
+{
+    history.replay = selectCPUExecutor(profile, CPU_EXECUTE_RECORD);
+    if ((history.replay == NULL) || (interval == 0) ||
+        (budget < (sizeof(ReverseSnapshot) + REVERSE_ENTRY_BYTES))) {
+        return false;
+    }
+
+    history.interval = interval;
+    history.budget = budget;
+    history.used = 0;
+    history.position = 0;
+    history.snapshots.clear();
+    history.entries.clear();
+    history.writes.clear();
+
+    return true;
+}
+
+
+/**
+ * @brief Closes the current interval and starts a new one at the
+ *        current position. Only pages written since the last snapshot
+ *        are copied.
+ * @param history history to record in
+ * @param ctx CPU Context
+ * @param mem Memory
+ */
+void takeReverseSnapshot(ReverseHistory &history, const CPUContext &ctx,
+                         const Memory &mem)
+{
+    if (history.snapshots.empty()) {
+        history.shadow = mem;
+    } else {
+        ReverseSnapshot &last = history.snapshots.back();
+        size_t before = reverseSnapshotBytes(last);
+
+        for (U32 page=0; page<MEMORY_PAGE_COUNT; ++page) {
+            if (mem.pageVersion[page] == history.shadow.pageVersion[page]) {
+                continue;
+            }
+
+            U32 offset = page << MEMORY_PAGE_SHIFT;
+            U32 length = reversePageLength(page);
+
+            last.pages.push_back(page);
+            last.data.insert(last.data.end(),
+                             &history.shadow.data[offset],
+                             &history.shadow.data[offset] + length);
+
+            memcpy(&history.shadow.data[offset], &mem.data[offset], length);
+            history.shadow.pageVersion[page] = mem.pageVersion[page];
+        }
+
+        history.used += reverseSnapshotBytes(last) - before;
+    }
+
+    history.snapshots.push_back(ReverseSnapshot());
+
+    ReverseSnapshot &snapshot = history.snapshots.back();
+    snapshot.position = history.position;
+    snapshot.ctx = ctx;
+    history.used += reverseSnapshotBytes(snapshot);
+
+    history.used -= reverseLogBytes(history);
+    history.entries.clear();
+    history.writes.clear();
+
+    // Keep within budget, the newest snapshot is always kept
+    while ((history.used > history.budget) &&
+           (history.snapshots.size() > 1)) {
+        history.used -= reverseSnapshotBytes(history.snapshots.front());
+        history.snapshots.pop_front();
+    }
+}
+
+
+/**
+ * @brief Returns the earliest position the history can go back to
+ * @param history history
+ * @return position
+ */
+U64 oldestReversePosition(const ReverseHistory &history)
+{
+    if (history.snapshots.empty()) {
+        return history.position;
+    }
+
+    return history.snapshots.front().position;
+}
+
+
+/**
+ * @brief Undoes the last entry of the undo log
+ * @param history history
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param debug write watchpoints to check the undone writes against,
+ *              NULL to not check
+ */
+static void undoReverseEntry(ReverseHistory &history, CPUContext &ctx,
+                             Memory &mem, DebugState *debug)
+{
+    const ReverseEntry &entry = history.entries.back();
+
+    for (U32 i=0; i<entry.writeCount; ++i) {
+        const ReverseWrite &write = history.writes.back();
+
+        if (debug != NULL) {
+            checkDebugAccess(*debug, DEBUG_WATCH_WRITE, write.address, 4);
+        }
+
+        write32Memory(mem, write.address, write.value);
+        history.writes.pop_back();
+        history.used -= sizeof(ReverseWrite);
+    }
+
+    // Reverse order, so a register written twice gets its oldest value
+    for (U32 i=entry.regCount; i>0; --i) {
+        ctx.reg[entry.regIndex[i - 1]] = entry.regValue[i - 1];
+    }
+
+    ctx.reg[CPU_PC_INDEX(ctx.registerCount)] = entry.pc;
+    ctx.reg[CPU_SP_INDEX(ctx.registerCount)] = entry.sp;
+    ctx.instructionCount = entry.instructionCount;
+    ctx.cycleCount = entry.cycleCount;
+
+    history.entries.pop_back();
+    history.used -= sizeof(ReverseEntry);
+    --history.position;
+}
+
+
+/**
+ * @brief Restores the latest snapshot at or before target, later
+ *        snapshots are dropped
+ * @param history history
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param target position to restore to, at least the oldest position
+ */
+static void restoreReverseSnapshot(ReverseHistory &history, CPUContext &ctx,
+                                   Memory &mem, U64 target)
+{
+    // Back to the newest snapshot, the shadow holds it
+    for (U32 page=0; page<MEMORY_PAGE_COUNT; ++page) {
+        if (mem.pageVersion[page] != history.shadow.pageVersion[page]) {
+            U32 offset = page << MEMORY_PAGE_SHIFT;
+
+            memcpy(&mem.data[offset], &history.shadow.data[offset],
+                   reversePageLength(page));
+            touchMemoryPages(mem, offset, reversePageLength(page));
+        }
+    }
+
+    // Then back one interval at a time
+    while (history.snapshots.back().position > target) {
+        history.used -= reverseSnapshotBytes(history.snapshots.back());
+        history.snapshots.pop_back();
+
+        ReverseSnapshot &snapshot = history.snapshots.back();
+        const U8 *data = snapshot.data.data();
+
+        for (size_t i=0; i<snapshot.pages.size(); ++i) {
+            U32 offset = snapshot.pages[i] << MEMORY_PAGE_SHIFT;
+            U32 length = reversePageLength(snapshot.pages[i]);
+
+            memcpy(&mem.data[offset], data, length);
+            touchMemoryPages(mem, offset, length);
+            data += length;
+        }
+
+        // Interval is open again
+        history.used -= snapshot.pages.size() * sizeof(U32) +
+                        snapshot.data.size();
+        snapshot.pages.clear();
+        snapshot.data.clear();
+    }
+
+    history.shadow = mem;
+    restoreReverseContext(ctx, history.snapshots.back().ctx);
+    history.position = history.snapshots.back().position;
+    history.used -= reverseLogBytes(history);
+    history.entries.clear();
+    history.writes.clear();
+}
+
+
+/**
+ * @brief Replays forward with the recording executor, rebuilding the
+ *        undo log
+ */
+static void replayReverseHistory(ReverseHistory &history, CPUContext &ctx,
+                                 Memory &mem, U64 target)
+{
+    ReverseHistory *saved = ctx.history;
+
+    ctx.history = &history;
+    while (history.position < target) {
+        // Every call records exactly one entry, even if it fails
+        history.replay(ctx, mem);
+    }
+    ctx.history = saved;
+}
+
+
+/**
+ * @brief Moves the CPU and memory back to an earlier position
+ * @param history history
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param target position to go back to
+ * @return true if success, false if target is not within the history
+ */
+bool reverseToPosition(ReverseHistory &history, CPUContext &ctx,
+                       Memory &mem, U64 target)
+{
+    if ((target > history.position) ||
+        (target < oldestReversePosition(history))) {
+        return false;
+    }
+
+    if (target == history.position) {
+        return true;
+    }
+
+    if (target < history.snapshots.back().position) {
+        restoreReverseSnapshot(history, ctx, mem, target);
+        replayReverseHistory(history, ctx, mem, target);
+    }
+
+    while (history.position > target) {
+        undoReverseEntry(history, ctx, mem, NULL);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Moves the CPU back by one executor call
+ * @param history history
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @return true if success, false at the start of the history
+ */
+bool reverseStep(ReverseHistory &history, CPUContext &ctx, Memory &mem)
+{
+    if (history.position == oldestReversePosition(history)) {
+        return false;
+    }
+
+    return reverseToPosition(history, ctx, mem, history.position - 1);
+}
+
+
+/**
+ * @brief Runs backwards until a breakpoint of ctx.debug is reached or
+ *        an undone write matches one of its write watchpoints. Read
+ *        watchpoints are not seen going backwards.
+ * @param history history
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @return true if stopped by a debug point, ctx.debug->hit is set,
+ *         false at the start of the history
+ */
+bool reverseContinue(ReverseHistory &history, CPUContext &ctx, Memory &mem)
+{
+    DebugState *debug = ctx.debug;
+    U64 oldest = oldestReversePosition(history);
+
+    if (debug != NULL) {
+        debug->hit.hit = false;
+    }
+
+    while (history.position > oldest) {
+        if (history.entries.empty()) {
+            // Rebuild the undo log of the previous interval
+            U64 position = history.position;
+
+            restoreReverseSnapshot(history, ctx, mem, position - 1);
+            replayReverseHistory(history, ctx, mem, position);
+        }
+
+        undoReverseEntry(history, ctx, mem, debug);
+
+        if (debug == NULL) {
+            continue;
+        }
+
+        U32 pc = ctx.reg[CPU_PC_INDEX(ctx.registerCount)];
+
+        if (!debug->hit.hit && debugPageSet(*debug, DEBUG_BREAK_EXECUTE, pc)) {
+            matchDebugPoint(*debug, DEBUG_BREAK_EXECUTE, pc, 1);
+        }
+
+        if (debug->hit.hit) {
+            debug->hit.pc = pc;
+            return true;
+        }
+    }
+
+    return false;
+}
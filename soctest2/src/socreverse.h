@@ -0,0 +1,163 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains reverse execution, going back to any
+ *        earlier instruction of a run
+ */
+
+#ifndef _EWATC_SOCREVERSE_H
+#define _EWATC_SOCREVERSE_H
+
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include "socbasic.h"
+#include "socisa.h"
+
+// Budget used when none is given
+#define REVERSE_DEFAULT_BUDGET (16 * 1024 * 1024)
+
+// History is kept as:
+//   snapshots  CPUContext every interval executor calls, plus the old
+//              contents of every page written before the next snapshot
+//   undo log   per executor call since the last snapshot, the registers
+//              and memory words it overwrote
+// Going back within the undo log pops entries. Going back further
+// restores the nearest earlier snapshot and replays forward with a
+// recording executor, which rebuilds the undo log on the way.
+// Snapshots and the undo log share the budget, a snapshot is taken
+// early when the log would not fit.
+
+struct ReverseEntry
+{
+    U32 pc;
+    U32 sp;
+    U64 instructionCount;
+    U64 cycleCount;
+    U32 regValue[ISA_MAX_FIELDS];
+    U8 regIndex[ISA_MAX_FIELDS];
+    U8 regCount;
+    U32 writeCount;     // entries of ReverseHistory::writes
+};
+
+struct ReverseWrite
+{
+    U32 address;
+    U32 value;          // value before the write
+};
+
+struct ReverseSnapshot
+{
+    U64 position;
+    CPUContext ctx;
+    std::vector<U32> pages;     // pages written before the next snapshot
+    std::vector<U8> data;       // their contents at position
+};
+
+// Undo log bytes of one executor call, an instruction writes at most
+// one memory word
+#define REVERSE_ENTRY_BYTES (sizeof(ReverseEntry) + sizeof(ReverseWrite))
+
+struct ReverseHistory
+{
+    U64 interval;               // most executor calls between snapshots
+    size_t budget;              // bytes of snapshots and undo log kept
+    size_t used;
+    CPUExecuteFunction replay;  // recording executor of the profile
+
+    U64 position;               // executor calls recorded so far
+    std::deque<ReverseSnapshot> snapshots;
+    Memory shadow;              // memory at the last snapshot
+    std::vector<ReverseEntry> entries;
+    std::vector<ReverseWrite> writes;
+};
+
+bool initReverseHistory(ReverseHistory &history, const CPUProfile &profile,
+                        U64 interval, size_t budget);
+void takeReverseSnapshot(ReverseHistory &history, const CPUContext &ctx,
+                         const Memory &mem);
+
+U64 oldestReversePosition(const ReverseHistory &history);
+bool reverseToPosition(ReverseHistory &history, CPUContext &ctx,
+                       Memory &mem, U64 target);
+bool reverseStep(ReverseHistory &history, CPUContext &ctx, Memory &mem);
+bool reverseContinue(ReverseHistory &history, CPUContext &ctx, Memory &mem);
+
+
+/**
+ * @brief Starts the undo entry of one executor call, called by
+ *        recording executors before the instruction is fetched
+ * @param history history to record in
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param pc PC index of the profile
+ * @param sp SP index of the profile
+ */
+static inline void beginReverseEntry(ReverseHistory &history,
+                                     const CPUContext &ctx,
+                                     const Memory &mem, U32 pc, U32 sp)
+{
+    if (history.snapshots.empty() ||
+        ((history.position - history.snapshots.back().position) >=
+         history.interval) ||
+        (!history.entries.empty() &&
+         ((history.used + REVERSE_ENTRY_BYTES) > history.budget))) {
+        takeReverseSnapshot(history, ctx, mem);
+    }
+
+    ReverseEntry entry;
+
+    entry.pc = ctx.reg[pc];
+    entry.sp = ctx.reg[sp];
+    entry.instructionCount = ctx.instructionCount;
+    entry.cycleCount = ctx.cycleCount;
+    entry.regCount = 0;
+    entry.writeCount = 0;
+
+    history.entries.push_back(entry);
+    history.used += sizeof(entry);
+    ++history.position;
+}
+
+
+/**
+ * @brief Records a register the current instruction writes
+ * @param history history to record in
+ * @param ctx CPU Context
+ * @param regIndex register written
+ */
+static inline void recordReverseRegister(ReverseHistory &history,
+                                         const CPUContext &ctx, U8 regIndex)
+{
+    ReverseEntry &entry = history.entries.back();
+
+    entry.regIndex[entry.regCount] = regIndex;
+    entry.regValue[entry.regCount] = ctx.reg[regIndex];
+    ++entry.regCount;
+}
+
+
+/**
+ * @brief Records the memory word the current instruction writes,
+ *        writes that will fault are not recorded
+ * @param history history to record in
+ * @param mem Memory
+ * @param address location written
+ */
+static inline void recordReverseWrite(ReverseHistory &history,
+                                      const Memory &mem, U32 address)
+{
+    ReverseWrite write;
+
+    if (((address & 0x3) != 0) || (address > MEMORY_SIZE - 4)) {
+        return;
+    }
+
+    write.address = address;
+    read32Memory(mem, address, write.value);
+
+    history.writes.push_back(write);
+    history.used += sizeof(write);
+    ++history.entries.back().writeCount;
+}
+
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Sampled simulation, fast forwards with the fusing executor and
+ *        measures short windows with the timing executor
+ */
+
+#include <math.h>
+#include <string.h>
+#include "socsample.h"
+
+// Names of SampleMetric, in order
+static const char *const sampleMetricNames[SAMPLE_METRIC_COUNT] = {
+    "stall cycles",
+    "icache misses",
+    "dcache misses",
+    "tlb misses"
+};
+
+// Student's t of a two sided 95% interval by degrees of freedom, from 1,
+// the normal 1.96 is used past the table
+static const double sampleStudentT[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+#define SAMPLE_STUDENT_T_COUNT \
+    (sizeof(sampleStudentT) / sizeof(sampleStudentT[0]))
+
+
+/**
+ * @brief Fills in a config that times a window of 10000 instructions
+ *        after 1000 of warmup every million instructions, with no limit
+ * @param config config to fill in
+ */
+void defaultSampleConfig(SampleConfig &config)
+{
+    config.skip = 989000;
+    config.warmup = 1000;
+    config.window = 10000;
+    config.limit = ~0ULL;
+    config.timing = soc::defaultTimingConfig();
+}
+
+
+/**
+ * @brief Reads the counters of a cache model as SampleMetric
+ * @param timing cache model
+ * @param counters location to store a value per metric
+ */
+static void readSampleCounters(const soc::MemoryTiming &timing,
+                               double counters[SAMPLE_METRIC_COUNT])
+{
+    counters[SAMPLE_STALL_CYCLES] = (double)timing.getStallCycles();
+    counters[SAMPLE_ICACHE_MISSES] = (double)timing.getICacheStats().misses;
+    counters[SAMPLE_DCACHE_MISSES] = (double)timing.getDCacheStats().misses;
+    counters[SAMPLE_TLB_MISSES] = (double)timing.getTLBStats().misses;
+}
+
+
+/**
+ * @brief Runs one phase of a sampled run
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param execute executor of the phase
+ * @param idle idle loop state, NULL to interpret every instruction
+ * @param count instructions to run
+ * @param ran location to add the instructions run to
+ * @return false if the CPU stopped, otherwise true
+ */
+static bool runSamplePhase(CPUContext &ctx, Memory &mem,
+                           CPUExecuteFunction execute, IdleLoop *idle,
+                           U64 count, U64 &ran)
+{
+    U32 pcIndex = CPU_PC_INDEX(ctx.registerCount);
+    U64 done = 0;
+    bool retval = true;
+
+    while (done < count) {
+        U32 oldPC = ctx.reg[pcIndex];
+
+        if (!stepCPU(ctx, mem, execute, count - done, done)) {
+            retval = false;
+            break;
+        }
+
+        if ((idle != NULL) && checkIdleLoop(*idle, ctx, mem, oldPC)) {
+            done += skipIdleLoop(*idle, ctx, count - done);
+        }
+    }
+
+    ran += done;
+
+    return retval;
+}
+
+
+/**
+ * @brief Scales what the windows measured up to the whole run. The
+ *        windows are a sample of the run, the rate per instruction of
+ *        each is one observation.
+ * @param measured total measured by every window
+ * @param sum sum of the rates of the windows
+ * @param sumSquares sum of the squared rates of the windows
+ * @param result result holding the instructions and windows of the run
+ * @return estimate
+ */
+static SampleEstimate estimateSampleTotal(double measured, double sum,
+                                          double sumSquares,
+                                          const SampleResult &result)
+{
+    SampleEstimate estimate;
+    double instructions = (double)result.instructions;
+    U32 n = result.windows;
+
+    estimate.total = 0.0;
+    estimate.error = -1.0;
+
+    if (result.measured == 0) {
+        return estimate;
+    }
+
+    estimate.total = measured * instructions / (double)result.measured;
+
+    if (n < 2) {
+        return estimate;
+    }
+
+    double mean = sum / n;
+    double variance = (sumSquares - (n * mean * mean)) / (n - 1);
+    // Nothing is left to estimate once every instruction was measured
+    double unmeasured = 1.0 - ((double)result.measured / instructions);
+    double t = ((n - 1) <= SAMPLE_STUDENT_T_COUNT) ?
+                   sampleStudentT[n - 2] : 1.96;
+
+    if ((variance < 0.0) || (unmeasured < 0.0)) {
+        variance = 0.0;
+    }
+
+    estimate.error = t * sqrt(variance * unmeasured / n) * instructions;
+
+    return estimate;
+}
+
+
+/**
+ * @brief Runs the loaded program sampled until it stops or the limit is
+ *        reached. Registers, memory and counters end exactly as in a
+ *        run without sampling, only the cache model is estimated.
+ * @param ctx CPU Context, reset and loaded
+ * @param mem Memory
+ * @param profile CPU profile ctx was reset with
+ * @param config skip, warmup and window lengths
+ * @param result location to store the estimates
+ * @return true if the run was sampled, false if the profile is not
+ *         supported or the window is empty
+ */
+bool runSampled(CPUContext &ctx, Memory &mem, const CPUProfile &profile,
+                const SampleConfig &config, SampleResult &result)
+{
+    CPUExecuteFunction fast = selectCPUExecutor(profile, CPU_EXECUTE_FUSE);
+    CPUExecuteFunction timed = selectCPUExecutor(profile,
+                                                 CPU_EXECUTE_TIMING);
+
+    if ((fast == NULL) || (timed == NULL) || (config.window == 0)) {
+        return false;
+    }
+
+    soc::MemoryTiming timing(config.timing);
+    IdleLoop idle;
+    double measured[SAMPLE_METRIC_COUNT];
+    double sum[SAMPLE_METRIC_COUNT];
+    double sumSquares[SAMPLE_METRIC_COUNT];
+    U64 startCycles = ctx.cycleCount;
+    U64 ran = 0;
+    bool running = true;
+
+    memset(&result, 0, sizeof(result));
+    for (U32 i=0; i<SAMPLE_METRIC_COUNT; ++i) {
+        measured[i] = 0.0;
+        sum[i] = 0.0;
+        sumSquares[i] = 0.0;
+    }
+
+    resetIdleLoop(idle);
+
+    while (running && (ran < config.limit)) {
+        U64 left = config.limit - ran;
+
+        running = runSamplePhase(ctx, mem, fast, &idle,
+                                 (config.skip < left) ? config.skip : left,
+                                 ran);
+        if (!running || (ran >= config.limit)) {
+            break;
+        }
+
+        // Same context and memory, only the executor changes
+        ctx.timing = &timing;
+
+        left = config.limit - ran;
+        running = runSamplePhase(ctx, mem, timed, NULL,
+                                 (config.warmup < left) ? config.warmup :
+                                                          left,
+                                 ran);
+
+        if (running && (ran < config.limit)) {
+            double before[SAMPLE_METRIC_COUNT];
+            double after[SAMPLE_METRIC_COUNT];
+            U64 first = ran;
+
+            left = config.limit - ran;
+            readSampleCounters(timing, before);
+            running = runSamplePhase(ctx, mem, timed, NULL,
+                                     (config.window < left) ? config.window :
+                                                              left,
+                                     ran);
+            readSampleCounters(timing, after);
+
+            U64 length = ran - first;
+            if (length > 0) {
+                ++result.windows;
+                result.measured += length;
+
+                for (U32 i=0; i<SAMPLE_METRIC_COUNT; ++i) {
+                    double delta = after[i] - before[i];
+                    double rate = delta / (double)length;
+
+                    measured[i] += delta;
+                    sum[i] += rate;
+                    sumSquares[i] += rate * rate;
+                }
+            }
+        }
+
+        ctx.timing = NULL;
+    }
+
+    result.finished = !running;
+    result.instructions = ran;
+    result.baseCycles = ctx.cycleCount - startCycles;
+
+    for (U32 i=0; i<SAMPLE_METRIC_COUNT; ++i) {
+        result.metric[i] = estimateSampleTotal(measured[i], sum[i],
+                                               sumSquares[i], result);
+    }
+
+    result.cycles = result.metric[SAMPLE_STALL_CYCLES];
+    result.cycles.total += (double)result.baseCycles;
+
+    return true;
+}
+
+
+/**
+ * @brief Returns a string describing a SampleMetric
+ * @param metric SampleMetric
+ * @return string, "unknown" if out of range
+ */
+const char *describeSampleMetric(U32 metric)
+{
+    return (metric < SAMPLE_METRIC_COUNT) ? sampleMetricNames[metric] :
+                                            "unknown";
+}
+
+
+/**
+ * @brief Prints an estimate with its 95% confidence interval
+ */
+static void writeSampleEstimate(FILE *fp, const char *name,
+                                const SampleEstimate &estimate)
+{
+    if (estimate.error < 0.0) {
+        fprintf(fp, "\t%-14s %.0f\n", name, estimate.total);
+    } else {
+        fprintf(fp, "\t%-14s %.0f +/- %.0f (95%%)\n", name, estimate.total,
+                estimate.error);
+    }
+}
+
+
+/**
+ * @brief Prints the estimates of a sampled run
+ * @param fp file to print to
+ * @param result result of runSampled
+ */
+void writeSampleResult(FILE *fp, const SampleResult &result)
+{
+    fprintf(fp, "Sampled %u windows, %llu of %llu instructions measured%s\n",
+            result.windows, result.measured, result.instructions,
+            result.finished ? "" : ", limit reached");
+
+    writeSampleEstimate(fp, "cycles", result.cycles);
+    for (U32 i=0; i<SAMPLE_METRIC_COUNT; ++i) {
+        writeSampleEstimate(fp, describeSampleMetric(i), result.metric[i]);
+    }
+}
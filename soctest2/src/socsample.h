@@ -0,0 +1,66 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains sampled simulation, a fast run with short
+ *        detailed windows that estimate totals of the whole run
+ */
+
+#ifndef _EWATC_SOCSAMPLE_H
+#define _EWATC_SOCSAMPLE_H
+
+#include <stdio.h>
+#include <soc/memtiming.h>
+#include "socbasic.h"
+
+// Totals estimated from the windows of a sampled run
+enum SampleMetric {
+    SAMPLE_STALL_CYCLES,
+    SAMPLE_ICACHE_MISSES,
+    SAMPLE_DCACHE_MISSES,
+    SAMPLE_TLB_MISSES,
+    SAMPLE_METRIC_COUNT
+};
+
+/**
+ * @brief How a sampled run alternates between executors. The fusing
+ *        executor runs skip instructions, then the timing executor runs
+ *        warmup instructions to refill the caches and window
+ *        instructions that are measured, over and over. Both run on the
+ *        same CPU context and memory, so switching costs nothing.
+ */
+struct SampleConfig
+{
+    U64 skip;               // instructions run fast before each window
+    U64 warmup;             // instructions timed but not measured
+    U64 window;             // instructions measured, at least 1
+    U64 limit;              // instructions of the whole run
+    soc::TimingConfig timing;
+};
+
+/**
+ * @brief Estimate of a total over the whole run
+ */
+struct SampleEstimate
+{
+    double total;
+    double error;           // half width of the 95% confidence interval,
+                            // negative with less than two windows
+};
+
+struct SampleResult
+{
+    bool finished;          // program stopped before the limit
+    U64 instructions;       // run in total
+    U64 measured;           // run in measured windows
+    U32 windows;
+    U64 baseCycles;         // cycles of the instructions, exact
+    SampleEstimate metric[SAMPLE_METRIC_COUNT];
+    SampleEstimate cycles;  // base cycles and stall cycles
+};
+
+void defaultSampleConfig(SampleConfig &config);
+bool runSampled(CPUContext &ctx, Memory &mem, const CPUProfile &profile,
+                const SampleConfig &config, SampleResult &result);
+const char *describeSampleMetric(U32 metric);
+void writeSampleResult(FILE *fp, const SampleResult &result);
+
+#endif
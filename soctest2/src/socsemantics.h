@@ -0,0 +1,297 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the semantics of every CPU instruction
+ */
+
+#ifndef _EWATC_SOCSEMANTICS_H
+#define _EWATC_SOCSEMANTICS_H
+
+#include <soc/memtiming.h>
+#include "socbasic.h"
+#include "socisa.h"
+#include "socdebug.h"
+#include "socreverse.h"
+#include "soctrace.h"
+
+/**
+ * @brief Decoded instruction fields, register fields are already
+ *        bounds checked by the decoder
+ */
+struct ISAOperands
+{
+    U8 reg[ISA_MAX_FIELDS];
+    U32 imm;    // IMM16 zero extended, OFF8 sign extended
+};
+
+/**
+ * @brief Compile time view of a CPU profile, executors are
+ *        instantiated once per supported profile
+ */
+template <U32 RegisterCount, U32 InstructionSize, U32 Features=0>
+struct CPUProfileTraits
+{
+    enum {
+        REGISTER_COUNT = RegisterCount,
+        PC = CPU_PC_INDEX(RegisterCount),
+        SP = CPU_SP_INDEX(RegisterCount),
+        INSTRUCTION_SIZE = InstructionSize,
+        DEBUG = ((Features & CPU_EXECUTE_DEBUG) != 0),
+        RECORD = ((Features & CPU_EXECUTE_RECORD) != 0),
+        TRACE = ((Features & CPU_EXECUTE_TRACE) != 0),
+        FUSE = (Features == CPU_EXECUTE_FUSE),
+        TIMING = (Features == CPU_EXECUTE_TIMING)
+    };
+};
+
+
+/**
+ * @brief Records a fault of the current instruction, the executor adds
+ *        the pc
+ * @param ctx CPU Context
+ * @param kind CPUFaultKind
+ * @param address address accessed
+ * @param size bytes accessed
+ * @return false, so semantics can return it
+ */
+static inline bool raiseCPUFault(CPUContext &ctx, U32 kind, U32 address,
+                                 U32 size)
+{
+    ctx.fault.kind = kind;
+    ctx.fault.address = address;
+    ctx.fault.size = size;
+
+    return false;
+}
+
+
+/**
+ * @brief Reads a 32-bit value for an instruction, watchpoints are
+ *        only checked by debug profiles and the cache model only
+ *        timed by timing profiles
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param address location to read from
+ * @param value location to store value read
+ * @return true if success, otherwise false with a read fault raised
+ */
+template <typename Profile>
+static inline bool loadMemory32(CPUContext &ctx, const Memory &mem,
+                                U32 address, U32 &value)
+{
+    if (Profile::DEBUG && (ctx.debug != NULL)) {
+        checkDebugAccess(*ctx.debug, DEBUG_WATCH_READ, address, 4);
+    }
+
+    if (Profile::TIMING && (ctx.timing != NULL)) {
+        ctx.timing->access(soc::TIMING_READ, address);
+    }
+
+    if (SOC_LIKELY(read32Memory(mem, address, value))) {
+        return true;
+    }
+
+    return raiseCPUFault(ctx, CPU_FAULT_READ, address, 4);
+}
+
+
+/**
+ * @brief Writes a 32-bit value for an instruction, watchpoints are
+ *        only checked by debug profiles and the old value is only
+ *        logged by recording profiles
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param address location to write to
+ * @param value value to store in memory
+ * @return true if success, otherwise false with a write fault raised
+ */
+template <typename Profile>
+static inline bool storeMemory32(CPUContext &ctx, Memory &mem,
+                                 U32 address, U32 value)
+{
+    if (Profile::DEBUG && (ctx.debug != NULL)) {
+        checkDebugAccess(*ctx.debug, DEBUG_WATCH_WRITE, address, 4);
+    }
+
+    if (Profile::RECORD && (ctx.history != NULL)) {
+        recordReverseWrite(*ctx.history, mem, address);
+    }
+
+    if (Profile::TIMING && (ctx.timing != NULL)) {
+        ctx.timing->access(soc::TIMING_WRITE, address);
+    }
+
+    if (SOC_LIKELY(write32Memory(mem, address, value))) {
+        if (Profile::TRACE && (ctx.trace != NULL)) {
+            traceMemoryWrite(*ctx.trace, address, value);
+        }
+        return true;
+    }
+
+    return raiseCPUFault(ctx, CPU_FAULT_WRITE, address, 4);
+}
+
+// Each functor named in ISA_INSTRUCTIONS provides
+//   template <typename Profile>
+//   static bool execute(CPUContext &ctx, Memory &mem, const ISAOperands &op)
+// returning false after raising a fault, Profile is a CPUProfileTraits.
+// Registers are only changed once nothing can fault, so faults are
+// precise.
+
+// LOAD LOW Immediate data into register
+struct ISALoadLow
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        U32 value = ctx.reg[op.reg[0]];
+
+        ctx.reg[op.reg[0]] = (value&0xFFFF0000) | op.imm;
+
+        return true;
+    }
+};
+
+// LOAD HIGH Immediate data into register
+struct ISALoadHigh
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        U32 value = ctx.reg[op.reg[0]];
+
+        ctx.reg[op.reg[0]] = (value&0x0000FFFF) | (op.imm << 16);
+
+        return true;
+    }
+};
+
+// ADD reg1 + reg2 -> reg3
+struct ISAAdd
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        ctx.reg[op.reg[2]] = ctx.reg[op.reg[0]] + ctx.reg[op.reg[1]];
+
+        return true;
+    }
+};
+
+// SUB reg1 - reg2 -> reg3
+struct ISASub
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        ctx.reg[op.reg[2]] = ctx.reg[op.reg[0]] - ctx.reg[op.reg[1]];
+
+        return true;
+    }
+};
+
+// DIV reg1 / reg2 -> reg3, unsigned, divide by zero faults
+struct ISADiv
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        U32 divisor = ctx.reg[op.reg[1]];
+
+        if (divisor == 0) {
+            return raiseCPUFault(ctx, CPU_FAULT_DIVIDE, 0, 0);
+        }
+
+        ctx.reg[op.reg[2]] = ctx.reg[op.reg[0]] / divisor;
+
+        return true;
+    }
+};
+
+// STORE mem[reg1 + offset] <- reg2
+struct ISAStore
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        return storeMemory32<Profile>(ctx, mem,
+                                      ctx.reg[op.reg[0]] + op.imm,  // address
+                                      ctx.reg[op.reg[1]]);          // value
+    }
+};
+
+// LOAD reg2 <- mem[reg1 + offset]
+struct ISALoad
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        U32 value;
+
+        if (!loadMemory32<Profile>(ctx, mem,
+                                   ctx.reg[op.reg[0]] + op.imm, // address
+                                   value)) {
+            return false;
+        }
+
+        ctx.reg[op.reg[1]] = value;
+
+        return true;
+    }
+};
+
+// PUSH SP = SP - 4, mem[SP] = reg1
+struct ISAPush
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        U32 sp = ctx.reg[Profile::SP] - 4;
+        // SP is updated first, so PUSH SP stores the new SP
+        U32 value = (op.reg[0] == Profile::SP) ? sp : ctx.reg[op.reg[0]];
+
+        // Store value on the stack
+        if (!storeMemory32<Profile>(ctx, mem, sp, value)) {
+            return false;
+        }
+
+        // Update Stack Pointer
+        ctx.reg[Profile::SP] = sp;
+
+        return true;
+    }
+};
+
+// POP reg1 = mem[SP], SP = SP + 4
+struct ISAPop
+{
+    template <typename Profile>
+    static inline bool execute(CPUContext &ctx, Memory &mem,
+                               const ISAOperands &op)
+    {
+        U32 sp = ctx.reg[Profile::SP];
+        U32 value;
+
+        // Load value off of the stack
+        if (!loadMemory32<Profile>(ctx, mem, sp, value)) {
+            return false;
+        }
+
+        // Register is written first, so POP SP gets the value + 4
+        ctx.reg[op.reg[0]] = value;
+
+        // Update Stack Pointer
+        ctx.reg[Profile::SP] += 4;
+
+        return true;
+    }
+};
+
+#endif
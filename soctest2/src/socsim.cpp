@@ -0,0 +1,231 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Library interface functions
+ */
+
+#include <new>
+#include "socsim.h"
+#include "socimage.h"
+
+struct SimInstance
+{
+    CPUContext ctx;
+    Memory mem;
+    CPUProfile profile;
+    CPUExecuteFunction execute;
+    soc::PageBlock pages;       // mapping holding this instance
+};
+
+
+/**
+ * @brief Creates an instance and resets it, memory holds
+ *        MEMORY_RESET_VALUE until an image is loaded
+ * @param profile CPU profile of the instance
+ * @param policy pages backing the instance
+ * @return instance, NULL if the profile is not supported or out of
+ *         memory
+ */
+SimInstance *createSimInstance(const CPUProfile &profile,
+                               const soc::MemoryPolicy &policy)
+{
+    CPUExecuteFunction execute = selectCPUExecutor(profile,
+                                                   CPU_EXECUTE_FUSE);
+    soc::PageBlock pages;
+
+    if (execute == NULL) {
+        return NULL;
+    }
+
+    if (!soc::allocatePages(sizeof(SimInstance), policy, pages)) {
+        return NULL;
+    }
+
+    SimInstance *sim = new (pages.base) SimInstance;
+
+    sim->profile = profile;
+    sim->execute = execute;
+    sim->pages = pages;
+
+    if (!resetSim(*sim)) {
+        destroySimInstance(sim);
+        return NULL;
+    }
+
+    return sim;
+}
+
+
+/**
+ * @brief Destroys an instance
+ * @param sim instance to destroy, may be NULL
+ */
+void destroySimInstance(SimInstance *sim)
+{
+    if (sim == NULL) {
+        return;
+    }
+
+    soc::PageBlock pages = sim->pages;
+
+    sim->~SimInstance();
+    soc::freePages(pages);
+}
+
+
+/**
+ * @brief Resets the CPU and memory of an instance
+ * @param sim instance
+ * @return true if success, otherwise false
+ */
+bool resetSim(SimInstance &sim)
+{
+    return resetSoC(sim.ctx, sim.mem, sim.profile);
+}
+
+
+/**
+ * @brief Loads a binary image, see socimage.h, in to memory
+ * @param sim instance
+ * @param image image to load
+ * @param size size of image in bytes
+ * @return true if success, otherwise false
+ */
+bool loadSimImage(SimInstance &sim, const U8 *image, U32 size)
+{
+    return loadImage(sim.mem, image, size);
+}
+
+
+/**
+ * @brief Runs instructions until count have run or the CPU stops. The
+ *        fault of a previous run is cleared first, so a CPU stopped by
+ *        a fault runs the faulting instruction again unless its state
+ *        was changed. A loop that changes nothing is not interpreted
+ *        to the end of the run, its counters are moved past the
+ *        iterations that fit instead.
+ * @param sim instance
+ * @param count instructions to run
+ * @param ran location to store instructions run, including one that
+ *            stopped the CPU
+ * @return SimStopReason
+ */
+U32 runSim(SimInstance &sim, U64 count, U64 &ran)
+{
+    ran = 0;
+
+    if (sim.execute == NULL) {
+        return SIM_STOP_INVALID;
+    }
+
+    IdleLoop idle;
+    U32 pcIndex = CPU_PC_INDEX(sim.ctx.registerCount);
+
+    sim.ctx.fault.kind = CPU_FAULT_NONE;
+    resetIdleLoop(idle);
+
+    while (ran < count) {
+        U32 oldPC = sim.ctx.reg[pcIndex];
+
+        if (!stepCPU(sim.ctx, sim.mem, sim.execute, count - ran, ran)) {
+            return SIM_STOP_FINISHED;
+        }
+
+        if (checkIdleLoop(idle, sim.ctx, sim.mem, oldPC)) {
+            ran += skipIdleLoop(idle, sim.ctx, count - ran);
+        }
+    }
+
+    return SIM_STOP_LIMIT;
+}
+
+
+/**
+ * @brief Returns the CPU state of an instance, counters and the fault
+ *        of the last run included
+ * @param sim instance
+ * @return CPU context, valid until the instance is destroyed
+ */
+const CPUContext &getSimContext(const SimInstance &sim)
+{
+    return sim.ctx;
+}
+
+
+/**
+ * @brief Returns the profile an instance was created with
+ * @param sim instance
+ * @return CPU profile, its registerCount locates PC and SP
+ */
+const CPUProfile &getSimProfile(const SimInstance &sim)
+{
+    return sim.profile;
+}
+
+
+/**
+ * @brief Reads a register
+ * @param sim instance
+ * @param index register, less than the profile's registerCount
+ * @param value location to store value
+ * @return true if success, false if index is out of range
+ */
+bool getSimRegister(const SimInstance &sim, U32 index, U32 &value)
+{
+    if (index >= sim.ctx.registerCount) {
+        return false;
+    }
+
+    value = sim.ctx.reg[index];
+
+    return true;
+}
+
+
+/**
+ * @brief Writes a register
+ * @param sim instance
+ * @param index register, less than the profile's registerCount
+ * @param value value to store
+ * @return true if success, false if index is out of range
+ */
+bool setSimRegister(SimInstance &sim, U32 index, U32 value)
+{
+    if (index >= sim.ctx.registerCount) {
+        return false;
+    }
+
+    sim.ctx.reg[index] = value;
+
+    return true;
+}
+
+
+/**
+ * @brief Copies bytes out of memory in SoC byte order
+ * @param sim instance
+ * @param address first location to read
+ * @param dst location to store bytes
+ * @param length number of bytes to copy
+ * @return true if success, false if the range is outside of memory
+ */
+bool readSimMemory(const SimInstance &sim, U32 address, U8 *dst,
+                   U32 length)
+{
+    return readMemoryBlock(sim.mem, address, dst, length);
+}
+
+
+/**
+ * @brief Copies bytes in SoC byte order in to memory, instructions
+ *        already fetched from the range are fetched again
+ * @param sim instance
+ * @param address first location to write
+ * @param src bytes to copy
+ * @param length number of bytes to copy
+ * @return true if success, false if the range is outside of memory
+ */
+bool writeSimMemory(SimInstance &sim, U32 address, const U8 *src,
+                    U32 length)
+{
+    return writeMemoryBlock(sim.mem, address, src, length);
+}
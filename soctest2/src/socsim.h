@@ -0,0 +1,48 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the library interface for embedding the
+ *        simulator in another program
+ */
+
+#ifndef _EWATC_SOCSIM_H
+#define _EWATC_SOCSIM_H
+
+#include <soc/pagealloc.h>
+#include "socbasic.h"
+
+// Everything below works on one instance and keeps no other state, so
+// instances can be driven from any number of threads as long as each
+// instance is only used by one thread at a time. Nothing is printed,
+// as long as the library is built without CPU_TRACE_ENABLED (the
+// default for optimized builds).
+
+// Instance of one SoC, created by createSimInstance
+struct SimInstance;
+
+// Why runSim returned
+enum SimStopReason {
+    SIM_STOP_LIMIT,         // every instruction asked for ran
+    SIM_STOP_FINISHED,      // the CPU stopped, see getSimContext().fault
+    SIM_STOP_INVALID        // instance was not usable
+};
+
+SimInstance *createSimInstance(const CPUProfile &profile=defaultCPUProfile,
+                               const soc::MemoryPolicy &policy=
+                                   soc::defaultMemoryPolicy());
+void destroySimInstance(SimInstance *sim);
+
+bool resetSim(SimInstance &sim);
+bool loadSimImage(SimInstance &sim, const U8 *image, U32 size);
+
+U32 runSim(SimInstance &sim, U64 count, U64 &ran);
+
+const CPUContext &getSimContext(const SimInstance &sim);
+const CPUProfile &getSimProfile(const SimInstance &sim);
+bool getSimRegister(const SimInstance &sim, U32 index, U32 &value);
+bool setSimRegister(SimInstance &sim, U32 index, U32 value);
+bool readSimMemory(const SimInstance &sim, U32 address, U8 *dst,
+                   U32 length);
+bool writeSimMemory(SimInstance &sim, U32 address, const U8 *src,
+                    U32 length);
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * @author Wayne Moorefield
+ * @brief C interface functions, each one forwards to socsim.h
+ */
+
+#include "socsim.h"
+#include "socsimc.h"
+
+// socsim_t is never defined, its pointers are SimInstance pointers
+static inline SimInstance *toSim(socsim_t *sim)
+{
+    return reinterpret_cast<SimInstance*>(sim);
+}
+
+static inline const SimInstance *toSim(const socsim_t *sim)
+{
+    return reinterpret_cast<const SimInstance*>(sim);
+}
+
+
+/**
+ * @brief Fills in the profile built from soccfg.h
+ * @param profile location to store profile
+ */
+void socsim_default_profile(socsim_profile_t *profile)
+{
+    profile->register_count = defaultCPUProfile.registerCount;
+    profile->reset_vector = defaultCPUProfile.resetVector;
+    profile->stack_reset = defaultCPUProfile.stackReset;
+    profile->instruction_size = defaultCPUProfile.instructionSize;
+    profile->exception_vector = defaultCPUProfile.exceptionVector;
+}
+
+
+/**
+ * @brief Creates an instance on normal pages
+ * @param profile CPU profile, NULL for the default profile
+ * @return instance, NULL if the profile is not supported or out of
+ *         memory
+ */
+socsim_t *socsim_create(const socsim_profile_t *profile)
+{
+    CPUProfile cpuProfile = defaultCPUProfile;
+
+    if (profile != NULL) {
+        cpuProfile.registerCount = profile->register_count;
+        cpuProfile.resetVector = profile->reset_vector;
+        cpuProfile.stackReset = profile->stack_reset;
+        cpuProfile.instructionSize = profile->instruction_size;
+        cpuProfile.exceptionVector = profile->exception_vector;
+    }
+
+    return reinterpret_cast<socsim_t*>(createSimInstance(cpuProfile));
+}
+
+
+void socsim_destroy(socsim_t *sim)
+{
+    destroySimInstance(toSim(sim));
+}
+
+
+int socsim_reset(socsim_t *sim)
+{
+    return resetSim(*toSim(sim)) ? 1 : 0;
+}
+
+
+int socsim_load_image(socsim_t *sim, const void *image, uint32_t size)
+{
+    return loadSimImage(*toSim(sim), (const U8*)image, size) ? 1 : 0;
+}
+
+
+/**
+ * @brief Runs instructions until count have run or the CPU stops
+ * @param sim instance
+ * @param count instructions to run
+ * @param ran location to store instructions run, may be NULL
+ * @return SOCSIM_STOP_*
+ */
+int socsim_run(socsim_t *sim, uint64_t count, uint64_t *ran)
+{
+    U64 executed;
+    U32 reason = runSim(*toSim(sim), count, executed);
+
+    if (ran != NULL) {
+        *ran = executed;
+    }
+
+    return (int)reason;
+}
+
+
+uint32_t socsim_register_count(const socsim_t *sim)
+{
+    return getSimProfile(*toSim(sim)).registerCount;
+}
+
+
+int socsim_get_register(const socsim_t *sim, uint32_t index,
+                        uint32_t *value)
+{
+    U32 regValue;
+
+    if (!getSimRegister(*toSim(sim), index, regValue)) {
+        return 0;
+    }
+
+    *value = regValue;
+
+    return 1;
+}
+
+
+int socsim_set_register(socsim_t *sim, uint32_t index, uint32_t value)
+{
+    return setSimRegister(*toSim(sim), index, value) ? 1 : 0;
+}
+
+
+int socsim_read_memory(const socsim_t *sim, uint32_t address, void *dst,
+                       uint32_t length)
+{
+    return readSimMemory(*toSim(sim), address, (U8*)dst, length) ? 1 : 0;
+}
+
+
+int socsim_write_memory(socsim_t *sim, uint32_t address, const void *src,
+                        uint32_t length)
+{
+    return writeSimMemory(*toSim(sim), address, (const U8*)src, length) ?
+               1 : 0;
+}
+
+
+uint64_t socsim_instruction_count(const socsim_t *sim)
+{
+    return getSimContext(*toSim(sim)).instructionCount;
+}
+
+
+uint64_t socsim_cycle_count(const socsim_t *sim)
+{
+    return getSimContext(*toSim(sim)).cycleCount;
+}
+
+
+void socsim_get_fault(const socsim_t *sim, socsim_fault_t *fault)
+{
+    const CPUFault &cpuFault = getSimContext(*toSim(sim)).fault;
+
+    fault->kind = cpuFault.kind;
+    fault->address = cpuFault.address;
+    fault->size = cpuFault.size;
+    fault->pc = cpuFault.pc;
+}
@@ -0,0 +1,80 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the C interface of the simulator library,
+ *        a thin wrapper of socsim.h for callers that are not C++
+ */
+
+#ifndef _EWATC_SOCSIMC_H
+#define _EWATC_SOCSIMC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Instance of one SoC, the same rules as socsim.h: one thread at a
+   time per instance, no state shared between instances */
+typedef struct socsim socsim_t;
+
+typedef struct socsim_profile
+{
+    uint32_t register_count;    /* including PC and SP */
+    uint32_t reset_vector;
+    uint32_t stack_reset;
+    uint32_t instruction_size;
+    uint32_t exception_vector;  /* SOCSIM_NO_EXCEPTION_VECTOR to stop */
+} socsim_profile_t;
+
+typedef struct socsim_fault
+{
+    uint32_t kind;              /* SOCSIM_FAULT_* */
+    uint32_t address;
+    uint32_t size;
+    uint32_t pc;
+} socsim_fault_t;
+
+#define SOCSIM_NO_EXCEPTION_VECTOR  0xFFFFFFFFu
+
+/* Values of socsim_fault_t.kind, the same as CPUFaultKind */
+#define SOCSIM_FAULT_NONE       0
+#define SOCSIM_FAULT_FETCH      1
+#define SOCSIM_FAULT_ILLEGAL    2
+#define SOCSIM_FAULT_READ       3
+#define SOCSIM_FAULT_WRITE      4
+#define SOCSIM_FAULT_DIVIDE     5
+
+/* Return values of socsim_run, the same as SimStopReason */
+#define SOCSIM_STOP_LIMIT       0
+#define SOCSIM_STOP_FINISHED    1
+#define SOCSIM_STOP_INVALID     2
+
+/* Functions returning int return 1 for success and 0 for failure,
+   unless noted otherwise */
+void socsim_default_profile(socsim_profile_t *profile);
+socsim_t *socsim_create(const socsim_profile_t *profile);
+void socsim_destroy(socsim_t *sim);
+
+int socsim_reset(socsim_t *sim);
+int socsim_load_image(socsim_t *sim, const void *image, uint32_t size);
+
+int socsim_run(socsim_t *sim, uint64_t count, uint64_t *ran);
+
+uint32_t socsim_register_count(const socsim_t *sim);
+int socsim_get_register(const socsim_t *sim, uint32_t index,
+                        uint32_t *value);
+int socsim_set_register(socsim_t *sim, uint32_t index, uint32_t value);
+int socsim_read_memory(const socsim_t *sim, uint32_t address, void *dst,
+                       uint32_t length);
+int socsim_write_memory(socsim_t *sim, uint32_t address, const void *src,
+                        uint32_t length);
+
+uint64_t socsim_instruction_count(const socsim_t *sim);
+uint64_t socsim_cycle_count(const socsim_t *sim);
+void socsim_get_fault(const socsim_t *sim, socsim_fault_t *fault);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
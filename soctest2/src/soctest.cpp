@@ -4,48 +4,85 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "socbasic.h"
-
-// All known CPU OPCodes
-enum {
-    OPCODE_LOADLI = 0x01, // Fmt1
-    OPCODE_LOADHI = 0x02, // Fmt1
-    OPCODE_ADD    = 0x03, // Fmt2
-    OPCODE_SUB    = 0x04, // Fmt2
-    OPCODE_DIV    = 0x05, // Fmt2
-    OPCODE_STORE  = 0x10, // Fmt3
-    OPCODE_LOAD   = 0x11, // Fmt3
-    OPCODE_PUSH   = 0x20, // Fmt2
-    OPCODE_POP    = 0x21  // Fmt2
-};
+#include "socisa.h"
+#include "socsemantics.h"
+#include "socdisasm.h"
+#include "socmemutil.h"
+#include "socdebug.h"
+#include "socreverse.h"
+#include "soctrace.h"
 
 #define LOWVALUE(_value) (_value&0x0000FFFF)
 #define HIGHVALUE(_value) ((_value&0xFFFF0000) >> 16)
 #define NOT_USED    0xFF
 
+// Profile built from soccfg.h
+const CPUProfile defaultCPUProfile = {
+    MAX_CPU_REGISTERS,
+    CPU_PC_RESET_VECTOR,
+    MEMORY_SIZE,
+    CPU_INSTRUCTION_SIZE,
+    CPU_EXCEPTION_VECTOR
+};
+
+
 /**
- * @brief resets everything
+ * @brief resets everything using the default CPU profile
  * @param ctx CPU Context
  * @param mem Memory
  * @return true if success, otherwise failure
  */
 bool resetSoC(CPUContext &ctx, Memory &mem)
 {
+    return resetSoC(ctx, mem, defaultCPUProfile);
+}
+
+
+/**
+ * @brief resets everything
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param profile CPU profile to reset the CPU with
+ * @return true if success, otherwise failure
+ */
+bool resetSoC(CPUContext &ctx, Memory &mem, const CPUProfile &profile)
+{
+    if ((profile.registerCount < 3) ||
+        (profile.registerCount > CPU_REGISTER_FILE_SIZE)) {
+        return false;
+    }
+
     // Initialize CPU
-    for (int i=0; i<MAX_CPU_REGISTERS; ++i) {
+    for (int i=0; i<CPU_REGISTER_FILE_SIZE; ++i) {
         ctx.reg[i] = CPU_REGISTER_RESET_VALUE;
     }
+    ctx.registerCount = profile.registerCount;
 
     // Set PC to Reset Vector
-    ctx.reg[REG_PC] = CPU_PC_RESET_VECTOR;
-
-    // Set SP to top of memory
-    ctx.reg[REG_SP] = MEMORY_SIZE;
-
-    // Initialize Memory
-    for (int j=0; j<MEMORY_SIZE; ++j) {
-        mem.data[j] = MEMORY_RESET_VALUE;
-    }
+    ctx.reg[CPU_PC_INDEX(profile.registerCount)] = profile.resetVector;
+
+    // Set SP, by default the top of memory
+    ctx.reg[CPU_SP_INDEX(profile.registerCount)] = profile.stackReset;
+
+    ctx.instructionCount = 0;
+    ctx.cycleCount = 0;
+    ctx.instructionLimit = ~0ULL;
+    ctx.fault.kind = CPU_FAULT_NONE;
+    ctx.fault.address = 0;
+    ctx.fault.size = 0;
+    ctx.fault.pc = 0;
+    ctx.exceptionVector = profile.exceptionVector;
+    invalidateFetchBuffer(ctx.fetch);
+    ctx.debug = NULL;
+    ctx.history = NULL;
+    ctx.trace = NULL;
+    ctx.timing = NULL;
+
+    // Initialize Memory, page versions start from zero
+    memset(mem.pageVersion, 0, sizeof(mem.pageVersion));
+    fillMemory(mem, MEMORY_RESET_VALUE);
 
     return true;
 }
@@ -65,46 +102,46 @@ bool loadProgram(Memory &mem)
 
     {
         // reg0 = Return Address
-        instruction = buildCPUInstructionFmt1(0x01, 0x00, LOWVALUE(0x28));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADLI, 0x00, LOWVALUE(0x28));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
-        instruction = buildCPUInstructionFmt1(0x02, 0x00, HIGHVALUE(0x28));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADHI, 0x00, HIGHVALUE(0x28));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
         // push reg0 on to the stack
-        instruction = buildCPUInstructionFmt2(0x20, 0x00, NOT_USED, NOT_USED);
+        instruction = buildCPUInstructionFmt2(OPCODE_PUSH, 0x00, NOT_USED, NOT_USED);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
         // A = 4... reg[0] = 4
-        instruction = buildCPUInstructionFmt1(0x01, 0x00, LOWVALUE(4));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADLI, 0x00, LOWVALUE(4));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
-        instruction = buildCPUInstructionFmt1(0x02, 0x00, HIGHVALUE(4));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADHI, 0x00, HIGHVALUE(4));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
         // B = 3... reg[1] = 3
-        instruction = buildCPUInstructionFmt1(0x01, 0x01, LOWVALUE(3));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADLI, 0x01, LOWVALUE(3));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
-        instruction = buildCPUInstructionFmt1(0x02, 0x01, HIGHVALUE(3));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADHI, 0x01, HIGHVALUE(3));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
         // push reg0 on to the stack
-        instruction = buildCPUInstructionFmt2(0x20, 0x00, NOT_USED, NOT_USED);
+        instruction = buildCPUInstructionFmt2(OPCODE_PUSH, 0x00, NOT_USED, NOT_USED);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
         // push reg1 on to the stack
-        instruction = buildCPUInstructionFmt2(0x20, 0x01, NOT_USED, NOT_USED);
+        instruction = buildCPUInstructionFmt2(OPCODE_PUSH, 0x01, NOT_USED, NOT_USED);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
 		// Jump to funcAdd, 0x30
-        instruction = buildCPUInstructionFmt1(0x01, REG_PC, LOWVALUE(0x30));
+        instruction = buildCPUInstructionFmt1(OPCODE_LOADLI, REG_PC, LOWVALUE(0x30));
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
@@ -117,22 +154,22 @@ bool loadProgram(Memory &mem)
 		// int funcAdd(int A, int B)
 
         // pop reg1 (B) off of the stack
-        instruction = buildCPUInstructionFmt2(0x21, 0x01, NOT_USED, NOT_USED);
+        instruction = buildCPUInstructionFmt2(OPCODE_POP, 0x01, NOT_USED, NOT_USED);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
         // pop reg0 (A) off of the stack
-        instruction = buildCPUInstructionFmt2(0x21, 0x00, NOT_USED, NOT_USED);
+        instruction = buildCPUInstructionFmt2(OPCODE_POP, 0x00, NOT_USED, NOT_USED);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
 
 		// C = A + B
-        instruction = buildCPUInstructionFmt2(0x3, 0x00, 0x01, 0x01);
+        instruction = buildCPUInstructionFmt2(OPCODE_ADD, 0x00, 0x01, 0x01);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr +=4;
 
 		// pop PC, answer returned in reg1
-        instruction = buildCPUInstructionFmt2(0x21, REG_PC, NOT_USED, NOT_USED);
+        instruction = buildCPUInstructionFmt2(OPCODE_POP, REG_PC, NOT_USED, NOT_USED);
         write32Memory(mem, instrAddr, instruction.value32);
         instrAddr += 4;
     }
@@ -144,220 +181,765 @@ bool loadProgram(Memory &mem)
 
 
 /**
- * @brief executes 1 CPU instruction
+ * @brief Decodes one instruction field, register fields are bounds
+ *        checked, everything else is resolved at compile time
+ * @param instruction instruction word in host order
+ * @param op location to store decoded field
+ * @return true if field is valid, otherwise false
+ */
+template <typename Profile, int Role, int Index>
+static inline bool decodeInstructionField(U32 instruction, ISAOperands &op)
+{
+    U32 field = (instruction >> ((ISA_MAX_FIELDS - 1 - Index) * 8)) & 0xFF;
+
+    if (ISA_ROLE_IS_REGISTER(Role)) {
+        op.reg[Index] = (U8)field;
+        return (field < (U32)Profile::REGISTER_COUNT);
+    } else if (Role == ISA_ROLE_IMM16) {
+        op.imm = ISA_DATA16(instruction);
+    } else if (Role == ISA_ROLE_OFF8) {
+        op.imm = (U32)(S32)(S8)field;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Logs the old value of a register field the instruction
+ *        writes, other fields are skipped at compile time
+ * @param history history to record in
+ * @param ctx CPU Context
+ * @param op decoded instruction fields
+ */
+template <int Role, int Index>
+static inline void recordWrittenRegister(ReverseHistory &history,
+                                         const CPUContext &ctx,
+                                         const ISAOperands &op)
+{
+    if ((Role == ISA_ROLE_DST) || (Role == ISA_ROLE_SRCDST)) {
+        recordReverseRegister(history, ctx, op.reg[Index]);
+    }
+}
+
+
+/**
+ * @brief Traces the new value of a register field the instruction
+ *        wrote, other fields are skipped at compile time
+ * @param stream stream to trace to
+ * @param ctx CPU Context
+ * @param op decoded instruction fields
+ */
+template <int Role, int Index>
+static inline void traceWrittenRegister(TraceStream &stream,
+                                        const CPUContext &ctx,
+                                        const ISAOperands &op)
+{
+    if ((Role == ISA_ROLE_DST) || (Role == ISA_ROLE_SRCDST)) {
+        traceRegister(stream, op.reg[Index], ctx.reg[op.reg[Index]]);
+    }
+}
+
+
+/**
+ * @brief Decodes and executes one instruction, instantiated once per
+ *        entry of ISA_INSTRUCTIONS
  * @param ctx CPU Context
  * @param mem Memory
- * @return true if everything ok, otherwise stop program
+ * @param instruction instruction word in host order
+ * @return true if everything ok, otherwise false with ctx.fault set
  */
-bool executeCPUInstruction(CPUContext &ctx, Memory &mem)
+template <typename Profile, int Role1, int Role2, int Role3, int Cycles,
+          typename Semantics>
+static inline bool executeDecodedInstruction(CPUContext &ctx, Memory &mem,
+                                             U32 instruction)
 {
-    bool retval;
-    TestInstruction data;
-    U32 oldPC = ctx.reg[REG_PC];
+    ISAOperands op;
+
+    if (!decodeInstructionField<Profile, Role1, 0>(instruction, op) ||
+        !decodeInstructionField<Profile, Role2, 1>(instruction, op) ||
+        !decodeInstructionField<Profile, Role3, 2>(instruction, op)) {
+        return raiseCPUFault(ctx, CPU_FAULT_ILLEGAL, 0, 0);
+    }
+
+    if (Profile::RECORD && (ctx.history != NULL)) {
+        recordWrittenRegister<Role1, 0>(*ctx.history, ctx, op);
+        recordWrittenRegister<Role2, 1>(*ctx.history, ctx, op);
+        recordWrittenRegister<Role3, 2>(*ctx.history, ctx, op);
+    }
 
-    if (!read32Memory(mem, ctx.reg[REG_PC], data.value32)) {
-        printf("ERROR: Invalid address: 0x%08x\n", ctx.reg[REG_PC]);
+    if (!Semantics::template execute<Profile>(ctx, mem, op)) {
         return false;
     }
 
-    // Increment Program Count
-    ctx.reg[REG_PC] += CPU_INSTRUCTION_SIZE;
+    if (Profile::TRACE && (ctx.trace != NULL)) {
+        traceWrittenRegister<Role1, 0>(*ctx.trace, ctx, op);
+        traceWrittenRegister<Role2, 1>(*ctx.trace, ctx, op);
+        traceWrittenRegister<Role3, 2>(*ctx.trace, ctx, op);
+    }
 
-    // Process the instruction
-    switch (data.format1.opcode) {
-    case OPCODE_LOADLI: // LOAD LOW Immediate data into register
-        printf("0x%08x: OpCode: %8s(0x%02x) Reg[0x%02x].low = 0x%04x\n",
-                   oldPC,
-                   "LOADLI",
-                   data.format1.opcode,
-                   data.format1.regIndex,
-                   data.format1.data);
-
-        if (data.format1.regIndex >= MAX_CPU_REGISTERS) {
-            retval = false;
+    ctx.cycleCount += Cycles;
+
+    return true;
+}
+
+
+/**
+ * @brief Prints one instruction before it is executed
+ * @param pc address of instruction
+ * @param instruction instruction word in host order
+ * @param registerCount registers of the CPU profile
+ */
+static void traceCPUInstruction(U32 pc, U32 instruction, U32 registerCount)
+{
+    char text[DISASM_MAX_LENGTH];
+
+    disassembleInstruction(instruction, text, registerCount);
+    printf("0x%08x: 0x%08x  %s\n", pc, instruction, text);
+}
+
+
+/**
+ * @brief Enters the exception vector with a frame of the fault on the
+ *        stack. A stack that cannot take the frame stops the CPU.
+ * @param ctx CPU Context, fault is cleared if the vector is entered
+ * @param mem Memory
+ * @return true if the vector was entered, otherwise false
+ */
+template <typename Profile>
+static bool enterCPUExceptionVector(CPUContext &ctx, Memory &mem)
+{
+    U32 sp = ctx.reg[Profile::SP];
+
+    if (((sp & 0x3) != 0) || (sp < 12) || (sp > MEMORY_SIZE)) {
+        return false;
+    }
+
+    // Stores cannot fault, the frame was checked above
+    storeMemory32<Profile>(ctx, mem, sp - 4, ctx.fault.pc);
+    storeMemory32<Profile>(ctx, mem, sp - 8, ctx.fault.address);
+    storeMemory32<Profile>(ctx, mem, sp - 12, ctx.fault.kind);
+
+    ctx.reg[Profile::SP] = sp - 12;
+    ctx.reg[Profile::PC] = ctx.exceptionVector;
+    ctx.fault.kind = CPU_FAULT_NONE;
+
+    return true;
+}
+
+
+/**
+ * @brief Makes a fault precise, the faulting instruction did not
+ *        happen as far as PC and the counters are concerned, then
+ *        enters the exception vector if there is one
+ * @param ctx CPU Context, fault set by the instruction
+ * @param mem Memory
+ * @param pc address of the faulting instruction
+ * @return true if the CPU can continue, otherwise false
+ */
+template <typename Profile>
+static bool handleCPUFault(CPUContext &ctx, Memory &mem, U32 pc)
+{
+    bool entered;
+
+    ctx.fault.pc = pc;
+    ctx.reg[Profile::PC] = pc;
+
+    if (Profile::TRACE && (ctx.trace != NULL)) {
+        // Only the exception entry is traced, not the faulting access
+        rewindTraceRecord(*ctx.trace);
+    }
+
+    entered = (ctx.exceptionVector != CPU_NO_EXCEPTION_VECTOR) &&
+              enterCPUExceptionVector<Profile>(ctx, mem);
+
+    if (Profile::TRACE && (ctx.trace != NULL)) {
+        if (entered) {
+            traceRegister(*ctx.trace, Profile::SP, ctx.reg[Profile::SP]);
+            traceRegister(*ctx.trace, Profile::PC, ctx.reg[Profile::PC]);
+            commitTraceRecord(*ctx.trace, TRACE_FLAG_EXCEPTION);
         } else {
-            U32 value = ctx.reg[data.format1.regIndex];
+            abortTraceRecord(*ctx.trace);
+        }
+    }
+
+    return entered;
+}
+
+
+template <U32 RegisterCount, U32 InstructionSize, U32 Features>
+static bool executeProfileInstruction(CPUContext &ctx, Memory &mem);
 
-            value = (value&0xFFFF0000) | (data.format1.data&0xFFFF);
 
-            ctx.reg[data.format1.regIndex] = value;
+/**
+ * @brief Compile time view of an instruction of ISA_INSTRUCTIONS, lets
+ *        idioms run instructions chosen by opcode
+ */
+template <int Opcode>
+struct ISAInstructionTraits;
+
+#define ISA_TRAITS_ENTRY(_mnemonic, _opcode, _format, _role1, _role2, _role3, \
+                         _cycles, _semantics) \
+template <> \
+struct ISAInstructionTraits<_opcode> \
+{ \
+    enum { ROLE1 = _role1, ROLE2 = _role2, ROLE3 = _role3, CYCLES = _cycles }; \
+    typedef _semantics Semantics; \
+};
+ISA_INSTRUCTIONS(ISA_TRAITS_ENTRY)
+#undef ISA_TRAITS_ENTRY
+
+
+/**
+ * @brief Runs an instruction after the first of an idiom. An
+ *        instruction that faults is undone and left for the next call,
+ *        which runs it on its own so the fault is handled and counted
+ *        like any other.
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param pc address of the instruction
+ * @param word instruction in host order
+ * @param fault fault as it was before the idiom
+ * @return true if the instruction retired, otherwise false
+ */
+template <typename Profile, int Opcode>
+struct ISAIdiomStep
+{
+    static inline bool execute(CPUContext &ctx, Memory &mem, U32 pc,
+                               const U32 *word, const CPUFault &fault)
+    {
+        typedef ISAInstructionTraits<Opcode> Traits;
+
+        ctx.reg[Profile::PC] = pc + Profile::INSTRUCTION_SIZE;
+
+        if (CPU_TRACE_ENABLED) {
+            traceCPUInstruction(pc, *word, Profile::REGISTER_COUNT);
         }
-        break;
-    case OPCODE_LOADHI: // LOAD HIGH Immediate data into register
-        printf("0x%08x: OpCode: %8s(0x%02x) Reg[0x%02x].high = 0x%04x\n",
-                   oldPC,
-                   "LOADHI",
-                   data.format1.opcode,
-                   data.format1.regIndex,
-                   data.format1.data);
-
-        if (data.format1.regIndex >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else {
-            U32 value = ctx.reg[data.format1.regIndex];
 
-            value = (value&0x00000FFFF) | ((data.format1.data&0xFFFF) << 16);
+        if (!executeDecodedInstruction<Profile, Traits::ROLE1, Traits::ROLE2,
+                                       Traits::ROLE3, Traits::CYCLES,
+                                       typename Traits::Semantics>(ctx, mem,
+                                                                   *word)) {
+            ctx.reg[Profile::PC] = pc;
+            ctx.fault = fault;
+            return false;
+        }
+
+        ++ctx.instructionCount;
+
+        return true;
+    }
+};
+
+// Pairs have no third instruction
+template <typename Profile>
+struct ISAIdiomStep<Profile, ISA_IDIOM_END>
+{
+    static inline bool execute(CPUContext & /*ctx*/, Memory & /*mem*/,
+                               U32 /*pc*/, const U32 * /*word*/,
+                               const CPUFault & /*fault*/)
+    {
+        return false;
+    }
+};
+
+
+/**
+ * @brief Runs a pair of instructions as one operation. Only pairs that
+ *        cannot stop half way are fused: both registers are ordinary,
+ *        every access is in range and misses the idiom's line, and the
+ *        instruction limit leaves room for both. Anything else is left
+ *        to ISAIdiomStep, one instruction at a time.
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param pc address of the first instruction
+ * @param words instructions of the idiom in host order
+ * @return true if both instructions retired, false if nothing changed
+ */
+template <typename Profile, int Opcode1, int Opcode2, int Opcode3>
+struct ISAFusedIdiom
+{
+    static inline bool execute(CPUContext & /*ctx*/, Memory & /*mem*/,
+                               U32 /*pc*/, const U32 * /*words*/)
+    {
+        return false;
+    }
+};
+
+
+/**
+ * @brief Checks a register field of a fused pair names an ordinary
+ *        register, not PC or SP whose updates the pair would reorder
+ * @param field register field of the instruction
+ * @return true if the pair can be fused on this register
+ */
+template <typename Profile>
+static inline bool fusableCPURegister(U32 field)
+{
+    return (field < (U32)Profile::SP);
+}
+
+
+/**
+ * @brief Retires a fused pair, PC and the counters end as if both
+ *        instructions ran on their own
+ * @param ctx CPU Context
+ * @param pc address of the first instruction
+ * @param words instructions of the pair in host order
+ */
+template <typename Profile, int Opcode1, int Opcode2>
+static inline void retireCPUPair(CPUContext &ctx, U32 pc, const U32 *words)
+{
+    if (CPU_TRACE_ENABLED) {
+        traceCPUInstruction(pc, words[0], Profile::REGISTER_COUNT);
+        traceCPUInstruction(pc + Profile::INSTRUCTION_SIZE, words[1],
+                            Profile::REGISTER_COUNT);
+    }
+
+    ctx.reg[Profile::PC] = pc + (2 * Profile::INSTRUCTION_SIZE);
+    ctx.instructionCount += 2;
+    ctx.cycleCount += ISAInstructionTraits<Opcode1>::CYCLES +
+                      ISAInstructionTraits<Opcode2>::CYCLES;
+}
+
+// CONST, LOADLI and LOADHI of one register write the 32-bit value once
+template <typename Profile>
+struct ISAFusedIdiom<Profile, OPCODE_LOADLI, OPCODE_LOADHI, ISA_IDIOM_END>
+{
+    static inline bool execute(CPUContext &ctx, Memory & /*mem*/, U32 pc,
+                               const U32 *words)
+    {
+        U32 reg = ISA_BYTE1(words[0]);
 
-            ctx.reg[data.format1.regIndex] = value;
+        if ((reg != ISA_BYTE1(words[1])) ||
+            !fusableCPURegister<Profile>(reg) ||
+            ((ctx.instructionCount + 1) >= ctx.instructionLimit)) {
+            return false;
         }
-        break;
-    case OPCODE_ADD: // ADD reg1 + reg2 -> reg3
-        printf("0x%08x: OpCode: %8s(0x%02x) RegIndex: 0x%02x RegIndex: 0x%02x RegIndex: 0x%02x\n",
-                   oldPC,
-                   "ADD",
-                   data.format2.opcode,
-                   data.format2.regIndex1,
-                   data.format2.regIndex2,
-                   data.format2.regIndex3);
-
-        if (data.format2.regIndex1 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else if (data.format2.regIndex2 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else if (data.format2.regIndex3 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else {
-            // reg1 + reg2 -> reg3
-            U32 reg1 = ctx.reg[data.format2.regIndex1];
-            U32 reg2 = ctx.reg[data.format2.regIndex2];
-            U32 reg3;
 
-            reg3 = reg1 + reg2;
+        ctx.reg[reg] = (ISA_DATA16(words[1]) << 16) | ISA_DATA16(words[0]);
+        retireCPUPair<Profile, OPCODE_LOADLI, OPCODE_LOADHI>(ctx, pc, words);
 
-            ctx.reg[data.format2.regIndex3] = reg3;
+        return true;
+    }
+};
+
+// PUSH2, SP moves down once and both values are stored below it
+template <typename Profile>
+struct ISAFusedIdiom<Profile, OPCODE_PUSH, OPCODE_PUSH, ISA_IDIOM_END>
+{
+    static inline bool execute(CPUContext &ctx, Memory &mem, U32 pc,
+                               const U32 *words)
+    {
+        U32 reg1 = ISA_BYTE1(words[0]);
+        U32 reg2 = ISA_BYTE1(words[1]);
+        U32 sp = ctx.reg[Profile::SP];
+
+        if (!fusableCPURegister<Profile>(reg1) ||
+            !fusableCPURegister<Profile>(reg2) ||
+            ((sp & 0x3) != 0) || (sp < 8) || (sp > MEMORY_SIZE) ||
+            (((sp - 8) >> MEMORY_PAGE_SHIFT) == (pc >> MEMORY_PAGE_SHIFT)) ||
+            (((sp - 4) >> MEMORY_PAGE_SHIFT) == (pc >> MEMORY_PAGE_SHIFT)) ||
+            ((ctx.instructionCount + 1) >= ctx.instructionLimit)) {
+            return false;
         }
-        break;
-    case OPCODE_SUB: // SUB reg1 - reg2 -> reg3
-        printf("0x%08x: OpCode: %8s(0x%02x) RegIndex: 0x%02x RegIndex: 0x%02x RegIndex: 0x%02x\n",
-                   oldPC,
-                   "SUB",
-                   data.format2.opcode,
-                   data.format2.regIndex1,
-                   data.format2.regIndex2,
-                   data.format2.regIndex3);
-
-        if (data.format2.regIndex1 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else if (data.format2.regIndex2 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else if (data.format2.regIndex3 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else {
-            // reg1 - reg2 -> reg3
-            U32 reg1 = ctx.reg[data.format2.regIndex1];
-            U32 reg2 = ctx.reg[data.format2.regIndex2];
-            U32 reg3;
 
-            reg3 = reg1 - reg2;
+        // Stores cannot fault, both were checked above
+        storeMemory32<Profile>(ctx, mem, sp - 4, ctx.reg[reg1]);
+        storeMemory32<Profile>(ctx, mem, sp - 8, ctx.reg[reg2]);
+        ctx.reg[Profile::SP] = sp - 8;
+        retireCPUPair<Profile, OPCODE_PUSH, OPCODE_PUSH>(ctx, pc, words);
 
-            ctx.reg[data.format2.regIndex3] = reg3;
+        return true;
+    }
+};
+
+// POP2, both values are loaded above SP and SP moves up once
+template <typename Profile>
+struct ISAFusedIdiom<Profile, OPCODE_POP, OPCODE_POP, ISA_IDIOM_END>
+{
+    static inline bool execute(CPUContext &ctx, Memory &mem, U32 pc,
+                               const U32 *words)
+    {
+        U32 reg1 = ISA_BYTE1(words[0]);
+        U32 reg2 = ISA_BYTE1(words[1]);
+        U32 sp = ctx.reg[Profile::SP];
+        U32 value1;
+        U32 value2;
+
+        if (!fusableCPURegister<Profile>(reg1) ||
+            !fusableCPURegister<Profile>(reg2) ||
+            ((sp & 0x3) != 0) || (sp > MEMORY_SIZE - 8) ||
+            ((ctx.instructionCount + 1) >= ctx.instructionLimit)) {
+            return false;
         }
-        break;
-    case OPCODE_STORE: // mem[reg1] <- reg2
-        printf("0x%08x: OpCode: %8s(0x%02x) RegIndex: 0x%02x RegIndex: 0x%02x Offset: 0x%02x\n",
-               oldPC,
-               "STORE",
-               data.format3.opcode,
-               data.format3.regIndex1,
-               data.format3.regIndex2,
-               data.format3.data);
-
-        if (data.format3.regIndex1 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else if (data.format3.regIndex2 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else {
-            // reg1 has address
-            // reg2 has value
 
-            write32Memory(mem,
-                          ctx.reg[data.format3.regIndex1] + (S8)data.format3.data,  // address
-                          ctx.reg[data.format3.regIndex2]); // value
+        // Loads cannot fault, both were checked above
+        loadMemory32<Profile>(ctx, mem, sp, value1);
+        loadMemory32<Profile>(ctx, mem, sp + 4, value2);
+        ctx.reg[reg1] = value1;
+        ctx.reg[reg2] = value2;
+        ctx.reg[Profile::SP] = sp + 8;
+        retireCPUPair<Profile, OPCODE_POP, OPCODE_POP>(ctx, pc, words);
+
+        return true;
+    }
+};
+
+
+/**
+ * @brief Checks that the instruction after one of an idiom is the next
+ *        one to run: no jump was taken, the line holding the idiom was
+ *        not written and the instruction limit is not reached
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param pc address of the next instruction of the idiom
+ * @return true if the idiom can go on
+ */
+template <typename Profile>
+static inline bool continueCPUIdiom(const CPUContext &ctx, const Memory &mem,
+                                    U32 pc)
+{
+    return (ctx.reg[Profile::PC] == pc) &&
+           (ctx.instructionCount < ctx.instructionLimit) &&
+           (mem.pageVersion[pc >> MEMORY_PAGE_SHIFT] ==
+            fetchLineOf(ctx.fetch, pc).version);
+}
+
+
+/**
+ * @brief Runs an idiom with one dispatch, as one operation if
+ *        ISAFusedIdiom has a handler for it and the operands allow,
+ *        otherwise one instruction at a time. The first instruction
+ *        faults like any other. The idiom stops early, with the instructions
+ *        so far retired, at a jump, a write to its own line, the
+ *        instruction limit, or an instruction that faults, so PC and
+ *        the counters are always those of the instructions retired.
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @param pc address of the first instruction
+ * @param words instructions of the idiom in host order
+ * @return true if everything ok, otherwise stop program
+ */
+template <typename Profile, int Opcode1, int Opcode2, int Opcode3>
+static bool executeCPUIdiom(CPUContext &ctx, Memory &mem, U32 pc,
+                            const U32 *words)
+{
+    const U32 size = Profile::INSTRUCTION_SIZE;
+    CPUFault fault = ctx.fault;
+
+    if (ISAFusedIdiom<Profile, Opcode1, Opcode2, Opcode3>::execute(ctx, mem, pc,
+                                                                   words)) {
+        return true;
+    }
+
+    if (!ISAIdiomStep<Profile, Opcode1>::execute(ctx, mem, pc, words, fault)) {
+        // Nothing retired, run it again on its own to handle the fault
+        return executeProfileInstruction<Profile::REGISTER_COUNT,
+                                         Profile::INSTRUCTION_SIZE, 0>(ctx,
+                                                                       mem);
+    }
+
+    if (continueCPUIdiom<Profile>(ctx, mem, pc + size) &&
+        ISAIdiomStep<Profile, Opcode2>::execute(ctx, mem, pc + size,
+                                                words + 1, fault) &&
+        continueCPUIdiom<Profile>(ctx, mem, pc + (2 * size))) {
+        ISAIdiomStep<Profile, Opcode3>::execute(ctx, mem, pc + (2 * size),
+                                                words + 2, fault);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief executes 1 CPU instruction, specialized for one CPU profile.
+ *        Debug executors stop before a breakpoint and after an
+ *        instruction that hit a watchpoint, leaving ctx.debug->hit set.
+ *        Recording executors log an undo entry to ctx.history and
+ *        tracing executors write every retired instruction to
+ *        ctx.trace. Fusing executors run a whole idiom when one starts
+ *        at PC, timing executors pass every access to ctx.timing.
+ *        Nothing is printed unless CPU_TRACE_ENABLED, a fault is left
+ *        in ctx.fault for the caller.
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @return true if everything ok, otherwise stop program
+ */
+template <U32 RegisterCount, U32 InstructionSize, U32 Features>
+static bool executeProfileInstruction(CPUContext &ctx, Memory &mem)
+{
+    typedef CPUProfileTraits<RegisterCount, InstructionSize, Features> Profile;
+
+    bool retval;
+    TestInstruction data;
+    U32 oldPC = ctx.reg[Profile::PC];
+
+    if (Profile::DEBUG && (ctx.debug != NULL) &&
+        checkDebugBreakpoint(*ctx.debug, oldPC)) {
+        ctx.debug->hit.pc = oldPC;
+        return false;
+    }
+
+    if (Profile::RECORD && (ctx.history != NULL)) {
+        beginReverseEntry(*ctx.history, ctx, mem, Profile::PC, Profile::SP);
+    }
+
+    U32 oldSP = ctx.reg[Profile::SP];
+    if (Profile::TRACE && (ctx.trace != NULL)) {
+        beginTraceRecord(*ctx.trace, oldPC);
+    }
+
+    if (SOC_UNLIKELY(!fetch32Memory(mem, ctx.fetch, oldPC, data.value32))) {
+        raiseCPUFault(ctx, CPU_FAULT_FETCH, oldPC, Profile::INSTRUCTION_SIZE);
+        return handleCPUFault<Profile>(ctx, mem, oldPC);
+    }
+
+    if (Profile::TRACE && (ctx.trace != NULL)) {
+        traceInstructionWord(*ctx.trace, data.value32);
+    }
+
+    if (Profile::TIMING && (ctx.timing != NULL)) {
+        ctx.timing->access(soc::TIMING_FETCH, oldPC);
+    }
+
+    // Idioms found when the line was fetched, 4 byte instructions only
+    const FetchLine &held = fetchLineOf(ctx.fetch, oldPC);
+    if (Profile::FUSE && (Profile::INSTRUCTION_SIZE == 4) &&
+        (held.line == (oldPC & ~(U32)(MEMORY_PAGE_SIZE - 1)))) {
+        U32 index = (oldPC >> 2) & (FETCH_LINE_WORDS - 1);
+
+        switch (held.idiom[index]) {
+#define ISA_IDIOM_CASE(_name, _opcode1, _opcode2, _opcode3) \
+        case ISA_IDIOM_##_name: \
+            return executeCPUIdiom<Profile, _opcode1, _opcode2, _opcode3>( \
+                       ctx, mem, oldPC, &held.word[index]);
+        ISA_IDIOMS(ISA_IDIOM_CASE)
+#undef ISA_IDIOM_CASE
+        default:
+            break;
         }
+    }
+
+    // Increment Program Count
+    ctx.reg[Profile::PC] += Profile::INSTRUCTION_SIZE;
+
+    if (CPU_TRACE_ENABLED) {
+        traceCPUInstruction(oldPC, data.value32, RegisterCount);
+    }
+
+    // Process the instruction, one case per entry of ISA_INSTRUCTIONS
+    switch (data.format1.opcode) {
+#define ISA_EXECUTE_CASE(_mnemonic, _opcode, _format, _role1, _role2, _role3, \
+                         _cycles, _semantics) \
+    case OPCODE_##_mnemonic: \
+        retval = executeDecodedInstruction<Profile, _role1, _role2, _role3, \
+                                           _cycles, _semantics>(ctx, mem, \
+                                                                data.value32); \
         break;
-    case OPCODE_LOAD: // reg2 <- mem[reg1]
-        printf("0x%08x: OpCode: %8s(0x%02x) RegIndex: 0x%02x RegIndex: 0x%02x Offset: 0x%02x\n",
-               oldPC,
-               "LOAD",
-               data.format3.opcode,
-               data.format3.regIndex1,
-               data.format3.regIndex2,
-               data.format3.data);
-
-        if (data.format3.regIndex1 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else if (data.format3.regIndex2 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else {
-            // reg1 has address
-            // reg2 has value
+    ISA_INSTRUCTIONS(ISA_EXECUTE_CASE)
+#undef ISA_EXECUTE_CASE
+    default:
+        // Invalid opcode
+        retval = raiseCPUFault(ctx, CPU_FAULT_ILLEGAL, 0, 0);
+    }
 
-            read32Memory(mem,
-                         ctx.reg[data.format3.regIndex1] + (S8)data.format3.data,  // address
-                         ctx.reg[data.format3.regIndex2]); // value
+    if (SOC_UNLIKELY(retval == false)) {
+        if (ctx.fault.kind == CPU_FAULT_ILLEGAL) {
+            ctx.fault.address = oldPC;
         }
-        break;
-    case OPCODE_PUSH: // SP = SP - 4, mem[SP] = reg1
-        printf("0x%08x: OpCode: %8s(0x%02x) RegIndex: 0x%02x\n",
-               oldPC,
-               "PUSH",
-               data.format2.opcode,
-               data.format2.regIndex1);
-
-        if (data.format2.regIndex1 >= MAX_CPU_REGISTERS) {
+        retval = handleCPUFault<Profile>(ctx, mem, oldPC);
+    } else {
+        ++ctx.instructionCount;
+
+        if (Profile::TRACE && (ctx.trace != NULL)) {
+            // PUSH and POP move SP without naming it
+            if (ctx.reg[Profile::SP] != oldSP) {
+                traceRegister(*ctx.trace, Profile::SP, ctx.reg[Profile::SP]);
+            }
+            commitTraceRecord(*ctx.trace, 0);
+        }
+
+        if (Profile::DEBUG && (ctx.debug != NULL) && ctx.debug->hit.hit) {
+            // Watchpoint, stop with the instruction completed
+            ctx.debug->hit.pc = oldPC;
             retval = false;
-        } else {
-            // reg1 has value
+        }
+    }
 
-            // Update Stack Pointer
-            ctx.reg[REG_SP] = ctx.reg[REG_SP] - 4;
+    return retval;
+}
 
-            // Store value on the stack
-            write32Memory(mem,
-                          ctx.reg[REG_SP],  // address
-                          ctx.reg[data.format2.regIndex1]); // value
-        }
-        break;
-    case OPCODE_POP: // reg1 = mem[SP], SP = SP + 4
-        printf("0x%08x: OpCode: %8s(0x%02x) RegIndex: 0x%02x\n",
-               oldPC,
-               "POP",
-               data.format2.opcode,
-               data.format2.regIndex1);
-
-        if (data.format2.regIndex1 >= MAX_CPU_REGISTERS) {
-            retval = false;
-        } else {
-            // reg1 is where the value is stored
 
-            // Store value on the stack
-            read32Memory(mem,
-                         ctx.reg[REG_SP],  // address
-                         ctx.reg[data.format2.regIndex1]); // value
+/**
+ * @brief executes 1 CPU instruction using the default CPU profile
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @return true if everything ok, otherwise stop program
+ */
+bool executeCPUInstruction(CPUContext &ctx, Memory &mem)
+{
+    return executeProfileInstruction<MAX_CPU_REGISTERS,
+                                     CPU_INSTRUCTION_SIZE, 0>(ctx, mem);
+}
+
 
-            // Update Stack Pointer
-            ctx.reg[REG_SP] = ctx.reg[REG_SP] + 4;
-        }
-        break;
+/**
+ * @brief Finds the executor compiled for a register count
+ * @param registerCount registers of the CPU profile
+ * @return executor, NULL if no executor is compiled for the count
+ */
+template <U32 InstructionSize, U32 Features>
+static CPUExecuteFunction selectCPUExecutorForSize(U32 registerCount)
+{
+    switch (registerCount) {
+#define CPU_SELECT_REGISTER_COUNT(_count) \
+    case _count: \
+        return executeProfileInstruction<_count, InstructionSize, Features>;
+    CPU_PROFILE_REGISTER_COUNTS(CPU_SELECT_REGISTER_COUNT)
+#undef CPU_SELECT_REGISTER_COUNT
     default:
-        // Invalid opcode
-        printf("0x%08x: OpCode: %8s(0x%02x) Byte1: 0x%02x Byte2: 0x%02x Byte3: 0x%02x\n",
-               oldPC,
-               "INVALID",
-               data.format1.opcode,
-               data.value8[1],
-               data.value8[2],
-               data.value8[3]);
+        return NULL;
+    }
+}
 
-        retval = false;
+
+/**
+ * @brief Finds the executor compiled for a set of features
+ * @param registerCount registers of the CPU profile
+ * @param features CPU_EXECUTE_* flags
+ * @return executor, NULL if none is compiled for the count or features
+ */
+template <U32 InstructionSize>
+static CPUExecuteFunction selectCPUExecutorForFeatures(U32 registerCount,
+                                                       U32 features)
+{
+    switch (features) {
+#define CPU_SELECT_FEATURES(_features) \
+    case _features: \
+        return selectCPUExecutorForSize<InstructionSize, _features>( \
+                   registerCount);
+    CPU_EXECUTE_FEATURES(CPU_SELECT_FEATURES)
+#undef CPU_SELECT_FEATURES
+    default:
+        return NULL;
+    }
+}
+
+
+/**
+ * @brief Selects the executor specialized for a CPU profile, call once
+ *        at startup and pass the result to runProgram
+ * @param profile CPU profile
+ * @param features CPU_EXECUTE_* flags, CPU_EXECUTE_DEBUG checks the
+ *                 breakpoints and watchpoints of ctx.debug and
+ *                 CPU_EXECUTE_RECORD logs undo entries to ctx.history.
+ *                 Executors without a feature never look at its state.
+ *                 CPU_EXECUTE_FUSE only works alone, run it with
+ *                 stepCPU to count the instructions of each call.
+ *                 CPU_EXECUTE_TIMING only works alone and feeds
+ *                 ctx.timing.
+ *                 Flags without a compiled executor return NULL.
+ * @return executor, NULL if the profile is not supported
+ */
+CPUExecuteFunction selectCPUExecutor(const CPUProfile &profile, U32 features)
+{
+    if ((profile.instructionSize == 0) ||
+        ((profile.resetVector % profile.instructionSize) != 0)) {
+        return NULL;
     }
 
-    if (retval == false) {
-        // Last operation did not succeed
-        printf("Last opcode failed to execute @ 0x%08x\n",
-               oldPC);
+    switch (profile.instructionSize) {
+#define CPU_SELECT_INSTRUCTION_SIZE(_size) \
+    case _size: \
+        return selectCPUExecutorForFeatures<_size>(profile.registerCount, \
+                                                   features);
+    CPU_PROFILE_INSTRUCTION_SIZES(CPU_SELECT_INSTRUCTION_SIZE)
+#undef CPU_SELECT_INSTRUCTION_SIZE
+    default:
+        return NULL;
     }
+}
 
-    return retval;
+
+/**
+ * @brief Forgets any loop head, call before a run
+ * @param idle loop state
+ */
+void resetIdleLoop(IdleLoop &idle)
+{
+    idle.armed = false;
+    idle.periodInstructions = 0;
+    idle.periodCycles = 0;
 }
 
+
+/**
+ * @brief Called after a backward jump. Compares the SoC with its state
+ *        the last time the CPU jumped back to the same pc, and
+ *        remembers the new head otherwise. Runs with debug, record,
+ *        trace or timing state attached are never idle, those see every
+ *        instruction.
+ * @param idle loop state
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @return true if nothing changed over an iteration, idle then holds
+ *         its instructions and cycles
+ */
+bool matchIdleLoop(IdleLoop &idle, const CPUContext &ctx, const Memory &mem)
+{
+    U32 pc = ctx.reg[CPU_PC_INDEX(ctx.registerCount)];
+    bool same;
+
+    if ((ctx.debug != NULL) || (ctx.history != NULL) ||
+        (ctx.trace != NULL) || (ctx.timing != NULL)) {
+        return false;
+    }
+
+    same = idle.armed && (idle.head == pc) &&
+           (memcmp(idle.reg, ctx.reg,
+                   ctx.registerCount * sizeof(ctx.reg[0])) == 0) &&
+           (memcmp(idle.pageVersion, mem.pageVersion,
+                   sizeof(mem.pageVersion)) == 0);
+
+    if (same) {
+        idle.periodInstructions = ctx.instructionCount -
+                                  idle.instructionCount;
+        idle.periodCycles = ctx.cycleCount - idle.cycleCount;
+    } else {
+        idle.armed = true;
+        idle.head = pc;
+        memcpy(idle.reg, ctx.reg, ctx.registerCount * sizeof(ctx.reg[0]));
+        memcpy(idle.pageVersion, mem.pageVersion, sizeof(mem.pageVersion));
+    }
+
+    // Counters of the head, only registers and memory are compared
+    idle.instructionCount = ctx.instructionCount;
+    idle.cycleCount = ctx.cycleCount;
+
+    return same && (idle.periodInstructions != 0);
+}
+
+
+/**
+ * @brief Moves the counters past the whole iterations of an idle loop
+ *        that fit in a budget, the loop ends where it started so no
+ *        other state changes
+ * @param idle loop matched by matchIdleLoop
+ * @param ctx CPU Context
+ * @param budget instructions left in the run
+ * @return instructions skipped
+ */
+U64 skipIdleLoop(const IdleLoop &idle, CPUContext &ctx, U64 budget)
+{
+    if (idle.periodInstructions == 0) {
+        return 0;
+    }
+
+    U64 iterations = budget / idle.periodInstructions;
+
+    ctx.instructionCount += iterations * idle.periodInstructions;
+    ctx.cycleCount += iterations * idle.periodCycles;
+
+    return iterations * idle.periodInstructions;
+}
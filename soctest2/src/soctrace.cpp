@@ -0,0 +1,473 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Instruction trace writer and reader
+ */
+
+#include <soc/lzblock.h>
+#include "soctrace.h"
+
+static const char traceMagic[8] = {'S', 'O', 'C', 'T', 'R', 'A', 'C', 'E'};
+static const U32 traceByteOrder = 0x01020304;
+
+#define TRACE_CHUNK_HEADER  20
+
+
+/**
+ * @brief Appends a 32-bit value in host order
+ */
+static void appendTraceU32(std::vector<U8> &out, U32 value)
+{
+    const U8 *bytes = (const U8*)&value;
+
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+
+/**
+ * @brief Writes the collected chunks to the file
+ * @param writer trace file
+ * @return true if success, otherwise false
+ */
+static bool flushTraceOutput(TraceWriter &writer)
+{
+    if (writer.output.empty()) {
+        return true;
+    }
+
+    size_t written = fwrite(writer.output.data(), 1, writer.output.size(),
+                            writer.fp);
+    bool ok = (written == writer.output.size());
+
+    writer.output.clear();
+
+    return ok;
+}
+
+
+/**
+ * @brief Compresses one block in to a chunk of the output, the block
+ *        is stored as is if it does not get smaller
+ * @param writer trace file
+ * @param block block of records
+ */
+static void writeTraceChunk(TraceWriter &writer, const TraceBlock &block)
+{
+    size_t stored = soc::lzCompress(block.data.data(), block.used,
+                                    writer.scratch.data(),
+                                    writer.scratch.size());
+    bool compressed = (stored != 0) && (stored < block.used);
+
+    if (!compressed) {
+        stored = block.used;
+    }
+
+    appendTraceU32(writer.output, block.stream);
+    appendTraceU32(writer.output, block.records);
+    appendTraceU32(writer.output, (U32)block.used);
+    appendTraceU32(writer.output, (U32)stored);
+    appendTraceU32(writer.output, compressed ? TRACE_CHUNK_COMPRESSED : 0);
+
+    const U8 *data = compressed ? writer.scratch.data() : block.data.data();
+    writer.output.insert(writer.output.end(), data, data + stored);
+}
+
+
+/**
+ * @brief Background thread, compresses queued blocks and writes them
+ *        once TRACE_WRITE_SIZE bytes are collected
+ * @param writer trace file
+ */
+static void traceWriterThread(TraceWriter *writer)
+{
+    std::unique_lock<std::mutex> guard(writer->lock);
+
+    for (;;) {
+        while (writer->queue.empty() && !writer->closing) {
+            writer->wake.wait(guard);
+        }
+
+        if (writer->queue.empty()) {
+            // Closing and nothing left
+            break;
+        }
+
+        TraceBlock *block = writer->queue.front();
+        writer->queue.pop_front();
+
+        // Streams keep running while the block is compressed
+        guard.unlock();
+        writeTraceChunk(*writer, *block);
+        bool ok = true;
+        if (writer->output.size() >= TRACE_WRITE_SIZE) {
+            ok = flushTraceOutput(*writer);
+        }
+        guard.lock();
+
+        if (!ok) {
+            writer->failed = true;
+        }
+        block->busy = false;
+        writer->released.notify_all();
+    }
+
+    guard.unlock();
+    if (!flushTraceOutput(*writer)) {
+        guard.lock();
+        writer->failed = true;
+    }
+}
+
+
+/**
+ * @brief Creates a trace file and starts its writer thread
+ * @param writer trace file to set up
+ * @param path file to create
+ * @param blockSize bytes of records per block
+ * @return true if success, otherwise false
+ */
+bool openTraceWriter(TraceWriter &writer, const char *path, size_t blockSize)
+{
+    if (blockSize < (TRACE_MAX_RECORD * 2)) {
+        return false;
+    }
+
+    writer.fp = fopen(path, "wb");
+    if (writer.fp == NULL) {
+        return false;
+    }
+
+    writer.blockSize = blockSize;
+    writer.streams = 0;
+    writer.closing = false;
+    writer.failed = false;
+    writer.queue.clear();
+    writer.output.clear();
+    writer.output.reserve(TRACE_WRITE_SIZE +
+                          soc::lzCompressBound(blockSize) +
+                          TRACE_CHUNK_HEADER);
+    writer.scratch.resize(soc::lzCompressBound(blockSize));
+
+    writer.output.insert(writer.output.end(), traceMagic,
+                         traceMagic + sizeof(traceMagic));
+    appendTraceU32(writer.output, TRACE_VERSION);
+    appendTraceU32(writer.output, traceByteOrder);
+
+    writer.thread = std::thread(traceWriterThread, &writer);
+
+    return true;
+}
+
+
+/**
+ * @brief Waits for every queued block to be written, then closes the
+ *        file. Every stream must be closed first.
+ * @param writer trace file
+ * @return true if everything was written, otherwise false
+ */
+bool closeTraceWriter(TraceWriter &writer)
+{
+    {
+        std::lock_guard<std::mutex> guard(writer.lock);
+
+        writer.closing = true;
+        writer.wake.notify_one();
+    }
+
+    writer.thread.join();
+
+    bool ok = !writer.failed;
+
+    if (fclose(writer.fp) != 0) {
+        ok = false;
+    }
+    writer.fp = NULL;
+
+    return ok;
+}
+
+
+/**
+ * @brief Sets up a stream for the calling thread
+ * @param stream stream to set up
+ * @param writer trace file the stream writes to
+ * @return true if success, otherwise false
+ */
+bool openTraceStream(TraceStream &stream, TraceWriter &writer)
+{
+    {
+        std::lock_guard<std::mutex> guard(writer.lock);
+
+        stream.id = writer.streams++;
+    }
+
+    stream.writer = &writer;
+
+    for (int i=0; i<2; ++i) {
+        TraceBlock &block = stream.blocks[i];
+
+        block.data.resize(writer.blockSize);
+        block.stream = stream.id;
+        block.records = 0;
+        block.used = 0;
+        block.busy = false;
+    }
+
+    stream.current = 0;
+    stream.pos = stream.blocks[0].data.data();
+    stream.record = stream.pos;
+    stream.limit = stream.pos + writer.blockSize - TRACE_MAX_RECORD;
+
+    return true;
+}
+
+
+/**
+ * @brief Hands the current block to the writer thread and continues in
+ *        the other one, waiting only if that one is still being
+ *        compressed
+ * @param stream stream of the calling thread
+ */
+void switchTraceBlock(TraceStream &stream)
+{
+    TraceWriter &writer = *stream.writer;
+    TraceBlock &full = stream.blocks[stream.current];
+    std::unique_lock<std::mutex> guard(writer.lock);
+
+    full.used = stream.pos - full.data.data();
+    if (full.records != 0) {
+        full.busy = true;
+        writer.queue.push_back(&full);
+        writer.wake.notify_one();
+    }
+
+    stream.current ^= 1;
+
+    TraceBlock &next = stream.blocks[stream.current];
+    while (next.busy) {
+        writer.released.wait(guard);
+    }
+
+    next.records = 0;
+    next.used = 0;
+    stream.pos = next.data.data();
+    stream.record = stream.pos;
+    stream.limit = stream.pos + writer.blockSize - TRACE_MAX_RECORD;
+}
+
+
+/**
+ * @brief Hands over the last records of a stream and waits until the
+ *        writer thread is done with both blocks
+ * @param stream stream of the calling thread
+ */
+void closeTraceStream(TraceStream &stream)
+{
+    TraceWriter &writer = *stream.writer;
+
+    switchTraceBlock(stream);
+
+    std::unique_lock<std::mutex> guard(writer.lock);
+    while (stream.blocks[0].busy || stream.blocks[1].busy) {
+        writer.released.wait(guard);
+    }
+}
+
+
+/**
+ * @brief Opens a trace file for reading
+ * @param reader reader to set up
+ * @param path trace file
+ * @return true if success, otherwise false
+ */
+bool openTraceReader(TraceReader &reader, const char *path)
+{
+    char magic[sizeof(traceMagic)];
+    U32 header[2];
+
+    reader.failed = false;
+    reader.offset = 0;
+    reader.length = 0;
+    reader.stream = 0;
+    reader.remaining = 0;
+
+    reader.fp = fopen(path, "rb");
+    if (reader.fp == NULL) {
+        return false;
+    }
+
+    if ((fread(magic, 1, sizeof(magic), reader.fp) != sizeof(magic)) ||
+        (memcmp(magic, traceMagic, sizeof(magic)) != 0) ||
+        (fread(header, sizeof(U32), 2, reader.fp) != 2) ||
+        (header[0] != TRACE_VERSION) || (header[1] != traceByteOrder)) {
+        fclose(reader.fp);
+        reader.fp = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Reads and decompresses the next chunk
+ * @param reader trace reader
+ * @return true if success, false at the end of the file or on damage
+ */
+static bool readTraceChunk(TraceReader &reader)
+{
+    U32 header[TRACE_CHUNK_HEADER / sizeof(U32)];
+    size_t count = fread(header, sizeof(U32), TRACE_CHUNK_HEADER / sizeof(U32),
+                         reader.fp);
+
+    if (count == 0) {
+        return false;
+    }
+    if (count != (TRACE_CHUNK_HEADER / sizeof(U32))) {
+        reader.failed = true;
+        return false;
+    }
+
+    U32 rawLength = header[2];
+    U32 storedLength = header[3];
+
+    reader.stored.resize(storedLength);
+    if (fread(reader.stored.data(), 1, storedLength, reader.fp) !=
+        storedLength) {
+        reader.failed = true;
+        return false;
+    }
+
+    if ((header[4] & TRACE_CHUNK_COMPRESSED) != 0) {
+        size_t produced;
+
+        reader.raw.resize(rawLength);
+        if (!soc::lzDecompress(reader.stored.data(), storedLength,
+                          reader.raw.data(), rawLength, produced) ||
+            (produced != rawLength)) {
+            reader.failed = true;
+            return false;
+        }
+    } else {
+        if (storedLength != rawLength) {
+            reader.failed = true;
+            return false;
+        }
+        reader.raw.swap(reader.stored);
+    }
+
+    reader.stream = header[0];
+    reader.remaining = header[1];
+    reader.offset = 0;
+    reader.length = rawLength;
+
+    return true;
+}
+
+
+/**
+ * @brief Reads the next record, chunks are read one at a time so any
+ *        size of trace can be streamed
+ * @param reader trace reader
+ * @param record location to store the record
+ * @return true if success, false at the end of the trace, reader.failed
+ *         tells whether the file was damaged
+ */
+bool readTraceRecord(TraceReader &reader, TraceRecord &record)
+{
+    while (reader.remaining == 0) {
+        if (!readTraceChunk(reader)) {
+            return false;
+        }
+    }
+
+    const U8 *ptr = reader.raw.data() + reader.offset;
+    const U8 *end = reader.raw.data() + reader.length;
+
+    if ((end - ptr) < TRACE_RECORD_HEADER) {
+        reader.failed = true;
+        return false;
+    }
+
+    record.stream = reader.stream;
+    memcpy(&record.pc, ptr, sizeof(U32));
+    memcpy(&record.instruction, ptr + 4, sizeof(U32));
+    record.flags = ptr[8];
+    record.entryCount = ptr[9];
+    ptr += TRACE_RECORD_HEADER;
+
+    if (record.entryCount > TRACE_MAX_ENTRIES) {
+        reader.failed = true;
+        return false;
+    }
+
+    for (U32 i=0; i<record.entryCount; ++i) {
+        TraceEntry &entry = record.entries[i];
+
+        if (ptr >= end) {
+            reader.failed = true;
+            return false;
+        }
+
+        entry.kind = ptr[0];
+        if ((entry.kind == TRACE_ENTRY_REGISTER) && ((end - ptr) >= 6)) {
+            entry.index = ptr[1];
+            entry.address = 0;
+            memcpy(&entry.value, ptr + 2, sizeof(U32));
+            ptr += 6;
+        } else if ((entry.kind == TRACE_ENTRY_MEMORY) && ((end - ptr) >= 9)) {
+            entry.index = 0;
+            memcpy(&entry.address, ptr + 1, sizeof(U32));
+            memcpy(&entry.value, ptr + 5, sizeof(U32));
+            ptr += 9;
+        } else {
+            reader.failed = true;
+            return false;
+        }
+    }
+
+    reader.offset = ptr - reader.raw.data();
+    --reader.remaining;
+
+    return true;
+}
+
+
+/**
+ * @brief Closes a trace file opened for reading
+ * @param reader trace reader
+ */
+void closeTraceReader(TraceReader &reader)
+{
+    if (reader.fp != NULL) {
+        fclose(reader.fp);
+        reader.fp = NULL;
+    }
+}
+
+
+/**
+ * @brief Prints one record as a line of text
+ * @param fp file to print to
+ * @param record record to print
+ */
+void printTraceRecord(FILE *fp, const TraceRecord &record)
+{
+    fprintf(fp, "%u 0x%08x: 0x%08x", record.stream, record.pc,
+            record.instruction);
+
+    if ((record.flags & TRACE_FLAG_EXCEPTION) != 0) {
+        fprintf(fp, " exception");
+    }
+
+    for (U32 i=0; i<record.entryCount; ++i) {
+        const TraceEntry &entry = record.entries[i];
+
+        if (entry.kind == TRACE_ENTRY_REGISTER) {
+            fprintf(fp, " r%u=0x%08x", entry.index, entry.value);
+        } else {
+            fprintf(fp, " [0x%08x]=0x%08x", entry.address, entry.value);
+        }
+    }
+
+    fprintf(fp, "\n");
+}
@@ -0,0 +1,230 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the binary instruction trace, written in
+ *        compressed blocks by a background thread and read back as a
+ *        stream of records
+ */
+
+#ifndef _EWATC_SOCTRACE_H
+#define _EWATC_SOCTRACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "types.h"
+#include "socmemory.h"
+
+// Bytes of records a stream fills before handing a block over
+#define TRACE_DEFAULT_BLOCK     (256 * 1024)
+
+// Compressed chunks are collected and written this many bytes at a time
+#define TRACE_WRITE_SIZE        (1024 * 1024)
+
+// Record layout, in host order:
+//   U32 pc, U32 instruction, U8 flags, U8 entry count, then entries
+//   register  U8 TRACE_ENTRY_REGISTER, U8 index, U32 new value
+//   memory    U8 TRACE_ENTRY_MEMORY, U32 address, U32 new value
+#define TRACE_RECORD_HEADER     10
+#define TRACE_MAX_ENTRIES       8
+#define TRACE_MAX_RECORD        (TRACE_RECORD_HEADER + (TRACE_MAX_ENTRIES * 9))
+
+#define TRACE_ENTRY_REGISTER    0
+#define TRACE_ENTRY_MEMORY      1
+
+// Record flags
+#define TRACE_FLAG_EXCEPTION    0x1     // not retired, exception vector
+                                        // entered, pc is the faulting
+                                        // instruction
+
+// File layout:
+//   "SOCTRACE", U32 version, U32 0x01020304 in the writer's order
+//   chunks of U32 stream, U32 records, U32 raw length, U32 stored
+//   length, U32 flags, then stored length bytes
+#define TRACE_VERSION           1
+#define TRACE_CHUNK_COMPRESSED  0x1
+
+struct TraceBlock
+{
+    std::vector<U8> data;
+    U32 stream;
+    U32 records;
+    size_t used;
+    bool busy;          // owned by the writer thread
+};
+
+/**
+ * @brief One trace file, shared by every stream writing to it. A
+ *        background thread compresses the blocks handed to it and
+ *        writes them in large sequential writes.
+ */
+struct TraceWriter
+{
+    FILE *fp;
+    size_t blockSize;
+    U32 streams;
+
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;       // block queued or closing
+    std::condition_variable released;   // block compressed
+    std::deque<TraceBlock*> queue;
+    bool closing;
+    bool failed;
+
+    std::vector<U8> output;             // chunks not yet written
+    std::vector<U8> scratch;            // compression buffer
+};
+
+/**
+ * @brief Records of one simulation thread, double buffered so the
+ *        thread keeps filling one block while the other is compressed
+ */
+struct TraceStream
+{
+    TraceWriter *writer;
+    U32 id;
+    TraceBlock blocks[2];
+    U32 current;
+
+    U8 *record;         // header of the open record
+    U8 *pos;            // next free byte of the current block
+    U8 *limit;          // a record can start before limit
+};
+
+struct TraceEntry
+{
+    U8 kind;            // TRACE_ENTRY_*
+    U8 index;           // register index
+    U32 address;        // memory address
+    U32 value;
+};
+
+struct TraceRecord
+{
+    U32 stream;
+    U32 pc;
+    U32 instruction;
+    U8 flags;
+    U8 entryCount;
+    TraceEntry entries[TRACE_MAX_ENTRIES];
+};
+
+struct TraceReader
+{
+    FILE *fp;
+    bool failed;        // damaged or truncated file
+    std::vector<U8> stored;
+    std::vector<U8> raw;
+    size_t offset;      // next record in raw
+    size_t length;      // bytes of raw in use
+    U32 stream;
+    U32 remaining;      // records left in the chunk
+};
+
+bool openTraceWriter(TraceWriter &writer, const char *path,
+                     size_t blockSize=TRACE_DEFAULT_BLOCK);
+bool closeTraceWriter(TraceWriter &writer);
+bool openTraceStream(TraceStream &stream, TraceWriter &writer);
+void closeTraceStream(TraceStream &stream);
+void switchTraceBlock(TraceStream &stream);
+
+bool openTraceReader(TraceReader &reader, const char *path);
+bool readTraceRecord(TraceReader &reader, TraceRecord &record);
+void closeTraceReader(TraceReader &reader);
+void printTraceRecord(FILE *fp, const TraceRecord &record);
+
+
+/**
+ * @brief Opens the record of one instruction, called before it is
+ *        fetched
+ * @param stream stream of the calling thread
+ * @param pc address of the instruction
+ */
+static inline void beginTraceRecord(TraceStream &stream, U32 pc)
+{
+    if (SOC_UNLIKELY(stream.pos >= stream.limit)) {
+        switchTraceBlock(stream);
+    }
+
+    stream.record = stream.pos;
+    memcpy(stream.record, &pc, sizeof(pc));
+    memset(stream.record + 4, 0, TRACE_RECORD_HEADER - 4);
+    stream.pos += TRACE_RECORD_HEADER;
+}
+
+/**
+ * @brief Sets the instruction word of the open record
+ */
+static inline void traceInstructionWord(TraceStream &stream, U32 instruction)
+{
+    memcpy(stream.record + 4, &instruction, sizeof(instruction));
+}
+
+/**
+ * @brief Adds a register write to the open record
+ * @param stream stream of the calling thread
+ * @param index register written
+ * @param value value written
+ */
+static inline void traceRegister(TraceStream &stream, U8 index, U32 value)
+{
+    if (stream.record[9] < TRACE_MAX_ENTRIES) {
+        stream.pos[0] = TRACE_ENTRY_REGISTER;
+        stream.pos[1] = index;
+        memcpy(stream.pos + 2, &value, sizeof(value));
+        stream.pos += 6;
+        ++stream.record[9];
+    }
+}
+
+/**
+ * @brief Adds a memory write to the open record
+ * @param stream stream of the calling thread
+ * @param address location written
+ * @param value value written
+ */
+static inline void traceMemoryWrite(TraceStream &stream, U32 address,
+                                    U32 value)
+{
+    if (stream.record[9] < TRACE_MAX_ENTRIES) {
+        stream.pos[0] = TRACE_ENTRY_MEMORY;
+        memcpy(stream.pos + 1, &address, sizeof(address));
+        memcpy(stream.pos + 5, &value, sizeof(value));
+        stream.pos += 9;
+        ++stream.record[9];
+    }
+}
+
+/**
+ * @brief Drops the entries of the open record, the record stays open
+ */
+static inline void rewindTraceRecord(TraceStream &stream)
+{
+    stream.pos = stream.record + TRACE_RECORD_HEADER;
+    stream.record[9] = 0;
+}
+
+/**
+ * @brief Drops the open record, the instruction left no trace
+ */
+static inline void abortTraceRecord(TraceStream &stream)
+{
+    stream.pos = stream.record;
+}
+
+/**
+ * @brief Closes the open record
+ * @param stream stream of the calling thread
+ * @param flags TRACE_FLAG_* of the record
+ */
+static inline void commitTraceRecord(TraceStream &stream, U8 flags)
+{
+    stream.record[8] = flags;
+    ++stream.blocks[stream.current].records;
+}
+
+#endif
@@ -0,0 +1,535 @@
+/**
+ * @author Wayne Moorefield
+ * @brief Verifies final CPU and memory state against a spec
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include "socverify.h"
+#include "socmemutil.h"
+#include "socimage.h"
+
+// Bytes per mem line written by writeVerifySpec
+#define VERIFY_MEM_LINE_SIZE 32
+
+
+/**
+ * @brief Returns the next white space separated token of a line
+ * @param ptr current position, updated past the token
+ * @param end end of line
+ * @param token location to store token
+ * @return true if a token was found
+ */
+static bool nextToken(const char *&ptr, const char *end, std::string &token)
+{
+    while ((ptr < end) && isspace((unsigned char)*ptr)) {
+        ++ptr;
+    }
+
+    const char *start = ptr;
+    while ((ptr < end) && !isspace((unsigned char)*ptr)) {
+        ++ptr;
+    }
+
+    token.assign(start, ptr - start);
+
+    return (ptr != start);
+}
+
+
+/**
+ * @brief Parses a decimal or 0x prefixed number, negative numbers and
+ *        numbers past 64 bits are rejected
+ */
+static bool parseNumber(const std::string &token, U64 &value)
+{
+    char *end;
+
+    if (token.empty() || !isdigit((unsigned char)token[0])) {
+        return false;
+    }
+
+    errno = 0;
+    value = strtoull(token.c_str(), &end, 0);
+
+    return (*end == '\0') && (errno != ERANGE);
+}
+
+
+/**
+ * @brief Parses a number that must fit in 32 bits, a larger one is an
+ *        error rather than truncated
+ */
+static bool parseNumber32(const std::string &token, U32 &value)
+{
+    U64 wide;
+
+    if (!parseNumber(token, wide) || (wide > 0xFFFFFFFFULL)) {
+        return false;
+    }
+
+    value = (U32)wide;
+
+    return true;
+}
+
+
+/**
+ * @brief Parses a register name, r<n>, pc or sp
+ */
+static bool parseRegister(const std::string &token, U32 &regIndex)
+{
+    U64 value;
+
+    if (token == "pc") {
+        regIndex = VERIFY_REG_PC;
+        return true;
+    }
+
+    if (token == "sp") {
+        regIndex = VERIFY_REG_SP;
+        return true;
+    }
+
+    if ((token.size() < 2) || (token[0] != 'r') ||
+        !isdigit((unsigned char)token[1]) ||
+        !parseNumber(token.substr(1), value) ||
+        (value >= CPU_REGISTER_FILE_SIZE)) {
+        return false;
+    }
+
+    regIndex = (U32)value;
+
+    return true;
+}
+
+
+/**
+ * @brief Converts a hex digit
+ * @return value of digit, -1 if not a hex digit
+ */
+static int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Parses hex bytes, white space between bytes is ignored
+ */
+static bool parseHexBytes(const char *ptr, const char *end,
+                          std::vector<U8> &bytes)
+{
+    int high = -1;
+
+    for (; ptr < end; ++ptr) {
+        if (isspace((unsigned char)*ptr)) {
+            continue;
+        }
+
+        int digit = hexValue(*ptr);
+        if (digit < 0) {
+            return false;
+        }
+
+        if (high < 0) {
+            high = digit;
+        } else {
+            bytes.push_back((U8)((high << 4) | digit));
+            high = -1;
+        }
+    }
+
+    return ((high < 0) && !bytes.empty());
+}
+
+
+/**
+ * @brief Parses a verification spec
+ * @param text spec text
+ * @param length length of text in bytes
+ * @param spec location to store spec
+ * @param errorLine set to the line number of an error
+ * @return true if success, otherwise false
+ */
+bool parseVerifySpec(const char *text, size_t length,
+                     VerifySpec &spec, U32 &errorLine)
+{
+    const char *ptr = text;
+    const char *end = text + length;
+    std::string token;
+    std::string valueToken;
+
+    spec.registers.clear();
+    spec.memory.clear();
+    spec.checkHash = false;
+    spec.checkInstructions = false;
+    spec.checkCycles = false;
+    errorLine = 0;
+
+    while (ptr < end) {
+        const char *eol = ptr;
+        while ((eol < end) && (*eol != '\n')) {
+            ++eol;
+        }
+
+        const char *lineEnd = ptr;
+        while ((lineEnd < eol) && (*lineEnd != '#')) {
+            ++lineEnd;
+        }
+
+        const char *cur = ptr;
+        ptr = eol + 1;
+        ++errorLine;
+
+        if (!nextToken(cur, lineEnd, token)) {
+            continue;
+        }
+
+        U64 value;
+
+        if (token == "mem") {
+            VerifyMemory check;
+
+            if (!nextToken(cur, lineEnd, valueToken) ||
+                !parseNumber32(valueToken, check.address) ||
+                !parseHexBytes(cur, lineEnd, check.bytes)) {
+                return false;
+            }
+
+            spec.memory.push_back(check);
+            continue;
+        }
+
+        if (!nextToken(cur, lineEnd, valueToken) ||
+            !parseNumber(valueToken, value) ||
+            nextToken(cur, lineEnd, valueToken)) {
+            return false;
+        }
+
+        if (token == "hash") {
+            spec.checkHash = true;
+            spec.hash = value;
+        } else if (token == "instructions") {
+            spec.checkInstructions = true;
+            spec.instructions = value;
+        } else if (token == "cycles") {
+            spec.checkCycles = true;
+            spec.cycles = value;
+        } else {
+            VerifyRegister check;
+
+            if (!parseRegister(token, check.regIndex) ||
+                (value > 0xFFFFFFFFULL)) {
+                return false;
+            }
+
+            check.value = (U32)value;
+            spec.registers.push_back(check);
+        }
+    }
+
+    errorLine = 0;
+
+    return true;
+}
+
+
+/**
+ * @brief Loads a verification spec file
+ * @param path file to load
+ * @param spec location to store spec
+ * @param errorLine set to the line number of an error, 0 if the file
+ *                  could not be read
+ * @return true if success, otherwise false
+ */
+bool loadVerifySpec(const char *path, VerifySpec &spec, U32 &errorLine)
+{
+    std::vector<U8> text;
+
+    errorLine = 0;
+    if (!readFile(path, text)) {
+        return false;
+    }
+
+    return parseVerifySpec((const char*)text.data(), text.size(),
+                           spec, errorLine);
+}
+
+
+/**
+ * @brief Writes a spec that the current state passes, used to
+ *        produce golden results. Memory still holding the reset value
+ *        is only covered by the hash.
+ * @param fp file to write to
+ * @param ctx CPU Context
+ * @param mem Memory
+ * @return true if success, otherwise false
+ */
+bool writeVerifySpec(FILE *fp, const CPUContext &ctx, const Memory &mem)
+{
+    U8 row[VERIFY_MEM_LINE_SIZE];
+
+    for (U32 i=0; i<ctx.registerCount - 2; ++i) {
+        fprintf(fp, "r%u 0x%08x\n", i, ctx.reg[i]);
+    }
+    fprintf(fp, "sp 0x%08x\n", ctx.reg[CPU_SP_INDEX(ctx.registerCount)]);
+    fprintf(fp, "pc 0x%08x\n", ctx.reg[CPU_PC_INDEX(ctx.registerCount)]);
+    fprintf(fp, "instructions %llu\n", ctx.instructionCount);
+    fprintf(fp, "cycles %llu\n", ctx.cycleCount);
+    fprintf(fp, "hash 0x%016llx\n", hashMemory(mem));
+
+    for (U32 address=0; address<MEMORY_SIZE; address+=VERIFY_MEM_LINE_SIZE) {
+        U32 length = MEMORY_SIZE - address;
+        bool reset = true;
+
+        if (length > VERIFY_MEM_LINE_SIZE) {
+            length = VERIFY_MEM_LINE_SIZE;
+        }
+
+        readMemoryBlock(mem, address, row, length);
+        for (U32 i=0; i<length; ++i) {
+            if (row[i] != MEMORY_RESET_VALUE) {
+                reset = false;
+                break;
+            }
+        }
+
+        if (reset) {
+            continue;
+        }
+
+        fprintf(fp, "mem 0x%08x ", address);
+        for (U32 i=0; i<length; ++i) {
+            fprintf(fp, "%02x", row[i]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    return (ferror(fp) == 0);
+}
+
+
+// Lets the compiler check the arguments of a printf style function
+#if defined(__GNUC__) || defined(__clang__)
+    #define SOC_PRINTF_FORMAT(_fmt, _args) \
+        __attribute__((format(printf, _fmt, _args)))
+#else
+    #define SOC_PRINTF_FORMAT(_fmt, _args)
+#endif
+
+/**
+ * @brief Records a failed check
+ */
+static void addFailure(VerifyReport &report, const char *format, ...)
+    SOC_PRINTF_FORMAT(2, 3);
+
+static void addFailure(VerifyReport &report, const char *format, ...)
+{
+    char message[128];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    report.passed = false;
+    report.failures.push_back(message);
+}
+
+
+/**
+ * @brief Checks a result against a spec
+ * @param spec expected results
+ * @param ctx final CPU Context
+ * @param mem final Memory
+ * @param report location to store outcome, name is left alone
+ * @return true if every check passed, otherwise false
+ */
+bool verifyResult(const VerifySpec &spec, const CPUContext &ctx,
+                  const Memory &mem, VerifyReport &report)
+{
+    report.passed = true;
+    report.checks = 0;
+    report.failures.clear();
+
+    for (size_t i=0; i<spec.registers.size(); ++i) {
+        const VerifyRegister &check = spec.registers[i];
+        U32 regIndex = check.regIndex;
+
+        if (regIndex == VERIFY_REG_PC) {
+            regIndex = CPU_PC_INDEX(ctx.registerCount);
+        } else if (regIndex == VERIFY_REG_SP) {
+            regIndex = CPU_SP_INDEX(ctx.registerCount);
+        }
+
+        ++report.checks;
+        if (regIndex >= ctx.registerCount) {
+            addFailure(report, "r%u does not exist", regIndex);
+        } else if (ctx.reg[regIndex] != check.value) {
+            addFailure(report, "r%u = 0x%08x expected 0x%08x",
+                       regIndex, ctx.reg[regIndex], check.value);
+        }
+    }
+
+    for (size_t i=0; i<spec.memory.size(); ++i) {
+        const VerifyMemory &check = spec.memory[i];
+        U32 length = (U32)check.bytes.size();
+        U32 address = compareMemoryBlock(mem, check.address,
+                                         check.bytes.data(), length);
+
+        ++report.checks;
+        if (address == check.address + length) {
+            continue;
+        }
+
+        if ((check.address > MEMORY_SIZE) ||
+            (length > (MEMORY_SIZE - check.address))) {
+            addFailure(report, "mem 0x%08x+%u is outside of memory",
+                       check.address, length);
+        } else {
+            addFailure(report, "mem 0x%08x = 0x%02x expected 0x%02x",
+                       address, mem.data[address ^ MEMORY_XOR8],
+                       check.bytes[address - check.address]);
+        }
+    }
+
+    if (spec.checkHash) {
+        U64 hash = hashMemory(mem);
+
+        ++report.checks;
+        if (hash != spec.hash) {
+            addFailure(report, "hash = 0x%016llx expected 0x%016llx",
+                       hash, spec.hash);
+        }
+    }
+
+    if (spec.checkInstructions) {
+        ++report.checks;
+        if (ctx.instructionCount != spec.instructions) {
+            addFailure(report, "instructions = %llu expected %llu",
+                       ctx.instructionCount, spec.instructions);
+        }
+    }
+
+    if (spec.checkCycles) {
+        ++report.checks;
+        if (ctx.cycleCount != spec.cycles) {
+            addFailure(report, "cycles = %llu expected %llu",
+                       ctx.cycleCount, spec.cycles);
+        }
+    }
+
+    return report.passed;
+}
+
+
+/**
+ * @brief Verifies a batch of results in parallel
+ * @param jobs results and the spec each one is checked against
+ * @param threads number of worker threads, 0 uses every host thread
+ * @param reports location to store one report per job, in job order
+ * @return number of jobs that failed
+ */
+U32 verifyBatch(const std::vector<VerifyJob> &jobs, U32 threads,
+                std::vector<VerifyReport> &reports)
+{
+    std::atomic<size_t> next(0);
+    std::atomic<U32> failed(0);
+    std::vector<std::thread> workers;
+
+    reports.clear();
+    reports.resize(jobs.size());
+
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads > jobs.size()) {
+        threads = (U32)jobs.size();
+    }
+
+    auto worker = [&]() {
+        size_t i;
+
+        while ((i = next.fetch_add(1)) < jobs.size()) {
+            reports[i].name = jobs[i].name;
+            if (!verifyResult(*jobs[i].spec, *jobs[i].ctx, *jobs[i].mem,
+                              reports[i])) {
+                failed.fetch_add(1);
+            }
+        }
+    };
+
+    // Calling thread does its share of the work
+    for (U32 t=1; t<threads; ++t) {
+        workers.push_back(std::thread(worker));
+    }
+    worker();
+
+    for (size_t t=0; t<workers.size(); ++t) {
+        workers[t].join();
+    }
+
+    return failed.load();
+}
+
+
+/**
+ * @brief Writes a JSON string, escaping as needed
+ */
+static void writeJSONString(FILE *fp, const std::string &str)
+{
+    fputc('"', fp);
+
+    for (size_t i=0; i<str.size(); ++i) {
+        unsigned char c = (unsigned char)str[i];
+
+        if ((c == '"') || (c == '\\')) {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+
+    fputc('"', fp);
+}
+
+
+/**
+ * @brief Writes a report as one line of JSON
+ * @param fp file to write to
+ * @param report report to write
+ */
+void writeVerifyReport(FILE *fp, const VerifyReport &report)
+{
+    fprintf(fp, "{\"name\":");
+    writeJSONString(fp, report.name);
+    fprintf(fp, ",\"result\":\"%s\",\"checks\":%u,\"failures\":[",
+            report.passed ? "pass" : "fail", report.checks);
+
+    for (size_t i=0; i<report.failures.size(); ++i) {
+        if (i > 0) {
+            fputc(',', fp);
+        }
+        writeJSONString(fp, report.failures[i]);
+    }
+
+    fprintf(fp, "]}\n");
+}
@@ -0,0 +1,81 @@
+/**
+ * @author Wayne Moorefield
+ * @brief This file contains the result verification prototypes
+ */
+
+#ifndef _EWATC_SOCVERIFY_H
+#define _EWATC_SOCVERIFY_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "socbasic.h"
+
+// Spec file, one constraint per line, # starts a comment:
+//   r<n>|pc|sp <value>          register must equal value
+//   mem <address> <hex bytes>   memory must hold bytes (SoC byte order)
+//   hash <value>                hashMemory() of all of memory, only
+//                               matches builds with the same
+//                               MEMORY_HOST_ORDER
+//   instructions <count>        retired instruction count
+//   cycles <count>              cycle count
+// Numbers are decimal or 0x prefixed hex. Register values and addresses
+// past 32 bits are an error on their line.
+
+struct VerifyRegister
+{
+    U32 regIndex;   // VERIFY_REG_PC/VERIFY_REG_SP or an index
+    U32 value;
+};
+
+struct VerifyMemory
+{
+    U32 address;
+    std::vector<U8> bytes;
+};
+
+// pc and sp depend on the profile the result was produced with
+#define VERIFY_REG_PC 0x100
+#define VERIFY_REG_SP 0x101
+
+struct VerifySpec
+{
+    std::vector<VerifyRegister> registers;
+    std::vector<VerifyMemory> memory;
+    bool checkHash;
+    U64 hash;
+    bool checkInstructions;
+    U64 instructions;
+    bool checkCycles;
+    U64 cycles;
+};
+
+struct VerifyJob
+{
+    std::string name;
+    const VerifySpec *spec;
+    const CPUContext *ctx;
+    const Memory *mem;
+};
+
+struct VerifyReport
+{
+    std::string name;
+    bool passed;
+    U32 checks;
+    std::vector<std::string> failures;
+};
+
+bool parseVerifySpec(const char *text, size_t length,
+                     VerifySpec &spec, U32 &errorLine);
+bool loadVerifySpec(const char *path, VerifySpec &spec, U32 &errorLine);
+bool writeVerifySpec(FILE *fp, const CPUContext &ctx, const Memory &mem);
+
+bool verifyResult(const VerifySpec &spec, const CPUContext &ctx,
+                  const Memory &mem, VerifyReport &report);
+U32 verifyBatch(const std::vector<VerifyJob> &jobs, U32 threads,
+                std::vector<VerifyReport> &reports);
+
+void writeVerifyReport(FILE *fp, const VerifyReport &report);
+
+#endif
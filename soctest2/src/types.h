@@ -9,9 +9,11 @@
 typedef unsigned int U32;
 typedef unsigned short U16;
 typedef unsigned char U8;
+typedef unsigned long long U64;
 
 typedef signed int S32;
 typedef signed short S16;
 typedef signed char S8;
+typedef signed long long S64;
 
 #endif